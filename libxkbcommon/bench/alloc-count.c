@@ -0,0 +1,87 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Heap allocations counter for the benchmarks, to be loaded with LD_PRELOAD.
+ *
+ * It forwards the allocation functions to the glibc implementation. The
+ * benchmarks look up `bench_allocations_count()` at run time and report
+ * the allocations only if the counter is loaded.
+ *
+ * It must not be used together with sanitizers, which interpose the same
+ * functions.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <malloc.h>
+#include <stdlib.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+size_t
+bench_allocations_count(void);
+
+/* The benchmarks are single-threaded */
+static size_t allocations_count = 0;
+
+size_t
+bench_allocations_count(void)
+{
+    return allocations_count;
+}
+
+void *
+malloc(size_t size)
+{
+    allocations_count++;
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+    allocations_count++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    allocations_count++;
+    return __libc_realloc(ptr, size);
+}
+
+void *
+memalign(size_t alignment, size_t size)
+{
+    allocations_count++;
+    return __libc_memalign(alignment, size);
+}
+
+void *
+aligned_alloc(size_t alignment, size_t size)
+{
+    allocations_count++;
+    return __libc_memalign(alignment, size);
+}
+
+int
+posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    if (alignment % sizeof(void *) != 0 ||
+        (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+    allocations_count++;
+    void * const p = __libc_memalign(alignment, size);
+    if (!p && size)
+        return ENOMEM;
+    *ptr = p;
+    return 0;
+}
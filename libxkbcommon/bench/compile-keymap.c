@@ -19,6 +19,25 @@
 #define DEFAULT_ITERATIONS 3000
 #define DEFAULT_STDEV 0.05
 
+#ifdef __GLIBC__
+#include <dlfcn.h>
+
+/*
+ * Count the heap allocations if the counter of bench/alloc-count.c is
+ * preloaded, as done by `meson benchmark`.
+ */
+#define HAVE_ALLOCATIONS_COUNT
+typedef size_t (*allocations_count_func)(void);
+
+static allocations_count_func
+get_allocations_counter(void)
+{
+    allocations_count_func counter;
+    *(void **) &counter = dlsym(RTLD_DEFAULT, "bench_allocations_count");
+    return counter;
+}
+#endif
+
 static void
 usage(FILE *fp, char **argv)
 {
@@ -370,6 +389,30 @@ main(int argc, char **argv)
     dup2(stderr_old, STDERR_FILENO);
     close(stderr_old);
 
+#ifdef HAVE_ALLOCATIONS_COUNT
+    /* Allocations for a single run */
+    const allocations_count_func allocations_count = get_allocations_counter();
+    const size_t allocations_start = (allocations_count)
+        ? allocations_count()
+        : 0;
+#ifdef KEYMAP_DUMP
+    char *s = xkb_keymap_get_as_string2(keymap, keymap_output_format,
+                                        serialize_flags);
+    assert(s);
+    free(s);
+#else
+    keymap = xkb_keymap_new_from_buffer(
+        context, keymap_str, keymap_str_length,
+        keymap_input_format, XKB_KEYMAP_COMPILE_NO_FLAGS
+    );
+    assert(keymap);
+    xkb_keymap_unref(keymap);
+#endif
+    const size_t allocations = (allocations_count)
+        ? allocations_count() - allocations_start
+        : 0;
+#endif
+
 #ifdef KEYMAP_DUMP
     xkb_keymap_unref(keymap);
 #else
@@ -398,6 +441,10 @@ main(int argc, char **argv)
                 max_iterations, elapsed.seconds, elapsed.nanoseconds / 1000,
                 total_elapsed.seconds, total_elapsed.nanoseconds / 1000);
     }
+#ifdef HAVE_ALLOCATIONS_COUNT
+    if (allocations_count)
+        fprintf(stderr, "allocations per run: %zu\n", allocations);
+#endif
 
 keymap_error:
     xkb_context_unref(context);
@@ -22,10 +22,27 @@ compose_fn(struct xkb_compose_table_entry *entry, void *data)
     assert (entry);
 }
 
-/* Benchmark compose traversal using:
- * • the internal recursive function `xkb_compose_table_for_each` if `foreach` is
- *   is passed as argument to the program;
- * • else the iterator API (`xkb_compose_table_iterator_new`, …).
+enum traversal {
+    TRAVERSAL_ITERATOR,
+    TRAVERSAL_ITERATOR_INIT,
+    TRAVERSAL_FOREACH,
+    TRAVERSAL_RECURSIVE,
+};
+
+static const char *traversal_names[] = {
+    [TRAVERSAL_ITERATOR] = "iterator",
+    [TRAVERSAL_ITERATOR_INIT] = "iterator-init",
+    [TRAVERSAL_FOREACH] = "foreach",
+    [TRAVERSAL_RECURSIVE] = "recursive",
+};
+
+/* Benchmark compose traversal using, depending on the program argument:
+ * • `iterator` (default): the iterator API (`xkb_compose_table_iterator_new`,
+ *   …), with one heap allocation per traversal;
+ * • `iterator-init`: the iterator API with caller-provided storage
+ *   (`xkb_compose_table_iterator_init`), without any heap allocation;
+ * • `foreach`: the callback API `xkb_compose_table_for_each`;
+ * • `recursive`: the recursive reference implementation used in tests.
  */
 int
 main(int argc, char *argv[])
@@ -37,7 +54,19 @@ main(int argc, char *argv[])
     struct bench bench;
     char *elapsed;
 
-    bool use_foreach_impl = (argc > 1 && strcmp(argv[1], "foreach") == 0);
+    enum traversal traversal = TRAVERSAL_ITERATOR;
+    if (argc > 1) {
+        for (size_t k = 0; k < ARRAY_SIZE(traversal_names); k++) {
+            if (strcmp(argv[1], traversal_names[k]) == 0) {
+                traversal = (enum traversal) k;
+                break;
+            }
+            if (k + 1 == ARRAY_SIZE(traversal_names)) {
+                fprintf(stderr, "ERROR: unknown traversal: %s\n", argv[1]);
+                return EXIT_INVALID_USAGE;
+            }
+        }
+    }
 
     ctx = test_get_context(CONTEXT_NO_FLAG);
     assert(ctx);
@@ -60,27 +89,49 @@ main(int argc, char *argv[])
     fclose(file);
     assert(table);
 
+    const size_t storage_size = xkb_compose_table_iterator_storage_size(table);
+    void *storage = malloc(storage_size);
+    assert(storage);
+    size_t allocations = 0;
+
     bench_start(&bench);
     for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
-        if (use_foreach_impl) {
-            xkb_compose_table_for_each(table, compose_fn, NULL);
-        } else {
-            struct xkb_compose_table_iterator *iter;
-            struct xkb_compose_table_entry *entry;
+        struct xkb_compose_table_iterator *iter;
+        struct xkb_compose_table_entry *entry;
+        switch (traversal) {
+        case TRAVERSAL_ITERATOR:
             iter = xkb_compose_table_iterator_new(table);
+            allocations++;
             while ((entry = xkb_compose_table_iterator_next(iter))) {
                 assert (entry);
             }
             xkb_compose_table_iterator_free(iter);
+            break;
+        case TRAVERSAL_ITERATOR_INIT:
+            iter = xkb_compose_table_iterator_init(table, storage,
+                                                   storage_size);
+            while ((entry = xkb_compose_table_iterator_next(iter))) {
+                assert (entry);
+            }
+            break;
+        case TRAVERSAL_FOREACH:
+            xkb_compose_table_for_each(table, compose_fn, NULL);
+            break;
+        case TRAVERSAL_RECURSIVE:
+            compose_table_for_each_recursive(table, compose_fn, NULL);
+            break;
         }
     }
     bench_stop(&bench);
 
+    free(storage);
     xkb_compose_table_unref(table);
 
     elapsed = bench_elapsed_str(&bench);
-    fprintf(stderr, "traversed %d compose tables in %ss\n",
-            BENCHMARK_ITERATIONS, elapsed);
+    fprintf(stderr, "traversed %d compose tables in %ss (%s); "
+            "iterator heap allocations: %zu (%zu bytes each)\n",
+            BENCHMARK_ITERATIONS, elapsed, traversal_names[traversal],
+            allocations, storage_size);
     free(elapsed);
 
     xkb_context_unref(ctx);
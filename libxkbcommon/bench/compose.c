@@ -8,12 +8,42 @@
 #include <time.h>
 
 #include "xkbcommon/xkbcommon-compose.h"
+#include "src/compose/table.h"
 
 #include "../test/test.h"
 #include "bench.h"
 
 #define BENCHMARK_ITERATIONS 1000
 
+/* Report the memory used by the table, compared to storing every result
+ * string separately. */
+static void
+report_table_memory(struct xkb_compose_table *table)
+{
+    struct xkb_compose_table_iterator *iter;
+    struct xkb_compose_table_entry *entry;
+    size_t unshared_utf8_size = 1;
+
+    iter = xkb_compose_table_iterator_new(table);
+    while ((entry = xkb_compose_table_iterator_next(iter))) {
+        const char *utf8 = xkb_compose_table_entry_utf8(entry);
+        if (utf8[0] != '\0')
+            unshared_utf8_size += strlen(utf8) + 1;
+    }
+    xkb_compose_table_iterator_free(iter);
+
+    const size_t nodes_size =
+        darray_size(table->nodes) * sizeof(darray_item(table->nodes, 0));
+    const size_t utf8_size = darray_size(table->utf8);
+    fprintf(stderr,
+            "table memory: %zu nodes (%zu bytes), "
+            "utf8 pool: %zu bytes unshared, %zu bytes interned; "
+            "total: %zu -> %zu bytes\n",
+            (size_t) darray_size(table->nodes), nodes_size,
+            unshared_utf8_size, utf8_size,
+            nodes_size + unshared_utf8_size, nodes_size + utf8_size);
+}
+
 int
 main(void)
 {
@@ -49,6 +79,14 @@ main(void)
     }
     bench_stop(&bench);
 
+    fseek(file, 0, SEEK_SET);
+    table = xkb_compose_table_new_from_file(ctx, file, "",
+                                            XKB_COMPOSE_FORMAT_TEXT_V1,
+                                            XKB_COMPOSE_COMPILE_NO_FLAGS);
+    assert(table);
+    report_table_memory(table);
+    xkb_compose_table_unref(table);
+
     fclose(file);
     free(path);
 
@@ -0,0 +1,85 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#include <time.h>
+#include <stdbool.h>
+
+#include "xkbcommon/xkbcommon.h"
+#include "src/xkbcomp/ast.h"
+#include "src/xkbcomp/xkbcomp-priv.h"
+
+#include "../test/test.h"
+#include "bench.h"
+
+#define BENCHMARK_ITERATIONS 2000
+
+static const char *parser_names[] = {
+    [KEYMAP_TEXT_PARSER_BISON] = "Bison",
+    [KEYMAP_TEXT_PARSER_HANDWRITTEN] = "hand-written",
+};
+
+/* Parse a keymap string, without compiling it */
+static bool
+parse_keymap(struct xkb_context *ctx, enum keymap_text_parser parser,
+             const char *string, size_t len)
+{
+    struct scanner scanner;
+    XkbFile *file = NULL;
+    if (!XkbParseStringInit(ctx, &scanner, string, len, "(bench)", NULL))
+        return false;
+    const bool ok = XkbParseStringNextWithParser(ctx, &scanner, parser,
+                                                 NULL, &file);
+    FreeXkbFile(file);
+    return ok && file;
+}
+
+int
+main(void)
+{
+    struct bench bench;
+    char *elapsed;
+
+    struct xkb_context *ctx = test_get_context(CONTEXT_NO_FLAG);
+    assert(ctx);
+
+    /* A real-world keymap */
+    struct xkb_keymap *keymap = test_compile_rules(ctx, XKB_KEYMAP_FORMAT_TEXT_V1,
+                                                   "evdev", "pc105", "us,de",
+                                                   ",nodeadkeys",
+                                                   "grp:alt_shift_toggle");
+    assert(keymap);
+    char *string = xkb_keymap_get_as_string(keymap, XKB_KEYMAP_FORMAT_TEXT_V1);
+    assert(string);
+    const size_t len = strlen(string);
+    xkb_keymap_unref(keymap);
+
+    xkb_context_set_log_level(ctx, XKB_LOG_LEVEL_CRITICAL);
+    xkb_context_set_log_verbosity(ctx, 0);
+
+    for (size_t p = 0; p < ARRAY_SIZE(parser_names); p++) {
+        const enum keymap_text_parser parser = (enum keymap_text_parser) p;
+
+        bench_start(&bench);
+        for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+            if (!parse_keymap(ctx, parser, string, len)) {
+                fprintf(stderr, "ERROR: %s parser failed\n", parser_names[p]);
+                return 1;
+            }
+        }
+        bench_stop(&bench);
+
+        elapsed = bench_elapsed_str(&bench);
+        fprintf(stderr, "%s parser: parsed %d times a %zu bytes keymap "
+                "in %ss\n", parser_names[p], BENCHMARK_ITERATIONS, len,
+                elapsed);
+        free(elapsed);
+    }
+
+    free(string);
+    xkb_context_unref(ctx);
+    return 0;
+}
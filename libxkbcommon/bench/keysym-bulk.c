@@ -0,0 +1,167 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#include <time.h>
+#include <stdbool.h>
+
+#include "xkbcommon/xkbcommon.h"
+#include "src/utf8-decoding.h"
+
+#include "../test/test.h"
+#include "bench.h"
+
+#define BENCHMARK_ITERATIONS 2000
+#define CORPUS_REPEAT 16
+
+/* Mostly Latin text, with some other scripts and emoji */
+static const char *corpus[] = {
+    "The quick brown fox jumps over the lazy dog. "
+    "Pack my box with five dozen liquor jugs! "
+    "Sphinx of black quartz, judge my vow.",
+    "Voix ambiguë d’un cœur qui, au zéphyr, préfère les jattes de kiwis.",
+    "Falsches Üben von Xylophonmusik quält jeden größeren Zwerg.",
+    "Съешь же ещё этих мягких французских булок, да выпей чаю.",
+    "Emoji and beyond the BMP: 😀 🎹 𝔸𝔹ℂ 𐍈 🙂🙃🤖🚀🌍🎉",
+};
+
+static uint32_t *
+load_corpus(size_t *count)
+{
+    size_t length = 0;
+    for (size_t k = 0; k < ARRAY_SIZE(corpus); k++)
+        length += strlen(corpus[k]);
+    length *= CORPUS_REPEAT;
+
+    uint32_t *cps = calloc(length, sizeof(*cps));
+    assert(cps);
+    *count = 0;
+    for (unsigned int r = 0; r < CORPUS_REPEAT; r++) {
+        for (size_t k = 0; k < ARRAY_SIZE(corpus); k++) {
+            const char *s = corpus[k];
+            size_t remaining = strlen(s);
+            while (remaining > 0) {
+                size_t size = 0;
+                const uint32_t cp = utf8_next_code_point(s, remaining, &size);
+                assert(cp != INVALID_UTF8_CODE_POINT && size > 0);
+                cps[(*count)++] = cp;
+                s += size;
+                remaining -= size;
+            }
+        }
+    }
+    return cps;
+}
+
+enum conversion {
+    CONVERSION_KEYSYM_TO_UTF32,
+    CONVERSION_UTF32_TO_KEYSYM,
+    CONVERSION_TO_UPPER,
+    CONVERSION_TO_LOWER,
+};
+
+static const char *conversion_names[] = {
+    [CONVERSION_KEYSYM_TO_UTF32] = "keysym to UTF-32",
+    [CONVERSION_UTF32_TO_KEYSYM] = "UTF-32 to keysym",
+    [CONVERSION_TO_UPPER] = "keysym to upper",
+    [CONVERSION_TO_LOWER] = "keysym to lower",
+};
+
+static void
+convert_loop(enum conversion conversion, const uint32_t *in, uint32_t *out,
+             size_t count)
+{
+    switch (conversion) {
+    case CONVERSION_KEYSYM_TO_UTF32:
+        for (size_t k = 0; k < count; k++)
+            out[k] = xkb_keysym_to_utf32(in[k]);
+        break;
+    case CONVERSION_UTF32_TO_KEYSYM:
+        for (size_t k = 0; k < count; k++)
+            out[k] = xkb_utf32_to_keysym(in[k]);
+        break;
+    case CONVERSION_TO_UPPER:
+        for (size_t k = 0; k < count; k++)
+            out[k] = xkb_keysym_to_upper(in[k]);
+        break;
+    case CONVERSION_TO_LOWER:
+        for (size_t k = 0; k < count; k++)
+            out[k] = xkb_keysym_to_lower(in[k]);
+        break;
+    }
+}
+
+static void
+convert_bulk(enum conversion conversion, const uint32_t *in, uint32_t *out,
+             size_t count)
+{
+    switch (conversion) {
+    case CONVERSION_KEYSYM_TO_UTF32:
+        xkb_keysyms_to_utf32(in, out, count);
+        break;
+    case CONVERSION_UTF32_TO_KEYSYM:
+        xkb_utf32_to_keysyms(in, out, count);
+        break;
+    case CONVERSION_TO_UPPER:
+        xkb_keysyms_to_upper(in, out, count);
+        break;
+    case CONVERSION_TO_LOWER:
+        xkb_keysyms_to_lower(in, out, count);
+        break;
+    }
+}
+
+int
+main(void)
+{
+    struct bench bench;
+    char *elapsed;
+    size_t count;
+    uint32_t *cps = load_corpus(&count);
+    xkb_keysym_t *keysyms = calloc(count, sizeof(*keysyms));
+    uint32_t *expected = calloc(count, sizeof(*expected));
+    uint32_t *results = calloc(count, sizeof(*results));
+    assert(keysyms && expected && results);
+    xkb_utf32_to_keysyms(cps, keysyms, count);
+
+    for (size_t c = 0; c < ARRAY_SIZE(conversion_names); c++) {
+        const enum conversion conversion = (enum conversion) c;
+        const uint32_t *in = (conversion == CONVERSION_UTF32_TO_KEYSYM)
+            ? cps
+            : keysyms;
+
+        bench_start(&bench);
+        for (int i = 0; i < BENCHMARK_ITERATIONS; i++)
+            convert_loop(conversion, in, expected, count);
+        bench_stop(&bench);
+
+        elapsed = bench_elapsed_str(&bench);
+        fprintf(stderr, "%s: converted %d times %zu items "
+                "one by one in %ss\n",
+                conversion_names[c], BENCHMARK_ITERATIONS, count, elapsed);
+        free(elapsed);
+
+        bench_start(&bench);
+        for (int i = 0; i < BENCHMARK_ITERATIONS; i++)
+            convert_bulk(conversion, in, results, count);
+        bench_stop(&bench);
+
+        elapsed = bench_elapsed_str(&bench);
+        fprintf(stderr, "%s: converted %d times %zu items "
+                "in bulk in %ss\n",
+                conversion_names[c], BENCHMARK_ITERATIONS, count, elapsed);
+        free(elapsed);
+
+        /* Sanity check */
+        assert(memcmp(expected, results, count * sizeof(*results)) == 0);
+    }
+
+    free(results);
+    free(expected);
+    free(keysyms);
+    free(cps);
+    return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#include <time.h>
+#include <stdbool.h>
+
+#include "xkbcommon/xkbcommon.h"
+#include "src/utf8-decoding.h"
+
+#include "../test/test.h"
+#include "bench.h"
+
+#define BENCHMARK_ITERATIONS 2000
+
+/* Multilingual text, mixing scripts with and without legacy keysyms */
+static const char *corpus[] = {
+    "The quick brown fox jumps over the lazy dog.",
+    "Voix ambiguë d’un cœur qui, au zéphyr, préfère les jattes de kiwis.",
+    "Falsches Üben von Xylophonmusik quält jeden größeren Zwerg.",
+    "Pchnąć w tę łódź jeża lub ośm skrzyń fig.",
+    "Příliš žluťoučký kůň úpěl ďábelské ódy.",
+    "Árvíztűrő tükörfúrógép.",
+    "Τάχιστη αλώπηξ βαφής ψημένη γη, δρασκελίζει υπέρ νωθρού κυνός.",
+    "Съешь же ещё этих мягких французских булок, да выпей чаю.",
+    "Чуєш їх, доцю, га? Кумедна ж ти, прощайся без ґольфів!",
+    "דג סקרן שט בים מאוכזב ולפתע מצא חברה.",
+    "صِف خَلقَ خَودِ كَمِثلِ الشَمسِ إِذ بَزَغَت يَحظى الضَجيعُ بِها نَجلاءَ مِعطارِ",
+    "เป็นมนุษย์สุดประเสริฐเลิศคุณค่า กว่าบรรดาฝูงสัตว์เดรัจฉาน",
+    "いろはにほへと ちりぬるを わかよたれそ つねならむ",
+    "イロハニホヘト チリヌルヲ ワカヨタレソ ツネナラム",
+    "키스의 고유조건은 입술끼리 만나야 하고 특별한 기술은 필요치 않다.",
+    "ㄱㄴㄷㄹㅁㅂㅅㅇㅈㅊㅋㅌㅍㅎ ㅏㅑㅓㅕㅗㅛㅜㅠㅡㅣ",
+    "我能吞下玻璃而不伤身体。",
+    "Tiếng Việt có dấu: Ông già ăn phở ở đường Đồng Khởi.",
+    "Ψ ≤ ∞ ≠ ∑ √ ∫ ← → ↑ ↓ ⌈ ⌉ ⌊ ⌋ • … ™ € ₩ ‰ ‘’ “” –—",
+    "Emoji and beyond the BMP: 😀 🎹 𝔸𝔹ℂ 𐍈",
+};
+
+static uint32_t *
+load_corpus(size_t *count)
+{
+    size_t length = 0;
+    for (size_t k = 0; k < ARRAY_SIZE(corpus); k++)
+        length += strlen(corpus[k]);
+
+    uint32_t *cps = calloc(length, sizeof(*cps));
+    assert(cps);
+    *count = 0;
+    for (size_t k = 0; k < ARRAY_SIZE(corpus); k++) {
+        const char *s = corpus[k];
+        size_t remaining = strlen(s);
+        while (remaining > 0) {
+            size_t size = 0;
+            const uint32_t cp = utf8_next_code_point(s, remaining, &size);
+            assert(cp != INVALID_UTF8_CODE_POINT && size > 0);
+            cps[(*count)++] = cp;
+            s += size;
+            remaining -= size;
+        }
+    }
+    return cps;
+}
+
+int
+main(void)
+{
+    struct bench bench;
+    char *elapsed;
+    size_t count;
+    uint32_t *cps = load_corpus(&count);
+    xkb_keysym_t *keysyms = calloc(count, sizeof(*keysyms));
+    assert(keysyms);
+
+    bench_start(&bench);
+    for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        for (size_t k = 0; k < count; k++)
+            keysyms[k] = xkb_utf32_to_keysym(cps[k]);
+    }
+    bench_stop(&bench);
+
+    /* Sanity check */
+    for (size_t k = 0; k < count; k++)
+        assert(keysyms[k] != XKB_KEY_NoSymbol);
+
+    elapsed = bench_elapsed_str(&bench);
+    fprintf(stderr, "converted %d times %zu code points to keysyms in %ss\n",
+            BENCHMARK_ITERATIONS, count, elapsed);
+    free(elapsed);
+
+    /* Reverse conversion */
+    uint32_t *cps2 = calloc(count, sizeof(*cps2));
+    assert(cps2);
+
+    bench_start(&bench);
+    for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        for (size_t k = 0; k < count; k++)
+            cps2[k] = xkb_keysym_to_utf32(keysyms[k]);
+    }
+    bench_stop(&bench);
+
+    /* Sanity check: round-trip */
+    for (size_t k = 0; k < count; k++)
+        assert(cps2[k] == cps[k]);
+
+    elapsed = bench_elapsed_str(&bench);
+    fprintf(stderr, "converted %d times %zu keysyms to code points in %ss\n",
+            BENCHMARK_ITERATIONS, count, elapsed);
+    free(elapsed);
+
+    free(cps2);
+    free(keysyms);
+    free(cps);
+    return 0;
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#include <getopt.h>
+#include <time.h>
+
+#include "xkbcommon/xkbcommon.h"
+
+#include "../test/test.h"
+#include "bench.h"
+
+#define DEFAULT_ITERATIONS 20
+
+static void
+usage(FILE *fp, char **argv)
+{
+    fprintf(fp, "Usage: %s [OPTIONS]\n"
+           "\n"
+           "Benchmark the first keymap compilation of a new context,\n"
+           "with and without prewarming it with the default layout.\n"
+           "\n"
+           "Options:\n"
+           " --help\n"
+           "    Print this help and exit\n"
+           " --iter\n"
+           "    Number of contexts to create (default: %d)\n"
+           "\n"
+           "XKB-specific options:\n"
+           " --rules <rules>\n"
+           "    The XKB ruleset (default: '%s')\n"
+           " --model <model>\n"
+           "    The XKB model (default: '%s')\n"
+           " --layout <layout>\n"
+           "    The XKB layout of the first keymap (default: 'us,de')\n"
+           " --variant <variant>\n"
+           "    The XKB layout variant of the first keymap (default: '<none>')\n"
+           " --options <options>\n"
+           "    The XKB options of the first keymap (default: '<none>')\n"
+           "\n",
+           argv[0], DEFAULT_ITERATIONS, DEFAULT_XKB_RULES, DEFAULT_XKB_MODEL);
+}
+
+/* Time the prewarming, if any, and the first compilation of a new context */
+static bool
+run(const struct xkb_rule_names *prewarm, const struct xkb_rule_names *rmlvo,
+    unsigned int iterations, struct bench_time *prewarm_time,
+    struct bench_time *compile_time)
+{
+    struct bench bench;
+    struct bench_time elapsed;
+    long long int prewarm_ns = 0;
+    long long int compile_ns = 0;
+
+    for (unsigned int i = 0; i < iterations; i++) {
+        struct xkb_context * const ctx = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+        if (!ctx)
+            return false;
+        xkb_enable_quiet_logging(ctx);
+
+        if (prewarm) {
+            bench_start2(&bench);
+            const int ok = xkb_context_prewarm(ctx, prewarm,
+                                               XKB_KEYMAP_FORMAT_TEXT_V1);
+            bench_stop2(&bench);
+            if (!ok) {
+                xkb_context_unref(ctx);
+                return false;
+            }
+            bench_elapsed(&bench, &elapsed);
+            prewarm_ns += bench_time_elapsed_nanoseconds(&elapsed);
+        }
+
+        bench_start2(&bench);
+        struct xkb_keymap * const keymap =
+            xkb_keymap_new_from_names2(ctx, rmlvo, XKB_KEYMAP_FORMAT_TEXT_V1,
+                                       XKB_KEYMAP_COMPILE_NO_FLAGS);
+        bench_stop2(&bench);
+        xkb_keymap_unref(keymap);
+        xkb_context_unref(ctx);
+        if (!keymap)
+            return false;
+        bench_elapsed(&bench, &elapsed);
+        compile_ns += bench_time_elapsed_nanoseconds(&elapsed);
+    }
+
+    prewarm_ns /= iterations;
+    compile_ns /= iterations;
+    prewarm_time->seconds = (long) (prewarm_ns / 1000000000);
+    prewarm_time->nanoseconds = (long) (prewarm_ns % 1000000000);
+    compile_time->seconds = (long) (compile_ns / 1000000000);
+    compile_time->nanoseconds = (long) (compile_ns % 1000000000);
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    unsigned int iterations = DEFAULT_ITERATIONS;
+    struct xkb_rule_names rmlvo = {
+        .rules = DEFAULT_XKB_RULES,
+        .model = DEFAULT_XKB_MODEL,
+        .layout = "us,de",
+        .variant = NULL,
+        .options = NULL,
+    };
+
+    enum options {
+        OPT_RULES,
+        OPT_MODEL,
+        OPT_LAYOUT,
+        OPT_VARIANT,
+        OPT_OPTION,
+        OPT_ITERATIONS,
+    };
+
+    static struct option opts[] = {
+        {"help",             no_argument,            0, 'h'},
+        {"rules",            required_argument,      0, OPT_RULES},
+        {"model",            required_argument,      0, OPT_MODEL},
+        {"layout",           required_argument,      0, OPT_LAYOUT},
+        {"variant",          required_argument,      0, OPT_VARIANT},
+        {"options",          required_argument,      0, OPT_OPTION},
+        {"iter",             required_argument,      0, OPT_ITERATIONS},
+        {0, 0, 0, 0},
+    };
+
+    while (1) {
+        int c;
+        int option_index = 0;
+        c = getopt_long(argc, argv, "h", opts, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'h':
+            usage(stdout, argv);
+            exit(EXIT_SUCCESS);
+        case OPT_RULES:
+            rmlvo.rules = optarg;
+            break;
+        case OPT_MODEL:
+            rmlvo.model = optarg;
+            break;
+        case OPT_LAYOUT:
+            rmlvo.layout = optarg;
+            break;
+        case OPT_VARIANT:
+            rmlvo.variant = optarg;
+            break;
+        case OPT_OPTION:
+            rmlvo.options = optarg;
+            break;
+        case OPT_ITERATIONS: {
+            const int iterations_raw = atoi(optarg);
+            if (iterations_raw <= 0) {
+                usage(stderr, argv);
+                exit(EXIT_INVALID_USAGE);
+            }
+            iterations = (unsigned int) iterations_raw;
+            break;
+        }
+        default:
+            usage(stderr, argv);
+            exit(EXIT_INVALID_USAGE);
+        }
+    }
+
+    /* Prewarm with the default layout of the same rules and model */
+    const struct xkb_rule_names prewarm = {
+        .rules = rmlvo.rules,
+        .model = rmlvo.model,
+        .layout = DEFAULT_XKB_LAYOUT,
+        .variant = DEFAULT_XKB_VARIANT,
+        .options = DEFAULT_XKB_OPTIONS,
+    };
+
+    struct bench_time prewarm_time, cold_time, warm_time;
+    if (!run(NULL, &rmlvo, iterations, &prewarm_time, &cold_time) ||
+        !run(&prewarm, &rmlvo, iterations, &prewarm_time, &warm_time)) {
+        fprintf(stderr, "ERROR: Cannot compile keymap.\n");
+        return EXIT_FAILURE;
+    }
+
+    fprintf(stderr, "cold: first keymap compiled in %ld.%06lds\n",
+            cold_time.seconds, cold_time.nanoseconds / 1000);
+    fprintf(stderr, "warm: prewarmed in %ld.%06lds, "
+            "first keymap compiled in %ld.%06lds\n",
+            prewarm_time.seconds, prewarm_time.nanoseconds / 1000,
+            warm_time.seconds, warm_time.nanoseconds / 1000);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,267 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "xkbcommon/xkbregistry.h"
+#include "utils.h"
+
+#include "../test/test.h"
+#include "bench.h"
+
+#define BENCHMARK_ITERATIONS 200
+#define LOOKUP_ITERATIONS 2000
+
+/* Queries of a typical installer wizard */
+static const char *languages[] = {
+    "eng", "fra", "deu", "spa", "por", "ita", "rus", "ara", "jpn", "tur"
+};
+static const char *countries[] = {
+    "US", "GB", "FR", "DE", "ES", "BR", "IT", "RU", "JP", "TR"
+};
+static const struct { const char *layout; const char *variant; } layouts[] = {
+    { "us", NULL }, { "us", "intl" }, { "gb", NULL }, { "fr", "oss" },
+    { "de", "nodeadkeys" }, { "es", NULL }, { "br", NULL }, { "ru", NULL },
+    { "jp", NULL }, { "tr", "f" }
+};
+static const char *options[] = {
+    "grp:alt_shift_toggle", "grp:win_space_toggle", "compose:ralt",
+    "caps:escape", "ctrl:nocaps", "lv3:ralt_switch"
+};
+
+static bool
+has_code(struct rxkb_layout *l, const char *code, bool language)
+{
+    if (language) {
+        for (struct rxkb_iso639_code *c = rxkb_layout_get_iso639_first(l);
+             c; c = rxkb_iso639_code_next(c)) {
+            if (istreq(rxkb_iso639_code_get_code(c), code))
+                return true;
+        }
+    } else {
+        for (struct rxkb_iso3166_code *c = rxkb_layout_get_iso3166_first(l);
+             c; c = rxkb_iso3166_code_next(c)) {
+            if (istreq(rxkb_iso3166_code_get_code(c), code))
+                return true;
+        }
+    }
+    return false;
+}
+
+/* Lookups by iterating the lists */
+static size_t
+linear_lookups(struct rxkb_context *ctx)
+{
+    size_t found = 0;
+    for (size_t k = 0; k < ARRAY_SIZE(languages); k++) {
+        for (struct rxkb_layout *l = rxkb_layout_first(ctx); l;
+             l = rxkb_layout_next(l))
+            found += has_code(l, languages[k], true);
+    }
+    for (size_t k = 0; k < ARRAY_SIZE(countries); k++) {
+        for (struct rxkb_layout *l = rxkb_layout_first(ctx); l;
+             l = rxkb_layout_next(l))
+            found += has_code(l, countries[k], false);
+    }
+    for (size_t k = 0; k < ARRAY_SIZE(layouts); k++) {
+        for (struct rxkb_layout *l = rxkb_layout_first(ctx); l;
+             l = rxkb_layout_next(l)) {
+            if (streq(rxkb_layout_get_name(l), layouts[k].layout) &&
+                streq_null(rxkb_layout_get_variant(l), layouts[k].variant)) {
+                found++;
+                break;
+            }
+        }
+    }
+    for (size_t k = 0; k < ARRAY_SIZE(options); k++) {
+        for (struct rxkb_option_group *g = rxkb_option_group_first(ctx); g;
+             g = rxkb_option_group_next(g)) {
+            for (struct rxkb_option *o = rxkb_option_first(g); o;
+                 o = rxkb_option_next(o)) {
+                if (streq(rxkb_option_get_name(o), options[k])) {
+                    found++;
+                    goto next_option;
+                }
+            }
+        }
+next_option:
+        ;
+    }
+    return found;
+}
+
+/* Lookups using the indices */
+static size_t
+indexed_lookups(struct rxkb_context *ctx)
+{
+    size_t found = 0;
+    size_t count;
+    for (size_t k = 0; k < ARRAY_SIZE(languages); k++) {
+        rxkb_layouts_for_language(ctx, languages[k], &count);
+        found += count;
+    }
+    for (size_t k = 0; k < ARRAY_SIZE(countries); k++) {
+        rxkb_layouts_for_country(ctx, countries[k], &count);
+        found += count;
+    }
+    for (size_t k = 0; k < ARRAY_SIZE(layouts); k++)
+        found += !!rxkb_layout_find(ctx, layouts[k].layout, layouts[k].variant);
+    for (size_t k = 0; k < ARRAY_SIZE(options); k++)
+        found += !!rxkb_option_find(ctx, options[k]);
+    return found;
+}
+
+static int
+bench_lookups(const char *root)
+{
+    struct bench bench;
+    char *elapsed;
+
+    struct rxkb_context *ctx =
+        rxkb_context_new(RXKB_CONTEXT_NO_DEFAULT_INCLUDES |
+                         RXKB_CONTEXT_LOAD_EXOTIC_RULES);
+    assert(ctx);
+    if (!rxkb_context_include_path_append(ctx, root) ||
+        !rxkb_context_parse(ctx, "evdev")) {
+        fprintf(stderr, "ERROR: failed to parse the registry\n");
+        rxkb_context_unref(ctx);
+        return EXIT_FAILURE;
+    }
+
+    static const struct {
+        const char *name;
+        size_t (*lookups)(struct rxkb_context *ctx);
+    } modes[] = {
+        { "linear", linear_lookups },
+        { "indexed", indexed_lookups },
+    };
+    size_t expected = 0;
+    for (size_t m = 0; m < ARRAY_SIZE(modes); m++) {
+        size_t found = 0;
+        bench_start(&bench);
+        for (int i = 0; i < LOOKUP_ITERATIONS; i++)
+            found = modes[m].lookups(ctx);
+        bench_stop(&bench);
+
+        if (m == 0) {
+            expected = found;
+        } else if (found != expected) {
+            fprintf(stderr, "ERROR: %s lookups found %zu items, expected %zu\n",
+                    modes[m].name, found, expected);
+            rxkb_context_unref(ctx);
+            return EXIT_FAILURE;
+        }
+
+        elapsed = bench_elapsed_str(&bench);
+        fprintf(stderr, "%s: %d times the installer lookups (%zu results) "
+                "in %ss\n", modes[m].name, LOOKUP_ITERATIONS, found, elapsed);
+        free(elapsed);
+    }
+
+    rxkb_context_unref(ctx);
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Parse the test data rules XML files. The peak RSS is per process, so the
+ * parsing modes must be compared using separate runs:
+ *
+ *     bench-registry
+ *     bench-registry --validate
+ *     bench-registry --cache
+ *     bench-registry --lazy
+ *     bench-registry --lookups
+ *
+ * With `--cache`, the first iteration creates a binary cache of the registry
+ * and the subsequent iterations load it. With `--lazy`, only the names are
+ * loaded, as when listing the layouts. With `--lookups`, compare the queries
+ * of an installer wizard using the lookup functions against iterating the
+ * lists.
+ */
+int
+main(int argc, char *argv[])
+{
+    struct bench bench;
+    char *elapsed;
+    enum rxkb_context_flags flags = RXKB_CONTEXT_NO_DEFAULT_INCLUDES |
+                                    RXKB_CONTEXT_LOAD_EXOTIC_RULES;
+
+    char *cache_dir = NULL;
+    char *cache = NULL;
+    if (argc > 1 && strcmp(argv[1], "--validate") == 0) {
+        flags |= RXKB_CONTEXT_VALIDATE_XML;
+    } else if (argc > 1 && strcmp(argv[1], "--lazy") == 0) {
+        flags |= RXKB_CONTEXT_LAZY_DETAILS;
+    } else if (argc > 1 && strcmp(argv[1], "--cache") == 0) {
+        cache_dir = test_maketempdir("bench-registry.XXXXXX");
+        assert(cache_dir);
+        cache = asprintf_safe("%s/registry.cache", cache_dir);
+        assert(cache);
+    }
+
+    char *root = test_get_path("");
+    assert(root);
+
+    if (argc > 1 && strcmp(argv[1], "--lookups") == 0) {
+        const int ret = bench_lookups(root);
+        free(root);
+        return ret;
+    }
+
+    size_t names = 0;
+    bench_start(&bench);
+    for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        struct rxkb_context *ctx = rxkb_context_new(flags);
+        assert(ctx);
+        if (!rxkb_context_include_path_append(ctx, root) ||
+            (cache && !rxkb_context_set_cache_path(ctx, cache)) ||
+            !rxkb_context_parse(ctx, "evdev")) {
+            fprintf(stderr, "ERROR: failed to parse the registry\n");
+            rxkb_context_unref(ctx);
+            free(root);
+            free(cache);
+            free(cache_dir);
+            return EXIT_FAILURE;
+        }
+        /* List the layout names */
+        for (struct rxkb_layout *l = rxkb_layout_first(ctx); l;
+             l = rxkb_layout_next(l))
+            names += strlen(rxkb_layout_get_name(l));
+        rxkb_context_unref(ctx);
+    }
+    bench_stop(&bench);
+
+    assert(names > 0);
+    elapsed = bench_elapsed_str(&bench);
+    fprintf(stderr, "%s: parsed %d times the registry in %ss\n",
+            cache ? "cached" :
+            (flags & RXKB_CONTEXT_LAZY_DETAILS) ? "lazy" :
+            (flags & RXKB_CONTEXT_VALIDATE_XML) ? "validating" : "streaming",
+            BENCHMARK_ITERATIONS, elapsed);
+    free(elapsed);
+
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        fprintf(stderr, "peak RSS: %ld KiB\n", usage.ru_maxrss);
+#endif
+
+    if (cache) {
+        unlink(cache);
+        rmdir(cache_dir);
+    }
+    free(cache);
+    free(cache_dir);
+    free(root);
+    return EXIT_SUCCESS;
+}
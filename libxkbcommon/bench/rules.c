@@ -16,6 +16,16 @@
 const unsigned int DEFAULT_ITERATIONS = 20000;
 const double       DEFAULT_STDEV = 0.05;
 
+/* Typical multi-layout setup, with many layout-specific rules to expand */
+static const struct xkb_rule_names multi_layouts_rmlvo = {
+    .layout = "us,de,ru,cz",
+    .variant = ",nodeadkeys,phonetic,qwerty",
+    .options = "grp:alt_shift_toggle,grp_led:scroll,ctrl:nocaps,compose:ralt,"
+               "lv3:ralt_switch,caps:escape,altwin:swap_lalt_lwin,"
+               "terminate:ctrl_alt_bksp,ctrl:swap_lalt_lctl,"
+               "grp:win_space_toggle",
+};
+
 static void
 usage(char **argv)
 {
@@ -44,11 +54,14 @@ usage(char **argv)
            "    The XKB layout variant (default: '%s')\n"
            " --options <options>\n"
            "    The XKB options (default: '%s')\n"
+           " --multi-layouts\n"
+           "    Use %u layouts and %u options, unless set explicitly\n"
            "\n",
            argv[0], DEFAULT_STDEV * 100, DEFAULT_XKB_RULES,
            DEFAULT_XKB_MODEL, DEFAULT_XKB_LAYOUT,
            DEFAULT_XKB_VARIANT ? DEFAULT_XKB_VARIANT : "<none>",
-           DEFAULT_XKB_OPTIONS ? DEFAULT_XKB_OPTIONS : "<none>");
+           DEFAULT_XKB_OPTIONS ? DEFAULT_XKB_OPTIONS : "<none>",
+           4, 10);
 }
 
 int
@@ -69,6 +82,8 @@ main(int argc, char *argv[])
     };
     unsigned int max_iterations = DEFAULT_ITERATIONS;
     double stdev = DEFAULT_STDEV;
+    bool multi_layouts = false;
+    bool explicit_options = false;
 
     enum options {
         OPT_RULES,
@@ -76,6 +91,7 @@ main(int argc, char *argv[])
         OPT_LAYOUT,
         OPT_VARIANT,
         OPT_OPTION,
+        OPT_MULTI_LAYOUTS,
         OPT_ITERATIONS,
         OPT_STDEV,
     };
@@ -87,6 +103,7 @@ main(int argc, char *argv[])
         {"layout",           required_argument,      0, OPT_LAYOUT},
         {"variant",          required_argument,      0, OPT_VARIANT},
         {"options",          required_argument,      0, OPT_OPTION},
+        {"multi-layouts",    no_argument,            0, OPT_MULTI_LAYOUTS},
         {"iter",             required_argument,      0, OPT_ITERATIONS},
         {"stdev",            required_argument,      0, OPT_STDEV},
         {0, 0, 0, 0},
@@ -117,6 +134,10 @@ main(int argc, char *argv[])
             break;
         case OPT_OPTION:
             rmlvo.options = optarg;
+            explicit_options = true;
+            break;
+        case OPT_MULTI_LAYOUTS:
+            multi_layouts = true;
             break;
         case OPT_ITERATIONS:
             if (max_iterations == 0) {
@@ -148,6 +169,16 @@ main(int argc, char *argv[])
         }
     }
 
+    if (multi_layouts) {
+        if (!rmlvo.layout || !*rmlvo.layout) {
+            rmlvo.layout = multi_layouts_rmlvo.layout;
+            if (!rmlvo.variant)
+                rmlvo.variant = multi_layouts_rmlvo.variant;
+        }
+        if (!explicit_options)
+            rmlvo.options = multi_layouts_rmlvo.options;
+    }
+
     /* Now fill in the layout */
     if (!rmlvo.layout || !*rmlvo.layout) {
         if (rmlvo.variant && *rmlvo.variant) {
@@ -5,6 +5,8 @@
 
 #include "config.h"
 
+#include <inttypes.h>
+#include <string.h>
 #include <time.h>
 
 #include "../test/test.h"
@@ -13,34 +15,67 @@
 
 #define BENCHMARK_ITERATIONS 1000
 
-int
-main(int argc, char *argv[])
+/* Compile keymaps cycling through the given layouts */
+static void
+bench_layouts(struct xkb_context *ctx, const char *scenario,
+              const char * const *layouts, size_t num_layouts)
 {
-    struct xkb_context *ctx;
-    struct xkb_keymap *keymap;
     struct bench bench;
     char *elapsed;
-    int i;
-
-    ctx = test_get_context(0);
-    assert(ctx);
+    uint64_t hits, misses;
 
-    xkb_enable_quiet_logging(ctx);
+    xkb_context_get_keymap_cache_stats(ctx, &hits, &misses);
 
     bench_start(&bench);
-    for (i = 0; i < BENCHMARK_ITERATIONS; i++) {
-        keymap = test_compile_rules(ctx, XKB_KEYMAP_FORMAT_TEXT_V1, "evdev",
-                                    "pc104", "us", "", "");
+    for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        struct xkb_keymap * const keymap =
+            test_compile_rules(ctx, XKB_KEYMAP_FORMAT_TEXT_V1, "evdev",
+                               "pc104", layouts[i % num_layouts], "", "");
         assert(keymap);
         xkb_keymap_unref(keymap);
     }
     bench_stop(&bench);
 
     elapsed = bench_elapsed_str(&bench);
-    fprintf(stderr, "compiled %d keymaps in %ss\n",
-            BENCHMARK_ITERATIONS, elapsed);
+    fprintf(stderr, "%s: compiled %d keymaps in %ss\n",
+            scenario, BENCHMARK_ITERATIONS, elapsed);
     free(elapsed);
 
+    uint64_t new_hits, new_misses;
+    xkb_context_get_keymap_cache_stats(ctx, &new_hits, &new_misses);
+    if (new_hits + new_misses > hits + misses) {
+        fprintf(stderr, "%s: keymap cache: %"PRIu64" hits, %"PRIu64" misses\n",
+                scenario, new_hits - hits, new_misses - misses);
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct xkb_context *ctx;
+
+    ctx = test_get_context(0);
+    assert(ctx);
+
+    xkb_enable_quiet_logging(ctx);
+
+    /* Cycle through a few layouts, as when switching keyboards */
+    static const char *layouts[] = { "us", "de", "ch", "cz" };
+    if (argc > 1 && strcmp(argv[1], "--cache") == 0)
+        xkb_context_set_keymap_cache_size(ctx, ARRAY_SIZE(layouts));
+
+    bench_layouts(ctx, "switch layouts", layouts, ARRAY_SIZE(layouts));
+
+    /*
+     * Add and remove layouts. There are more combinations than keymaps in the
+     * cache, so that keymaps are always assembled from the cached layouts.
+     */
+    static const char *multiple_layouts[] = {
+        "us,ru", "us,ru,de", "us,ru,de,cz", "us,ru,cz", "us,cz", "us,ru,ch"
+    };
+    bench_layouts(ctx, "add/remove layouts", multiple_layouts,
+                  ARRAY_SIZE(multiple_layouts));
+
     xkb_context_unref(ctx);
     return 0;
 }
@@ -6,16 +6,77 @@
 #include "config.h"
 
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 #include <xcb/xkb.h>
 
 #include "xkbcommon/xkbcommon.h"
 #include "xkbcommon/xkbcommon-x11.h"
+#include "src/x11/x11-priv.h"
 
 #include "bench.h"
 
 #define BENCHMARK_ITERATIONS 2500
+#define ATOMS_BENCHMARK_ITERATIONS 500
+/* Group, type, level and indicator names of a large keymap */
+#define ATOMS_COUNT 1024
+
+/*
+ * Resolve the X atoms names as done when retrieving a keymap with many group,
+ * type and indicator names. All the names are cached in the context after the
+ * first iteration, so this measures the atom cache lookups.
+ */
+static int
+bench_atoms(struct xkb_context *ctx, xcb_connection_t *conn)
+{
+    static const char *prefixes[] = {
+        "Group", "TYPE", "Level", "Indicator"
+    };
+    xcb_intern_atom_cookie_t cookies[ATOMS_COUNT];
+    xcb_atom_t atoms[ATOMS_COUNT];
+    xkb_atom_t names[ATOMS_COUNT];
+    struct bench bench;
+    char *elapsed;
+    char name[64];
+
+    for (int i = 0; i < ATOMS_COUNT; i++) {
+        const int len = snprintf(name, sizeof(name), "bench-x11 %s %d",
+                                 prefixes[i % ARRAY_SIZE(prefixes)], i);
+        cookies[i] = xcb_intern_atom(conn, 0, (uint16_t) len, name);
+    }
+    for (int i = 0; i < ATOMS_COUNT; i++) {
+        xcb_intern_atom_reply_t *reply =
+            xcb_intern_atom_reply(conn, cookies[i], NULL);
+        if (!reply) {
+            fprintf(stderr, "Couldn't intern atom #%d\n", i);
+            return -1;
+        }
+        atoms[i] = reply->atom;
+        free(reply);
+    }
+
+    bench_start(&bench);
+    for (int i = 0; i < ATOMS_BENCHMARK_ITERATIONS; i++) {
+        struct x11_atom_interner interner;
+        x11_atom_interner_init(&interner, ctx, conn);
+        for (int a = 0; a < ATOMS_COUNT; a++)
+            x11_atom_interner_adopt_atom(&interner, atoms[a], &names[a]);
+        x11_atom_interner_round_trip(&interner);
+        if (interner.had_error) {
+            fprintf(stderr, "Couldn't get the atoms names\n");
+            return -1;
+        }
+    }
+    bench_stop(&bench);
+
+    elapsed = bench_elapsed_str(&bench);
+    fprintf(stderr, "resolved %d times %d X atoms in %ss\n",
+            ATOMS_BENCHMARK_ITERATIONS, ATOMS_COUNT, elapsed);
+    free(elapsed);
+
+    return 0;
+}
 
 int
 main(void)
@@ -75,13 +136,14 @@ main(void)
         xkb_keymap_unref(keymap);
     }
     bench_stop(&bench);
-    ret = 0;
 
     elapsed = bench_elapsed_str(&bench);
     fprintf(stderr, "retrieved %d keymaps from X in %ss\n",
             BENCHMARK_ITERATIONS, elapsed);
     free(elapsed);
 
+    ret = bench_atoms(ctx, conn);
+
     xkb_context_unref(ctx);
 err_conn:
     xcb_disconnect(conn);
@@ -420,6 +420,89 @@ xkb_compose_table_iterator_free(struct xkb_compose_table_iterator *iter);
 XKB_EXPORT struct xkb_compose_table_entry *
 xkb_compose_table_iterator_next(struct xkb_compose_table_iterator *iter);
 
+/**
+ * Get the size of the storage required by
+ * xkb_compose_table_iterator_init() for a compose table.
+ *
+ * The size depends on the shape of the table, but is constant for a given
+ * table.
+ *
+ * @memberof xkb_compose_table_iterator
+ * @since 1.14.0
+ */
+XKB_EXPORT size_t
+xkb_compose_table_iterator_storage_size(struct xkb_compose_table *table);
+
+/**
+ * Initialize an iterator for a compose table in caller-provided storage.
+ *
+ * Contrary to xkb_compose_table_iterator_new(), this does not allocate any
+ * memory: neither here nor in xkb_compose_table_iterator_next().
+ *
+ * Intended use:
+ *
+ * ```c
+ * size_t size = xkb_compose_table_iterator_storage_size(compose_table);
+ * void *storage = malloc(size); // or any reused buffer
+ * struct xkb_compose_table_iterator *iter =
+ *     xkb_compose_table_iterator_init(compose_table, storage, size);
+ * struct xkb_compose_table_entry *entry;
+ * while ((entry = xkb_compose_table_iterator_next(iter))) {
+ *     // ...
+ * }
+ * free(storage);
+ * ```
+ *
+ * The iterator does not take a reference to the table: the table must
+ * outlive the iterator. There is no need to call
+ * xkb_compose_table_iterator_free() on the result, although it is harmless.
+ *
+ * @param table        The compose table to iterate.
+ * @param storage      The storage of the iterator. It must be aligned as
+ *                     for any object type, e.g. as the result of `malloc()`.
+ * @param storage_size The size of @p storage in bytes. It must be at least
+ *                     xkb_compose_table_iterator_storage_size().
+ *
+ * @returns The iterator, located at @p storage, or `NULL` if the storage
+ * is invalid.
+ *
+ * @memberof xkb_compose_table_iterator
+ * @sa xkb_compose_table_iterator_storage_size()
+ * @since 1.14.0
+ */
+XKB_EXPORT struct xkb_compose_table_iterator *
+xkb_compose_table_iterator_init(struct xkb_compose_table *table,
+                                void *storage, size_t storage_size);
+
+/**
+ * The iterator function type used by xkb_compose_table_for_each().
+ *
+ * @attention The entry is valid only during the call of the function.
+ *
+ * @sa xkb_compose_table_for_each()
+ * @memberof xkb_compose_table
+ * @since 1.14.0
+ */
+typedef void
+(*xkb_compose_table_iter_t)(struct xkb_compose_table_entry *entry,
+                            void *data);
+
+/**
+ * Run a specified function for every entry in a compose table.
+ *
+ * The entries are traversed in the same order as with
+ * xkb_compose_table_iterator_next().
+ *
+ * This is the most efficient way to traverse a whole table.
+ *
+ * @memberof xkb_compose_table
+ * @since 1.14.0
+ */
+XKB_EXPORT void
+xkb_compose_table_for_each(struct xkb_compose_table *table,
+                           xkb_compose_table_iter_t iter,
+                           void *data);
+
 /** Flags for compose state creation. */
 enum xkb_compose_state_flags {
     /** Do not apply any flags. */
@@ -217,6 +217,91 @@ xkb_x11_state_new_from_device(struct xkb_keymap *keymap,
                               xcb_connection_t *connection,
                               int32_t device_id);
 
+/**
+ * @struct xkb_x11_keymap_request
+ * Opaque handle of pending X11 requests to create a keymap and its state.
+ *
+ * @sa `xkb_x11_keymap_request()`
+ * @since 1.14.0
+ */
+struct xkb_x11_keymap_request;
+
+/**
+ * Send the requests to create a keymap and a state from an X11 keyboard device,
+ * without waiting for their replies.
+ *
+ * Contrary to `xkb_x11_keymap_new_from_device()`, this function returns as
+ * soon as the requests are sent, so that the caller may do other work while
+ * the X server processes them. The result is then retrieved with
+ * `xkb_x11_keymap_finish()`, or the requests can be abandoned with
+ * `xkb_x11_keymap_cancel()`.
+ *
+ * The keyboard state is requested in the same batch as the keymap. Together
+ * they require two round trips, one fewer than
+ * `xkb_x11_keymap_new_from_device()` followed by
+ * `xkb_x11_state_new_from_device()`: the second one retrieves the names of the
+ * X atoms of the keymap, and it is skipped if all of them are already cached
+ * in the context, e.g. when retrieving the keymap again.
+ *
+ * @param context
+ *     The context in which to create the keymap.
+ * @param connection
+ *     An XCB connection to the X server. It must remain valid until the
+ *     request is finished or cancelled.
+ * @param device_id
+ *     An XInput device ID (in the range 0-127) with input class KEY.
+ * @param flags
+ *     Optional flags for the keymap, or 0.
+ *
+ * @returns A handle of the pending requests, or `NULL` on failure.
+ *
+ * @sa `xkb_x11_keymap_new_from_device()`
+ * @since 1.14.0
+ * @memberof xkb_x11_keymap_request
+ */
+XKB_EXPORT struct xkb_x11_keymap_request *
+xkb_x11_keymap_request(struct xkb_context *context,
+                       xcb_connection_t *connection,
+                       int32_t device_id,
+                       enum xkb_keymap_compile_flags flags);
+
+/**
+ * Wait for the replies of the requests sent by `xkb_x11_keymap_request()` and
+ * create the corresponding keymap and state.
+ *
+ * The request handle is consumed and must not be used afterwards, even on
+ * failure.
+ *
+ * @param request
+ *     The handle returned by `xkb_x11_keymap_request()`.
+ * @param[out] state_out
+ *     If not `NULL`, set to a new keyboard state object initialized with the
+ *     state of the device at the time of the request, or to `NULL` on failure.
+ *
+ * @returns A keymap retrieved from the X server, or `NULL` on failure.
+ *
+ * @since 1.14.0
+ * @memberof xkb_x11_keymap_request
+ */
+XKB_EXPORT struct xkb_keymap *
+xkb_x11_keymap_finish(struct xkb_x11_keymap_request *request,
+                      struct xkb_state **state_out);
+
+/**
+ * Abandon the requests sent by `xkb_x11_keymap_request()`.
+ *
+ * The replies are discarded and the request handle is freed.
+ *
+ * @param request
+ *     The handle returned by `xkb_x11_keymap_request()`. If it is `NULL`,
+ *     this function does nothing.
+ *
+ * @since 1.14.0
+ * @memberof xkb_x11_keymap_request
+ */
+XKB_EXPORT void
+xkb_x11_keymap_cancel(struct xkb_x11_keymap_request *request);
+
 /** @} */
 
 #ifdef __cplusplus
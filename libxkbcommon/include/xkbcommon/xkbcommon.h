@@ -557,6 +557,40 @@ xkb_components_names_from_rules(struct xkb_context *context,
                                 struct xkb_rule_names *rmlvo_out,
                                 struct xkb_component_names *components_out);
 
+/**
+ * Resolve several [RMLVO] names to [KcCGST] components.
+ *
+ * This is equivalent to calling `xkb_components_names_from_rules()` for each
+ * entry, but the names sharing the same rules are resolved with a *single*
+ * pass over the rules files. This is useful to validate many [RMLVO]
+ * combinations at once, e.g. all the layouts and variants offered to the user.
+ *
+ * @param[in]  context    The context in which to resolve the names.
+ * @param[in]  rmlvo_in   Array of @c count [RMLVO] names to use.
+ * @param[in]  count      The number of [RMLVO] names.
+ * @param[out] components_out Array of @c count [KcCGST] components, filled
+ * with the result of the resolution of the corresponding [RMLVO] names.
+ *
+ * The components are filled with dynamically-allocated strings that should be
+ * freed by the caller. The components of the names that could not be
+ * resolved are set to `NULL`.
+ *
+ * @returns The number of [RMLVO] names that could be resolved.
+ *
+ * @see xkb_components_names_from_rules()
+ *
+ * @since 1.14.0
+ * @memberof xkb_component_names
+ *
+ * [RMLVO]: @ref RMLVO-intro
+ * [KcCGST]: @ref KcCGST-intro
+ */
+XKB_EXPORT size_t
+xkb_components_names_from_rules_batch(struct xkb_context *context,
+                                      const struct xkb_rule_names *rmlvo_in,
+                                      size_t count,
+                                      struct xkb_component_names *components_out);
+
 /** @} */
 
 /**
@@ -759,6 +793,78 @@ xkb_keysym_to_upper(xkb_keysym_t ks);
 XKB_EXPORT xkb_keysym_t
 xkb_keysym_to_lower(xkb_keysym_t ks);
 
+/**
+ * Get the Unicode/UTF-32 representation of an array of keysyms.
+ *
+ * This is equivalent to calling `xkb_keysym_to_utf32()` on each keysym, but
+ * faster for large arrays.
+ *
+ * @param[in]  keysyms     The keysyms to convert.
+ * @param[out] codepoints  The resulting code points, 0 for keysyms without
+ * Unicode representation. It may be the same array as @p keysyms.
+ * @param[in]  count       The number of items of both arrays.
+ *
+ * @sa `xkb_keysym_to_utf32()`
+ * @since 1.14.0
+ */
+XKB_EXPORT void
+xkb_keysyms_to_utf32(const xkb_keysym_t *keysyms, uint32_t *codepoints,
+                     size_t count);
+
+/**
+ * Get the keysyms corresponding to an array of Unicode/UTF-32 code points.
+ *
+ * This is equivalent to calling `xkb_utf32_to_keysym()` on each code point,
+ * but faster for large arrays.
+ *
+ * @param[in]  codepoints  The code points to convert.
+ * @param[out] keysyms     The resulting keysyms, `XKB_KEY_NoSymbol` for
+ * invalid code points. It may be the same array as @p codepoints.
+ * @param[in]  count       The number of items of both arrays.
+ *
+ * @sa `xkb_utf32_to_keysym()`
+ * @since 1.14.0
+ */
+XKB_EXPORT void
+xkb_utf32_to_keysyms(const uint32_t *codepoints, xkb_keysym_t *keysyms,
+                     size_t count);
+
+/**
+ * Convert an array of keysyms to their uppercase form.
+ *
+ * This is equivalent to calling `xkb_keysym_to_upper()` on each keysym, but
+ * faster for large arrays.
+ *
+ * @param[in]  keysyms  The keysyms to convert.
+ * @param[out] out      The resulting keysyms. It may be the same array as
+ * @p keysyms.
+ * @param[in]  count    The number of items of both arrays.
+ *
+ * @sa `xkb_keysym_to_upper()`
+ * @since 1.14.0
+ */
+XKB_EXPORT void
+xkb_keysyms_to_upper(const xkb_keysym_t *keysyms, xkb_keysym_t *out,
+                     size_t count);
+
+/**
+ * Convert an array of keysyms to their lowercase form.
+ *
+ * This is equivalent to calling `xkb_keysym_to_lower()` on each keysym, but
+ * faster for large arrays.
+ *
+ * @param[in]  keysyms  The keysyms to convert.
+ * @param[out] out      The resulting keysyms. It may be the same array as
+ * @p keysyms.
+ * @param[in]  count    The number of items of both arrays.
+ *
+ * @sa `xkb_keysym_to_lower()`
+ * @since 1.14.0
+ */
+XKB_EXPORT void
+xkb_keysyms_to_lower(const xkb_keysym_t *keysyms, xkb_keysym_t *out,
+                     size_t count);
+
 /** @} */
 
 /**
@@ -871,6 +977,74 @@ xkb_context_set_user_data(struct xkb_context *context, void *user_data);
 XKB_EXPORT void *
 xkb_context_get_user_data(struct xkb_context *context);
 
+/**
+ * Set the maximum number of keymaps kept in the context’s keymap cache.
+ *
+ * When the cache is enabled, the keymaps compiled with
+ * `xkb_keymap::xkb_keymap_new_from_names()`,
+ * `xkb_keymap::xkb_keymap_new_from_names2()` and
+ * `xkb_keymap::xkb_keymap_new_from_rmlvo()` are cached, indexed by their
+ * format, compilation flags and normalized RMLVO names.  Compiling again
+ * the same names returns a new reference to the cached keymap instead of
+ * compiling a new one.  The least recently used keymaps are evicted first.
+ *
+ * Keymaps are immutable, so sharing them is safe.  Note that the compilation
+ * messages are not logged again when a keymap is found in the cache.  The
+ * cache is cleared whenever the include path of the context is modified.
+ *
+ * Enabling the cache also enables the compiler caches of the context: the
+ * parsed rules files, the keycodes, types and compat sections and the symbols
+ * of each layout are cached, so that compiling a keymap that shares them with
+ * a previously compiled one, e.g. when adding or removing a layout, only
+ * compiles the new layouts.  The rules and keymap component files are
+ * identified by their path: changes of their content are only taken into
+ * account after clearing the cache.
+ *
+ * @param context The context.
+ * @param size    The maximum number of cached keymaps.  `0`, the default,
+ * disables the cache and the compiler caches, including when they were
+ * enabled by `xkb_context::xkb_context_prewarm()`.  Lowering the size evicts
+ * the extra keymaps.
+ *
+ * @sa xkb_context::xkb_context_clear_keymap_cache()
+ * @memberof xkb_context
+ * @since 1.14.0
+ */
+XKB_EXPORT void
+xkb_context_set_keymap_cache_size(struct xkb_context *context,
+                                  unsigned int size);
+
+/**
+ * Remove all the keymaps from the context’s keymap cache.
+ *
+ * This also empties the compiler caches, see
+ * `xkb_context::xkb_context_set_keymap_cache_size()` and
+ * `xkb_context::xkb_context_prewarm()`.  The cache size and statistics are not
+ * modified.
+ *
+ * @memberof xkb_context
+ * @since 1.14.0
+ */
+XKB_EXPORT void
+xkb_context_clear_keymap_cache(struct xkb_context *context);
+
+/**
+ * Get the statistics of the context’s keymap cache.
+ *
+ * Lookups are only counted while the cache is enabled.
+ *
+ * @param[in]  context The context.
+ * @param[out] hits    The number of keymaps found in the cache, or `NULL`.
+ * @param[out] misses  The number of keymaps not found in the cache, or `NULL`.
+ *
+ * @sa xkb_context::xkb_context_set_keymap_cache_size()
+ * @memberof xkb_context
+ * @since 1.14.0
+ */
+XKB_EXPORT void
+xkb_context_get_keymap_cache_stats(struct xkb_context *context,
+                                   uint64_t *hits, uint64_t *misses);
+
 /** @} */
 
 /**
@@ -1267,6 +1441,44 @@ xkb_keymap_new_from_names2(struct xkb_context *context,
                            enum xkb_keymap_format format,
                            enum xkb_keymap_compile_flags flags);
 
+/**
+ * Populate the compiler caches of the context for the compilation of keymaps.
+ *
+ * This enables the compiler caches of the context, then parses the rules file
+ * and compiles the keymap components corresponding to the given names, e.g.
+ * the keycodes, types, compat and `pc` symbols, which are kept in the caches.
+ * The next compilations of keymaps from RMLVO names reuse them: they only
+ * match the cached rules and compile the symbols of their other layouts.
+ * The compiled keymap itself is not kept, unless the keymap cache is enabled
+ * with `xkb_context::xkb_context_set_keymap_cache_size()`.
+ *
+ * The compiler caches remain enabled even if the keymap cache is disabled.
+ * They are emptied, but not disabled, by
+ * `xkb_context::xkb_context_clear_keymap_cache()` and when the include path is
+ * modified.  Setting the keymap cache size to `0` with
+ * `xkb_context::xkb_context_set_keymap_cache_size()` disables and frees them.
+ *
+ * This function is synchronous: it returns once the caches are populated.  It
+ * is meant to be called early, e.g. at application startup, possibly in a
+ * background thread.  The context is not thread-safe: it must not be used by
+ * another thread until this function returns.
+ *
+ * @param context The context.
+ * @param names   The RMLVO names of the expected keymap.  If `NULL` or if some
+ * members are not set, the defaults are used, as with
+ * `xkb_keymap::xkb_keymap_new_from_names2()`.
+ * @param format  The format of the expected keymap.
+ *
+ * @returns 1 on success, or 0 if the keymap could not be compiled.
+ *
+ * @memberof xkb_context
+ * @since 1.14.0
+ */
+XKB_EXPORT int
+xkb_context_prewarm(struct xkb_context *context,
+                    const struct xkb_rule_names *names,
+                    enum xkb_keymap_format format);
+
 /**
  * Create a keymap from a keymap file.
  *
@@ -1406,6 +1618,341 @@ xkb_keymap_get_as_string2(struct xkb_keymap *keymap,
                           enum xkb_keymap_format format,
                           enum xkb_keymap_serialize_flags flags);
 
+/**
+ * Get the compiled keymap as a string owned by the keymap.
+ *
+ * Same as `xkb_keymap::xkb_keymap_get_as_string2()`, but the serialization
+ * is performed only on the first call for a given format and flags: it is
+ * then cached in the keymap and the next calls return the same string.
+ * This is useful when the keymap must be sent repeatedly, e.g. by Wayland
+ * compositors to every new client.
+ *
+ * The cached serialization is also used by the other serialization
+ * functions, e.g. `xkb_keymap::xkb_keymap_get_as_string2()` returns a
+ * copy of it.
+ *
+ * This function and the other serialization functions may be called
+ * concurrently on the same keymap from multiple threads.  If several threads
+ * serialize the keymap at the same time, only one of the serializations is
+ * cached and all of them get the same string.  Note that taking and releasing
+ * references to the keymap is not thread-safe.
+ *
+ * @param keymap The keymap to get as a string.
+ * @param format The keymap format to use, see
+ * `xkb_keymap::xkb_keymap_get_as_string2()`.
+ * @param flags  Optional flags to control the serialization, or 0.
+ * @param[out] length The length of the string, excluding the terminating
+ * `NULL` byte. May be `NULL`.
+ *
+ * @returns The keymap as a `NULL`-terminated string, or `NULL` if
+ * unsuccessful. The string is owned by the keymap: it must *not* be modified
+ * nor freed, and it is valid as long as the keymap is alive.
+ *
+ * @since 1.14.0
+ *
+ * @sa `xkb_keymap::xkb_keymap_get_as_string2()`
+ * @memberof xkb_keymap
+ */
+XKB_EXPORT const char *
+xkb_keymap_get_as_cached_string(struct xkb_keymap *keymap,
+                                enum xkb_keymap_format format,
+                                enum xkb_keymap_serialize_flags flags,
+                                size_t *length);
+
+/**
+ * The function type used by `xkb_keymap::xkb_keymap_write()` to output
+ * the serialized keymap.
+ *
+ * @param chunk The next chunk of the serialized keymap. It is *not*
+ * `NULL`-terminated and it is valid only during the call of the function.
+ * @param size  The size of @p chunk in bytes.
+ * @param data  The user data passed to `xkb_keymap::xkb_keymap_write()`.
+ *
+ * @returns `true` on success, or `false` to abort the serialization.
+ *
+ * @sa `xkb_keymap::xkb_keymap_write()`
+ * @memberof xkb_keymap
+ * @since 1.14.0
+ */
+typedef bool
+(*xkb_keymap_write_func_t)(const char *chunk, size_t size, void *data);
+
+/**
+ * Serialize the compiled keymap by chunks.
+ *
+ * This is the streaming variant of `xkb_keymap::xkb_keymap_get_as_string2()`:
+ * the output is the same, but it is passed by chunks to @p write, so that the
+ * whole string is never allocated.
+ *
+ * @param keymap The keymap to serialize.
+ * @param format The keymap format to use, see
+ * `xkb_keymap::xkb_keymap_get_as_string2()`.
+ * @param flags  Optional flags to control the serialization, or 0.
+ * @param write  The function called with each chunk, in order. It is not
+ * called with a terminating `NULL` byte.
+ * @param data   User data passed to @p write.
+ *
+ * @returns `true` on success, or `false` if unsuccessful or if @p write
+ * returned `false`.
+ *
+ * @since 1.14.0
+ *
+ * @sa `xkb_keymap::xkb_keymap_get_as_string2()`
+ * @sa `xkb_keymap::xkb_keymap_write_to_fd()`
+ * @memberof xkb_keymap
+ */
+XKB_EXPORT bool
+xkb_keymap_write(struct xkb_keymap *keymap,
+                 enum xkb_keymap_format format,
+                 enum xkb_keymap_serialize_flags flags,
+                 xkb_keymap_write_func_t write, void *data);
+
+/**
+ * Serialize the compiled keymap into a file descriptor.
+ *
+ * Same as `xkb_keymap::xkb_keymap_write()`, writing the chunks to @p fd at
+ * its current offset. No terminating `NULL` byte is written.
+ *
+ * @returns `true` on success, or `false` if unsuccessful, e.g. on I/O error.
+ *
+ * @since 1.14.0
+ *
+ * @sa `xkb_keymap::xkb_keymap_write()`
+ * @sa `xkb_keymap::xkb_keymap_get_as_memfd()`
+ * @memberof xkb_keymap
+ */
+XKB_EXPORT bool
+xkb_keymap_write_to_fd(struct xkb_keymap *keymap, int fd,
+                       enum xkb_keymap_format format,
+                       enum xkb_keymap_serialize_flags flags);
+
+/**
+ * Serialize the compiled keymap into a new sealed memory file.
+ *
+ * The file contains the `NULL`-terminated serialized keymap, as expected
+ * by e.g. the Wayland [wl_keyboard.keymap] event. It is sealed against
+ * writing, shrinking and growing, so that it can be shared read-only with
+ * untrusted processes, that should map it with `MAP_PRIVATE`.
+ *
+ * @param keymap The keymap to serialize.
+ * @param format The keymap format to use, see
+ * `xkb_keymap::xkb_keymap_get_as_string2()`.
+ * @param flags  Optional flags to control the serialization, or 0.
+ * @param[out] size The size of the file, *including* the terminating `NULL`
+ * byte.
+ *
+ * @returns A new file descriptor, that should be closed by the caller, or -1
+ * if unsuccessful. This is supported only on platforms with `memfd_create()`
+ * and file sealing, e.g. Linux and FreeBSD.
+ *
+ * @since 1.14.0
+ *
+ * @sa `xkb_keymap::xkb_keymap_write_to_fd()`
+ * @memberof xkb_keymap
+ *
+ * [wl_keyboard.keymap]: https://wayland.freedesktop.org/docs/html/apa.html#protocol-spec-wl_keyboard-event-keymap
+ */
+XKB_EXPORT int
+xkb_keymap_get_as_memfd(struct xkb_keymap *keymap,
+                        enum xkb_keymap_format format,
+                        enum xkb_keymap_serialize_flags flags,
+                        size_t *size);
+
+/**
+ * Size in bytes of a keymap fingerprint.
+ *
+ * @sa `xkb_keymap::xkb_keymap_get_fingerprint()`
+ * @since 1.14.0
+ */
+#define XKB_KEYMAP_FINGERPRINT_SIZE 16
+
+/**
+ * Get the fingerprint of a keymap.
+ *
+ * The fingerprint is a 128-bit hash of the content of the keymap: modifiers,
+ * key types, LEDs, keycodes, key aliases and key symbols and actions. It does
+ * not depend on the context, the include path, the keymap source formatting
+ * nor on the platform. Thus two keymaps with the same content have the same
+ * fingerprint, so it can be used e.g. as a key of a cache of compiled
+ * keymaps, or to avoid sending identical keymaps to a client.
+ *
+ * Different keymaps are *very unlikely* to have the same fingerprint, but it
+ * is not a cryptographic hash and it should not be used with untrusted
+ * keymaps designed to collide. Note that the algorithm may change between
+ * xkbcommon releases.
+ *
+ * The fingerprint is computed only on the first call, then cached in the
+ * keymap.  This function may be called concurrently on the same keymap from
+ * multiple threads.
+ *
+ * @param keymap The keymap.
+ * @param[out] fingerprint The fingerprint, as an array of
+ * `XKB_KEYMAP_FINGERPRINT_SIZE` bytes.
+ *
+ * @since 1.14.0
+ *
+ * @memberof xkb_keymap
+ */
+XKB_EXPORT void
+xkb_keymap_get_fingerprint(struct xkb_keymap *keymap,
+                           uint8_t fingerprint[XKB_KEYMAP_FINGERPRINT_SIZE]);
+
+/**
+ * @struct xkb_keymap_diff
+ * Opaque set of changes between two keymaps.
+ *
+ * It is self-contained: it does not refer to the keymaps it was created
+ * from, but holds a copy of the changed items.
+ *
+ * @since 1.14.0
+ */
+struct xkb_keymap_diff;
+
+/**
+ * Keymap components, as reported by
+ * `xkb_keymap_diff::xkb_keymap_diff_get_components()`.
+ *
+ * @since 1.14.0
+ */
+enum xkb_keymap_component {
+    /** Keycodes, key names and key aliases */
+    XKB_KEYMAP_COMPONENT_KEYCODES = (1 << 0),
+    /** Key types */
+    XKB_KEYMAP_COMPONENT_TYPES = (1 << 1),
+    /** Compatibility interpretations and enabled controls */
+    XKB_KEYMAP_COMPONENT_COMPAT = (1 << 2),
+    /** Keys keysyms, actions, types and modifier maps; layout names */
+    XKB_KEYMAP_COMPONENT_SYMBOLS = (1 << 3),
+    /** Modifiers and their mapping */
+    XKB_KEYMAP_COMPONENT_MODS = (1 << 4),
+    /** LEDs */
+    XKB_KEYMAP_COMPONENT_LEDS = (1 << 5)
+};
+
+/**
+ * Compute the changes between two keymaps.
+ *
+ * The diff reports the changed modifiers, LEDs, keys and keymap components.
+ * It can be applied to @p from with `xkb_keymap_diff::xkb_keymap_diff_apply()`
+ * to get a keymap identical to @p to, without compiling it from source.
+ *
+ * @param from The source keymap.
+ * @param to   The target keymap. It must share the same context as @p from.
+ *
+ * @returns A new diff, that should be freed with
+ * `xkb_keymap_diff::xkb_keymap_diff_free()`, or `NULL` on error.
+ *
+ * @since 1.14.0
+ *
+ * @memberof xkb_keymap_diff
+ */
+XKB_EXPORT struct xkb_keymap_diff *
+xkb_keymap_diff_new(struct xkb_keymap *from, struct xkb_keymap *to);
+
+/**
+ * Free a keymap diff.
+ *
+ * @param diff The diff to free. If it is `NULL`, this function does nothing.
+ *
+ * @since 1.14.0
+ *
+ * @memberof xkb_keymap_diff
+ */
+XKB_EXPORT void
+xkb_keymap_diff_free(struct xkb_keymap_diff *diff);
+
+/**
+ * Get the keymap components that changed.
+ *
+ * @returns A mask of `xkb_keymap_component`; it is 0 if the keymaps are
+ * identical.
+ *
+ * @since 1.14.0
+ *
+ * @memberof xkb_keymap_diff
+ */
+XKB_EXPORT enum xkb_keymap_component
+xkb_keymap_diff_get_components(const struct xkb_keymap_diff *diff);
+
+/**
+ * Check whether the changes affect the keyboard state.
+ *
+ * The keyboard state is affected if the changes could result in different
+ * modifiers, layouts or LEDs for the same key events, e.g. changes of key
+ * actions, key types or modifiers mapping. Changes of keysyms, key names,
+ * key repetition or layout names do not affect the keyboard state: an
+ * existing `xkb_state` remains valid for the new keymap in that regard.
+ *
+ * @since 1.14.0
+ *
+ * @memberof xkb_keymap_diff
+ */
+XKB_EXPORT bool
+xkb_keymap_diff_affects_state(const struct xkb_keymap_diff *diff);
+
+/**
+ * Get the keycodes of the keys that changed, including the added and removed
+ * keys.
+ *
+ * @param diff The diff.
+ * @param[out] count The number of keycodes.
+ *
+ * @returns The keycodes sorted in ascending order. The array is owned by
+ * @p diff and is valid as long as @p diff is alive.
+ *
+ * @since 1.14.0
+ *
+ * @memberof xkb_keymap_diff
+ */
+XKB_EXPORT const xkb_keycode_t *
+xkb_keymap_diff_get_keys(const struct xkb_keymap_diff *diff, size_t *count);
+
+/**
+ * Get the modifiers that changed, including the added and removed modifiers.
+ *
+ * @returns A mask of modifier indices.
+ *
+ * @since 1.14.0
+ *
+ * @memberof xkb_keymap_diff
+ */
+XKB_EXPORT xkb_mod_mask_t
+xkb_keymap_diff_get_mods(const struct xkb_keymap_diff *diff);
+
+/**
+ * Get the LEDs that changed, including the added and removed LEDs.
+ *
+ * @returns A mask of LED indices.
+ *
+ * @since 1.14.0
+ *
+ * @memberof xkb_keymap_diff
+ */
+XKB_EXPORT xkb_led_mask_t
+xkb_keymap_diff_get_leds(const struct xkb_keymap_diff *diff);
+
+/**
+ * Apply a diff to a keymap.
+ *
+ * @param diff The diff to apply.
+ * @param from The source keymap used to create @p diff, or an identical
+ * keymap with the same context. Having the same fingerprint is not
+ * sufficient: the compatibility interpretations and the explicit key
+ * properties, which the fingerprint ignores, must match as well.
+ *
+ * @returns A new keymap identical to the target keymap used to create
+ * @p diff, or `NULL` on error, e.g. if @p from does not match the source
+ * keymap of @p diff.
+ *
+ * @since 1.14.0
+ *
+ * @sa `xkb_keymap::xkb_keymap_get_fingerprint()`
+ * @memberof xkb_keymap_diff
+ */
+XKB_EXPORT struct xkb_keymap *
+xkb_keymap_diff_apply(const struct xkb_keymap_diff *diff,
+                      struct xkb_keymap *from);
+
 /** @} */
 
 /**
@@ -8,6 +8,7 @@
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 /**
  * @file
@@ -158,7 +159,42 @@ enum rxkb_context_flags {
      *
      * @since 1.5.0
      */
-    RXKB_CONTEXT_NO_SECURE_GETENV = (1 << 2)
+    RXKB_CONTEXT_NO_SECURE_GETENV = (1 << 2),
+    /**
+     * Validate the rules XML files against the full registry DTD.
+     *
+     * By default, the files are parsed in a streaming fashion and only their
+     * structure is checked while reading them. With this flag, each file is
+     * loaded entirely in memory and validated before any of its items is
+     * added to the registry, which is slower and uses more memory.
+     *
+     * In both cases, a file that fails the checks contributes no item.
+     *
+     * @since 1.14.0
+     */
+    RXKB_CONTEXT_VALIDATE_XML = (1 << 3),
+    /**
+     * Load the details of the items on demand.
+     *
+     * By default, all the data of the rules XML files is loaded when parsing.
+     * With this flag, only the names and the popularity of the items are
+     * loaded by `rxkb_context_parse()`. The descriptions, the vendors and the
+     * ISO codes of the items of a rules file are loaded when one of them is
+     * first requested, e.g. with `rxkb_layout_get_description()`. This
+     * reduces the memory usage of the clients that list only the names of
+     * the items.
+     *
+     * The details are available only as long as the rules files are not
+     * modified; otherwise the corresponding getters return `NULL` or an empty
+     * list.
+     *
+     * Note that `rxkb_layouts_for_language()`, `rxkb_layouts_for_country()`
+     * and writing a cache with `rxkb_context_set_cache_path()` load all the
+     * details.
+     *
+     * @since 1.14.0
+     */
+    RXKB_CONTEXT_LAZY_DETAILS = (1 << 4)
 };
 
 /**
@@ -380,6 +416,32 @@ rxkb_context_include_path_append(struct rxkb_context *ctx, const char *path);
 RXKB_EXPORT bool
 rxkb_context_include_path_append_default(struct rxkb_context *ctx);
 
+/**
+ * Set the path of a binary cache of the parsed registry.
+ *
+ * When a cache path is set, `rxkb_context_parse()` first tries to load the
+ * registry from the cache. The cache is used only if it was created with the
+ * same ruleset, the same context flags and the same rules files, identified
+ * by their path, size and modification time. Otherwise the XML files are
+ * parsed as usual and the cache is (re)written on success.
+ *
+ * The cache is an implementation detail of this library version: it is not
+ * portable across machines and is invalidated by library upgrades. Errors
+ * while reading or writing the cache are not fatal.
+ *
+ * This function must be called before `rxkb_context_parse()` or
+ * `rxkb_context_parse_default_ruleset()`.
+ *
+ * @param ctx The xkb registry context
+ * @param path The path of the cache file, or `NULL` to disable the cache.
+ *
+ * @returns `true` on success, or `false` if the context was already parsed.
+ *
+ * @since 1.14.0
+ */
+RXKB_EXPORT bool
+rxkb_context_set_cache_path(struct rxkb_context *ctx, const char *path);
+
 /**
  * Return the first model for this context. Use this to start iterating over
  * the models, followed by calls to `rxkb_model_next()`. Models are not sorted.
@@ -474,6 +536,29 @@ rxkb_layout_first(struct rxkb_context *ctx);
 RXKB_EXPORT struct rxkb_layout *
 rxkb_layout_next(struct rxkb_layout *l);
 
+/**
+ * Find a layout by its name and variant.
+ *
+ * If the registry defines the same layout multiple times, e.g. in several
+ * include paths, the first one in the layout list is returned.
+ *
+ * The refcount of the returned layout is not increased. Use `rxkb_layout_ref()`
+ * if you need to keep this struct outside the immediate scope.
+ *
+ * @param ctx The xkb registry context
+ * @param name The layout name, e.g. `us`
+ * @param variant The variant name, e.g. `intl`, or `NULL` or an empty string
+ * for the base layout.
+ *
+ * @returns The layout or `NULL` if there is no such layout or if the context
+ * has not been parsed successfully.
+ *
+ * @since 1.14.0
+ */
+RXKB_EXPORT struct rxkb_layout *
+rxkb_layout_find(struct rxkb_context *ctx, const char *name,
+                 const char *variant);
+
 /**
  * Increase the refcount of the argument by one.
  *
@@ -629,6 +714,21 @@ rxkb_option_first(struct rxkb_option_group *group);
 RXKB_EXPORT struct rxkb_option *
 rxkb_option_next(struct rxkb_option *o);
 
+/**
+ * Find an option by its name, e.g. `grp:alt_shift_toggle`, in all the option
+ * groups of the context.
+ *
+ * The refcount of the returned option is not increased. Use `rxkb_option_ref()`
+ * if you need to keep this struct outside the immediate scope.
+ *
+ * @returns The first option with this name or `NULL` if there is no such
+ * option or if the context has not been parsed successfully.
+ *
+ * @since 1.14.0
+ */
+RXKB_EXPORT struct rxkb_option *
+rxkb_option_find(struct rxkb_context *ctx, const char *name);
+
 /**
  * Increase the refcount of the argument by one.
  *
@@ -783,6 +883,43 @@ rxkb_layout_get_iso3166_first(struct rxkb_layout *layout);
 RXKB_EXPORT struct rxkb_iso3166_code *
 rxkb_iso3166_code_next(struct rxkb_iso3166_code *iso3166);
 
+/**
+ * Return all the layouts and variants associated with a language.
+ *
+ * The layouts are in the same order as in the layout list. The array and
+ * the layouts are owned by the context and remain valid until the context is
+ * destroyed. The refcount of the returned layouts is not increased.
+ *
+ * @param ctx The xkb registry context
+ * @param iso639 The ISO 639-3 language code, e.g. `eng`. The comparison is
+ * case-insensitive.
+ * @param[out] count The number of layouts in the returned array.
+ *
+ * @returns An array of layouts, or `NULL` if there is no layout for this
+ * language or if the context has not been parsed successfully.
+ *
+ * @since 1.14.0
+ */
+RXKB_EXPORT struct rxkb_layout * const *
+rxkb_layouts_for_language(struct rxkb_context *ctx, const char *iso639,
+                          size_t *count);
+
+/**
+ * Return all the layouts and variants associated with a country.
+ *
+ * See `rxkb_layouts_for_language()` for details about the returned array.
+ *
+ * @param ctx The xkb registry context
+ * @param iso3166 The ISO 3166 Alpha 2 country code, e.g. `US`. The comparison
+ * is case-insensitive.
+ * @param[out] count The number of layouts in the returned array.
+ *
+ * @since 1.14.0
+ */
+RXKB_EXPORT struct rxkb_layout * const *
+rxkb_layouts_for_country(struct rxkb_context *ctx, const char *iso3166,
+                         size_t *count);
+
 /** @} */
 
 #ifdef __cplusplus
@@ -0,0 +1,255 @@
+#!/usr/bin/env python3
+
+"""
+Generate the lookup tables for keysyms <-> Unicode conversions of legacy
+keysyms, from the reference table `keysymtab` in `src/keysym-utf.c`.
+"""
+
+import argparse
+import re
+import sys
+from dataclasses import dataclass
+from pathlib import Path
+from typing import Sequence
+
+CODEPAIR_PATTERN = re.compile(
+    r"^\s*\{\s*(?P<keysym>0x[0-9a-fA-F]+),\s*(?P<deprecated>true|false),\s*"
+    r"(?P<ucs>0x[0-9a-fA-F]+)\s*\},"
+)
+
+
+@dataclass(frozen=True)
+class CodePair:
+    keysym: int
+    deprecated: bool
+    ucs: int
+
+
+def load_keysymtab(path: Path) -> tuple[CodePair, ...]:
+    pairs: list[CodePair] = []
+    with path.open("rt", encoding="utf-8") as fd:
+        for line in fd:
+            if m := CODEPAIR_PATTERN.match(line):
+                pairs.append(
+                    CodePair(
+                        keysym=int(m.group("keysym"), 16),
+                        deprecated=m.group("deprecated") == "true",
+                        ucs=int(m.group("ucs"), 16),
+                    )
+                )
+    if not pairs:
+        raise ValueError(f"No keysym table found in: {path}")
+    if any(p1.keysym >= p2.keysym for p1, p2 in zip(pairs, pairs[1:])):
+        raise ValueError("keysymtab is not sorted")
+    return tuple(pairs)
+
+
+@dataclass
+class TwoStageTable:
+    """
+    Two-stage lookup table: the data is split in blocks of 2^shift items,
+    identical blocks are stored only once and an index table maps each block
+    to its position in the data table:
+
+        data[(index[i >> shift] << shift) | (i & ((1 << shift) - 1))]
+    """
+
+    shift: int
+    index: list[int]
+    data: list[int]
+
+    @classmethod
+    def compute(cls, shift: int, values: Sequence[int]) -> "TwoStageTable":
+        size = 1 << shift
+        blocks: dict[tuple[int, ...], int] = {}
+        index: list[int] = []
+        data: list[int] = []
+        for start in range(0, len(values), size):
+            block = tuple(values[start : start + size])
+            block += (0,) * (size - len(block))
+            if block not in blocks:
+                blocks[block] = len(blocks)
+                data.extend(block)
+            index.append(blocks[block])
+        return cls(shift=shift, index=index, data=data)
+
+    @classmethod
+    def compute_best(
+        cls, values: Sequence[int], data_item_size: int
+    ) -> "TwoStageTable":
+        best = None
+        for shift in range(2, 10):
+            table = cls.compute(shift, values)
+            if best is None or table.size(data_item_size) < best.size(
+                data_item_size
+            ):
+                best = table
+        assert best is not None
+        return best
+
+    @property
+    def index_type(self) -> str:
+        return c_uint_type(max(self.index))
+
+    def size(self, data_item_size: int) -> int:
+        return len(self.index) * c_uint_size(max(self.index)) + len(
+            self.data
+        ) * data_item_size
+
+    def check(self, values: Sequence[int]) -> None:
+        mask = (1 << self.shift) - 1
+        for i, value in enumerate(values):
+            assert (
+                self.data[(self.index[i >> self.shift] << self.shift) | (i & mask)]
+                == value
+            )
+
+
+def c_uint_size(n: int) -> int:
+    if n < 1 << 8:
+        return 1
+    elif n < 1 << 16:
+        return 2
+    else:
+        return 4
+
+
+def c_uint_type(n: int) -> str:
+    return f"uint{c_uint_size(n) * 8}_t"
+
+
+def c_array(type: str, name: str, values: Sequence[int], width: int) -> str:
+    digits = max(len(f"{v:#x}") for v in values)
+    lines = []
+    for start in range(0, len(values), width):
+        chunk = values[start : start + width]
+        lines.append("    " + " ".join(f"{v:#0{digits}x}," for v in chunk))
+    body = "\n".join(lines)
+    return f"static const {type} {name}[{len(values)}] = {{\n{body}\n}};\n"
+
+
+def generate_ucs_to_keysym(pairs: Sequence[CodePair]) -> str:
+    # Keep the first non-deprecated keysym, as in the reference linear search
+    preferred: dict[int, int] = {}
+    for pair in pairs:
+        if not pair.deprecated and pair.ucs not in preferred:
+            preferred[pair.ucs] = pair.keysym
+
+    ucs_max = max(preferred)
+    values = [preferred.get(ucs, 0) for ucs in range(ucs_max + 1)]
+    assert max(values) < 1 << 16
+    table = TwoStageTable.compute_best(values, 2)
+    table.check(values)
+
+    return f"""\
+/*
+ * Unicode code point to legacy keysym, for code points up to
+ * UCS_TO_KEYSYM_MAX. The keysym is the first non-deprecated keysym of
+ * `keysymtab` with the given code point, or 0 if there is none.
+ *
+ * Total size: {table.size(2)} bytes.
+ */
+#define UCS_TO_KEYSYM_MAX {ucs_max:#06x}
+#define UCS_TO_KEYSYM_SHIFT {table.shift}
+
+{c_array(table.index_type, "ucs_to_keysym_index", table.index, 16)}
+{c_array("uint16_t", "ucs_to_keysym_data", table.data, 8)}
+static inline xkb_keysym_t
+lookup_ucs_to_keysym(uint32_t ucs)
+{{
+    if (ucs > UCS_TO_KEYSYM_MAX)
+        return XKB_KEY_NoSymbol;
+    const uint32_t mask = (UINT32_C(1) << UCS_TO_KEYSYM_SHIFT) - 1;
+    return ucs_to_keysym_data[
+        ((uint32_t) ucs_to_keysym_index[ucs >> UCS_TO_KEYSYM_SHIFT]
+            << UCS_TO_KEYSYM_SHIFT) | (ucs & mask)
+    ];
+}}
+"""
+
+
+def is_latin1(keysym: int) -> bool:
+    return 0x0020 <= keysym <= 0x007E or 0x00A0 <= keysym <= 0x00FF
+
+
+def generate_keysym_to_ucs(pairs: Sequence[CodePair]) -> str:
+    # Latin-1 keysyms are mapped 1:1; they are included in order to handle
+    # all the keysyms up to KEYSYM_TO_UCS_MAX with a single lookup.
+    mapping: dict[int, int] = {ks: ks for ks in range(0x100) if is_latin1(ks)}
+    for pair in pairs:
+        assert pair.keysym not in mapping, pair
+        mapping[pair.keysym] = pair.ucs
+
+    keysym_max = max(mapping)
+    values = [mapping.get(ks, 0) for ks in range(keysym_max + 1)]
+    assert max(values) < 1 << 16
+    table = TwoStageTable.compute_best(values, 2)
+    table.check(values)
+
+    return f"""\
+/*
+ * Legacy keysym to Unicode code point, for keysyms up to KEYSYM_TO_UCS_MAX,
+ * including Latin-1 keysyms. The code point is 0 if there is no conversion.
+ *
+ * Total size: {table.size(2)} bytes.
+ */
+#define KEYSYM_TO_UCS_MAX {keysym_max:#06x}
+#define KEYSYM_TO_UCS_SHIFT {table.shift}
+
+{c_array(table.index_type, "keysym_to_ucs_index", table.index, 16)}
+{c_array("uint16_t", "keysym_to_ucs_data", table.data, 8)}
+static inline uint32_t
+lookup_keysym_to_ucs(xkb_keysym_t keysym)
+{{
+    assert(keysym <= KEYSYM_TO_UCS_MAX);
+    const uint32_t mask = (UINT32_C(1) << KEYSYM_TO_UCS_SHIFT) - 1;
+    return keysym_to_ucs_data[
+        ((uint32_t) keysym_to_ucs_index[keysym >> KEYSYM_TO_UCS_SHIFT]
+            << KEYSYM_TO_UCS_SHIFT) | (keysym & mask)
+    ];
+}}
+"""
+
+
+def generate(pairs: Sequence[CodePair]) -> str:
+    return f"""\
+// NOTE: This file has been generated automatically by “{Path(__file__).name}”.
+//       Do not edit manually!
+
+/*
+ * Lookup tables for the conversions of legacy keysyms, generated from
+ * `keysymtab` in `keysym-utf.c`.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+#include "xkbcommon/xkbcommon.h"
+
+{generate_keysym_to_ucs(pairs)}
+{generate_ucs_to_keysym(pairs)}"""
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__)
+    root = Path(__file__).parent.parent
+    parser.add_argument(
+        "--root", type=Path, default=root, help="Path to the root of the project"
+    )
+    parser.add_argument(
+        "--output",
+        type=Path,
+        help="Output file (default: src/keysym-utf-tables.h)",
+    )
+    args = parser.parse_args()
+
+    pairs = load_keysymtab(args.root / "src" / "keysym-utf.c")
+    output = args.output or (args.root / "src" / "keysym-utf-tables.h")
+    if str(output) == "-":
+        sys.stdout.write(generate(pairs))
+    else:
+        output.write_text(generate(pairs), encoding="utf-8")
@@ -20,20 +20,6 @@
 #include "darray.h"
 #include "utils.h"
 
-/* FNV-1a (http://www.isthe.com/chongo/tech/comp/fnv/). */
-static inline uint32_t
-hash_buf(const char *string, size_t len)
-{
-    uint32_t hash = UINT32_C(2166136261);
-    for (size_t i = 0; i < (len + 1) / 2; i++) {
-        hash ^= (uint8_t) string[i];
-        hash *= 0x01000193;
-        hash ^= (uint8_t) string[len - 1 - i];
-        hash *= 0x01000193;
-    }
-    return hash;
-}
-
 /*
  * The atom table is an insert-only linear probing hash table
  * mapping strings to atoms. Another array maps the atoms to
@@ -89,9 +89,9 @@ lex(struct scanner *s, union lvalue *val)
 {
 skip_more_whitespace_and_comments:
     /* Skip spaces. */
-    while (is_space(scanner_peek(s)))
-        if (scanner_next(s) == '\n')
-            return TOK_END_OF_LINE;
+    scanner_skip_hspaces(s);
+    if (scanner_chr(s, '\n'))
+        return TOK_END_OF_LINE;
 
     /* Skip comments. */
     if (scanner_chr(s, '#')) {
@@ -200,14 +200,15 @@ skip_more_whitespace_and_comments:
 
     /* Identifier or include. */
     if (is_alpha(scanner_peek(s)) || scanner_peek(s) == '_') {
-        s->buf_pos = 0;
-        while (is_alnum(scanner_peek(s)) || scanner_peek(s) == '_')
-            scanner_buf_append(s, scanner_next(s));
-        if (!scanner_buf_append(s, '\0')) {
+        const size_t len = scanner_skip_ident(s);
+        if (len + 1 >= sizeof(s->buf)) {
             scanner_err(s, XKB_ERROR_INVALID_COMPOSE_SYNTAX,
                         "identifier is too long");
             return TOK_ERROR;
         }
+        memcpy(s->buf, s->s + s->token_pos, len);
+        s->buf[len] = '\0';
+        s->buf_pos = len + 1;
 
         if (streq(s->buf, "include"))
             return TOK_INCLUDE;
@@ -228,9 +229,9 @@ static enum rules_token
 lex_include_string(struct scanner *s, struct xkb_compose_table *table,
                    union lvalue *val_out)
 {
-    while (is_space(scanner_peek(s)))
-        if (scanner_next(s) == '\n')
-            return TOK_END_OF_LINE;
+    scanner_skip_hspaces(s);
+    if (scanner_chr(s, '\n'))
+        return TOK_END_OF_LINE;
 
     s->token_pos = s->pos;
     s->buf_pos = 0;
@@ -321,12 +322,99 @@ struct production {
     xkb_mod_mask_t mods;
 };
 
+/*
+ * Intern a result string into xkb_compose_table::utf8 and return its offset.
+ * Identical results, which are very common, are thus stored only once.
+ */
+static uint32_t
+intern_utf8(struct xkb_compose_table *table, const char *string)
+{
+    const size_t len = strlen(string);
+
+    /* count > 0.8 * index_size */
+    if (table->utf8_index_count >= (table->utf8_index_size / 5) * 4) {
+        const uint32_t new_size =
+            (table->utf8_index_size ? table->utf8_index_size * 2 : 64);
+        uint32_t *new_index = calloc(new_size, sizeof(*new_index));
+        if (!new_index)
+            goto append;
+        for (uint32_t j = 0; j < table->utf8_index_size; j++) {
+            const uint32_t offset = table->utf8_index[j];
+            if (offset == 0)
+                continue;
+            const char *str = &darray_item(table->utf8, offset);
+            uint32_t pos = hash_buf(str, strlen(str)) & (new_size - 1);
+            while (new_index[pos] != 0)
+                pos = (pos + 1) & (new_size - 1);
+            new_index[pos] = offset;
+        }
+        free(table->utf8_index);
+        table->utf8_index = new_index;
+        table->utf8_index_size = new_size;
+    }
+
+    uint32_t pos = hash_buf(string, len) & (table->utf8_index_size - 1);
+    while (table->utf8_index[pos] != 0) {
+        const uint32_t offset = table->utf8_index[pos];
+        if (streq(&darray_item(table->utf8, offset), string))
+            return offset;
+        pos = (pos + 1) & (table->utf8_index_size - 1);
+    }
+    table->utf8_index[pos] = darray_size(table->utf8);
+    table->utf8_index_count++;
+
+append:;
+    const uint32_t offset = darray_size(table->utf8);
+    darray_append_items(table->utf8, string, (darray_size_t) len + 1);
+    return offset;
+}
+
+/*
+ * Drop the strings that are no longer referenced by any leaf, e.g. after
+ * a sequence has been overridden.
+ */
+static void
+compact_utf8(struct xkb_compose_table *table)
+{
+    darray_uint remap = darray_new();
+    struct compose_node *node;
+    darray_size_t new_size = 1;
+
+    /* Mark referenced strings */
+    darray_resize0(remap, darray_size(table->utf8));
+    darray_foreach(node, table->nodes) {
+        if (node->is_leaf && node->leaf.utf8 != 0)
+            darray_item(remap, node->leaf.utf8) = 1;
+    }
+
+    /* Move referenced strings in place, preserving their order */
+    for (darray_size_t offset = 1; offset < darray_size(table->utf8);) {
+        const char *str = &darray_item(table->utf8, offset);
+        const darray_size_t size = (darray_size_t) strlen(str) + 1;
+        if (darray_item(remap, offset)) {
+            memmove(&darray_item(table->utf8, new_size), str, size);
+            darray_item(remap, offset) = new_size;
+            new_size += size;
+        }
+        offset += size;
+    }
+    darray_size(table->utf8) = new_size;
+
+    darray_foreach(node, table->nodes) {
+        if (node->is_leaf && node->leaf.utf8 != 0)
+            node->leaf.utf8 = darray_item(remap, node->leaf.utf8);
+    }
+
+    darray_free(remap);
+}
+
 static void
 add_production(struct xkb_compose_table *table, struct scanner *s,
                const struct production *production)
 {
     unsigned int lhs_pos = 0;
     uint32_t curr = darray_size(table->nodes) == 1 ? 0 : 1;
+    uint32_t depth = 1;
     uint32_t *pptr = NULL;
     struct compose_node *node = NULL;
 
@@ -371,6 +459,8 @@ add_production(struct xkb_compose_table *table, struct scanner *s,
                 pptr = NULL;
             }
             darray_append(table->nodes, new);
+            if (depth > table->depth)
+                table->depth = depth;
         }
 
         node = &darray_item(table->nodes, curr);
@@ -378,6 +468,7 @@ add_production(struct xkb_compose_table *table, struct scanner *s,
         if (keysym < node->keysym) {
             pptr = &node->lokid;
             curr = node->lokid;
+            depth++;
         } else if (keysym > node->keysym) {
             pptr = &node->hikid;
             curr = node->hikid;
@@ -386,12 +477,15 @@ add_production(struct xkb_compose_table *table, struct scanner *s,
                 scanner_warn(s, XKB_LOG_MESSAGE_NO_ID,
                              "a sequence already exists which is a prefix of "
                              "this sequence; overriding");
+                if (node->leaf.utf8 != 0)
+                    table->utf8_has_garbage = true;
                 node->internal.eqkid = 0;
                 node->internal.is_leaf = false;
             }
             lhs_pos++;
             pptr = &node->internal.eqkid;
             curr = node->internal.eqkid;
+            depth++;
         } else {
             if (node->is_leaf) {
                 bool same_string =
@@ -423,22 +517,13 @@ add_production(struct xkb_compose_table *table, struct scanner *s,
                 node->internal.eqkid = 0;
             }
 
-            /* NOTE: If there was a previous entry, its string may *not* be
-             * reused in the UTF8 table and the corresponding memory is then
-             * wasted! */
+            /* NOTE: If there was a previous entry, its string may be shared
+             * with other entries, so it cannot be overwritten. It is removed
+             * from the UTF8 table after parsing, if no longer used. */
+            if (node->is_leaf && node->leaf.utf8 != 0)
+                table->utf8_has_garbage = true;
             if (production->has_string) {
-                const size_t len = strlen(production->string);
-                if (node->is_leaf && node->leaf.utf8 &&
-                    len <= strlen(&darray_item(table->utf8, node->leaf.utf8))) {
-                    /* There is a previous entry with an overwritable string */
-                    memcpy(&darray_item(table->utf8, node->leaf.utf8),
-                           production->string, len + 1);
-                } else {
-                    /* Cannot reuse string: allocate new one */
-                    node->leaf.utf8 = darray_size(table->utf8);
-                    darray_append_items(table->utf8, production->string,
-                                        (darray_size_t)strlen(production->string) + 1);
-                }
+                node->leaf.utf8 = intern_utf8(table, production->string);
             } else {
                 /* Ensure we reset possible previous entry */
                 node->leaf.utf8 = 0;
@@ -791,8 +876,17 @@ parse_string(struct xkb_compose_table *table, const char *string, size_t len,
 {
     struct scanner s;
     scanner_init(&s, table->ctx, string, len, file_name, NULL);
-    if (!parse(table, &s, 0))
+    const bool ok = parse(table, &s, 0);
+    free(table->utf8_index);
+    table->utf8_index = NULL;
+    table->utf8_index_size = 0;
+    table->utf8_index_count = 0;
+    if (!ok)
         return false;
+    if (table->utf8_has_garbage) {
+        compact_utf8(table);
+        table->utf8_has_garbage = false;
+    }
     /* Maybe the allocator can use the excess space. */
     darray_shrink(table->nodes);
     darray_shrink(table->utf8);
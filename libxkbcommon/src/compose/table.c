@@ -248,59 +248,95 @@ struct xkb_compose_table_iterator {
     struct xkb_compose_table *table;
     /* Current entry */
     struct xkb_compose_table_entry entry;
-    /* Stack of pending nodes to process */
-    darray(struct xkb_compose_table_iterator_pending_node) pending_nodes;
+    xkb_keysym_t sequence[COMPOSE_MAX_LHS_LEN];
+    /* Whether the iterator holds a table reference and owns its memory */
+    bool owned;
+    /* Stack of pending nodes to process, bounded by the table depth */
+    uint32_t pending_count;
+    struct xkb_compose_table_iterator_pending_node pending_nodes[];
 };
 
-struct xkb_compose_table_iterator *
-xkb_compose_table_iterator_new(struct xkb_compose_table *table)
+static inline size_t
+iterator_size(const struct xkb_compose_table *table)
 {
-    struct xkb_compose_table_iterator *iter;
-    xkb_keysym_t *sequence;
+    return sizeof(struct xkb_compose_table_iterator) +
+           table->depth *
+           sizeof(struct xkb_compose_table_iterator_pending_node);
+}
 
-    iter = calloc(1, sizeof(*iter));
-    if (!iter) {
-        return NULL;
-    }
-    iter->table = xkb_compose_table_ref(table);
-    sequence = calloc(COMPOSE_MAX_LHS_LEN, sizeof(xkb_keysym_t));
-    if (!sequence) {
-        free(iter);
-        return NULL;
-    }
-    iter->entry.sequence = sequence;
+static void
+iterator_init(struct xkb_compose_table_iterator *iter,
+              struct xkb_compose_table *table, bool owned)
+{
+    iter->table = table;
+    iter->owned = owned;
+    iter->entry.sequence = iter->sequence;
     iter->entry.sequence_length = 0;
+    iter->pending_count = 0;
 
-    darray_init(iter->pending_nodes);
     /* Short-circuit if table contains only the dummy entry */
     if (darray_size(table->nodes) == 1) {
-        return iter;
+        return;
     }
     /* Add root node */
     struct xkb_compose_table_iterator_pending_node pending = {
         .offset = 1,
         .processed = false
     };
-    darray_append(iter->pending_nodes, pending);
-    const struct compose_node *node = &darray_item(iter->table->nodes,
+    iter->pending_nodes[iter->pending_count++] = pending;
+    const struct compose_node *node = &darray_item(table->nodes,
                                                    pending.offset);
 
     /* Find the first left-most node and store intermediate nodes as pending */
     while (node->lokid) {
         pending.offset = node->lokid;
-        darray_append(iter->pending_nodes, pending);
-        node = &darray_item(iter->table->nodes, pending.offset);
+        iter->pending_nodes[iter->pending_count++] = pending;
+        node = &darray_item(table->nodes, pending.offset);
     };
+}
+
+struct xkb_compose_table_iterator *
+xkb_compose_table_iterator_new(struct xkb_compose_table *table)
+{
+    struct xkb_compose_table_iterator *iter;
 
+    iter = calloc(1, iterator_size(table));
+    if (!iter) {
+        return NULL;
+    }
+    iterator_init(iter, xkb_compose_table_ref(table), true);
+    return iter;
+}
+
+size_t
+xkb_compose_table_iterator_storage_size(struct xkb_compose_table *table)
+{
+    return iterator_size(table);
+}
+
+struct xkb_compose_table_iterator *
+xkb_compose_table_iterator_init(struct xkb_compose_table *table,
+                                void *storage, size_t storage_size)
+{
+    struct xkb_compose_table_iterator *iter = storage;
+
+    if (!storage || storage_size < iterator_size(table) ||
+        !is_aligned(storage, _Alignof(struct xkb_compose_table_iterator))) {
+        log_err_func(table->ctx, XKB_LOG_MESSAGE_NO_ID,
+                     "invalid iterator storage: %p (size: %zu)\n",
+                     storage, storage_size);
+        return NULL;
+    }
+    iterator_init(iter, table, false);
     return iter;
 }
 
 void
 xkb_compose_table_iterator_free(struct xkb_compose_table_iterator *iter)
 {
+    if (!iter || !iter->owned)
+        return;
     xkb_compose_table_unref(iter->table);
-    darray_free(iter->pending_nodes);
-    free(iter->entry.sequence);
     free(iter);
 }
 
@@ -325,13 +361,12 @@ xkb_compose_table_iterator_next(struct xkb_compose_table_iterator *iter)
     const struct compose_node *node;
 
     /* Iterator is empty if there is no pending nodes */
-    if (unlikely(darray_empty(iter->pending_nodes))) {
+    if (unlikely(iter->pending_count == 0)) {
         return NULL;
     }
 
     /* Resume to the last element in the stack */
-    pending = &darray_item(iter->pending_nodes,
-                           darray_size(iter->pending_nodes) - 1);
+    pending = &iter->pending_nodes[iter->pending_count - 1];
     node = &darray_item(iter->table->nodes, pending->offset);
 
     struct xkb_compose_table_iterator_pending_node new = {
@@ -352,14 +387,12 @@ xkb_compose_table_iterator_next(struct xkb_compose_table_iterator *iter)
             goto node_left;
         } else {
             /* Remove processed node */
-            darray_remove_last(iter->pending_nodes);
-            if (unlikely(darray_empty(iter->pending_nodes))) {
+            if (unlikely(--iter->pending_count == 0)) {
                 /* No more nodes to process */
                 return NULL;
             }
             /* Get parent node */
-            pending = &darray_item(iter->pending_nodes,
-                                   darray_size(iter->pending_nodes) - 1);
+            pending = &iter->pending_nodes[iter->pending_count - 1];
             node = &darray_item(iter->table->nodes, pending->offset);
         }
     }
@@ -377,19 +410,106 @@ xkb_compose_table_iterator_next(struct xkb_compose_table_iterator *iter)
         }
         /* Not a leaf: process child node */
         new.offset = node->internal.eqkid;
-        darray_append(iter->pending_nodes, new);
-        pending = &darray_item(iter->pending_nodes,
-                               darray_size(iter->pending_nodes) - 1);
+        assert(iter->pending_count < iter->table->depth);
+        pending = &iter->pending_nodes[iter->pending_count++];
+        *pending = new;
 node_left:
         node = &darray_item(iter->table->nodes, pending->offset);
         /* Find the next left-most arrow and store intermediate pending nodes */
         while (node->lokid) {
             /* Follow left arrow */
             new.offset = node->lokid;
-            darray_append(iter->pending_nodes, new);
-            pending = &darray_item(iter->pending_nodes,
-                                   darray_size(iter->pending_nodes) - 1);
+            assert(iter->pending_count < iter->table->depth);
+            pending = &iter->pending_nodes[iter->pending_count++];
+            *pending = new;
             node = &darray_item(iter->table->nodes, new.offset);
         }
     }
 }
+
+struct for_each_pending_node {
+    uint32_t offset:31;
+    /* Whether the sequence up to this node has been processed, i.e. only
+     * the hikid subtree is pending. */
+    bool continuation:1;
+    uint32_t sequence_length;
+};
+
+void
+xkb_compose_table_for_each(struct xkb_compose_table *table,
+                           xkb_compose_table_iter_t fn, void *data)
+{
+    /*
+     * Iterative equivalent of an in-order recursive traversal. Contrary to
+     * xkb_compose_table_iterator_next(), it does not need to walk back the
+     * tree after each entry. The stack is bounded by the table depth.
+     */
+    struct for_each_pending_node stack_storage[64];
+    struct for_each_pending_node *stack = stack_storage;
+    xkb_keysym_t sequence[COMPOSE_MAX_LHS_LEN];
+    struct xkb_compose_table_entry entry = { .sequence = sequence };
+
+    if (darray_size(table->nodes) <= 1)
+        return;
+
+    if (table->depth > ARRAY_SIZE(stack_storage)) {
+        stack = calloc(table->depth, sizeof(*stack));
+        if (!stack) {
+            log_err_func1(table->ctx, XKB_ERROR_ALLOCATION_ERROR,
+                          "cannot allocate traversal stack\n");
+            return;
+        }
+    }
+
+    uint32_t count = 0;
+    uint32_t offset = 1;
+    uint32_t length = 0;
+    while (true) {
+        /* Find the left-most node and store intermediate nodes as pending */
+        while (offset) {
+            assert(count < table->depth);
+            stack[count++] = (struct for_each_pending_node) {
+                .offset = offset,
+                .continuation = false,
+                .sequence_length = length,
+            };
+            offset = darray_item(table->nodes, offset).lokid;
+        }
+        if (count == 0)
+            break;
+
+        const struct for_each_pending_node pending = stack[--count];
+        const struct compose_node *node =
+            &darray_item(table->nodes, pending.offset);
+        length = pending.sequence_length;
+        if (pending.continuation) {
+            /* Follow right arrow */
+            offset = node->hikid;
+            continue;
+        }
+
+        sequence[length] = node->keysym;
+        if (node->is_leaf) {
+            entry.sequence_length = length + 1;
+            entry.keysym = node->leaf.keysym;
+            entry.utf8 = &darray_item(table->utf8, node->leaf.utf8);
+            fn(&entry, data);
+            /* Follow right arrow */
+            offset = node->hikid;
+        } else {
+            /* Follow down arrow, then right arrow */
+            if (node->hikid) {
+                stack[count++] = (struct for_each_pending_node) {
+                    .offset = pending.offset,
+                    .continuation = true,
+                    .sequence_length = length,
+                };
+            }
+            offset = node->internal.eqkid;
+            length++;
+        }
+    }
+
+    if (stack != stack_storage)
+        free(stack);
+}
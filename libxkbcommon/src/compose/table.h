@@ -54,7 +54,9 @@
  * A leaf contains the result data of its sequence.  The result keysym is
  * contained in the node struct itself; the result UTF-8 string is a byte
  * offset into an array of the form "\0first\0second\0third" (the initial
- * \0 is so offset 0 points to an empty string).
+ * \0 is so offset 0 points to an empty string).  Result strings are
+ * interned while parsing, so that sequences with the same result share the
+ * same offset, and the array is compacted once parsing is complete.
  */
 
 /* 7 nodes for every potential Unicode character and then some should be
@@ -100,6 +102,22 @@ struct xkb_compose_table {
 
     darray_char utf8;
     darray(struct compose_node) nodes;
+    /*
+     * Upper bound of the count of pending nodes when traversing the tree:
+     * lokid and eqkid pointers count for one, hikid pointers for zero.
+     */
+    uint32_t depth;
+
+    /*
+     * Build-time only: insert-only linear probing hash table mapping the
+     * strings of xkb_compose_table::utf8 to their offset, or 0 for an empty
+     * slot. Freed once parsing is complete.
+     */
+    uint32_t *utf8_index;
+    uint32_t utf8_index_size;
+    uint32_t utf8_index_count;
+    /* Build-time only: whether some strings may no longer be referenced. */
+    bool utf8_has_garbage;
 };
 
 struct xkb_compose_table_entry {
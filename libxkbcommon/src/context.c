@@ -29,6 +29,140 @@
 #include "utils.h"
 
 
+/*
+ * Keymap cache
+ *
+ * Each cached keymap holds a reference to the context, which is released
+ * when the entry is evicted.
+ */
+
+/* Evict the least recently used entries, so that at most `size` remain */
+static void
+keymap_cache_shrink(struct keymap_cache *cache, darray_size_t size)
+{
+    if (darray_size(cache->entries) <= size)
+        return;
+
+    /*
+     * Detach the evicted entries before releasing them, because releasing
+     * the last keymap may free the context.
+     */
+    struct keymap_cache_entry *entries;
+    darray_size_t count;
+    if (size == 0) {
+        count = darray_size(cache->entries);
+        darray_steal(cache->entries, &entries, NULL);
+    } else {
+        /* Some references are held elsewhere: the array is not freed */
+        entries = &darray_item(cache->entries, size);
+        count = darray_size(cache->entries) - size;
+        darray_resize(cache->entries, size);
+    }
+
+    for (darray_size_t e = 0; e < count; e++) {
+        darray_free(entries[e].key);
+        xkb_keymap_unref(entries[e].keymap);
+    }
+
+    if (size == 0)
+        free(entries);
+}
+
+struct xkb_keymap *
+xkb_context_keymap_cache_lookup(struct xkb_context *ctx,
+                                const darray_char *key, uint32_t hash)
+{
+    struct keymap_cache * const cache = &ctx->keymap_cache;
+    if (cache->size == 0)
+        return NULL;
+
+    for (darray_size_t e = 0; e < darray_size(cache->entries); e++) {
+        const struct keymap_cache_entry * const entry =
+            &darray_item(cache->entries, e);
+        if (entry->hash != hash ||
+            darray_size(entry->key) != darray_size(*key) ||
+            memcmp(darray_items(entry->key), darray_items(*key),
+                   darray_size(*key)) != 0)
+            continue;
+        /* Move to front */
+        const struct keymap_cache_entry hit = *entry;
+        memmove(&darray_item(cache->entries, 1), darray_items(cache->entries),
+                e * sizeof(hit));
+        darray_item(cache->entries, 0) = hit;
+        cache->hits++;
+        return xkb_keymap_ref(hit.keymap);
+    }
+
+    cache->misses++;
+    return NULL;
+}
+
+void
+xkb_context_keymap_cache_insert(struct xkb_context *ctx,
+                                darray_char *key, uint32_t hash,
+                                struct xkb_keymap *keymap)
+{
+    struct keymap_cache * const cache = &ctx->keymap_cache;
+    if (cache->size == 0)
+        return;
+
+    keymap_cache_shrink(cache, cache->size - 1);
+    /* Take ownership of the key */
+    const struct keymap_cache_entry entry = {
+        .hash = hash,
+        .key = *key,
+        .keymap = xkb_keymap_ref(keymap),
+    };
+    darray_init(*key);
+    darray_insert(cache->entries, 0, entry);
+}
+
+unsigned int
+xkb_context_compiler_cache_size(struct xkb_context *ctx)
+{
+    return MAX(ctx->keymap_cache.size, (unsigned int) ctx->prewarmed);
+}
+
+static void
+compiler_caches_free(struct xkb_context *ctx)
+{
+    for (size_t c = 0; c < ARRAY_SIZE(ctx->compiler_caches); c++) {
+        if (ctx->compiler_caches[c].data) {
+            ctx->compiler_caches[c].free(ctx->compiler_caches[c].data);
+            ctx->compiler_caches[c].data = NULL;
+        }
+    }
+}
+
+void
+xkb_context_set_keymap_cache_size(struct xkb_context *ctx, unsigned int size)
+{
+    ctx->keymap_cache.size = size;
+    keymap_cache_shrink(&ctx->keymap_cache, size);
+    if (size == 0) {
+        /* Also opt out of the compiler caches enabled by prewarming */
+        ctx->prewarmed = false;
+        compiler_caches_free(ctx);
+    }
+}
+
+void
+xkb_context_clear_keymap_cache(struct xkb_context *ctx)
+{
+    keymap_cache_shrink(&ctx->keymap_cache, 0);
+    compiler_caches_free(ctx);
+}
+
+void
+xkb_context_get_keymap_cache_stats(struct xkb_context *ctx,
+                                   uint64_t *hits, uint64_t *misses)
+{
+    if (hits)
+        *hits = ctx->keymap_cache.hits;
+    if (misses)
+        *misses = ctx->keymap_cache.misses;
+}
+
 /**
  * Append one directory to the context’s include path.
  */
@@ -81,6 +215,8 @@ err:
 int
 xkb_context_include_path_append(struct xkb_context *ctx, const char *path)
 {
+    /* Cached keymaps may not match the new include path */
+    xkb_context_clear_keymap_cache(ctx);
     return (xkb_context_init_includes(ctx))
         ? context_include_path_append(ctx, path)
         : 0;
@@ -247,6 +383,8 @@ xkb_context_include_path_append_default(struct xkb_context *ctx)
      * we already initialized the includes paths or we are doing it now.
      */
 
+    xkb_context_clear_keymap_cache(ctx);
+
     char *user_path;
     int ret = 0;
 
@@ -347,6 +485,8 @@ xkb_context_include_path_clear(struct xkb_context *ctx)
 {
     char **path;
 
+    xkb_context_clear_keymap_cache(ctx);
+
     darray_foreach(path, ctx->includes)
         free(*path);
     darray_free(ctx->includes);
@@ -412,10 +552,21 @@ void
 xkb_context_unref(struct xkb_context *ctx)
 {
     assert(!ctx || ctx->refcnt > 0);
-    if (!ctx || --ctx->refcnt > 0)
+    if (!ctx)
         return;
+    if (--ctx->refcnt > 0) {
+        /*
+         * Break the reference cycle if the cached keymaps hold the only
+         * remaining references. The last eviction frees the context.
+         */
+        if ((darray_size_t) ctx->refcnt ==
+            darray_size(ctx->keymap_cache.entries))
+            keymap_cache_shrink(&ctx->keymap_cache, 0);
+        return;
+    }
 
     free(ctx->x11_atom_cache);
+    /* Also frees the keymap caches */
     xkb_context_include_path_clear(ctx);
     atom_table_free(ctx->atom_table);
     free(ctx);
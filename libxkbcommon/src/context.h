@@ -10,6 +10,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "xkbcommon/xkbcommon.h"
 #include "atom.h"
@@ -18,6 +19,33 @@
 #include "rmlvo.h"
 #include "utils.h"
 
+/* Keymap compiled from RMLVO, indexed by its normalized names */
+struct keymap_cache_entry {
+    uint32_t hash;
+    darray_char key;
+    struct xkb_keymap *keymap;
+};
+
+struct keymap_cache {
+    /* Most recently used first */
+    darray(struct keymap_cache_entry) entries;
+    /* Maximum number of entries; 0 disables the cache */
+    unsigned int size;
+    uint64_t hits;
+    uint64_t misses;
+};
+
+/* Caches of the keymap compiler, see: xkb_context_compiler_cache_size() */
+enum compiler_cache {
+    /* Lexed rules files */
+    COMPILER_CACHE_RULES,
+    /* Compiled keycodes, types and compat sections */
+    COMPILER_CACHE_COMPONENTS,
+    /* Compiled layouts of the symbols section */
+    COMPILER_CACHE_SYMBOLS,
+    _COMPILER_CACHE_NUM_ENTRIES
+};
+
 struct xkb_context {
     int refcnt;
 
@@ -35,6 +63,13 @@ struct xkb_context {
 
     struct atom_table *atom_table;
 
+    struct keymap_cache keymap_cache;
+    /* Used and allocated by the keymap compiler */
+    struct {
+        void *data;
+        void (*free)(void *data);
+    } compiler_caches[_COMPILER_CACHE_NUM_ENTRIES];
+
     /* Used and allocated by xkbcommon-x11, free()d with the context. */
     void *x11_atom_cache;
 
@@ -45,8 +80,26 @@ struct xkb_context {
     bool use_environment_names : 1;
     bool use_secure_getenv : 1;
     bool pending_default_includes : 1;
+    /* Set by xkb_context_prewarm(): enables the compiler caches */
+    bool prewarmed : 1;
 };
 
+struct xkb_keymap *
+xkb_context_keymap_cache_lookup(struct xkb_context *ctx,
+                                const darray_char *key, uint32_t hash);
+
+void
+xkb_context_keymap_cache_insert(struct xkb_context *ctx,
+                                darray_char *key, uint32_t hash,
+                                struct xkb_keymap *keymap);
+
+/*
+ * Number of keymaps the compiler caches are sized for; 0 disables them.
+ * They are enabled with the keymap cache or by prewarming the context.
+ */
+unsigned int
+xkb_context_compiler_cache_size(struct xkb_context *ctx);
+
 char *
 xkb_context_getenv(struct xkb_context *ctx, const char *name);
 
@@ -7,6 +7,8 @@
 #include "config.h"
 
 #include <assert.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "keymap.h"
 #include "src/messages-codes.h"
@@ -21,6 +23,103 @@
 
 /* TODO: enable to relax the order on some items, such as: aliases, etc. */
 
+/*
+ * Comparison of items of keymaps sharing the same context
+ *
+ * Atoms are compared directly and differences are not logged. The
+ * fingerprint below hashes a subset of the fields compared here, so that
+ * equal items always hash the same.
+ */
+
+static bool
+mods_equal(const struct xkb_mods *a, const struct xkb_mods *b)
+{
+    return a->mods == b->mods && a->mask == b->mask;
+}
+
+bool
+keymap_type_equal(const struct xkb_key_type *a, const struct xkb_key_type *b)
+{
+    if (a->name != b->name || !mods_equal(&a->mods, &b->mods) ||
+        a->required != b->required || a->num_levels != b->num_levels ||
+        a->num_level_names != b->num_level_names ||
+        a->num_entries != b->num_entries)
+        return false;
+    for (xkb_level_index_t l = 0; l < a->num_level_names; l++) {
+        if (a->level_names[l] != b->level_names[l])
+            return false;
+    }
+    for (darray_size_t e = 0; e < a->num_entries; e++) {
+        const struct xkb_key_type_entry * const ea = &a->entries[e];
+        const struct xkb_key_type_entry * const eb = &b->entries[e];
+        if (ea->level != eb->level || !mods_equal(&ea->mods, &eb->mods) ||
+            !mods_equal(&ea->preserve, &eb->preserve))
+            return false;
+    }
+    return true;
+}
+
+bool
+keymap_interpret_equal(const struct xkb_sym_interpret *a,
+                       const struct xkb_sym_interpret *b)
+{
+    if (a->sym != b->sym || a->match != b->match || a->mods != b->mods ||
+        a->virtual_mod != b->virtual_mod ||
+        a->level_one_only != b->level_one_only ||
+        a->repeat != b->repeat || a->required != b->required ||
+        a->num_actions != b->num_actions)
+        return false;
+    if (a->num_actions <= 1)
+        return action_equal(&a->a.action, &b->a.action);
+    for (xkb_action_count_t k = 0; k < a->num_actions; k++) {
+        if (!action_equal(&a->a.actions[k], &b->a.actions[k]))
+            return false;
+    }
+    return true;
+}
+
+bool
+keymap_led_equal(const struct xkb_led *a, const struct xkb_led *b)
+{
+    return a->name == b->name && a->which_groups == b->which_groups &&
+           a->groups == b->groups && a->which_mods == b->which_mods &&
+           mods_equal(&a->mods, &b->mods) && a->ctrls == b->ctrls;
+}
+
+enum keymap_key_change
+keymap_key_compare(const struct xkb_key *a, const struct xkb_key *b)
+{
+    enum keymap_key_change change = KEY_CHANGE_NONE;
+
+    if (a->name != b->name)
+        change |= KEY_CHANGE_KEYCODES;
+    if (a->explicit != b->explicit || a->repeats != b->repeats)
+        change |= KEY_CHANGE_SYMBOLS;
+    if (a->modmap != b->modmap || a->vmodmap != b->vmodmap ||
+        a->out_of_range_group_action != b->out_of_range_group_action ||
+        a->out_of_range_group_number != b->out_of_range_group_number ||
+        a->num_groups != b->num_groups)
+        return change | KEY_CHANGE_STATE;
+
+    for (xkb_layout_index_t g = 0; g < a->num_groups; g++) {
+        const struct xkb_group * const ga = &a->groups[g];
+        const struct xkb_group * const gb = &b->groups[g];
+        if (!keymap_type_equal(ga->type, gb->type))
+            return change | KEY_CHANGE_STATE;
+        if (ga->explicit_actions != gb->explicit_actions ||
+            ga->explicit_type != gb->explicit_type)
+            change |= KEY_CHANGE_SYMBOLS;
+        for (xkb_level_index_t l = 0; l < ga->type->num_levels; l++) {
+            if (!XkbLevelsSameActions(&ga->levels[l], &gb->levels[l]))
+                return change | KEY_CHANGE_STATE;
+            if (!XkbLevelsSameSyms(&ga->levels[l], &gb->levels[l]))
+                change |= KEY_CHANGE_SYMBOLS;
+        }
+    }
+
+    return change;
+}
+
 
 static bool
 keymap_compare_mods(struct xkb_context *ctx,
@@ -94,7 +193,7 @@ keymap_compare_keycodes(struct xkb_context *ctx,
                 keymap1->min_key_code, keymap2->min_key_code);
         identical = false;
     }
-    if (keymap1->max_key_code != keymap2->max_key_code) {
+    if (keymap1->num_keys_low != keymap2->num_keys_low) {
         log_err(ctx, XKB_LOG_MESSAGE_NO_ID,
                 "Low keycodes counts do not match: %"PRIu32" != %"PRIu32"\n",
                 keymap1->num_keys_low, keymap2->num_keys_low);
@@ -103,7 +202,7 @@ keymap_compare_keycodes(struct xkb_context *ctx,
     if (keymap1->max_key_code != keymap2->max_key_code) {
         log_err(ctx, XKB_LOG_MESSAGE_NO_ID,
                 "Max keycodes do not match: %"PRIu32" != %"PRIu32"\n",
-                keymap1->min_key_code, keymap2->min_key_code);
+                keymap1->max_key_code, keymap2->max_key_code);
         identical = false;
     }
 
@@ -111,7 +210,7 @@ keymap_compare_keycodes(struct xkb_context *ctx,
     const xkb_keycode_t k_max = MIN(keymap1->num_keys, keymap2->num_keys);
     for (xkb_keycode_t k = 0; k < k_max; k++) {
         const struct xkb_key * const key1 = &keymap1->keys[k];
-        const struct xkb_key * const key2 = &keymap1->keys[k];
+        const struct xkb_key * const key2 = &keymap2->keys[k];
         if (key1->keycode != key2->keycode) {
             log_err(ctx, XKB_LOG_MESSAGE_NO_ID,
                     "Key #%"PRIu32" keycodes do not match: "
@@ -182,6 +281,8 @@ keymap_compare_leds(struct xkb_context *ctx,
     for (xkb_led_index_t led = 0; led < led_max; led++) {
         const struct xkb_led * const led1 = &keymap1->leds[led];
         const struct xkb_led * const led2 = &keymap2->leds[led];
+        if (keymap1->ctx == keymap2->ctx && keymap_led_equal(led1, led2))
+            continue;
 
         /* NOTE: cannot compare atoms: keymaps may use different contexts */
         const char * const name1 = xkb_atom_text(keymap1->ctx, led1->name);
@@ -249,6 +350,10 @@ compare_types(struct xkb_context *ctx,
               const struct xkb_keymap *keymap1, const struct xkb_keymap *keymap2,
               const struct xkb_key_type *type1, const struct xkb_key_type *type2)
 {
+    /* Fast path for keymaps sharing the same context */
+    if (keymap1->ctx == keymap2->ctx && keymap_type_equal(type1, type2))
+        return true;
+
     bool identical = true;
 
     /* NOTE: cannot compare atoms: keymaps may use different contexts */
@@ -491,7 +596,7 @@ keymap_compare_symbols(struct xkb_context *ctx,
     const xkb_keycode_t k_max = MIN(keymap1->num_keys, keymap2->num_keys);
     for (xkb_keycode_t k = 0; k < k_max; k++) {
         const struct xkb_key * const key1 = &keymap1->keys[k];
-        const struct xkb_key * const key2 = &keymap1->keys[k];
+        const struct xkb_key * const key2 = &keymap2->keys[k];
         if (key1->keycode != key2->keycode) {
             log_err(ctx, XKB_LOG_MESSAGE_NO_ID,
                     "Key #%"PRIu32" keycodes do not match: "
@@ -501,6 +606,11 @@ keymap_compare_symbols(struct xkb_context *ctx,
             continue;
         }
 
+        /* Fast path for keymaps sharing the same context */
+        if (keymap1->ctx == keymap2->ctx &&
+            !(keymap_key_compare(key1, key2) & ~KEY_CHANGE_KEYCODES))
+            continue;
+
         const xkb_keycode_t kc = key1->keycode;
 
         /* NOTE: key name checked in `compare_keycodes()` */
@@ -589,3 +699,409 @@ xkb_keymap_compare(struct xkb_context *ctx,
 
     return identical;
 }
+
+/*
+ * Keymap fingerprint
+ *
+ * The fingerprint is a 128-bit hash of the exact same properties that are
+ * checked by `xkb_keymap_compare()` with `XKB_KEYMAP_CMP_ALL`, so that
+ * keymaps deemed identical always have the same fingerprint. Properties not
+ * compared must *not* be hashed.
+ *
+ * The hash is MurmurHash3 x64_128 in streaming form. Every value is fed as
+ * little-endian bytes, so that the result does not depend on the platform.
+ */
+
+struct fingerprint_hasher {
+    uint64_t h1;
+    uint64_t h2;
+    uint64_t block[2];
+    /* Count of bytes in the current block */
+    unsigned int pending;
+    uint64_t length;
+};
+
+#define FP_C1 UINT64_C(0x87c37b91114253d5)
+#define FP_C2 UINT64_C(0x4cf5ad432745937f)
+
+static inline uint64_t
+rotl64(uint64_t x, unsigned int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t
+fmix64(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= UINT64_C(0xff51afd7ed558ccd);
+    k ^= k >> 33;
+    k *= UINT64_C(0xc4ceb9fe1a85ec53);
+    k ^= k >> 33;
+    return k;
+}
+
+static void
+fingerprint_mix_block(struct fingerprint_hasher *hasher)
+{
+    uint64_t k1 = hasher->block[0];
+    uint64_t k2 = hasher->block[1];
+
+    k1 *= FP_C1; k1 = rotl64(k1, 31); k1 *= FP_C2; hasher->h1 ^= k1;
+    hasher->h1 = rotl64(hasher->h1, 27);
+    hasher->h1 += hasher->h2;
+    hasher->h1 = hasher->h1 * 5 + 0x52dce729;
+
+    k2 *= FP_C2; k2 = rotl64(k2, 33); k2 *= FP_C1; hasher->h2 ^= k2;
+    hasher->h2 = rotl64(hasher->h2, 31);
+    hasher->h2 += hasher->h1;
+    hasher->h2 = hasher->h2 * 5 + 0x38495ab5;
+
+    hasher->block[0] = hasher->block[1] = 0;
+    hasher->pending = 0;
+}
+
+static void
+fingerprint_add_bytes(struct fingerprint_hasher *hasher,
+                      const uint8_t *bytes, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        const unsigned int p = hasher->pending;
+        hasher->block[p / 8] |= (uint64_t) bytes[i] << (8 * (p % 8));
+        if (++hasher->pending == 16)
+            fingerprint_mix_block(hasher);
+    }
+    hasher->length += count;
+}
+
+static void
+fingerprint_add_uint(struct fingerprint_hasher *hasher, uint32_t value)
+{
+    const uint8_t bytes[4] = {
+        (uint8_t) value, (uint8_t) (value >> 8),
+        (uint8_t) (value >> 16), (uint8_t) (value >> 24)
+    };
+    fingerprint_add_bytes(hasher, bytes, sizeof(bytes));
+}
+
+/* Hash the text of an atom: atoms cannot be hashed directly, because
+ * keymaps may use different contexts */
+static void
+fingerprint_add_atom(struct fingerprint_hasher *hasher,
+                     const struct xkb_keymap *keymap, xkb_atom_t atom)
+{
+    const char * const text = xkb_atom_text(keymap->ctx, atom);
+    if (!text) {
+        /* Not a valid string length */
+        fingerprint_add_uint(hasher, UINT32_MAX);
+        return;
+    }
+    /* Length prefix, so that consecutive strings cannot be confused */
+    const size_t len = strlen(text);
+    fingerprint_add_uint(hasher, (uint32_t) len);
+    fingerprint_add_bytes(hasher, (const uint8_t *) text, len);
+}
+
+static void
+fingerprint_finish(struct fingerprint_hasher *hasher,
+                   uint8_t fingerprint[XKB_KEYMAP_FINGERPRINT_SIZE])
+{
+    /* Tail */
+    if (hasher->pending > 0) {
+        uint64_t k1 = hasher->block[0];
+        uint64_t k2 = hasher->block[1];
+        k2 *= FP_C2; k2 = rotl64(k2, 33); k2 *= FP_C1; hasher->h2 ^= k2;
+        k1 *= FP_C1; k1 = rotl64(k1, 31); k1 *= FP_C2; hasher->h1 ^= k1;
+    }
+
+    uint64_t h1 = hasher->h1 ^ hasher->length;
+    uint64_t h2 = hasher->h2 ^ hasher->length;
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+
+    for (unsigned int i = 0; i < 8; i++) {
+        fingerprint[i] = (uint8_t) (h1 >> (8 * i));
+        fingerprint[8 + i] = (uint8_t) (h2 >> (8 * i));
+    }
+}
+
+static void
+fingerprint_mods(struct fingerprint_hasher *hasher,
+                 const struct xkb_keymap *keymap)
+{
+    fingerprint_add_uint(hasher, keymap->mods.num_mods);
+    for (xkb_mod_index_t mod = 0; mod < keymap->mods.num_mods; mod++) {
+        const struct xkb_mod * const entry = &keymap->mods.mods[mod];
+        fingerprint_add_atom(hasher, keymap, entry->name);
+        fingerprint_add_uint(hasher, (uint32_t) entry->type);
+        fingerprint_add_uint(hasher, entry->mapping);
+    }
+}
+
+static void
+fingerprint_type(struct fingerprint_hasher *hasher,
+                 const struct xkb_keymap *keymap,
+                 const struct xkb_key_type *type)
+{
+    fingerprint_add_atom(hasher, keymap, type->name);
+    fingerprint_add_uint(hasher, type->mods.mods);
+    fingerprint_add_uint(hasher, type->num_levels);
+    fingerprint_add_uint(hasher, type->num_level_names);
+    for (xkb_level_index_t l = 0; l < type->num_level_names; l++)
+        fingerprint_add_atom(hasher, keymap, type->level_names[l]);
+    fingerprint_add_uint(hasher, type->num_entries);
+    for (darray_size_t e = 0; e < type->num_entries; e++) {
+        const struct xkb_key_type_entry * const entry = &type->entries[e];
+        fingerprint_add_uint(hasher, entry->level);
+        fingerprint_add_uint(hasher, entry->mods.mods);
+        fingerprint_add_uint(hasher, entry->preserve.mods);
+    }
+}
+
+static void
+fingerprint_types(struct fingerprint_hasher *hasher,
+                  const struct xkb_keymap *keymap)
+{
+    fingerprint_add_uint(hasher, keymap->num_types);
+    for (darray_size_t t = 0; t < keymap->num_types; t++)
+        fingerprint_type(hasher, keymap, &keymap->types[t]);
+}
+
+static void
+fingerprint_leds(struct fingerprint_hasher *hasher,
+                 const struct xkb_keymap *keymap)
+{
+    fingerprint_add_uint(hasher, keymap->num_leds);
+    for (xkb_led_index_t led = 0; led < keymap->num_leds; led++) {
+        const struct xkb_led * const entry = &keymap->leds[led];
+        fingerprint_add_atom(hasher, keymap, entry->name);
+        fingerprint_add_uint(hasher, (uint32_t) entry->which_groups);
+        fingerprint_add_uint(hasher, entry->groups);
+        fingerprint_add_uint(hasher, (uint32_t) entry->which_mods);
+        fingerprint_add_uint(hasher, entry->mods.mods);
+        fingerprint_add_uint(hasher, (uint32_t) entry->ctrls);
+    }
+}
+
+static void
+fingerprint_keycodes(struct fingerprint_hasher *hasher,
+                     const struct xkb_keymap *keymap)
+{
+    fingerprint_add_uint(hasher, keymap->num_keys);
+    fingerprint_add_uint(hasher, keymap->num_keys_low);
+    fingerprint_add_uint(hasher, keymap->min_key_code);
+    fingerprint_add_uint(hasher, keymap->max_key_code);
+    for (xkb_keycode_t k = 0; k < keymap->num_keys; k++) {
+        const struct xkb_key * const key = &keymap->keys[k];
+        fingerprint_add_uint(hasher, key->keycode);
+        fingerprint_add_atom(hasher, keymap, key->name);
+    }
+
+    fingerprint_add_uint(hasher, keymap->num_key_aliases);
+    for (darray_size_t a = 0; a < keymap->num_key_aliases; a++) {
+        const struct xkb_key_alias * const entry = &keymap->key_aliases[a];
+        fingerprint_add_atom(hasher, keymap, entry->alias);
+        fingerprint_add_atom(hasher, keymap, entry->real);
+    }
+}
+
+/* Hash only the fields compared in `action_equal()` */
+static void
+fingerprint_action(struct fingerprint_hasher *hasher,
+                   const union xkb_action *action)
+{
+    fingerprint_add_uint(hasher, (uint32_t) action->type);
+
+    static_assert(ACTION_TYPE_INTERNAL == 18 &&
+                  ACTION_TYPE_INTERNAL + 1 == _ACTION_TYPE_NUM_ENTRIES,
+                  "Missing action type");
+
+    switch (action->type) {
+    case ACTION_TYPE_NONE:
+    case ACTION_TYPE_VOID:
+    case ACTION_TYPE_TERMINATE:
+    case ACTION_TYPE_UNSUPPORTED_LEGACY:
+        break;
+    case ACTION_TYPE_MOD_SET:
+    case ACTION_TYPE_MOD_LATCH:
+    case ACTION_TYPE_MOD_LOCK:
+        fingerprint_add_uint(hasher, (uint32_t) action->mods.flags);
+        fingerprint_add_uint(hasher, action->mods.mods.mask);
+        fingerprint_add_uint(hasher, action->mods.mods.mods);
+        break;
+    case ACTION_TYPE_GROUP_SET:
+    case ACTION_TYPE_GROUP_LATCH:
+    case ACTION_TYPE_GROUP_LOCK:
+        fingerprint_add_uint(hasher, (uint32_t) action->group.flags);
+        fingerprint_add_uint(hasher, (uint32_t) action->group.group);
+        break;
+    case ACTION_TYPE_PTR_MOVE:
+        fingerprint_add_uint(hasher, (uint32_t) action->ptr.flags);
+        fingerprint_add_uint(hasher, (uint32_t) action->ptr.x);
+        fingerprint_add_uint(hasher, (uint32_t) action->ptr.y);
+        break;
+    case ACTION_TYPE_PTR_BUTTON:
+    case ACTION_TYPE_PTR_LOCK:
+        fingerprint_add_uint(hasher, (uint32_t) action->btn.flags);
+        fingerprint_add_uint(hasher, action->btn.button);
+        fingerprint_add_uint(hasher, action->btn.count);
+        break;
+    case ACTION_TYPE_PTR_DEFAULT:
+        fingerprint_add_uint(hasher, (uint32_t) action->dflt.flags);
+        fingerprint_add_uint(hasher, (uint32_t) action->dflt.value);
+        break;
+    case ACTION_TYPE_SWITCH_VT:
+        fingerprint_add_uint(hasher, (uint32_t) action->screen.flags);
+        fingerprint_add_uint(hasher, (uint32_t) action->screen.screen);
+        break;
+    case ACTION_TYPE_CTRL_SET:
+    case ACTION_TYPE_CTRL_LOCK:
+        fingerprint_add_uint(hasher, (uint32_t) action->ctrls.flags);
+        fingerprint_add_uint(hasher, (uint32_t) action->ctrls.ctrls);
+        break;
+    case ACTION_TYPE_INTERNAL:
+        fingerprint_add_uint(hasher, (uint32_t) action->internal.flags);
+        fingerprint_add_uint(hasher, action->internal.clear_latched_mods);
+        break;
+    default:
+        /* Private/custom action */
+        fingerprint_add_bytes(hasher, action->priv.data,
+                              sizeof(action->priv.data));
+    }
+}
+
+static void
+fingerprint_level(struct fingerprint_hasher *hasher,
+                  const struct xkb_level *level)
+{
+    fingerprint_add_uint(hasher, level->num_syms);
+    if (level->num_syms > 1) {
+        for (xkb_keysym_count_t k = 0; k < level->num_syms; k++)
+            fingerprint_add_uint(hasher, level->s.syms[k]);
+    } else if (level->num_syms == 1) {
+        fingerprint_add_uint(hasher, level->s.sym);
+    }
+
+    fingerprint_add_uint(hasher, level->num_actions);
+    if (level->num_actions > 1) {
+        for (xkb_action_count_t a = 0; a < level->num_actions; a++)
+            fingerprint_action(hasher, &level->a.actions[a]);
+    } else if (level->num_actions == 1) {
+        fingerprint_action(hasher, &level->a.action);
+    }
+}
+
+static void
+fingerprint_symbols(struct fingerprint_hasher *hasher,
+                    const struct xkb_keymap *keymap)
+{
+    fingerprint_add_uint(hasher, keymap->num_groups);
+    fingerprint_add_uint(hasher, keymap->num_group_names);
+    for (xkb_layout_index_t g = 0; g < keymap->num_group_names; g++)
+        fingerprint_add_atom(hasher, keymap, keymap->group_names[g]);
+
+    for (xkb_keycode_t k = 0; k < keymap->num_keys; k++) {
+        const struct xkb_key * const key = &keymap->keys[k];
+        fingerprint_add_uint(hasher, key->modmap);
+        fingerprint_add_uint(hasher, key->vmodmap);
+        fingerprint_add_uint(hasher, key->repeats);
+        fingerprint_add_uint(hasher,
+                             (uint32_t) key->out_of_range_group_action);
+        fingerprint_add_uint(hasher, key->out_of_range_group_number);
+        fingerprint_add_uint(hasher, key->num_groups);
+        for (xkb_layout_index_t g = 0; g < key->num_groups; g++) {
+            const struct xkb_group * const group = &key->groups[g];
+            /*
+             * The type content is already hashed in `fingerprint_types()`
+             * and type names are unique, so hash only the name.
+             */
+            fingerprint_add_atom(hasher, keymap, group->type->name);
+            fingerprint_add_uint(hasher, group->type->num_levels);
+            for (xkb_level_index_t l = 0; l < group->type->num_levels; l++)
+                fingerprint_level(hasher, &group->levels[l]);
+        }
+    }
+}
+
+void
+keymap_compute_fingerprint(const struct xkb_keymap *keymap,
+                           uint8_t fingerprint[XKB_KEYMAP_FINGERPRINT_SIZE])
+{
+    struct fingerprint_hasher hasher = { 0 };
+
+    /* Same order as in `xkb_keymap_compare()` */
+    fingerprint_mods(&hasher, keymap);
+    fingerprint_types(&hasher, keymap);
+    fingerprint_leds(&hasher, keymap);
+    fingerprint_keycodes(&hasher, keymap);
+    fingerprint_symbols(&hasher, keymap);
+
+    fingerprint_finish(&hasher, fingerprint);
+}
+
+/*
+ * Source digest of a keymap diff
+ *
+ * `xkb_keymap_diff_apply()` copies some items from the source keymap, which
+ * must then match exactly the keymap the diff was created from. The
+ * fingerprint is not enough for that purpose, because it ignores the
+ * compatibility interpretations and the explicit flags of the keys.
+ */
+
+/* Hash only the fields compared in `keymap_interpret_equal()` */
+static void
+fingerprint_interprets(struct fingerprint_hasher *hasher,
+                       const struct xkb_keymap *keymap)
+{
+    fingerprint_add_uint(hasher, keymap->num_sym_interprets);
+    for (darray_size_t i = 0; i < keymap->num_sym_interprets; i++) {
+        const struct xkb_sym_interpret * const entry = &keymap->sym_interprets[i];
+        fingerprint_add_uint(hasher, entry->sym);
+        fingerprint_add_uint(hasher, (uint32_t) entry->match);
+        fingerprint_add_uint(hasher, entry->mods);
+        fingerprint_add_uint(hasher, entry->virtual_mod);
+        fingerprint_add_uint(hasher, entry->level_one_only);
+        fingerprint_add_uint(hasher, entry->repeat);
+        fingerprint_add_uint(hasher, entry->required);
+        fingerprint_add_uint(hasher, entry->num_actions);
+        if (entry->num_actions > 1) {
+            for (xkb_action_count_t a = 0; a < entry->num_actions; a++)
+                fingerprint_action(hasher, &entry->a.actions[a]);
+        } else if (entry->num_actions == 1) {
+            fingerprint_action(hasher, &entry->a.action);
+        }
+    }
+}
+
+static void
+fingerprint_explicit(struct fingerprint_hasher *hasher,
+                     const struct xkb_keymap *keymap)
+{
+    for (xkb_keycode_t k = 0; k < keymap->num_keys; k++) {
+        const struct xkb_key * const key = &keymap->keys[k];
+        fingerprint_add_uint(hasher, (uint32_t) key->explicit);
+        for (xkb_layout_index_t g = 0; g < key->num_groups; g++) {
+            const struct xkb_group * const group = &key->groups[g];
+            fingerprint_add_uint(hasher, group->explicit_actions |
+                                         (group->explicit_type << 1));
+        }
+    }
+}
+
+void
+keymap_compute_diff_digest(const struct xkb_keymap *keymap,
+                           const uint8_t fingerprint[XKB_KEYMAP_FINGERPRINT_SIZE],
+                           uint8_t digest[XKB_KEYMAP_FINGERPRINT_SIZE])
+{
+    struct fingerprint_hasher hasher = { 0 };
+
+    fingerprint_add_bytes(&hasher, fingerprint, XKB_KEYMAP_FINGERPRINT_SIZE);
+    fingerprint_interprets(&hasher, keymap);
+    fingerprint_explicit(&hasher, keymap);
+
+    fingerprint_finish(&hasher, digest);
+}
@@ -7,6 +7,7 @@
 #include "config.h"
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "xkbcommon/xkbcommon.h"
 #include "utils.h"
@@ -37,3 +38,55 @@ xkb_keymap_compare(struct xkb_context *ctx,
                    const struct xkb_keymap *keymap1,
                    const struct xkb_keymap *keymap2,
                    enum xkb_keymap_compare_property properties);
+
+/*
+ * Comparison of items of keymaps sharing the same context
+ */
+
+struct xkb_key_type;
+struct xkb_sym_interpret;
+struct xkb_led;
+struct xkb_key;
+
+bool
+keymap_type_equal(const struct xkb_key_type *a, const struct xkb_key_type *b);
+
+bool
+keymap_interpret_equal(const struct xkb_sym_interpret *a,
+                       const struct xkb_sym_interpret *b);
+
+bool
+keymap_led_equal(const struct xkb_led *a, const struct xkb_led *b);
+
+enum keymap_key_change {
+    KEY_CHANGE_NONE = 0,
+    /* Name change */
+    KEY_CHANGE_KEYCODES = (1 << 0),
+    /* Keysyms, repeat, explicit flags */
+    KEY_CHANGE_SYMBOLS = (1 << 1),
+    /* Actions, types, modmap, groups: changes the keyboard state machine */
+    KEY_CHANGE_STATE = (1 << 2),
+};
+
+enum keymap_key_change
+keymap_key_compare(const struct xkb_key *a, const struct xkb_key *b);
+
+/**
+ * Compute the fingerprint of a keymap, i.e. a hash of the properties checked
+ * by `xkb_keymap_compare()` with `XKB_KEYMAP_CMP_ALL`.
+ */
+void
+keymap_compute_fingerprint(const struct xkb_keymap *keymap,
+                           uint8_t fingerprint[XKB_KEYMAP_FINGERPRINT_SIZE]);
+
+/**
+ * Compute the digest of the source keymap of a keymap diff, i.e. a hash of
+ * all the properties that `xkb_keymap_diff_apply()` may copy from it.
+ *
+ * It extends the given fingerprint of the keymap with the properties that
+ * the fingerprint ignores.
+ */
+void
+keymap_compute_diff_digest(const struct xkb_keymap *keymap,
+                           const uint8_t fingerprint[XKB_KEYMAP_FINGERPRINT_SIZE],
+                           uint8_t digest[XKB_KEYMAP_FINGERPRINT_SIZE]);
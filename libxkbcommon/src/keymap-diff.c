@@ -0,0 +1,684 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xkbcommon/xkbcommon.h"
+#include "keymap.h"
+#include "keymap-compare.h"
+#include "utils.h"
+
+/*
+ * A keymap diff is a self-contained patch: it holds copies of the items of
+ * the target keymap that differ from the source keymap, so that the target
+ * keymap can be rebuilt from the source keymap and the diff only.
+ *
+ * Both keymaps must share the same context, so that atoms can be compared
+ * and copied directly.
+ *
+ * The key types, modifiers and LEDs are always stored, because they are
+ * small and the keys refer to the types. However they are reported as
+ * changed only if they actually differ.
+ */
+struct xkb_keymap_diff {
+    struct xkb_context *ctx;
+
+    /*
+     * Digest of the source keymap, to check the patched keymap. It covers
+     * all the items that may be copied from the source keymap, including
+     * those ignored by the fingerprint.
+     */
+    uint8_t from_digest[XKB_KEYMAP_FINGERPRINT_SIZE];
+
+    /* Summary */
+    enum xkb_keymap_component components;
+    bool affects_state;
+    xkb_mod_mask_t changed_mods;
+    xkb_led_mask_t changed_leds;
+    darray_size_t num_changed_keys;
+    xkb_keycode_t *changed_keys;
+
+    /* Target keymap properties */
+    enum xkb_keymap_format format;
+    enum xkb_keymap_compile_flags flags;
+    enum xkb_action_controls enabled_ctrls;
+    xkb_keycode_t min_key_code;
+    xkb_keycode_t max_key_code;
+    xkb_keycode_t num_keys;
+    xkb_keycode_t num_keys_low;
+    xkb_layout_index_t num_groups;
+    struct xkb_mod_set mods;
+    xkb_mod_mask_t canonical_state_mask;
+    struct xkb_led leds[XKB_MAX_LEDS];
+    xkb_led_index_t num_leds;
+    darray_size_t num_types;
+    struct xkb_key_type *types;
+    char *keycodes_section_name;
+    char *symbols_section_name;
+    char *types_section_name;
+    char *compat_section_name;
+
+    /* Target keymap items stored only if they changed */
+    bool has_key_aliases;
+    darray_size_t num_key_aliases;
+    struct xkb_key_alias *key_aliases;
+
+    bool has_group_names;
+    xkb_layout_index_t num_group_names;
+    xkb_atom_t *group_names;
+
+    bool has_sym_interprets;
+    darray_size_t num_sym_interprets;
+    struct xkb_sym_interpret *sym_interprets;
+
+    /*
+     * Keys: if the key layout did not change, only the changed keys are
+     * stored, else all the keys are stored.
+     */
+    bool has_all_keys;
+    darray_size_t num_stored_keys;
+    /* Indexes of the stored keys in the keys array of the target keymap */
+    xkb_keycode_t *stored_key_indexes;
+    struct xkb_key *stored_keys;
+};
+
+/*
+ * Deep copies
+ *
+ * On error, the copies are left in a state that can be cleared safely.
+ */
+
+static bool
+copy_level(struct xkb_level *dst, const struct xkb_level *src)
+{
+    *dst = *src;
+    if (src->num_syms > 1) {
+        dst->s.syms = memdup(src->s.syms, src->num_syms, sizeof(*src->s.syms));
+        if (!dst->s.syms) {
+            dst->num_syms = 0;
+            dst->num_actions = 0;
+            return false;
+        }
+    }
+    if (src->num_actions > 1) {
+        dst->a.actions = memdup(src->a.actions, src->num_actions,
+                                sizeof(*src->a.actions));
+        if (!dst->a.actions) {
+            dst->num_actions = 0;
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Copy a key; its types are mapped using `type_map`, indexed by the index of
+ * the source type in `src_types`.
+ */
+static bool
+copy_key(struct xkb_key *dst, const struct xkb_key *src,
+         const struct xkb_key_type *src_types,
+         const struct xkb_key_type * const *type_map)
+{
+    *dst = *src;
+    dst->groups = NULL;
+    dst->num_groups = 0;
+    if (!src->num_groups)
+        return true;
+
+    dst->groups = calloc(src->num_groups, sizeof(*dst->groups));
+    if (!dst->groups)
+        return false;
+    dst->num_groups = src->num_groups;
+
+    for (xkb_layout_index_t g = 0; g < src->num_groups; g++) {
+        const struct xkb_group * const group = &src->groups[g];
+        struct xkb_group * const copy = &dst->groups[g];
+        copy->explicit_actions = group->explicit_actions;
+        copy->explicit_type = group->explicit_type;
+        copy->type = type_map[group->type - src_types];
+        if (!copy->type)
+            return false;
+        assert(copy->type->num_levels == group->type->num_levels);
+        copy->levels = calloc(group->type->num_levels, sizeof(*copy->levels));
+        if (!copy->levels)
+            return false;
+        for (xkb_level_index_t l = 0; l < group->type->num_levels; l++) {
+            if (!copy_level(&copy->levels[l], &group->levels[l]))
+                return false;
+        }
+    }
+    return true;
+}
+
+static void
+clear_key(struct xkb_key *key)
+{
+    if (!key->groups)
+        return;
+    for (xkb_layout_index_t g = 0; g < key->num_groups; g++) {
+        struct xkb_group * const group = &key->groups[g];
+        if (!group->levels)
+            continue;
+        for (xkb_level_index_t l = 0; l < group->type->num_levels; l++)
+            clear_level(&group->levels[l]);
+        free(group->levels);
+    }
+    free(key->groups);
+}
+
+static bool
+copy_section_names(char **keycodes, char **symbols, char **types, char **compat,
+                   const char *src_keycodes, const char *src_symbols,
+                   const char *src_types, const char *src_compat)
+{
+    *keycodes = strdup_safe(src_keycodes);
+    *symbols = strdup_safe(src_symbols);
+    *types = strdup_safe(src_types);
+    *compat = strdup_safe(src_compat);
+    return (!src_keycodes || *keycodes) && (!src_symbols || *symbols) &&
+           (!src_types || *types) && (!src_compat || *compat);
+}
+
+/*
+ * Diff
+ */
+
+static bool
+diff_add_changed_key(struct xkb_keymap_diff *diff, xkb_keycode_t kc)
+{
+    xkb_keycode_t * const keys =
+        realloc(diff->changed_keys,
+                (diff->num_changed_keys + 1) * sizeof(*diff->changed_keys));
+    if (!keys)
+        return false;
+    keys[diff->num_changed_keys++] = kc;
+    diff->changed_keys = keys;
+    return true;
+}
+
+static bool
+diff_store_key(struct xkb_keymap_diff *diff, const struct xkb_keymap *to,
+               xkb_keycode_t index, const struct xkb_key_type * const *type_map)
+{
+    struct xkb_key * const keys =
+        realloc(diff->stored_keys,
+                (diff->num_stored_keys + 1) * sizeof(*diff->stored_keys));
+    if (!keys)
+        return false;
+    diff->stored_keys = keys;
+    xkb_keycode_t * const indexes =
+        realloc(diff->stored_key_indexes,
+                (diff->num_stored_keys + 1) * sizeof(*indexes));
+    if (!indexes)
+        return false;
+    diff->stored_key_indexes = indexes;
+
+    /* Clearing a partial copy is safe, so count it at once */
+    indexes[diff->num_stored_keys] = index;
+    return copy_key(&keys[diff->num_stored_keys++], &to->keys[index],
+                    to->types, type_map);
+}
+
+static void
+diff_source_digest(struct xkb_keymap *keymap,
+                   uint8_t digest[XKB_KEYMAP_FINGERPRINT_SIZE])
+{
+    uint8_t fingerprint[XKB_KEYMAP_FINGERPRINT_SIZE];
+    xkb_keymap_get_fingerprint(keymap, fingerprint);
+    keymap_compute_diff_digest(keymap, fingerprint, digest);
+}
+
+static inline bool
+key_is_defined(const struct xkb_key *key)
+{
+    return key && key->name != XKB_ATOM_NONE;
+}
+
+static int
+compare_keycodes(const void *a, const void *b)
+{
+    const xkb_keycode_t ka = *(const xkb_keycode_t *) a;
+    const xkb_keycode_t kb = *(const xkb_keycode_t *) b;
+    return (ka > kb) - (ka < kb);
+}
+
+static bool
+diff_keys(struct xkb_keymap_diff *diff,
+          struct xkb_keymap *from, struct xkb_keymap *to,
+          const struct xkb_key_type * const *type_map)
+{
+    bool same_layout = (from->num_keys == to->num_keys &&
+                        from->num_keys_low == to->num_keys_low &&
+                        from->min_key_code == to->min_key_code &&
+                        from->max_key_code == to->max_key_code);
+    for (xkb_keycode_t k = 0; same_layout && k < to->num_keys; k++)
+        same_layout = (from->keys[k].keycode == to->keys[k].keycode);
+
+    enum keymap_key_change changes = KEY_CHANGE_NONE;
+
+    if (same_layout) {
+        for (xkb_keycode_t k = 0; k < to->num_keys; k++) {
+            const enum keymap_key_change change = keymap_key_compare(&from->keys[k],
+                                                       &to->keys[k]);
+            if (change == KEY_CHANGE_NONE)
+                continue;
+            changes |= change;
+            if (!diff_store_key(diff, to, k, type_map) ||
+                !diff_add_changed_key(diff, to->keys[k].keycode))
+                return false;
+        }
+    } else {
+        /* Store all the keys */
+        diff->has_all_keys = true;
+        changes |= KEY_CHANGE_KEYCODES;
+        for (xkb_keycode_t k = 0; k < to->num_keys; k++) {
+            if (!diff_store_key(diff, to, k, type_map))
+                return false;
+        }
+
+        /* Changed and added keys */
+        const struct xkb_key *key;
+        xkb_keys_foreach(key, to) {
+            if (!key_is_defined(key))
+                continue;
+            const struct xkb_key * const old = XkbKey(from, key->keycode);
+            const enum keymap_key_change change = (key_is_defined(old))
+                ? keymap_key_compare(old, key)
+                : KEY_CHANGE_STATE;
+            if (change == KEY_CHANGE_NONE)
+                continue;
+            changes |= change;
+            if (!diff_add_changed_key(diff, key->keycode))
+                return false;
+        }
+
+        /* Removed keys */
+        xkb_keys_foreach(key, from) {
+            if (!key_is_defined(key) || key_is_defined(XkbKey(to, key->keycode)))
+                continue;
+            changes |= KEY_CHANGE_STATE;
+            if (!diff_add_changed_key(diff, key->keycode))
+                return false;
+        }
+
+        qsort(diff->changed_keys, diff->num_changed_keys,
+              sizeof(*diff->changed_keys), compare_keycodes);
+    }
+
+    if (changes & KEY_CHANGE_KEYCODES)
+        diff->components |= XKB_KEYMAP_COMPONENT_KEYCODES;
+    if (changes & (KEY_CHANGE_SYMBOLS | KEY_CHANGE_STATE))
+        diff->components |= XKB_KEYMAP_COMPONENT_SYMBOLS;
+    if (changes & KEY_CHANGE_STATE)
+        diff->affects_state = true;
+
+    return true;
+}
+
+struct xkb_keymap_diff *
+xkb_keymap_diff_new(struct xkb_keymap *from, struct xkb_keymap *to)
+{
+    if (from->ctx != to->ctx) {
+        log_err_func1(to->ctx, XKB_LOG_MESSAGE_NO_ID,
+                      "keymaps must share the same context\n");
+        return NULL;
+    }
+
+    struct xkb_keymap_diff * const diff = calloc(1, sizeof(*diff));
+    if (!diff)
+        goto error;
+
+    diff->ctx = xkb_context_ref(to->ctx);
+    diff_source_digest(from, diff->from_digest);
+
+    /* Properties always stored */
+    diff->format = to->format;
+    diff->flags = to->flags;
+    diff->enabled_ctrls = to->enabled_ctrls;
+    diff->min_key_code = to->min_key_code;
+    diff->max_key_code = to->max_key_code;
+    diff->num_keys = to->num_keys;
+    diff->num_keys_low = to->num_keys_low;
+    diff->num_groups = to->num_groups;
+    diff->mods = to->mods;
+    diff->canonical_state_mask = to->canonical_state_mask;
+    memcpy(diff->leds, to->leds, sizeof(to->leds));
+    diff->num_leds = to->num_leds;
+    if (!copy_types(&diff->types, &diff->num_types,
+                    to->types, to->num_types) ||
+        !copy_section_names(&diff->keycodes_section_name,
+                            &diff->symbols_section_name,
+                            &diff->types_section_name,
+                            &diff->compat_section_name,
+                            to->keycodes_section_name,
+                            to->symbols_section_name,
+                            to->types_section_name,
+                            to->compat_section_name))
+        goto error;
+
+    /* Modifiers */
+    const xkb_mod_index_t num_mods = MAX(from->mods.num_mods,
+                                         to->mods.num_mods);
+    for (xkb_mod_index_t m = 0; m < num_mods; m++) {
+        if (m >= from->mods.num_mods || m >= to->mods.num_mods ||
+            from->mods.mods[m].name != to->mods.mods[m].name ||
+            from->mods.mods[m].type != to->mods.mods[m].type ||
+            from->mods.mods[m].mapping != to->mods.mods[m].mapping)
+            diff->changed_mods |= UINT32_C(1) << m;
+    }
+    if (diff->changed_mods ||
+        from->canonical_state_mask != to->canonical_state_mask) {
+        diff->components |= XKB_KEYMAP_COMPONENT_MODS;
+        diff->affects_state = true;
+    }
+
+    /* LEDs */
+    const xkb_led_index_t num_leds = MAX(from->num_leds, to->num_leds);
+    for (xkb_led_index_t led = 0; led < num_leds; led++) {
+        if (led >= from->num_leds || led >= to->num_leds ||
+            !keymap_led_equal(&from->leds[led], &to->leds[led]))
+            diff->changed_leds |= UINT32_C(1) << led;
+    }
+    if (diff->changed_leds) {
+        diff->components |= XKB_KEYMAP_COMPONENT_LEDS;
+        diff->affects_state = true;
+    }
+
+    /* Types; the keys using changed types are handled with the keys */
+    bool same_types = (from->num_types == to->num_types);
+    for (darray_size_t t = 0; same_types && t < to->num_types; t++)
+        same_types = keymap_type_equal(&from->types[t], &to->types[t]);
+    if (!same_types)
+        diff->components |= XKB_KEYMAP_COMPONENT_TYPES;
+
+    /* Compatibility */
+    bool same_interprets = (from->num_sym_interprets == to->num_sym_interprets);
+    for (darray_size_t k = 0; same_interprets && k < to->num_sym_interprets; k++) {
+        same_interprets = keymap_interpret_equal(&from->sym_interprets[k],
+                                          &to->sym_interprets[k]);
+    }
+    if (!same_interprets) {
+        diff->components |= XKB_KEYMAP_COMPONENT_COMPAT;
+        diff->has_sym_interprets = true;
+        if (!copy_interprets(&diff->sym_interprets, &diff->num_sym_interprets,
+                             to->sym_interprets, to->num_sym_interprets))
+            goto error;
+    }
+    if (from->enabled_ctrls != to->enabled_ctrls) {
+        diff->components |= XKB_KEYMAP_COMPONENT_COMPAT;
+        diff->affects_state = true;
+    }
+
+    /* Key aliases */
+    bool same_aliases = (from->num_key_aliases == to->num_key_aliases);
+    for (darray_size_t a = 0; same_aliases && a < to->num_key_aliases; a++) {
+        same_aliases =
+            (from->key_aliases[a].alias == to->key_aliases[a].alias &&
+             from->key_aliases[a].real == to->key_aliases[a].real);
+    }
+    if (!same_aliases) {
+        diff->components |= XKB_KEYMAP_COMPONENT_KEYCODES;
+        diff->has_key_aliases = true;
+        diff->num_key_aliases = to->num_key_aliases;
+        if (to->num_key_aliases) {
+            diff->key_aliases = memdup(to->key_aliases, to->num_key_aliases,
+                                       sizeof(*to->key_aliases));
+            if (!diff->key_aliases)
+                goto error;
+        }
+    }
+
+    /* Groups */
+    if (from->num_groups != to->num_groups) {
+        diff->components |= XKB_KEYMAP_COMPONENT_SYMBOLS;
+        diff->affects_state = true;
+    }
+    bool same_group_names = (from->num_group_names == to->num_group_names);
+    for (xkb_layout_index_t g = 0; same_group_names && g < to->num_group_names; g++)
+        same_group_names = (from->group_names[g] == to->group_names[g]);
+    if (!same_group_names) {
+        diff->components |= XKB_KEYMAP_COMPONENT_SYMBOLS;
+        diff->has_group_names = true;
+        diff->num_group_names = to->num_group_names;
+        if (to->num_group_names) {
+            diff->group_names = memdup(to->group_names, to->num_group_names,
+                                       sizeof(*to->group_names));
+            if (!diff->group_names)
+                goto error;
+        }
+    }
+
+    /* Keys: stored keys refer to the types stored in the diff */
+    const struct xkb_key_type **type_map =
+        calloc(to->num_types + 1, sizeof(*type_map));
+    if (!type_map)
+        goto error;
+    for (darray_size_t t = 0; t < to->num_types; t++)
+        type_map[t] = &diff->types[t];
+    const bool ok = diff_keys(diff, from, to, type_map);
+    free(type_map);
+    if (!ok)
+        goto error;
+
+    return diff;
+
+error:
+    log_err_func1(to->ctx, XKB_LOG_MESSAGE_NO_ID,
+                  "failed to create the keymap diff\n");
+    xkb_keymap_diff_free(diff);
+    return NULL;
+}
+
+void
+xkb_keymap_diff_free(struct xkb_keymap_diff *diff)
+{
+    if (!diff)
+        return;
+    for (darray_size_t k = 0; k < diff->num_stored_keys; k++)
+        clear_key(&diff->stored_keys[k]);
+    free(diff->stored_keys);
+    free(diff->stored_key_indexes);
+    free(diff->changed_keys);
+    clear_interprets(diff->sym_interprets, diff->num_sym_interprets);
+    free(diff->group_names);
+    free(diff->key_aliases);
+    /* Free types after the keys, that refer to them */
+    clear_types(diff->types, diff->num_types);
+    free(diff->keycodes_section_name);
+    free(diff->symbols_section_name);
+    free(diff->types_section_name);
+    free(diff->compat_section_name);
+    xkb_context_unref(diff->ctx);
+    free(diff);
+}
+
+enum xkb_keymap_component
+xkb_keymap_diff_get_components(const struct xkb_keymap_diff *diff)
+{
+    return diff->components;
+}
+
+bool
+xkb_keymap_diff_affects_state(const struct xkb_keymap_diff *diff)
+{
+    return diff->affects_state;
+}
+
+const xkb_keycode_t *
+xkb_keymap_diff_get_keys(const struct xkb_keymap_diff *diff, size_t *count)
+{
+    *count = diff->num_changed_keys;
+    return diff->changed_keys;
+}
+
+xkb_mod_mask_t
+xkb_keymap_diff_get_mods(const struct xkb_keymap_diff *diff)
+{
+    return diff->changed_mods;
+}
+
+xkb_led_mask_t
+xkb_keymap_diff_get_leds(const struct xkb_keymap_diff *diff)
+{
+    return diff->changed_leds;
+}
+
+/*
+ * Patch
+ */
+
+static bool
+apply_keys(struct xkb_keymap *keymap, const struct xkb_keymap_diff *diff,
+           const struct xkb_keymap *from)
+{
+    keymap->keys = calloc(diff->num_keys, sizeof(*keymap->keys));
+    if (!keymap->keys && diff->num_keys)
+        return false;
+    keymap->num_keys = diff->num_keys;
+
+    bool ok = false;
+    const struct xkb_key_type **diff_type_map =
+        calloc(diff->num_types + 1, sizeof(*diff_type_map));
+    const struct xkb_key_type **from_type_map =
+        calloc(from->num_types + 1, sizeof(*from_type_map));
+    if (!diff_type_map || !from_type_map)
+        goto out;
+
+    /* Types of the diff are copied in the same order */
+    for (darray_size_t t = 0; t < diff->num_types; t++)
+        diff_type_map[t] = &keymap->types[t];
+    /* Types of the source keymap are matched by their unique name; a missing
+     * type cannot be used by an unchanged key */
+    for (darray_size_t t = 0; t < from->num_types; t++) {
+        for (darray_size_t u = 0; u < keymap->num_types; u++) {
+            if (keymap->types[u].name == from->types[t].name &&
+                keymap->types[u].num_levels == from->types[t].num_levels) {
+                from_type_map[t] = &keymap->types[u];
+                break;
+            }
+        }
+    }
+
+    darray_size_t next_stored = 0;
+    for (xkb_keycode_t k = 0; k < diff->num_keys; k++) {
+        const struct xkb_key *src;
+        const struct xkb_key_type *src_types;
+        const struct xkb_key_type * const *type_map;
+        if (next_stored < diff->num_stored_keys &&
+            diff->stored_key_indexes[next_stored] == k) {
+            src = &diff->stored_keys[next_stored++];
+            src_types = diff->types;
+            type_map = diff_type_map;
+        } else {
+            assert(!diff->has_all_keys);
+            src = &from->keys[k];
+            src_types = from->types;
+            type_map = from_type_map;
+        }
+        if (!copy_key(&keymap->keys[k], src, src_types, type_map))
+            goto out;
+    }
+    ok = true;
+
+out:
+    free(diff_type_map);
+    free(from_type_map);
+    return ok;
+}
+
+struct xkb_keymap *
+xkb_keymap_diff_apply(const struct xkb_keymap_diff *diff,
+                      struct xkb_keymap *from)
+{
+    if (from->ctx != diff->ctx) {
+        log_err_func1(from->ctx, XKB_LOG_MESSAGE_NO_ID,
+                      "the keymap and the diff must share the same context\n");
+        return NULL;
+    }
+
+    uint8_t digest[XKB_KEYMAP_FINGERPRINT_SIZE];
+    diff_source_digest(from, digest);
+    if (memcmp(digest, diff->from_digest, sizeof(digest)) != 0) {
+        log_err_func1(from->ctx, XKB_LOG_MESSAGE_NO_ID,
+                      "the keymap is not the source keymap of the diff\n");
+        return NULL;
+    }
+
+    struct xkb_keymap * const keymap =
+        xkb_keymap_new(diff->ctx, diff->format, diff->flags);
+    if (!keymap)
+        goto error;
+
+    keymap->enabled_ctrls = diff->enabled_ctrls;
+    keymap->min_key_code = diff->min_key_code;
+    keymap->max_key_code = diff->max_key_code;
+    keymap->num_keys_low = diff->num_keys_low;
+    keymap->num_groups = diff->num_groups;
+    keymap->mods = diff->mods;
+    keymap->canonical_state_mask = diff->canonical_state_mask;
+    memcpy(keymap->leds, diff->leds, sizeof(diff->leds));
+    keymap->num_leds = diff->num_leds;
+
+    if (!copy_types(&keymap->types, &keymap->num_types,
+                    diff->types, diff->num_types) ||
+        !copy_section_names(&keymap->keycodes_section_name,
+                            &keymap->symbols_section_name,
+                            &keymap->types_section_name,
+                            &keymap->compat_section_name,
+                            diff->keycodes_section_name,
+                            diff->symbols_section_name,
+                            diff->types_section_name,
+                            diff->compat_section_name))
+        goto error;
+
+    const struct xkb_sym_interpret * const interprets =
+        (diff->has_sym_interprets) ? diff->sym_interprets : from->sym_interprets;
+    const darray_size_t num_interprets =
+        (diff->has_sym_interprets) ? diff->num_sym_interprets
+                                   : from->num_sym_interprets;
+    if (!copy_interprets(&keymap->sym_interprets, &keymap->num_sym_interprets,
+                         interprets, num_interprets))
+        goto error;
+
+    const struct xkb_key_alias * const aliases =
+        (diff->has_key_aliases) ? diff->key_aliases : from->key_aliases;
+    const darray_size_t num_aliases =
+        (diff->has_key_aliases) ? diff->num_key_aliases : from->num_key_aliases;
+    if (num_aliases) {
+        keymap->key_aliases = memdup(aliases, num_aliases, sizeof(*aliases));
+        if (!keymap->key_aliases)
+            goto error;
+        keymap->num_key_aliases = num_aliases;
+    }
+
+    const xkb_atom_t * const group_names =
+        (diff->has_group_names) ? diff->group_names : from->group_names;
+    const xkb_layout_index_t num_group_names =
+        (diff->has_group_names) ? diff->num_group_names : from->num_group_names;
+    if (num_group_names) {
+        keymap->group_names = memdup(group_names, num_group_names,
+                                     sizeof(*group_names));
+        if (!keymap->group_names)
+            goto error;
+        keymap->num_group_names = num_group_names;
+    }
+
+    if (!apply_keys(keymap, diff, from))
+        goto error;
+
+    return keymap;
+
+error:
+    log_err_func1(from->ctx, XKB_LOG_MESSAGE_NO_ID,
+                  "failed to apply the keymap diff\n");
+    xkb_keymap_unref(keymap);
+    return NULL;
+}
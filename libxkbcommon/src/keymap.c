@@ -14,10 +14,17 @@
 #include "config.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <stdint.h>
+#ifdef HAVE_MEMFD_CREATE
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
 
 #include "keymap.h"
+#include "keymap-compare.h"
 #include "text.h"
+#include "util-atomic.h"
 #include "xkbcommon/xkbcommon.h"
 
 struct xkb_keymap *
@@ -44,6 +51,82 @@ clear_interpret(struct xkb_sym_interpret *interp)
         free(interp->a.actions);
 }
 
+/*
+ * Deep copies
+ *
+ * On error, the copies are left in a state that can be cleared safely.
+ */
+
+bool
+copy_types(struct xkb_key_type **dst, darray_size_t *num_dst,
+           const struct xkb_key_type *src, darray_size_t num_src)
+{
+    *dst = calloc(num_src, sizeof(**dst));
+    if (!*dst && num_src)
+        return false;
+    *num_dst = num_src;
+    for (darray_size_t t = 0; t < num_src; t++) {
+        struct xkb_key_type * const type = &(*dst)[t];
+        *type = src[t];
+        type->level_names = NULL;
+        type->entries = NULL;
+        if (src[t].num_level_names) {
+            type->level_names = memdup(src[t].level_names,
+                                       src[t].num_level_names,
+                                       sizeof(*src[t].level_names));
+            if (!type->level_names)
+                return false;
+        }
+        if (src[t].num_entries) {
+            type->entries = memdup(src[t].entries, src[t].num_entries,
+                                   sizeof(*src[t].entries));
+            if (!type->entries)
+                return false;
+        }
+    }
+    return true;
+}
+
+void
+clear_types(struct xkb_key_type *types, darray_size_t num_types)
+{
+    for (darray_size_t t = 0; t < num_types; t++) {
+        free(types[t].level_names);
+        free(types[t].entries);
+    }
+    free(types);
+}
+
+bool
+copy_interprets(struct xkb_sym_interpret **dst, darray_size_t *num_dst,
+                const struct xkb_sym_interpret *src, darray_size_t num_src)
+{
+    *dst = calloc(num_src, sizeof(**dst));
+    if (!*dst && num_src)
+        return false;
+    *num_dst = num_src;
+    for (darray_size_t k = 0; k < num_src; k++) {
+        (*dst)[k] = src[k];
+        if (src[k].num_actions > 1) {
+            (*dst)[k].a.actions = memdup(src[k].a.actions, src[k].num_actions,
+                                         sizeof(*src[k].a.actions));
+            if (!(*dst)[k].a.actions) {
+                (*dst)[k].num_actions = 0;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void
+clear_interprets(struct xkb_sym_interpret *interprets, darray_size_t count)
+{
+    for (darray_size_t k = 0; k < count; k++)
+        clear_interpret(&interprets[k]);
+    free(interprets);
+}
+
 void
 xkb_keymap_unref(struct xkb_keymap *keymap)
 {
@@ -86,6 +169,14 @@ xkb_keymap_unref(struct xkb_keymap *keymap)
     free(keymap->symbols_section_name);
     free(keymap->types_section_name);
     free(keymap->compat_section_name);
+    for (size_t f = 0; f < ARRAY_SIZE(keymap->serialized); f++) {
+        for (size_t k = 0; k < ARRAY_SIZE(keymap->serialized[f]); k++) {
+            if (keymap->serialized[f][k])
+                free(keymap->serialized[f][k]->string);
+            free(keymap->serialized[f][k]);
+        }
+    }
+    free(keymap->fingerprint);
     xkb_context_unref(keymap->ctx);
     free(keymap);
 }
@@ -104,6 +195,75 @@ get_keymap_format_ops(enum xkb_keymap_format format)
     return keymap_format_ops[(int) format];
 }
 
+/*
+ * Keymap cache keys
+ *
+ * The key is a byte string encoding the format, the compilation flags and
+ * the normalized RMLVO names.  Keys from names and from RMLVO builders use
+ * distinct namespaces.
+ */
+
+static void
+keymap_cache_key_init(darray_char *key, char kind,
+                      enum xkb_keymap_format format,
+                      enum xkb_keymap_compile_flags flags)
+{
+    const int32_t values[] = { (int32_t) format, (int32_t) flags };
+    darray_append(*key, kind);
+    darray_append_items(*key, (const char *) values, sizeof(values));
+}
+
+/* A missing name is equivalent to an empty one */
+static void
+keymap_cache_key_add_string(darray_char *key, const char *string)
+{
+    if (!string)
+        string = "";
+    /* Names cannot contain NUL, so the terminator is a valid separator */
+    darray_append_string0(*key, string);
+}
+
+static uint32_t
+keymap_cache_key_from_names(darray_char *key,
+                            const struct xkb_rule_names *names,
+                            enum xkb_keymap_format format,
+                            enum xkb_keymap_compile_flags flags)
+{
+    keymap_cache_key_init(key, 'N', format, flags);
+    keymap_cache_key_add_string(key, names->rules);
+    keymap_cache_key_add_string(key, names->model);
+    keymap_cache_key_add_string(key, names->layout);
+    keymap_cache_key_add_string(key, names->variant);
+    keymap_cache_key_add_string(key, names->options);
+    return hash_buf(darray_items(*key), darray_size(*key));
+}
+
+static uint32_t
+keymap_cache_key_from_rmlvo(darray_char *key,
+                            const struct xkb_rmlvo_builder *rmlvo,
+                            enum xkb_keymap_format format,
+                            enum xkb_keymap_compile_flags flags)
+{
+    keymap_cache_key_init(key, 'B', format, flags);
+    keymap_cache_key_add_string(key, rmlvo->rules);
+    keymap_cache_key_add_string(key, rmlvo->model);
+    const darray_size_t num_layouts = darray_size(rmlvo->layouts);
+    darray_append_items(*key, (const char *) &num_layouts,
+                        sizeof(num_layouts));
+    const struct xkb_rmlvo_builder_layout *layout;
+    darray_foreach(layout, rmlvo->layouts) {
+        keymap_cache_key_add_string(key, layout->layout);
+        keymap_cache_key_add_string(key, layout->variant);
+    }
+    const struct xkb_rmlvo_builder_option *option;
+    darray_foreach(option, rmlvo->options) {
+        keymap_cache_key_add_string(key, option->option);
+        darray_append_items(*key, (const char *) &option->layout,
+                            sizeof(option->layout));
+    }
+    return hash_buf(darray_items(*key), darray_size(*key));
+}
+
 struct xkb_keymap *
 xkb_keymap_new_from_rmlvo(const struct xkb_rmlvo_builder *rmlvo,
                           enum xkb_keymap_format format,
@@ -125,15 +285,30 @@ xkb_keymap_new_from_rmlvo(const struct xkb_rmlvo_builder *rmlvo,
         return NULL;
     }
 
+    darray_char key = darray_new();
+    uint32_t hash = 0;
+    if (rmlvo->ctx->keymap_cache.size > 0) {
+        hash = keymap_cache_key_from_rmlvo(&key, rmlvo, format, flags);
+        keymap = xkb_context_keymap_cache_lookup(rmlvo->ctx, &key, hash);
+        if (keymap)
+            goto out;
+    }
+
     keymap = xkb_keymap_new(rmlvo->ctx, format, flags);
     if (!keymap)
-        return NULL;
+        goto out;
 
     if (!ops->keymap_new_from_rmlvo(keymap, rmlvo)) {
         xkb_keymap_unref(keymap);
-        return NULL;
+        keymap = NULL;
+        goto out;
     }
 
+    if (darray_size(key) > 0)
+        xkb_context_keymap_cache_insert(rmlvo->ctx, &key, hash, keymap);
+
+out:
+    darray_free(key);
     return keymap;
 }
 
@@ -160,21 +335,36 @@ xkb_keymap_new_from_names2(struct xkb_context *ctx,
         return NULL;
     }
 
-    keymap = xkb_keymap_new(ctx, format, flags);
-    if (!keymap)
-        return NULL;
-
     if (rmlvo_in)
         rmlvo = *rmlvo_in;
     else
         memset(&rmlvo, 0, sizeof(rmlvo));
     xkb_context_sanitize_rule_names(ctx, &rmlvo);
 
+    darray_char key = darray_new();
+    uint32_t hash = 0;
+    if (ctx->keymap_cache.size > 0) {
+        hash = keymap_cache_key_from_names(&key, &rmlvo, format, flags);
+        keymap = xkb_context_keymap_cache_lookup(ctx, &key, hash);
+        if (keymap)
+            goto out;
+    }
+
+    keymap = xkb_keymap_new(ctx, format, flags);
+    if (!keymap)
+        goto out;
+
     if (!ops->keymap_new_from_names(keymap, &rmlvo)) {
         xkb_keymap_unref(keymap);
-        return NULL;
+        keymap = NULL;
+        goto out;
     }
 
+    if (darray_size(key) > 0)
+        xkb_context_keymap_cache_insert(ctx, &key, hash, keymap);
+
+out:
+    darray_free(key);
     return keymap;
 }
 
@@ -188,6 +378,29 @@ xkb_keymap_new_from_names(struct xkb_context *ctx,
                                       XKB_KEYMAP_FORMAT_TEXT_V2, flags);
 }
 
+int
+xkb_context_prewarm(struct xkb_context *ctx,
+                    const struct xkb_rule_names *names,
+                    enum xkb_keymap_format format)
+{
+    if (!xkb_context_init_includes(ctx))
+        return 0;
+
+    /*
+     * Enable the compiler caches, then populate them with the rules files
+     * and the sections of the expected keymap.
+     */
+    ctx->prewarmed = true;
+    struct xkb_keymap * const keymap =
+        xkb_keymap_new_from_names2(ctx, names, format,
+                                   XKB_KEYMAP_COMPILE_NO_FLAGS);
+    if (!keymap)
+        return 0;
+
+    xkb_keymap_unref(keymap);
+    return 1;
+}
+
 struct xkb_keymap *
 xkb_keymap_new_from_string(struct xkb_context *ctx,
                            const char *string,
@@ -282,31 +495,201 @@ xkb_keymap_new_from_file(struct xkb_context *ctx,
     return keymap;
 }
 
+/* Check the serialization arguments and resolve the format */
+static const struct xkb_keymap_format_ops *
+get_serialize_ops(struct xkb_keymap *keymap, enum xkb_keymap_format *format,
+                  enum xkb_keymap_serialize_flags flags, const char *func)
+{
+    if (flags & ~XKB_KEYMAP_SERIALIZE_VALID_FLAGS) {
+        log_err(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
+                "%s: unrecognized serialization flags: %#x\n", func, flags);
+        return NULL;
+    }
+
+    if (*format == XKB_KEYMAP_USE_ORIGINAL_FORMAT)
+        *format = keymap->format;
+
+    const struct xkb_keymap_format_ops * const ops =
+        get_keymap_format_ops(*format);
+    if (!ops || !ops->keymap_get_as_string || !ops->keymap_write) {
+        log_err(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
+                "%s: unsupported keymap format: %d\n", func, *format);
+        return NULL;
+    }
+
+    assert((int) *format < _XKB_KEYMAP_FORMAT_NUM_ENTRIES);
+    return ops;
+}
+
 char *
 xkb_keymap_get_as_string2(struct xkb_keymap *keymap,
                           enum xkb_keymap_format format,
                           enum xkb_keymap_serialize_flags flags)
 {
-    const enum xkb_keymap_serialize_flags valid_flags =
-        XKB_KEYMAP_SERIALIZE_PRETTY | XKB_KEYMAP_SERIALIZE_KEEP_UNUSED;
-    if (flags & ~valid_flags) {
-        log_err_func(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
-                     "unrecognized serialization flags: %#x\n", flags);
+    const struct xkb_keymap_format_ops * const ops =
+        get_serialize_ops(keymap, &format, flags, __func__);
+    if (!ops)
         return NULL;
+
+    /* Copy the cached serialization, if any: cheaper than serializing */
+    const struct keymap_serialization * const cached =
+        atomic_ptr_load((void **) &keymap->serialized[format][flags]);
+    if (cached)
+        return memdup(cached->string, cached->length + 1,
+                      sizeof(*cached->string));
+
+    return ops->keymap_get_as_string(keymap, format, flags);
+}
+
+const char *
+xkb_keymap_get_as_cached_string(struct xkb_keymap *keymap,
+                                enum xkb_keymap_format format,
+                                enum xkb_keymap_serialize_flags flags,
+                                size_t *length)
+{
+    const struct xkb_keymap_format_ops * const ops =
+        get_serialize_ops(keymap, &format, flags, __func__);
+    if (!ops)
+        return NULL;
+
+    void ** const slot = (void **) &keymap->serialized[format][flags];
+    struct keymap_serialization *cached = atomic_ptr_load(slot);
+    if (!cached) {
+        char * const string = ops->keymap_get_as_string(keymap, format, flags);
+        if (!string)
+            return NULL;
+        cached = malloc(sizeof(*cached));
+        if (!cached) {
+            free(string);
+            return NULL;
+        }
+        cached->string = string;
+        cached->length = strlen(string);
+        /* Another thread may have published its serialization meanwhile */
+        if (!atomic_ptr_publish(slot, cached)) {
+            free(cached->string);
+            free(cached);
+            cached = atomic_ptr_load(slot);
+        }
     }
 
-    if (format == XKB_KEYMAP_USE_ORIGINAL_FORMAT)
-        format = keymap->format;
+    if (length)
+        *length = cached->length;
+    return cached->string;
+}
 
+bool
+xkb_keymap_write(struct xkb_keymap *keymap,
+                 enum xkb_keymap_format format,
+                 enum xkb_keymap_serialize_flags flags,
+                 xkb_keymap_write_func_t write, void *data)
+{
     const struct xkb_keymap_format_ops * const ops =
-        get_keymap_format_ops(format);
-    if (!ops || !ops->keymap_get_as_string) {
+        get_serialize_ops(keymap, &format, flags, __func__);
+    if (!ops)
+        return false;
+
+    /* Write the cached serialization at once, if any */
+    const struct keymap_serialization * const cached =
+        atomic_ptr_load((void **) &keymap->serialized[format][flags]);
+    if (cached)
+        return write(cached->string, cached->length, data);
+
+    return ops->keymap_write(keymap, format, flags, write, data);
+}
+
+struct fd_writer {
+    int fd;
+    size_t size;
+    int error;
+};
+
+static bool
+write_all(struct fd_writer *writer, const char *chunk, size_t size)
+{
+    while (size > 0) {
+        const ssize_t count = write(writer->fd, chunk, size);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            writer->error = errno;
+            return false;
+        }
+        chunk += count;
+        size -= (size_t) count;
+        writer->size += (size_t) count;
+    }
+    return true;
+}
+
+static bool
+fd_writer_write(const char *chunk, size_t size, void *data)
+{
+    return write_all(data, chunk, size);
+}
+
+bool
+xkb_keymap_write_to_fd(struct xkb_keymap *keymap, int fd,
+                       enum xkb_keymap_format format,
+                       enum xkb_keymap_serialize_flags flags)
+{
+    struct fd_writer writer = { .fd = fd, .size = 0, .error = 0 };
+    if (xkb_keymap_write(keymap, format, flags, fd_writer_write, &writer))
+        return true;
+
+    if (writer.error) {
         log_err_func(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
-                     "unsupported keymap format: %d\n", format);
-        return NULL;
+                     "cannot write keymap: %s\n", strerror(writer.error));
     }
+    return false;
+}
 
-    return ops->keymap_get_as_string(keymap, format, flags);
+int
+xkb_keymap_get_as_memfd(struct xkb_keymap *keymap,
+                        enum xkb_keymap_format format,
+                        enum xkb_keymap_serialize_flags flags,
+                        size_t *size)
+{
+#ifdef HAVE_MEMFD_CREATE
+    const int fd = memfd_create("xkb-keymap", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        log_err_func(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
+                     "cannot create memory file: %s\n", strerror(errno));
+        return -1;
+    }
+
+    struct fd_writer writer = { .fd = fd, .size = 0, .error = 0 };
+    if (!xkb_keymap_write(keymap, format, flags, fd_writer_write, &writer) ||
+        /* Terminating NULL byte */
+        !write_all(&writer, "", 1))
+        goto error;
+
+    static const int seals =
+        F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL;
+    if (fcntl(fd, F_ADD_SEALS, seals) < 0) {
+        writer.error = errno;
+        goto error;
+    }
+
+    *size = writer.size;
+    return fd;
+
+error:
+    if (writer.error) {
+        log_err_func(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
+                     "cannot write keymap to memory file: %s\n",
+                     strerror(writer.error));
+    }
+    close(fd);
+    return -1;
+#else
+    (void) format;
+    (void) flags;
+    (void) size;
+    log_err_func1(keymap->ctx, XKB_LOG_MESSAGE_NO_ID,
+                  "memory files are not supported on this platform\n");
+    return -1;
+#endif
 }
 
 char *
@@ -317,6 +700,25 @@ xkb_keymap_get_as_string(struct xkb_keymap *keymap,
                                      XKB_KEYMAP_SERIALIZE_NO_FLAGS);
 }
 
+void
+xkb_keymap_get_fingerprint(struct xkb_keymap *keymap,
+                           uint8_t fingerprint[XKB_KEYMAP_FINGERPRINT_SIZE])
+{
+    void ** const slot = (void **) &keymap->fingerprint;
+    const uint8_t *cached = atomic_ptr_load(slot);
+    if (cached) {
+        memcpy(fingerprint, cached, XKB_KEYMAP_FINGERPRINT_SIZE);
+        return;
+    }
+
+    keymap_compute_fingerprint(keymap, fingerprint);
+    /* Cache it, unless another thread did meanwhile; not fatal on error */
+    uint8_t * const copy = memdup(fingerprint, XKB_KEYMAP_FINGERPRINT_SIZE,
+                                  sizeof(*fingerprint));
+    if (copy && !atomic_ptr_publish(slot, copy))
+        free(copy);
+}
+
 /**
  * Returns the total number of modifiers active in the keymap.
  */
@@ -469,6 +469,21 @@ typedef union {
 } KeycodeMatch;
 
 /* Common keyboard description structure */
+/* Upper bound of the keymap formats values */
+#define _XKB_KEYMAP_FORMAT_NUM_ENTRIES (XKB_KEYMAP_FORMAT_TEXT_V2 + 1)
+
+#define XKB_KEYMAP_SERIALIZE_VALID_FLAGS \
+    (XKB_KEYMAP_SERIALIZE_PRETTY | XKB_KEYMAP_SERIALIZE_KEEP_UNUSED)
+/* Number of combinations of the serialization flags */
+#define _XKB_KEYMAP_SERIALIZE_FLAGS_NUM_ENTRIES \
+    (XKB_KEYMAP_SERIALIZE_VALID_FLAGS + 1)
+
+/* Cached keymap serialization */
+struct keymap_serialization {
+    char *string;
+    size_t length;
+};
+
 struct xkb_keymap {
     struct xkb_context *ctx;
 
@@ -574,6 +589,23 @@ struct xkb_keymap {
     char *symbols_section_name;
     char *types_section_name;
     char *compat_section_name;
+
+    /**
+     * Serialization cache, indexed by format and serialization flags.
+     * Filled lazily by `xkb_keymap_get_as_cached_string()`, possibly from
+     * multiple threads: access the entries only with `atomic_ptr_load()`
+     * and `atomic_ptr_publish()`.
+     */
+    struct keymap_serialization *
+        serialized[_XKB_KEYMAP_FORMAT_NUM_ENTRIES]
+                  [_XKB_KEYMAP_SERIALIZE_FLAGS_NUM_ENTRIES];
+
+    /**
+     * Content hash of `XKB_KEYMAP_FINGERPRINT_SIZE` bytes, computed lazily by
+     * `xkb_keymap_get_fingerprint()`, possibly from multiple threads: access
+     * it only with `atomic_ptr_load()` and `atomic_ptr_publish()`.
+     */
+    uint8_t *fingerprint;
 };
 
 #define xkb_keys_foreach(iter, keymap) \
@@ -631,6 +663,20 @@ struct xkb_keymap {
 void
 clear_level(struct xkb_level *leveli);
 
+bool
+copy_types(struct xkb_key_type **dst, darray_size_t *num_dst,
+           const struct xkb_key_type *src, darray_size_t num_src);
+
+void
+clear_types(struct xkb_key_type *types, darray_size_t num_types);
+
+bool
+copy_interprets(struct xkb_sym_interpret **dst, darray_size_t *num_dst,
+                const struct xkb_sym_interpret *src, darray_size_t num_src);
+
+void
+clear_interprets(struct xkb_sym_interpret *interprets, darray_size_t count);
+
 static inline const struct xkb_key *
 XkbKey(struct xkb_keymap *keymap, xkb_keycode_t kc)
 {
@@ -730,6 +776,10 @@ struct xkb_keymap_format_ops {
     char *(*keymap_get_as_string)(struct xkb_keymap *keymap,
                                   enum xkb_keymap_format format,
                                   enum xkb_keymap_serialize_flags flags);
+    bool (*keymap_write)(struct xkb_keymap *keymap,
+                         enum xkb_keymap_format format,
+                         enum xkb_keymap_serialize_flags flags,
+                         xkb_keymap_write_func_t write, void *data);
 };
 
 extern const struct xkb_keymap_format_ops text_v1_keymap_format_ops;
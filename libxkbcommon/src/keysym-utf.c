@@ -38,14 +38,29 @@
 #include "config.h"
 
 #include <stdbool.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "xkbcommon/xkbcommon.h"
 #include "utils.h"
 #include "utf8.h"
 #include "keysym.h"
+#include "keysym-utf-tables.h"
 
 #define NO_KEYSYM_UNICODE_CONVERSION 0
 
+/*
+ * NOTE: keysymtab[] is the reference for the lookup tables in
+ * keysym-utf-tables.h: run scripts/update-keysym-utf-tables.py after
+ * modifying it. It is only compiled for the tests, in order to check the
+ * generated tables.
+ */
+
+#ifdef ENABLE_PRIVATE_APIS
+
 /* We don't use the uint32_t types here, to save some space. */
 struct codepair {
     uint16_t keysym:15;
@@ -831,38 +846,48 @@ static const struct codepair keysymtab[] = {
     { 0x20ac, false, 0x20ac }, /*                    EuroSign € EURO SIGN */
 };
 
-/* binary search with range check */
-static uint32_t
-bin_search(const struct codepair *table, size_t length, xkb_keysym_t keysym)
+/* binary search in the reference table */
+uint32_t
+xkb_keysymtab_keysym_to_utf32(xkb_keysym_t keysym)
 {
     size_t first = 0;
-    size_t last = length;
+    size_t last = ARRAY_SIZE(keysymtab) - 1;
 
-    if (keysym < table[0].keysym  || keysym > table[length].keysym)
-        return 0;
+    if (keysym < keysymtab[first].keysym || keysym > keysymtab[last].keysym)
+        return NO_KEYSYM_UNICODE_CONVERSION;
 
-    /* binary search in table */
     while (last >= first) {
-        size_t mid = (first + last) / 2;
-        if (table[mid].keysym < keysym)
+        const size_t mid = (first + last) / 2;
+        if (keysymtab[mid].keysym < keysym)
             first = mid + 1;
-        else if (table[mid].keysym > keysym)
+        else if (keysymtab[mid].keysym > keysym)
             last = mid - 1;
         else /* found it */
-            return table[mid].ucs;
+            return keysymtab[mid].ucs;
     }
 
     /* no matching Unicode value found in table */
     return NO_KEYSYM_UNICODE_CONVERSION;
 }
 
+/* linear search in the reference table; skip deprecated keysyms */
+xkb_keysym_t
+xkb_keysymtab_utf32_to_keysym(uint32_t ucs)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(keysymtab); i++) {
+        if (keysymtab[i].ucs == ucs && !keysymtab[i].deprecated)
+            return keysymtab[i].keysym;
+    }
+    return XKB_KEY_NoSymbol;
+}
+#endif
+
 uint32_t
 xkb_keysym_to_utf32(xkb_keysym_t keysym)
 {
-    /* first check for Latin-1 characters (1:1 mapping) */
-    if ((keysym >= 0x0020 && keysym <= 0x007e) ||
-        (keysym >= 0x00a0 && keysym <= 0x00ff))
-        return keysym;
+    /* Latin-1 characters (1:1 mapping) and legacy keysyms */
+    if (keysym <= KEYSYM_TO_UCS_MAX)
+        return lookup_keysym_to_ucs(keysym);
 
     /* patch encoding botch */
     if (keysym == XKB_KEY_KP_Space)
@@ -894,8 +919,7 @@ xkb_keysym_to_utf32(xkb_keysym_t keysym)
     if (XKB_KEYSYM_UNICODE_OFFSET <= keysym && keysym <= XKB_KEYSYM_UNICODE_MAX)
         return keysym - XKB_KEYSYM_UNICODE_OFFSET;
 
-    /* search main table */
-    return bin_search(keysymtab, ARRAY_SIZE(keysymtab) - 1, keysym);
+    return NO_KEYSYM_UNICODE_CONVERSION;
 }
 
 xkb_keysym_t
@@ -922,12 +946,10 @@ xkb_utf32_to_keysym(uint32_t ucs)
     if (unlikely(ucs == 0 || is_surrogate(ucs) || ucs > 0x10ffff))
         return XKB_KEY_NoSymbol;
 
-    /* search main table */
-    for (size_t i = 0; i < ARRAY_SIZE(keysymtab); i++) {
-        /* Do not use deprecated keysyms */
-        if (keysymtab[i].ucs == ucs && !keysymtab[i].deprecated)
-            return keysymtab[i].keysym;
-    }
+    /* search main table; it does not contain deprecated keysyms */
+    const xkb_keysym_t keysym = lookup_ucs_to_keysym(ucs);
+    if (keysym != XKB_KEY_NoSymbol)
+        return keysym;
 
     /* Use direct encoding if everything else failed */
     return ucs | XKB_KEYSYM_UNICODE_OFFSET;
@@ -960,3 +982,285 @@ xkb_keysym_to_utf8(xkb_keysym_t keysym, char *buffer, size_t size)
 }
 
 /* SPDX-SnippetEnd */
+
+/*
+ * Bulk conversions
+ *
+ * The common cases, i.e. Latin-1 characters and directly encoded Unicode
+ * keysyms, are processed by blocks of 4 items with SSE2 or NEON when
+ * available. A block with any other item falls back to the scalar functions.
+ */
+
+#if defined(__SSE2__)
+#define BULK_BLOCK_SIZE 4
+/* Vector of 4 unsigned 32-bit integers */
+typedef __m128i bulk_vec;
+
+static inline bulk_vec
+bulk_vec_load(const uint32_t *p)
+{
+    return _mm_loadu_si128((const __m128i *) p);
+}
+
+static inline void
+bulk_vec_store(uint32_t *p, bulk_vec v)
+{
+    _mm_storeu_si128((__m128i *) p, v);
+}
+
+static inline bulk_vec
+bulk_vec_set1(uint32_t x)
+{
+    return _mm_set1_epi32((int32_t) x);
+}
+
+/* Unsigned (x - lo <= hi - lo) mask, using the signed comparison */
+static inline bulk_vec
+bulk_vec_in_range(bulk_vec x, uint32_t lo, uint32_t hi)
+{
+    const __m128i bias = _mm_set1_epi32((int32_t) 0x80000000);
+    const __m128i delta = _mm_sub_epi32(x, _mm_set1_epi32((int32_t) lo));
+    const __m128i gt = _mm_cmpgt_epi32(
+        _mm_xor_si128(delta, bias),
+        _mm_set1_epi32((int32_t) ((hi - lo) ^ 0x80000000))
+    );
+    return _mm_andnot_si128(gt, _mm_set1_epi32(-1));
+}
+
+static inline bulk_vec
+bulk_vec_and(bulk_vec a, bulk_vec b)
+{
+    return _mm_and_si128(a, b);
+}
+
+static inline bulk_vec
+bulk_vec_or(bulk_vec a, bulk_vec b)
+{
+    return _mm_or_si128(a, b);
+}
+
+/* a & ~b */
+static inline bulk_vec
+bulk_vec_and_not(bulk_vec a, bulk_vec b)
+{
+    return _mm_andnot_si128(b, a);
+}
+
+static inline bulk_vec
+bulk_vec_add(bulk_vec a, bulk_vec b)
+{
+    return _mm_add_epi32(a, b);
+}
+
+static inline bulk_vec
+bulk_vec_sub(bulk_vec a, bulk_vec b)
+{
+    return _mm_sub_epi32(a, b);
+}
+
+static inline bool
+bulk_vec_all(bulk_vec mask)
+{
+    return _mm_movemask_epi8(mask) == 0xffff;
+}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define BULK_BLOCK_SIZE 4
+/* Vector of 4 unsigned 32-bit integers */
+typedef uint32x4_t bulk_vec;
+
+static inline bulk_vec
+bulk_vec_load(const uint32_t *p)
+{
+    return vld1q_u32(p);
+}
+
+static inline void
+bulk_vec_store(uint32_t *p, bulk_vec v)
+{
+    vst1q_u32(p, v);
+}
+
+static inline bulk_vec
+bulk_vec_set1(uint32_t x)
+{
+    return vdupq_n_u32(x);
+}
+
+/* Unsigned (x - lo <= hi - lo) mask */
+static inline bulk_vec
+bulk_vec_in_range(bulk_vec x, uint32_t lo, uint32_t hi)
+{
+    return vcleq_u32(vsubq_u32(x, vdupq_n_u32(lo)), vdupq_n_u32(hi - lo));
+}
+
+static inline bulk_vec
+bulk_vec_and(bulk_vec a, bulk_vec b)
+{
+    return vandq_u32(a, b);
+}
+
+static inline bulk_vec
+bulk_vec_or(bulk_vec a, bulk_vec b)
+{
+    return vorrq_u32(a, b);
+}
+
+/* a & ~b */
+static inline bulk_vec
+bulk_vec_and_not(bulk_vec a, bulk_vec b)
+{
+    return vbicq_u32(a, b);
+}
+
+static inline bulk_vec
+bulk_vec_add(bulk_vec a, bulk_vec b)
+{
+    return vaddq_u32(a, b);
+}
+
+static inline bulk_vec
+bulk_vec_sub(bulk_vec a, bulk_vec b)
+{
+    return vsubq_u32(a, b);
+}
+
+static inline bool
+bulk_vec_all(bulk_vec mask)
+{
+    return vminvq_u32(mask) == UINT32_MAX;
+}
+#endif
+
+#ifdef BULK_BLOCK_SIZE
+static inline bulk_vec
+bulk_vec_is_latin1(bulk_vec x)
+{
+    return bulk_vec_or(bulk_vec_in_range(x, 0x0020, 0x007e),
+                       bulk_vec_in_range(x, 0x00a0, 0x00ff));
+}
+
+/* Convert a block of 4 keysyms; returns false if a slow path is required */
+static inline bool
+keysyms_to_utf32_block(const xkb_keysym_t *keysyms, uint32_t *codepoints)
+{
+    const bulk_vec ks = bulk_vec_load(keysyms);
+    const bulk_vec unicode = bulk_vec_and_not(
+        bulk_vec_in_range(ks, XKB_KEYSYM_UNICODE_OFFSET,
+                              XKB_KEYSYM_UNICODE_MAX),
+        bulk_vec_in_range(ks, XKB_KEYSYM_UNICODE_SURROGATE_MIN,
+                              XKB_KEYSYM_UNICODE_SURROGATE_MAX)
+    );
+    if (!bulk_vec_all(bulk_vec_or(unicode, bulk_vec_is_latin1(ks))))
+        return false;
+    const bulk_vec offset = bulk_vec_and(
+        unicode, bulk_vec_set1(XKB_KEYSYM_UNICODE_OFFSET)
+    );
+    bulk_vec_store(codepoints, bulk_vec_sub(ks, offset));
+    return true;
+}
+
+/* Convert a block of 4 code points; returns false if a slow path is required */
+static inline bool
+utf32_to_keysyms_block(const uint32_t *codepoints, xkb_keysym_t *keysyms)
+{
+    const bulk_vec cp = bulk_vec_load(codepoints);
+    /* Code points without legacy keysym */
+    const bulk_vec unicode = bulk_vec_and_not(
+        bulk_vec_in_range(cp, UCS_TO_KEYSYM_MAX + 1, 0x10ffff),
+        bulk_vec_in_range(cp, 0xd800, 0xdfff)
+    );
+    if (!bulk_vec_all(bulk_vec_or(unicode, bulk_vec_is_latin1(cp))))
+        return false;
+    const bulk_vec offset = bulk_vec_and(
+        unicode, bulk_vec_set1(XKB_KEYSYM_UNICODE_OFFSET)
+    );
+    bulk_vec_store(keysyms, bulk_vec_or(cp, offset));
+    return true;
+}
+
+/* Case mapping of a block of 4 ASCII keysyms; returns false otherwise */
+static inline bool
+keysyms_ascii_case_block(const xkb_keysym_t *in, xkb_keysym_t *out,
+                         bool upper)
+{
+    const bulk_vec ks = bulk_vec_load(in);
+    if (!bulk_vec_all(bulk_vec_in_range(ks, 0x0000, 0x007f)))
+        return false;
+    const bulk_vec letters = (upper)
+        ? bulk_vec_in_range(ks, 'a', 'z')
+        : bulk_vec_in_range(ks, 'A', 'Z');
+    const bulk_vec delta = bulk_vec_and(letters, bulk_vec_set1(0x20));
+    bulk_vec_store(out, (upper)
+                   ? bulk_vec_sub(ks, delta)
+                   : bulk_vec_add(ks, delta));
+    return true;
+}
+#endif
+
+void
+xkb_keysyms_to_utf32(const xkb_keysym_t *keysyms, uint32_t *codepoints,
+                     size_t count)
+{
+    size_t k = 0;
+#ifdef BULK_BLOCK_SIZE
+    for (; k + BULK_BLOCK_SIZE <= count; k += BULK_BLOCK_SIZE) {
+        if (keysyms_to_utf32_block(keysyms + k, codepoints + k))
+            continue;
+        for (size_t i = k; i < k + BULK_BLOCK_SIZE; i++)
+            codepoints[i] = xkb_keysym_to_utf32(keysyms[i]);
+    }
+#endif
+    for (; k < count; k++)
+        codepoints[k] = xkb_keysym_to_utf32(keysyms[k]);
+}
+
+void
+xkb_utf32_to_keysyms(const uint32_t *codepoints, xkb_keysym_t *keysyms,
+                     size_t count)
+{
+    size_t k = 0;
+#ifdef BULK_BLOCK_SIZE
+    for (; k + BULK_BLOCK_SIZE <= count; k += BULK_BLOCK_SIZE) {
+        if (utf32_to_keysyms_block(codepoints + k, keysyms + k))
+            continue;
+        for (size_t i = k; i < k + BULK_BLOCK_SIZE; i++)
+            keysyms[i] = xkb_utf32_to_keysym(codepoints[i]);
+    }
+#endif
+    for (; k < count; k++)
+        keysyms[k] = xkb_utf32_to_keysym(codepoints[k]);
+}
+
+void
+xkb_keysyms_to_upper(const xkb_keysym_t *keysyms, xkb_keysym_t *out,
+                     size_t count)
+{
+    size_t k = 0;
+#ifdef BULK_BLOCK_SIZE
+    for (; k + BULK_BLOCK_SIZE <= count; k += BULK_BLOCK_SIZE) {
+        if (keysyms_ascii_case_block(keysyms + k, out + k, true))
+            continue;
+        for (size_t i = k; i < k + BULK_BLOCK_SIZE; i++)
+            out[i] = xkb_keysym_to_upper(keysyms[i]);
+    }
+#endif
+    for (; k < count; k++)
+        out[k] = xkb_keysym_to_upper(keysyms[k]);
+}
+
+void
+xkb_keysyms_to_lower(const xkb_keysym_t *keysyms, xkb_keysym_t *out,
+                     size_t count)
+{
+    size_t k = 0;
+#ifdef BULK_BLOCK_SIZE
+    for (; k + BULK_BLOCK_SIZE <= count; k += BULK_BLOCK_SIZE) {
+        if (keysyms_ascii_case_block(keysyms + k, out + k, false))
+            continue;
+        for (size_t i = k; i < k + BULK_BLOCK_SIZE; i++)
+            out[i] = xkb_keysym_to_lower(keysyms[i]);
+    }
+#endif
+    for (; k < count; k++)
+        out[k] = xkb_keysym_to_lower(keysyms[k]);
+}
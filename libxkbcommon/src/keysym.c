@@ -93,6 +93,13 @@ xkb_keysym_get_name(xkb_keysym_t ks, char *buffer, size_t size)
     return snprintf(buffer, size, "0x%08x", ks);
 }
 
+const char *
+xkb_keysym_get_explicit_name(xkb_keysym_t ks)
+{
+    const ssize_t index = find_keysym_index(ks);
+    return (index != -1) ? get_name(&keysym_to_name[index]) : NULL;
+}
+
 bool
 xkb_keysym_is_assigned(xkb_keysym_t ks)
 {
@@ -66,6 +66,10 @@
 XKB_EXPORT_PRIVATE bool
 xkb_keysym_is_assigned(xkb_keysym_t ks);
 
+/** Canonical name of a keysym with an explicit name, else NULL */
+const char *
+xkb_keysym_get_explicit_name(xkb_keysym_t ks);
+
 XKB_EXPORT_PRIVATE int
 xkb_keysym_get_explicit_names(xkb_keysym_t ks, const char **buffer, size_t size);
 
@@ -95,6 +99,13 @@ xkb_keysym_is_deprecated(xkb_keysym_t keysym,
                          const char *name,
                          const char **reference_name);
 
+/* Reference implementations of the legacy keysyms conversions, for tests */
+XKB_EXPORT_PRIVATE uint32_t
+xkb_keysymtab_keysym_to_utf32(xkb_keysym_t keysym);
+
+XKB_EXPORT_PRIVATE xkb_keysym_t
+xkb_keysymtab_utf32_to_keysym(uint32_t ucs);
+
 #define XKB_MIN_VERBOSITY_DEPRECATED_KEYSYM 2
 #define check_deprecated_keysyms(log_func, log_param, ctx, keysym, name, token, format, end) \
     if (unlikely((ctx)->log_verbosity >= XKB_MIN_VERBOSITY_DEPRECATED_KEYSYM)) {             \
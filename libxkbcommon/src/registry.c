@@ -9,10 +9,12 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <libxml/parser.h>
+#include <libxml/xmlreader.h>
 
 #if HAVE_XKB_EXTENSIONS_DIRECTORIES
     #include <limits.h>
@@ -29,6 +31,7 @@
 #include "util-mem.h"
 
 struct rxkb_object;
+struct lazy_file;
 
 /**
  * All our objects are refcounted and are linked to iterate through them.
@@ -39,6 +42,7 @@ struct rxkb_object {
     struct rxkb_object *parent;
     uint32_t refcount;
     struct list link;
+    struct lazy_file *lazy; /* source of the details not loaded yet */
 };
 
 struct rxkb_iso639_code {
@@ -51,6 +55,15 @@ struct rxkb_iso3166_code {
     char *code;
 };
 
+struct index_entry;
+typedef darray(struct index_entry) darray_index;
+
+/* Layouts associated with an ISO code */
+struct iso_index {
+    darray_index entries;                   /* sorted by code */
+    darray(struct rxkb_layout *) layouts;   /* same order as entries */
+};
+
 enum context_state {
     CONTEXT_NEW,
     CONTEXT_PARSED,
@@ -63,13 +76,26 @@ struct rxkb_context {
 
     bool load_extra_rules_files;
     bool use_secure_getenv;
+    bool validate_xml;
+    bool lazy_details;
 
     struct list models;         /* list of struct rxkb_models */
     struct list layouts;        /* list of struct rxkb_layouts */
     struct list option_groups;  /* list of struct rxkb_option_group */
 
     darray(char *) includes;
+    char *cache_path;           /* optional binary cache of the registry */
+
+    /* Lookup indices, built on demand */
+    bool indexed;
+    darray_index layouts_index; /* sorted by name and variant */
+    darray_index options_index; /* sorted by name */
+    struct iso_index iso639_index;
+    struct iso_index iso3166_index;
+    bool iso_indexed;
 
+    /* Rules files with details to load on demand */
+    darray(struct lazy_file *) lazy_files;
 
     ATTR_PRINTF(3, 0) void (*log_fn)(struct rxkb_context *ctx,
                                      enum rxkb_log_level level,
@@ -121,9 +147,50 @@ struct rxkb_option {
     bool layout_specific;
 };
 
+enum lazy_kind {
+    LAZY_MODEL,
+    LAZY_LAYOUT,
+    LAZY_VARIANT,
+    LAZY_OPTION_GROUP,
+    LAZY_OPTION,
+};
+
+/* Item whose details are not loaded yet */
+struct lazy_item {
+    struct rxkb_object *object;
+    struct rxkb_layout *layout; /* base layout of a variant */
+    long line;                  /* line of its “configItem” element */
+    enum lazy_kind kind;
+};
+
+/* Rules file with items whose details are not loaded yet */
+struct lazy_file {
+    struct rxkb_context *ctx;
+    char *path;
+    enum rxkb_popularity popularity;
+    off_t size;
+    time_t mtime;
+    darray(struct lazy_item) items; /* in document order */
+};
+
 static bool
 parse(struct rxkb_context *ctx, const char *path,
       enum rxkb_popularity popularity);
+static void
+lazy_file_load(struct lazy_file *file);
+static void
+lazy_file_free(struct lazy_file *file);
+static void
+rxkb_context_load_details(struct rxkb_context *ctx);
+static void
+cache_key_init(struct rxkb_context *ctx, darray_uchar *key,
+               const char *ruleset);
+static void
+cache_key_add_file(darray_uchar *key, const char *path);
+static bool
+cache_load(struct rxkb_context *ctx, const darray_uchar *key);
+static void
+cache_write(struct rxkb_context *ctx, const darray_uchar *key);
 
 ATTR_PRINTF(3, 4)
 static void
@@ -192,6 +259,13 @@ rtype_ type_##_get_##field_(struct type_ *object) { \
 #define DECLARE_GETTER_FOR_TYPE(type_, field_) \
    DECLARE_TYPED_GETTER_FOR_TYPE(type_, field_, const char*)
 
+/* Getter of a field that may be loaded on demand */
+#define DECLARE_LAZY_GETTER_FOR_TYPE(type_, field_) \
+const char * type_##_get_##field_(struct type_ *object) { \
+    rxkb_object_load_details(&object->base); \
+    return object->field_; \
+}
+
 #define DECLARE_FIRST_NEXT_FOR_TYPE(type_, parent_type_, parent_field_) \
 struct type_ * type_##_first(struct parent_type_ *parent) { \
     struct type_ *o = NULL; \
@@ -219,6 +293,13 @@ rxkb_object_init(struct rxkb_object *object, struct rxkb_object *parent)
     list_init(&object->link);
 }
 
+static void
+rxkb_object_load_details(struct rxkb_object *object)
+{
+    if (object->lazy)
+        lazy_file_load(object->lazy);
+}
+
 static void *
 rxkb_object_ref(struct rxkb_object *object)
 {
@@ -238,6 +319,8 @@ rxkb_layout_get_iso639_first(struct rxkb_layout *layout)
 {
     struct rxkb_iso639_code *code = NULL;
 
+    rxkb_object_load_details(&layout->base);
+
     if (!list_empty(&layout->iso639s))
         code = list_first_entry(&layout->iso639s, code, base.link);
 
@@ -275,6 +358,8 @@ rxkb_layout_get_iso3166_first(struct rxkb_layout *layout)
 {
     struct rxkb_iso3166_code *code = NULL;
 
+    rxkb_object_load_details(&layout->base);
+
     if (!list_empty(&layout->iso3166s))
         code = list_first_entry(&layout->iso3166s, code, base.link);
 
@@ -312,8 +397,8 @@ rxkb_option_destroy(struct rxkb_option *o)
 DECLARE_REF_UNREF_FOR_TYPE(rxkb_option);
 DECLARE_CREATE_FOR_TYPE(rxkb_option);
 DECLARE_GETTER_FOR_TYPE(rxkb_option, name);
-DECLARE_GETTER_FOR_TYPE(rxkb_option, brief);
-DECLARE_GETTER_FOR_TYPE(rxkb_option, description);
+DECLARE_LAZY_GETTER_FOR_TYPE(rxkb_option, brief);
+DECLARE_LAZY_GETTER_FOR_TYPE(rxkb_option, description);
 DECLARE_TYPED_GETTER_FOR_TYPE(rxkb_option, popularity, enum rxkb_popularity);
 bool rxkb_option_is_layout_specific(struct rxkb_option *object) {
     return object->layout_specific;
@@ -342,8 +427,8 @@ rxkb_layout_destroy(struct rxkb_layout *l)
 DECLARE_REF_UNREF_FOR_TYPE(rxkb_layout);
 DECLARE_CREATE_FOR_TYPE(rxkb_layout);
 DECLARE_GETTER_FOR_TYPE(rxkb_layout, name);
-DECLARE_GETTER_FOR_TYPE(rxkb_layout, brief);
-DECLARE_GETTER_FOR_TYPE(rxkb_layout, description);
+DECLARE_LAZY_GETTER_FOR_TYPE(rxkb_layout, brief);
+DECLARE_LAZY_GETTER_FOR_TYPE(rxkb_layout, description);
 DECLARE_GETTER_FOR_TYPE(rxkb_layout, variant);
 DECLARE_TYPED_GETTER_FOR_TYPE(rxkb_layout, popularity, enum rxkb_popularity);
 DECLARE_FIRST_NEXT_FOR_TYPE(rxkb_layout, rxkb_context, layouts);
@@ -359,8 +444,8 @@ rxkb_model_destroy(struct rxkb_model *m)
 DECLARE_REF_UNREF_FOR_TYPE(rxkb_model);
 DECLARE_CREATE_FOR_TYPE(rxkb_model);
 DECLARE_GETTER_FOR_TYPE(rxkb_model, name);
-DECLARE_GETTER_FOR_TYPE(rxkb_model, vendor);
-DECLARE_GETTER_FOR_TYPE(rxkb_model, description);
+DECLARE_LAZY_GETTER_FOR_TYPE(rxkb_model, vendor);
+DECLARE_LAZY_GETTER_FOR_TYPE(rxkb_model, description);
 DECLARE_TYPED_GETTER_FOR_TYPE(rxkb_model, popularity, enum rxkb_popularity);
 DECLARE_FIRST_NEXT_FOR_TYPE(rxkb_model, rxkb_context, models);
 
@@ -386,18 +471,263 @@ rxkb_option_group_allows_multiple(struct rxkb_option_group *g)
 DECLARE_REF_UNREF_FOR_TYPE(rxkb_option_group);
 DECLARE_CREATE_FOR_TYPE(rxkb_option_group);
 DECLARE_GETTER_FOR_TYPE(rxkb_option_group, name);
-DECLARE_GETTER_FOR_TYPE(rxkb_option_group, description);
+DECLARE_LAZY_GETTER_FOR_TYPE(rxkb_option_group, description);
 DECLARE_TYPED_GETTER_FOR_TYPE(rxkb_option_group, popularity, enum rxkb_popularity);
 DECLARE_FIRST_NEXT_FOR_TYPE(rxkb_option_group, rxkb_context, option_groups);
 
+/*
+ * Lookup indices
+ *
+ * The context is immutable once parsed, so the indices are built on the first
+ * lookup and sorted once. Entries with equal keys keep the order of the lists,
+ * so that lookups return the same object as a linear search would.
+ */
+
+struct index_entry {
+    const char *key;
+    const char *subkey;     /* layout variant, may be NULL */
+    void *object;
+    darray_size_t seq;      /* position in the lists, for a stable sort */
+};
+
+static int
+index_entry_cmp_keys(const struct index_entry *entry,
+                     const char *key, const char *subkey, bool icase)
+{
+    int cmp = icase ? istrcmp(entry->key, key) : strcmp(entry->key, key);
+    if (cmp != 0)
+        return cmp;
+    if (!entry->subkey || !subkey)
+        return (entry->subkey != NULL) - (subkey != NULL);
+    return strcmp(entry->subkey, subkey);
+}
+
+static int
+index_entry_cmp(const struct index_entry *a, const struct index_entry *b,
+                bool icase)
+{
+    const int cmp = index_entry_cmp_keys(a, b->key, b->subkey, icase);
+    if (cmp != 0)
+        return cmp;
+    return (a->seq > b->seq) - (a->seq < b->seq);
+}
+
+static int
+index_entry_qsort_cmp(const void *a, const void *b)
+{
+    return index_entry_cmp(a, b, false);
+}
+
+static int
+index_entry_qsort_icmp(const void *a, const void *b)
+{
+    return index_entry_cmp(a, b, true);
+}
+
+/* Return the position of the first entry not less than the given keys */
+static darray_size_t
+index_lower_bound(const darray_index *index, const char *key,
+                  const char *subkey, bool icase)
+{
+    darray_size_t lo = 0;
+    darray_size_t hi = darray_size(*index);
+    while (lo < hi) {
+        const darray_size_t mid = lo + (hi - lo) / 2;
+        if (index_entry_cmp_keys(&darray_item(*index, mid), key, subkey,
+                                 icase) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void *
+index_find(const darray_index *index, const char *key, const char *subkey)
+{
+    const darray_size_t pos = index_lower_bound(index, key, subkey, false);
+    if (pos < darray_size(*index) &&
+        index_entry_cmp_keys(&darray_item(*index, pos), key, subkey,
+                             false) == 0)
+        return darray_item(*index, pos).object;
+    return NULL;
+}
+
+static void
+iso_index_append(struct iso_index *index, const char *code,
+                 struct rxkb_layout *layout, darray_size_t seq)
+{
+    if (!code)
+        return;
+    const struct index_entry entry = {
+        .key = code, .object = layout, .seq = seq
+    };
+    darray_append(index->entries, entry);
+}
+
+/* Sort the entries and gather their layouts in a contiguous array */
+static void
+iso_index_finish(struct iso_index *index)
+{
+    const struct index_entry *entry;
+
+    if (!darray_empty(index->entries))
+        qsort(darray_items(index->entries), darray_size(index->entries),
+              sizeof(*entry), index_entry_qsort_icmp);
+    darray_resize(index->layouts, darray_size(index->entries));
+    darray_size_t k = 0;
+    darray_foreach(entry, index->entries)
+        darray_item(index->layouts, k++) = entry->object;
+}
+
+static struct rxkb_layout * const *
+iso_index_find(const struct iso_index *index, const char *code,
+               size_t *count)
+{
+    const darray_size_t lo = index_lower_bound(&index->entries, code, NULL,
+                                               true);
+    darray_size_t hi = lo;
+    while (hi < darray_size(index->entries) &&
+           istreq(darray_item(index->entries, hi).key, code))
+        hi++;
+
+    *count = hi - lo;
+    return (hi > lo) ? &darray_item(index->layouts, lo) : NULL;
+}
+
+static void
+iso_index_free(struct iso_index *index)
+{
+    darray_free(index->entries);
+    darray_free(index->layouts);
+}
+
+static bool
+rxkb_context_build_indices(struct rxkb_context *ctx)
+{
+    struct rxkb_layout *l;
+    struct rxkb_option_group *g;
+    struct rxkb_option *o;
+    darray_size_t seq = 0;
+
+    if (ctx->context_state != CONTEXT_PARSED)
+        return false;
+    if (ctx->indexed)
+        return true;
+
+    list_for_each(l, &ctx->layouts, base.link) {
+        const struct index_entry entry = {
+            .key = l->name, .subkey = l->variant, .object = l, .seq = seq
+        };
+        darray_append(ctx->layouts_index, entry);
+        seq++;
+    }
+
+    seq = 0;
+    list_for_each(g, &ctx->option_groups, base.link) {
+        list_for_each(o, &g->options, base.link) {
+            const struct index_entry entry = {
+                .key = o->name, .object = o, .seq = seq++
+            };
+            darray_append(ctx->options_index, entry);
+        }
+    }
+
+    if (!darray_empty(ctx->layouts_index))
+        qsort(darray_items(ctx->layouts_index),
+              darray_size(ctx->layouts_index),
+              sizeof(struct index_entry), index_entry_qsort_cmp);
+    if (!darray_empty(ctx->options_index))
+        qsort(darray_items(ctx->options_index),
+              darray_size(ctx->options_index),
+              sizeof(struct index_entry), index_entry_qsort_cmp);
+
+    ctx->indexed = true;
+    return true;
+}
+
+/* The ISO codes may be loaded on demand, so they have their own indices */
+static bool
+rxkb_context_build_iso_indices(struct rxkb_context *ctx)
+{
+    struct rxkb_layout *l;
+    struct rxkb_iso639_code *iso639;
+    struct rxkb_iso3166_code *iso3166;
+    darray_size_t seq = 0;
+
+    if (ctx->context_state != CONTEXT_PARSED)
+        return false;
+    if (ctx->iso_indexed)
+        return true;
+
+    rxkb_context_load_details(ctx);
+
+    list_for_each(l, &ctx->layouts, base.link) {
+        list_for_each(iso639, &l->iso639s, base.link)
+            iso_index_append(&ctx->iso639_index, iso639->code, l, seq);
+        list_for_each(iso3166, &l->iso3166s, base.link)
+            iso_index_append(&ctx->iso3166_index, iso3166->code, l, seq);
+        seq++;
+    }
+    iso_index_finish(&ctx->iso639_index);
+    iso_index_finish(&ctx->iso3166_index);
+
+    ctx->iso_indexed = true;
+    return true;
+}
+
+struct rxkb_layout *
+rxkb_layout_find(struct rxkb_context *ctx, const char *name,
+                 const char *variant)
+{
+    if (!name || !rxkb_context_build_indices(ctx))
+        return NULL;
+    if (variant && !variant[0])
+        variant = NULL;
+    return index_find(&ctx->layouts_index, name, variant);
+}
+
+struct rxkb_option *
+rxkb_option_find(struct rxkb_context *ctx, const char *name)
+{
+    if (!name || !rxkb_context_build_indices(ctx))
+        return NULL;
+    return index_find(&ctx->options_index, name, NULL);
+}
+
+struct rxkb_layout * const *
+rxkb_layouts_for_language(struct rxkb_context *ctx, const char *iso639,
+                          size_t *count)
+{
+    *count = 0;
+    if (!iso639 || !rxkb_context_build_iso_indices(ctx))
+        return NULL;
+    return iso_index_find(&ctx->iso639_index, iso639, count);
+}
+
+struct rxkb_layout * const *
+rxkb_layouts_for_country(struct rxkb_context *ctx, const char *iso3166,
+                         size_t *count)
+{
+    *count = 0;
+    if (!iso3166 || !rxkb_context_build_iso_indices(ctx))
+        return NULL;
+    return iso_index_find(&ctx->iso3166_index, iso3166, count);
+}
+
 static void
 rxkb_context_destroy(struct rxkb_context *ctx)
 {
     struct rxkb_model *m, *mtmp;
     struct rxkb_layout *l, *ltmp;
     struct rxkb_option_group *og, *ogtmp;
+    struct lazy_file **file;
     char **path;
 
+    darray_foreach(file, ctx->lazy_files)
+        lazy_file_free(*file);
+    darray_free(ctx->lazy_files);
+
     list_for_each_safe(m, mtmp, &ctx->models, base.link)
         rxkb_model_unref(m);
     assert(list_empty(&ctx->models));
@@ -415,6 +745,13 @@ rxkb_context_destroy(struct rxkb_context *ctx)
     darray_free(ctx->includes);
 
     assert(darray_empty(ctx->includes));
+
+    free(ctx->cache_path);
+
+    darray_free(ctx->layouts_index);
+    darray_free(ctx->options_index);
+    iso_index_free(&ctx->iso639_index);
+    iso_index_free(&ctx->iso3166_index);
 }
 
 DECLARE_REF_UNREF_FOR_TYPE(rxkb_context);
@@ -504,6 +841,8 @@ rxkb_context_new(enum rxkb_context_flags flags)
     ctx->context_state = CONTEXT_NEW;
     ctx->load_extra_rules_files = flags & RXKB_CONTEXT_LOAD_EXOTIC_RULES;
     ctx->use_secure_getenv = !(flags & RXKB_CONTEXT_NO_SECURE_GETENV);
+    ctx->validate_xml = flags & RXKB_CONTEXT_VALIDATE_XML;
+    ctx->lazy_details = flags & RXKB_CONTEXT_LAZY_DETAILS;
     ctx->log_fn = default_log_fn;
     ctx->log_level = RXKB_LOG_LEVEL_ERROR;
 
@@ -822,11 +1161,30 @@ rxkb_context_parse_default_ruleset(struct rxkb_context *ctx)
     return rxkb_context_parse(ctx, DEFAULT_XKB_RULES);
 }
 
+bool
+rxkb_context_set_cache_path(struct rxkb_context *ctx, const char *path)
+{
+    if (ctx->context_state != CONTEXT_NEW) {
+        log_err(ctx, XKB_LOG_MESSAGE_NO_ID,
+                "cache path must be set before parsing\n");
+        return false;
+    }
+
+    char * const tmp = (path) ? strdup(path) : NULL;
+    if (path && !tmp)
+        return false;
+
+    free(ctx->cache_path);
+    ctx->cache_path = tmp;
+    return true;
+}
+
 bool
 rxkb_context_parse(struct rxkb_context *ctx, const char *ruleset)
 {
     char **path;
     bool success = false;
+    darray_uchar cache_key = darray_new();
 
     if (ctx->context_state != CONTEXT_NEW) {
         log_err(ctx, XKB_LOG_MESSAGE_NO_ID,
@@ -834,6 +1192,28 @@ rxkb_context_parse(struct rxkb_context *ctx, const char *ruleset)
         return false;
     }
 
+    if (ctx->cache_path) {
+        /* The cache is valid only for the exact same set of rules files */
+        cache_key_init(ctx, &cache_key, ruleset);
+        darray_foreach_reverse(path, ctx->includes) {
+            char rules[PATH_MAX];
+
+            if (snprintf_safe(rules, sizeof(rules), "%s/rules/%s.xml",
+                              *path, ruleset))
+                cache_key_add_file(&cache_key, rules);
+
+            if (ctx->load_extra_rules_files &&
+                snprintf_safe(rules, sizeof(rules), "%s/rules/%s.extras.xml",
+                              *path, ruleset))
+                cache_key_add_file(&cache_key, rules);
+        }
+
+        if (cache_load(ctx, &cache_key)) {
+            success = true;
+            goto out;
+        }
+    }
+
     darray_foreach_reverse(path, ctx->includes) {
         char rules[PATH_MAX];
 
@@ -853,6 +1233,14 @@ rxkb_context_parse(struct rxkb_context *ctx, const char *ruleset)
         }
     }
 
+    if (success && ctx->cache_path) {
+        /* The cache stores all the details */
+        rxkb_context_load_details(ctx);
+        cache_write(ctx, &cache_key);
+    }
+
+out:
+    darray_free(cache_key);
     ctx->context_state = success ? CONTEXT_PARSED : CONTEXT_FAILED;
 
     return success;
@@ -871,361 +1259,687 @@ rxkb_context_get_user_data(struct rxkb_context *ctx)
     return ctx->userdata;
 }
 
+/* Streaming reader of a rules XML file */
+struct rules_reader {
+    struct rxkb_context *ctx;
+    xmlTextReaderPtr reader;
+    enum rxkb_popularity popularity;
+    bool failed;
+    struct lazy_file *lazy; /* if set, the details are loaded on demand */
+};
+
+static long
+reader_line(struct rules_reader *r)
+{
+    xmlNode *node = xmlTextReaderCurrentNode(r->reader);
+    return node ? xmlGetLineNo(node) : -1;
+}
+
+#define reader_err(r, fmt, ...) do { \
+    log_err((r)->ctx, XKB_LOG_MESSAGE_NO_ID, "xml:%ld: " fmt, \
+            reader_line(r), __VA_ARGS__); \
+    (r)->failed = true; \
+} while (0)
+
+static inline const char *
+reader_name(struct rules_reader *r)
+{
+    return (const char *) xmlTextReaderConstName(r->reader);
+}
+
 static inline bool
-is_node(xmlNode *node, const char *name)
+reader_is_empty(struct rules_reader *r)
+{
+    return xmlTextReaderIsEmptyElement(r->reader) == 1;
+}
+
+/*
+ * Move to the next child element of the current non-empty element. The
+ * previous children must have been consumed entirely.
+ *
+ * Returns false at the end of the current element or on error.
+ */
+static bool
+reader_next_child(struct rules_reader *r)
 {
-    return node->type == XML_ELEMENT_NODE &&
-        xmlStrEqual(node->name, (const xmlChar*)name);
+    while (!r->failed) {
+        if (xmlTextReaderRead(r->reader) != 1) {
+            /* Either a parse error or a premature end of the document */
+            r->failed = true;
+            break;
+        }
+        switch (xmlTextReaderNodeType(r->reader)) {
+        case XML_READER_TYPE_ELEMENT:
+            return true;
+        case XML_READER_TYPE_END_ELEMENT:
+            return false;
+        case XML_READER_TYPE_TEXT:
+        case XML_READER_TYPE_CDATA:
+            reader_err(r, "unexpected text: \"%s\"\n",
+                       (const char *) xmlTextReaderConstValue(r->reader));
+            break;
+        default:
+            /* Whitespaces, comments, processing instructions */
+            break;
+        }
+    }
+    return false;
+}
+
+/* Iterate over the child elements of the current element */
+#define reader_foreach_child(r) \
+    for (bool empty_ = reader_is_empty(r); !empty_ && reader_next_child(r);)
+
+/* Consume the current element and its descendants */
+static void
+reader_skip(struct rules_reader *r)
+{
+    if (reader_is_empty(r))
+        return;
+    const int depth = xmlTextReaderDepth(r->reader);
+    while (xmlTextReaderRead(r->reader) == 1) {
+        if (xmlTextReaderNodeType(r->reader) == XML_READER_TYPE_END_ELEMENT &&
+            xmlTextReaderDepth(r->reader) == depth)
+            return;
+    }
+    r->failed = true;
 }
 
-/* return a copy of the text content from the first text node of this node */
+/*
+ * Return a copy of the content of the first text node of the current element
+ * and consume the element.
+ */
 static char *
-extract_text(xmlNode *node)
+reader_text(struct rules_reader *r)
 {
-    xmlNode *n;
+    char *text = NULL;
 
-    for (n = node->children; n; n = n->next) {
-        if (n->type == XML_TEXT_NODE)
-            return (char *)xmlStrdup(n->content);
+    if (reader_is_empty(r))
+        return NULL;
+
+    while (xmlTextReaderRead(r->reader) == 1) {
+        switch (xmlTextReaderNodeType(r->reader)) {
+        case XML_READER_TYPE_TEXT:
+        case XML_READER_TYPE_CDATA:
+        case XML_READER_TYPE_WHITESPACE:
+        case XML_READER_TYPE_SIGNIFICANT_WHITESPACE:
+            if (!text)
+                text = (char *) xmlStrdup(xmlTextReaderConstValue(r->reader));
+            break;
+        case XML_READER_TYPE_ELEMENT:
+            reader_err(r, "unexpected element '%s' in text\n", reader_name(r));
+            reader_skip(r);
+            break;
+        case XML_READER_TYPE_END_ELEMENT:
+            return text;
+        default:
+            break;
+        }
     }
+
+    r->failed = true;
+    free(text);
     return NULL;
 }
 
+/* Get an attribute of the current element, which must be “true” or “false” */
+static bool
+reader_bool_attribute(struct rules_reader *r, const char *name)
+{
+    xmlChar *raw = xmlTextReaderGetAttribute(r->reader, (const xmlChar *) name);
+    bool value = false;
+    if (raw) {
+        if (xmlStrEqual(raw, (const xmlChar *) "true"))
+            value = true;
+        else if (!xmlStrEqual(raw, (const xmlChar *) "false"))
+            reader_err(r, "invalid %s attribute: expected 'true' or 'false', "
+                       "got: '%s'\n", name, raw);
+    }
+    xmlFree(raw);
+    return value;
+}
+
+/*
+ * Element of a content model, i.e. an item of the sequence of children of an
+ * element as defined in the registry DTD.
+ */
+struct content_model {
+    const char *name;
+    bool required;
+    bool repeated;
+};
+
+/* Check the children of an element against its content model */
+struct content_check {
+    const char *parent;
+    const struct content_model *model;
+    int count;
+    int last; /* index of the last child in the model, -1 if none yet */
+};
+
+#define content_check_new(parent_, model_) { \
+    .parent = (parent_), \
+    .model = (model_), \
+    .count = (int) ARRAY_SIZE(model_), \
+    .last = -1 \
+}
+
+/*
+ * Check the current child element against the content model.
+ *
+ * Returns its index in the content model, or -1 if it is not allowed.
+ */
+static int
+content_check_child(struct rules_reader *r, struct content_check *check)
+{
+    const char * const name = reader_name(r);
+
+    for (int i = MAX(check->last, 0); i < check->count; i++) {
+        if (!streq(name, check->model[i].name))
+            continue;
+        if (i == check->last && !check->model[i].repeated)
+            break;
+        for (int j = check->last + 1; j < i; j++) {
+            if (check->model[j].required) {
+                reader_err(r, "missing required element '%s' in '%s'\n",
+                           check->model[j].name, check->parent);
+                return -1;
+            }
+        }
+        check->last = i;
+        return i;
+    }
+
+    reader_err(r, "unexpected element '%s' in '%s'\n", name, check->parent);
+    return -1;
+}
+
+static bool
+content_check_end(struct rules_reader *r, struct content_check *check)
+{
+    /* Report only the first error */
+    if (r->failed)
+        return false;
+    for (int j = check->last + 1; j < check->count; j++) {
+        if (check->model[j].required) {
+            reader_err(r, "missing required element '%s' in '%s'\n",
+                       check->model[j].name, check->parent);
+            return false;
+        }
+    }
+    return true;
+}
+
 /* Data from “configItem” node */
 struct config_item {
+    long line;
     char *name;
     char *description;
     char *brief;
     char *vendor;
     enum rxkb_popularity popularity;
     bool layout_specific;
+    bool has_iso639;
+    bool has_iso3166;
+    darray_string iso639;
+    darray_string iso3166;
 };
 
 #define config_item_new(popularity_) { \
+    .line = -1, \
     .name = NULL, \
     .description = NULL, \
     .brief = NULL, \
     .vendor = NULL, \
     .popularity = (popularity_), \
-    .layout_specific = false \
+    .layout_specific = false, \
+    .has_iso639 = false, \
+    .has_iso3166 = false, \
+    .iso639 = darray_new(), \
+    .iso3166 = darray_new() \
 }
 
 static void
 config_item_free(struct config_item *config) {
+    char **code;
+
     free(config->name);
     free(config->description);
     free(config->brief);
     free(config->vendor);
+    darray_foreach(code, config->iso639)
+        free(*code);
+    darray_free(config->iso639);
+    darray_foreach(code, config->iso3166)
+        free(*code);
+    darray_free(config->iso3166);
 }
 
-static bool
-parse_config_item(struct rxkb_context *ctx, xmlNode *parent,
-                  struct config_item *config)
-{
-    xmlNode *node = NULL;
-    xmlNode *ci = NULL;
-
-    for (ci = parent->children; ci; ci = ci->next) {
-        if (is_node(ci, "configItem")) {
-            /* Process attributes */
-            xmlChar *raw_popularity = xmlGetProp(ci, (const xmlChar*)"popularity");
-            if (raw_popularity) {
-                if (xmlStrEqual(raw_popularity, (const xmlChar*)"standard"))
-                    config->popularity = RXKB_POPULARITY_STANDARD;
-                else if (xmlStrEqual(raw_popularity, (const xmlChar*)"exotic"))
-                    config->popularity = RXKB_POPULARITY_EXOTIC;
-                else
-                    log_err(ctx, XKB_LOG_MESSAGE_NO_ID,
-                            "xml:%u: invalid popularity attribute: expected "
-                            "'standard' or 'exotic', got: '%s'\n",
-                            ci->line, raw_popularity);
-            }
-            xmlFree(raw_popularity);
-
-            /* Note: this is only useful for options */
-            xmlChar *raw_layout_specific =
-                xmlGetProp(ci, (const xmlChar*)"layout-specific");
-            if (raw_layout_specific &&
-                xmlStrEqual(raw_layout_specific, (const xmlChar*)"true"))
-                config->layout_specific = true;
-            xmlFree(raw_layout_specific);
-
-            /* Process children */
-            for (node = ci->children; node; node = node->next) {
-                if (is_node(node, "name"))
-                    config->name = extract_text(node);
-                else if (is_node(node, "description"))
-                    config->description = extract_text(node);
-                else if (is_node(node, "shortDescription"))
-                    config->brief = extract_text(node);
-                else if (is_node(node, "vendor"))
-                    config->vendor = extract_text(node);
-                /* Note: the DTD allows for vendor + brief but models only use
-                 * vendor and everything else only uses shortDescription */
-            }
-
-            if (!config->name || !strlen(config->name))  {
-                log_err(ctx, XKB_LOG_MESSAGE_NO_ID,
-                        "xml:%u: missing required element 'name'\n",
-                        ci->line);
-                config_item_free(config);
-                return false;
-            }
-
-            return true; /* only one configItem allowed in the dtd */
-        }
-    }
-
-    return false;
-}
-
+/*
+ * Parse a list of ISO codes, ignoring codes with an invalid length.
+ * If `codes` is NULL, only check the structure of the list.
+ */
 static void
-parse_model(struct rxkb_context *ctx, xmlNode *model,
-            enum rxkb_popularity popularity)
+parse_iso_list(struct rules_reader *r, const char *list, const char *item,
+               size_t length, darray_string *codes)
 {
-    struct config_item config = config_item_new(popularity);
-
-    if (parse_config_item(ctx, model, &config)) {
-        struct rxkb_model *m;
-
-        list_for_each(m, &ctx->models, base.link) {
-            if (streq(m->name, config.name)) {
-                config_item_free(&config);
-                return;
-            }
+    const struct content_model model[] = {
+        { .name = item, .required = true, .repeated = true },
+    };
+    struct content_check check = content_check_new(list, model);
+
+    reader_foreach_child(r) {
+        if (content_check_child(r, &check) < 0 || !codes) {
+            reader_skip(r);
+            continue;
         }
-
-        /* new model */
-        m = rxkb_model_create(&ctx->base);
-        m->name = steal(&config.name);
-        m->description = steal(&config.description);
-        m->vendor = steal(&config.vendor);
-        m->popularity = config.popularity;
-        list_append(&ctx->models, &m->base.link);
+        char *str = reader_text(r);
+        if (!str || strlen(str) != length) {
+            free(str);
+            continue;
+        }
+        darray_append(*codes, str);
     }
+    content_check_end(r, &check);
 }
 
 static void
-parse_model_list(struct rxkb_context *ctx, xmlNode *model_list,
-                 enum rxkb_popularity popularity)
+parse_hw_list(struct rules_reader *r)
 {
-    xmlNode *node = NULL;
-
-    for (node = model_list->children; node; node = node->next) {
-        if (is_node(node, "model"))
-            parse_model(ctx, node, popularity);
+    static const struct content_model model[] = {
+        { .name = "hwId", .required = true, .repeated = true },
+    };
+    struct content_check check = content_check_new("hwList", model);
+
+    reader_foreach_child(r) {
+        content_check_child(r, &check);
+        reader_skip(r);
     }
+    content_check_end(r, &check);
 }
 
-static void
-parse_language_list(xmlNode *language_list, struct rxkb_layout *layout)
-{
-    xmlNode *node = NULL;
-    struct rxkb_iso639_code *code;
+enum config_item_child {
+    CONFIG_ITEM_NAME,
+    CONFIG_ITEM_SHORT_DESCRIPTION,
+    CONFIG_ITEM_DESCRIPTION,
+    CONFIG_ITEM_VENDOR,
+    CONFIG_ITEM_COUNTRY_LIST,
+    CONFIG_ITEM_LANGUAGE_LIST,
+    CONFIG_ITEM_HW_LIST,
+};
 
-    for (node = language_list->children; node; node = node->next) {
-        if (is_node(node, "iso639Id")) {
-            char *str = extract_text(node);
-            struct rxkb_object *parent;
+static const struct content_model config_item_model[] = {
+    [CONFIG_ITEM_NAME] = { .name = "name", .required = true },
+    [CONFIG_ITEM_SHORT_DESCRIPTION] = { .name = "shortDescription" },
+    [CONFIG_ITEM_DESCRIPTION] = { .name = "description" },
+    [CONFIG_ITEM_VENDOR] = { .name = "vendor" },
+    [CONFIG_ITEM_COUNTRY_LIST] = { .name = "countryList" },
+    [CONFIG_ITEM_LANGUAGE_LIST] = { .name = "languageList" },
+    [CONFIG_ITEM_HW_LIST] = { .name = "hwList" },
+};
 
-            if (!str || strlen(str) != 3) {
-                free(str);
-                continue;
-            }
-
-            parent = &layout->base;
-            code = rxkb_iso639_code_create(parent);
-            code->code = str;
-            list_append(&layout->iso639s, &code->base.link);
+/* Parse the current “configItem” element */
+static bool
+parse_config_item(struct rules_reader *r, struct config_item *config)
+{
+    const long line = reader_line(r);
+    config->line = line;
+
+    /* Process attributes */
+    xmlChar *raw_popularity =
+        xmlTextReaderGetAttribute(r->reader, (const xmlChar*)"popularity");
+    if (raw_popularity) {
+        if (xmlStrEqual(raw_popularity, (const xmlChar*)"standard"))
+            config->popularity = RXKB_POPULARITY_STANDARD;
+        else if (xmlStrEqual(raw_popularity, (const xmlChar*)"exotic"))
+            config->popularity = RXKB_POPULARITY_EXOTIC;
+        else
+            reader_err(r, "invalid popularity attribute: expected "
+                       "'standard' or 'exotic', got: '%s'\n", raw_popularity);
+    }
+    xmlFree(raw_popularity);
+
+    /* Note: this is only useful for options */
+    config->layout_specific = reader_bool_attribute(r, "layout-specific");
+
+    /* Process children. The details are skipped if loaded on demand. */
+    const bool details = !r->lazy;
+    struct content_check check =
+        content_check_new("configItem", config_item_model);
+    reader_foreach_child(r) {
+        switch (content_check_child(r, &check)) {
+        case CONFIG_ITEM_NAME:
+            config->name = reader_text(r);
+            break;
+        case CONFIG_ITEM_SHORT_DESCRIPTION:
+            if (details)
+                config->brief = reader_text(r);
+            else
+                reader_skip(r);
+            break;
+        case CONFIG_ITEM_DESCRIPTION:
+            if (details)
+                config->description = reader_text(r);
+            else
+                reader_skip(r);
+            break;
+        case CONFIG_ITEM_VENDOR:
+            if (details)
+                config->vendor = reader_text(r);
+            else
+                reader_skip(r);
+            break;
+        /* Note: the DTD allows for vendor + brief but models only use
+         * vendor and everything else only uses shortDescription */
+        case CONFIG_ITEM_COUNTRY_LIST:
+            config->has_iso3166 = true;
+            parse_iso_list(r, "countryList", "iso3166Id", 2,
+                           details ? &config->iso3166 : NULL);
+            break;
+        case CONFIG_ITEM_LANGUAGE_LIST:
+            config->has_iso639 = true;
+            parse_iso_list(r, "languageList", "iso639Id", 3,
+                           details ? &config->iso639 : NULL);
+            break;
+        case CONFIG_ITEM_HW_LIST:
+            parse_hw_list(r);
+            break;
+        default:
+            reader_skip(r);
         }
     }
+
+    if (!content_check_end(r, &check))
+        return false;
+
+    if (!config->name || !strlen(config->name))  {
+        log_err(r->ctx, XKB_LOG_MESSAGE_NO_ID,
+                "xml:%ld: missing required element 'name'\n", line);
+        r->failed = true;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Parse the current element, which contains only a “configItem” element
+ * followed by an optional list.
+ */
+static bool
+parse_config_item_child(struct rules_reader *r, const char *parent,
+                        struct config_item *config)
+{
+    const struct content_model model[] = {
+        { .name = "configItem", .required = true },
+    };
+    struct content_check check = content_check_new(parent, model);
+
+    reader_foreach_child(r) {
+        if (content_check_child(r, &check) < 0)
+            reader_skip(r);
+        else if (!parse_config_item(r, config))
+            break;
+    }
+    return content_check_end(r, &check);
 }
 
+/* Register an item whose details are loaded on demand */
 static void
-parse_country_list(xmlNode *country_list, struct rxkb_layout *layout)
+lazy_file_add(struct rules_reader *r, struct rxkb_object *object,
+              enum lazy_kind kind, struct rxkb_layout *layout, long line)
 {
-    xmlNode *node = NULL;
-    struct rxkb_iso3166_code *code;
+    if (!r->lazy)
+        return;
+    const struct lazy_item item = {
+        .object = object,
+        .layout = layout,
+        .line = line,
+        .kind = kind,
+    };
+    darray_append(r->lazy->items, item);
+    object->lazy = r->lazy;
+}
 
-    for (node = country_list->children; node; node = node->next) {
-        if (is_node(node, "iso3166Id")) {
-            char *str = extract_text(node);
-            struct rxkb_object *parent;
+static void
+parse_model(struct rules_reader *r)
+{
+    struct rxkb_context *ctx = r->ctx;
+    struct config_item config = config_item_new(r->popularity);
 
-            if (!str || strlen(str) != 2) {
-                free(str);
-                continue;
-            }
+    if (parse_config_item_child(r, "model", &config)) {
+        struct rxkb_model *m;
 
-            parent = &layout->base;
-            code = rxkb_iso3166_code_create(parent);
-            code->code = str;
-            list_append(&layout->iso3166s, &code->base.link);
+        list_for_each(m, &ctx->models, base.link) {
+            if (streq(m->name, config.name))
+                goto out;
         }
+
+        /* new model */
+        m = rxkb_model_create(&ctx->base);
+        m->name = steal(&config.name);
+        m->description = steal(&config.description);
+        m->vendor = steal(&config.vendor);
+        m->popularity = config.popularity;
+        list_append(&ctx->models, &m->base.link);
+        lazy_file_add(r, &m->base, LAZY_MODEL, NULL, config.line);
     }
+
+out:
+    config_item_free(&config);
 }
 
 static void
-parse_variant(struct rxkb_context *ctx, struct rxkb_layout *l,
-              xmlNode *variant, enum rxkb_popularity popularity)
+parse_model_list(struct rules_reader *r)
 {
-    xmlNode *ci;
-    struct config_item config = config_item_new(popularity);
-
-    if (parse_config_item(ctx, variant, &config)) {
-        struct rxkb_layout *v;
-        bool exists = false;
+    static const struct content_model model[] = {
+        { .name = "model", .repeated = true },
+    };
+    struct content_check check = content_check_new("modelList", model);
+
+    reader_foreach_child(r) {
+        if (content_check_child(r, &check) < 0)
+            reader_skip(r);
+        else
+            parse_model(r);
+    }
+    content_check_end(r, &check);
+}
 
-        list_for_each(v, &ctx->layouts, base.link) {
-            if (streq_null(v->variant, config.name) &&
-                streq(v->name, l->name)) {
-                exists = true;
-                break;
-            }
-        }
+static void
+add_iso639_codes(struct rxkb_layout *layout, darray_string *codes)
+{
+    char **str;
 
-        if (!exists) {
-            v = rxkb_layout_create(&ctx->base);
-            list_init(&v->iso639s);
-            list_init(&v->iso3166s);
-            v->name = strdup(l->name);
-            v->variant = steal(&config.name);
-            v->description = steal(&config.description);
-            // if variant omits brief, inherit from parent layout.
-            v->brief = config.brief == NULL ? strdup_safe(l->brief) : steal(&config.brief);
-            v->popularity = config.popularity;
-            list_append(&ctx->layouts, &v->base.link);
-
-            for (ci = variant->children; ci; ci = ci->next) {
-                xmlNode *node;
-
-                if (!is_node(ci, "configItem"))
-                    continue;
-
-                bool found_language_list = false;
-                bool found_country_list = false;
-                for (node = ci->children; node; node = node->next) {
-                    if (is_node(node, "languageList")) {
-                        parse_language_list(node, v);
-                        found_language_list = true;
-                    }
-                    if (is_node(node, "countryList")) {
-                        parse_country_list(node, v);
-                        found_country_list = true;
-                    }
-                }
-                if (!found_language_list) {
-                    // inherit from parent layout
-                    struct rxkb_iso639_code* x;
-                    list_for_each(x, &l->iso639s, base.link) {
-                        struct rxkb_iso639_code* code = rxkb_iso639_code_create(&v->base);
-                        code->code = strdup(x->code);
-                        list_append(&v->iso639s, &code->base.link);
-                    }
-                }
-                if (!found_country_list) {
-                    // inherit from parent layout
-                    struct rxkb_iso3166_code* x;
-                    list_for_each(x, &l->iso3166s, base.link) {
-                        struct rxkb_iso3166_code* code = rxkb_iso3166_code_create(&v->base);
-                        code->code = strdup(x->code);
-                        list_append(&v->iso3166s, &code->base.link);
-                    }
-                }
-            }
-        } else {
-            config_item_free(&config);
-        }
+    darray_foreach(str, *codes) {
+        struct rxkb_iso639_code *code = rxkb_iso639_code_create(&layout->base);
+        code->code = steal(str);
+        list_append(&layout->iso639s, &code->base.link);
     }
 }
 
 static void
-parse_variant_list(struct rxkb_context *ctx, struct rxkb_layout *l,
-                   xmlNode *variant_list, enum rxkb_popularity popularity)
+add_iso3166_codes(struct rxkb_layout *layout, darray_string *codes)
 {
-    xmlNode *node = NULL;
+    char **str;
 
-    for (node = variant_list->children; node; node = node->next) {
-        if (is_node(node, "variant"))
-            parse_variant(ctx, l, node, popularity);
+    darray_foreach(str, *codes) {
+        struct rxkb_iso3166_code *code = rxkb_iso3166_code_create(&layout->base);
+        code->code = steal(str);
+        list_append(&layout->iso3166s, &code->base.link);
     }
 }
 
 static void
-parse_layout(struct rxkb_context *ctx, xmlNode *layout,
-             enum rxkb_popularity popularity)
+layout_set_details(struct rxkb_layout *l, struct config_item *config)
 {
-    struct config_item config = config_item_new(popularity);
-    struct rxkb_layout *l;
-    xmlNode *node = NULL;
-    bool exists = false;
+    l->description = steal(&config->description);
+    l->brief = steal(&config->brief);
+    add_iso639_codes(l, &config->iso639);
+    add_iso3166_codes(l, &config->iso3166);
+}
 
-    if (!parse_config_item(ctx, layout, &config))
-        return;
+static void
+variant_set_details(struct rxkb_layout *v, struct rxkb_layout *l,
+                    struct config_item *config)
+{
+    v->description = steal(&config->description);
+    // if variant omits brief, inherit from parent layout.
+    v->brief = config->brief == NULL ? strdup_safe(l->brief) : steal(&config->brief);
 
-    list_for_each(l, &ctx->layouts, base.link) {
-        if (streq(l->name, config.name) && l->variant == NULL) {
-            exists = true;
-            break;
+    if (config->has_iso639) {
+        add_iso639_codes(v, &config->iso639);
+    } else {
+        // inherit from parent layout
+        struct rxkb_iso639_code* x;
+        list_for_each(x, &l->iso639s, base.link) {
+            struct rxkb_iso639_code* code = rxkb_iso639_code_create(&v->base);
+            code->code = strdup(x->code);
+            list_append(&v->iso639s, &code->base.link);
         }
     }
-
-    if (!exists) {
-        l = rxkb_layout_create(&ctx->base);
-        list_init(&l->iso639s);
-        list_init(&l->iso3166s);
-        l->name = steal(&config.name);
-        l->variant = NULL;
-        l->description = steal(&config.description);
-        l->brief = steal(&config.brief);
-        l->popularity = config.popularity;
-        list_append(&ctx->layouts, &l->base.link);
+    if (config->has_iso3166) {
+        add_iso3166_codes(v, &config->iso3166);
     } else {
-        config_item_free(&config);
+        // inherit from parent layout
+        struct rxkb_iso3166_code* x;
+        list_for_each(x, &l->iso3166s, base.link) {
+            struct rxkb_iso3166_code* code = rxkb_iso3166_code_create(&v->base);
+            code->code = strdup(x->code);
+            list_append(&v->iso3166s, &code->base.link);
+        }
     }
+}
+
+static void
+parse_variant(struct rules_reader *r, struct rxkb_layout *l)
+{
+    struct rxkb_context *ctx = r->ctx;
+    struct config_item config = config_item_new(r->popularity);
 
-    for (node = layout->children; node; node = node->next) {
-        if (is_node(node, "variantList")) {
-            parse_variant_list(ctx, l, node, popularity);
+    if (parse_config_item_child(r, "variant", &config)) {
+        struct rxkb_layout *v;
+
+        list_for_each(v, &ctx->layouts, base.link) {
+            if (streq_null(v->variant, config.name) &&
+                streq(v->name, l->name))
+                goto out;
         }
-        if (!exists && is_node(node, "configItem")) {
-            xmlNode *ll;
-            for (ll = node->children; ll; ll = ll->next) {
-                if (is_node(ll, "languageList"))
-                    parse_language_list(ll, l);
-                if (is_node(ll, "countryList"))
-                    parse_country_list(ll, l);
+
+        v = rxkb_layout_create(&ctx->base);
+        list_init(&v->iso639s);
+        list_init(&v->iso3166s);
+        v->name = strdup(l->name);
+        v->variant = steal(&config.name);
+        v->popularity = config.popularity;
+        list_append(&ctx->layouts, &v->base.link);
+
+        if (r->lazy)
+            lazy_file_add(r, &v->base, LAZY_VARIANT, l, config.line);
+        else
+            variant_set_details(v, l, &config);
+    }
+
+out:
+    config_item_free(&config);
+}
+
+static void
+parse_variant_list(struct rules_reader *r, struct rxkb_layout *l)
+{
+    static const struct content_model model[] = {
+        { .name = "variant", .repeated = true },
+    };
+    struct content_check check = content_check_new("variantList", model);
+
+    reader_foreach_child(r) {
+        if (content_check_child(r, &check) < 0)
+            reader_skip(r);
+        else
+            parse_variant(r, l);
+    }
+    content_check_end(r, &check);
+}
+
+static void
+parse_layout(struct rules_reader *r)
+{
+    static const struct content_model model[] = {
+        { .name = "configItem", .required = true },
+        { .name = "variantList" },
+    };
+    struct content_check check = content_check_new("layout", model);
+    struct rxkb_context *ctx = r->ctx;
+    struct rxkb_layout *l = NULL;
+
+    reader_foreach_child(r) {
+        switch (content_check_child(r, &check)) {
+        case 0: {
+            struct config_item config = config_item_new(r->popularity);
+            if (!parse_config_item(r, &config)) {
+                config_item_free(&config);
+                break;
             }
+
+            list_for_each(l, &ctx->layouts, base.link) {
+                if (streq(l->name, config.name) && l->variant == NULL)
+                    break;
+            }
+
+            if (&l->base.link == &ctx->layouts) {
+                l = rxkb_layout_create(&ctx->base);
+                list_init(&l->iso639s);
+                list_init(&l->iso3166s);
+                l->name = steal(&config.name);
+                l->variant = NULL;
+                l->popularity = config.popularity;
+                list_append(&ctx->layouts, &l->base.link);
+                if (r->lazy)
+                    lazy_file_add(r, &l->base, LAZY_LAYOUT, NULL, config.line);
+                else
+                    layout_set_details(l, &config);
+            }
+            config_item_free(&config);
+            break;
+        }
+        case 1:
+            parse_variant_list(r, l);
+            break;
+        default:
+            reader_skip(r);
         }
     }
+    content_check_end(r, &check);
 }
 
 static void
-parse_layout_list(struct rxkb_context *ctx, xmlNode *layout_list,
-                  enum rxkb_popularity popularity)
+parse_layout_list(struct rules_reader *r)
 {
-    xmlNode *node = NULL;
-
-    for (node = layout_list->children; node; node = node->next) {
-        if (is_node(node, "layout"))
-            parse_layout(ctx, node, popularity);
+    static const struct content_model model[] = {
+        { .name = "layout", .repeated = true },
+    };
+    struct content_check check = content_check_new("layoutList", model);
+
+    reader_foreach_child(r) {
+        if (content_check_child(r, &check) < 0)
+            reader_skip(r);
+        else
+            parse_layout(r);
     }
+    content_check_end(r, &check);
 }
 
 static void
-parse_option(struct rxkb_context *ctx, struct rxkb_option_group *group,
-             xmlNode *option, enum rxkb_popularity popularity)
+parse_option(struct rules_reader *r, struct rxkb_option_group *group)
 {
-    struct config_item config = config_item_new(popularity);
+    struct config_item config = config_item_new(r->popularity);
 
-    if (parse_config_item(ctx, option, &config)) {
+    if (parse_config_item_child(r, "option", &config)) {
         struct rxkb_option *o;
 
         list_for_each(o, &group->options, base.link) {
-            if (streq(o->name, config.name)) {
-                config_item_free(&config);
-                return;
-            }
+            if (streq(o->name, config.name))
+                goto out;
         }
 
         o = rxkb_option_create(&group->base);
@@ -1234,80 +1948,184 @@ parse_option(struct rxkb_context *ctx, struct rxkb_option_group *group,
         o->popularity = config.popularity;
         o->layout_specific = config.layout_specific;
         list_append(&group->options, &o->base.link);
+        lazy_file_add(r, &o->base, LAZY_OPTION, NULL, config.line);
     }
+
+out:
+    config_item_free(&config);
 }
 
 static void
-parse_group(struct rxkb_context *ctx, xmlNode *group,
-            enum rxkb_popularity popularity)
+parse_group(struct rules_reader *r)
 {
-    struct config_item config = config_item_new(popularity);
-    struct rxkb_option_group *g;
-    xmlNode *node = NULL;
-    xmlChar *multiple;
-    bool exists = false;
+    static const struct content_model model[] = {
+        { .name = "configItem", .required = true },
+        { .name = "option", .repeated = true },
+    };
+    struct content_check check = content_check_new("group", model);
+    struct rxkb_context *ctx = r->ctx;
+    struct rxkb_option_group *g = NULL;
+
+    /* Attributes must be read before moving to the children */
+    const bool multiple = reader_bool_attribute(r, "allowMultipleSelection");
+
+    reader_foreach_child(r) {
+        switch (content_check_child(r, &check)) {
+        case 0: {
+            struct config_item config = config_item_new(r->popularity);
+            if (!parse_config_item(r, &config)) {
+                config_item_free(&config);
+                break;
+            }
 
-    if (!parse_config_item(ctx, group, &config))
-        return;
+            list_for_each(g, &ctx->option_groups, base.link) {
+                if (streq(g->name, config.name))
+                    break;
+            }
 
-    list_for_each(g, &ctx->option_groups, base.link) {
-        if (streq(g->name, config.name)) {
-            exists = true;
+            if (&g->base.link == &ctx->option_groups) {
+                g = rxkb_option_group_create(&ctx->base);
+                g->name = steal(&config.name);
+                g->description = steal(&config.description);
+                g->popularity = config.popularity;
+                g->allow_multiple = multiple;
+                list_init(&g->options);
+                list_append(&ctx->option_groups, &g->base.link);
+                lazy_file_add(r, &g->base, LAZY_OPTION_GROUP, NULL,
+                              config.line);
+            }
+            config_item_free(&config);
             break;
         }
+        case 1:
+            parse_option(r, g);
+            break;
+        default:
+            reader_skip(r);
+        }
     }
+    content_check_end(r, &check);
+}
 
-    if (!exists) {
-        g = rxkb_option_group_create(&ctx->base);
-        g->name = steal(&config.name);
-        g->description = steal(&config.description);
-        g->popularity = config.popularity;
-
-        multiple = xmlGetProp(group, (const xmlChar*)"allowMultipleSelection");
-        if (multiple && xmlStrEqual(multiple, (const xmlChar*)"true"))
-            g->allow_multiple = true;
-        xmlFree(multiple);
+static void
+parse_option_list(struct rules_reader *r)
+{
+    static const struct content_model model[] = {
+        { .name = "group", .repeated = true },
+    };
+    struct content_check check = content_check_new("optionList", model);
+
+    reader_foreach_child(r) {
+        if (content_check_child(r, &check) < 0)
+            reader_skip(r);
+        else
+            parse_group(r);
+    }
+    content_check_end(r, &check);
+}
 
-        list_init(&g->options);
-        list_append(&ctx->option_groups, &g->base.link);
-    } else {
-        config_item_free(&config);
+static bool
+parse_rules_xml(struct rules_reader *r)
+{
+    static const struct content_model model[] = {
+        { .name = "modelList" },
+        { .name = "layoutList" },
+        { .name = "optionList" },
+    };
+    struct content_check check = content_check_new("xkbConfigRegistry", model);
+
+    /* Move to the root element */
+    if (!reader_next_child(r))
+        return false;
+    if (!streq(reader_name(r), "xkbConfigRegistry")) {
+        reader_err(r, "unexpected root element '%s'\n", reader_name(r));
+        return false;
     }
 
-    for (node = group->children; node; node = node->next) {
-        if (is_node(node, "option"))
-            parse_option(ctx, g, node, popularity);
+    reader_foreach_child(r) {
+        switch (content_check_child(r, &check)) {
+        case 0:
+            parse_model_list(r);
+            break;
+        case 1:
+            parse_layout_list(r);
+            break;
+        case 2:
+            parse_option_list(r);
+            break;
+        default:
+            reader_skip(r);
+        }
     }
+
+    return content_check_end(r, &check);
 }
 
+/*
+ * State of the context before parsing a file, in order to discard the items
+ * of the file if it turns out to be invalid.
+ */
+struct parse_checkpoint {
+    struct list *models;
+    struct list *layouts;
+    struct list *option_groups;
+    /* Last option of each existing group */
+    darray(struct list *) options;
+};
+
 static void
-parse_option_list(struct rxkb_context *ctx, xmlNode *option_list,
-                  enum rxkb_popularity popularity)
+parse_checkpoint_init(struct rxkb_context *ctx,
+                      struct parse_checkpoint *checkpoint)
 {
-    xmlNode *node = NULL;
+    struct rxkb_option_group *g;
 
-    for (node = option_list->children; node; node = node->next) {
-        if (is_node(node, "group"))
-            parse_group(ctx, node, popularity);
-    }
+    checkpoint->models = ctx->models.prev;
+    checkpoint->layouts = ctx->layouts.prev;
+    checkpoint->option_groups = ctx->option_groups.prev;
+    darray_init(checkpoint->options);
+    list_for_each(g, &ctx->option_groups, base.link)
+        darray_append(checkpoint->options, g->options.prev);
 }
 
+/* Remove all the items added after the checkpoint */
 static void
-parse_rules_xml(struct rxkb_context *ctx, xmlNode *root,
-                enum rxkb_popularity popularity)
+parse_checkpoint_restore(struct rxkb_context *ctx,
+                         struct parse_checkpoint *checkpoint)
 {
-    xmlNode *node = NULL;
+    struct rxkb_model *m;
+    struct rxkb_layout *l;
+    struct rxkb_option_group *g;
+    struct rxkb_option *o;
+
+    while (checkpoint->models->next != &ctx->models) {
+        m = list_first_entry(checkpoint->models, m, base.link);
+        rxkb_model_unref(m);
+    }
+    while (checkpoint->layouts->next != &ctx->layouts) {
+        l = list_first_entry(checkpoint->layouts, l, base.link);
+        rxkb_layout_unref(l);
+    }
+    while (checkpoint->option_groups->next != &ctx->option_groups) {
+        g = list_first_entry(checkpoint->option_groups, g, base.link);
+        rxkb_option_group_unref(g);
+    }
 
-    for (node = root->children; node; node = node->next) {
-        if (is_node(node, "modelList"))
-            parse_model_list(ctx, node, popularity);
-        else if (is_node(node, "layoutList"))
-            parse_layout_list(ctx, node, popularity);
-        else if (is_node(node, "optionList"))
-            parse_option_list(ctx, node, popularity);
+    darray_size_t idx = 0;
+    list_for_each(g, &ctx->option_groups, base.link) {
+        struct list * const last = darray_item(checkpoint->options, idx++);
+        while (last->next != &g->options) {
+            o = list_first_entry(last, o, base.link);
+            rxkb_option_unref(o);
+        }
     }
 }
 
+static void
+parse_checkpoint_free(struct parse_checkpoint *checkpoint)
+{
+    darray_free(checkpoint->options);
+}
+
 static void
 ATTR_PRINTF(2, 0)
 xml_error_func(void *ctx, const char *msg, ...)
@@ -1358,10 +2176,12 @@ xml_structured_error_func(void *userData, const xmlError * error)
 }
 #endif
 
+/* Note: big lines are required to identify the items loaded on demand */
 #ifdef XML_PARSE_NO_XXE
-#define _XML_OPTIONS (XML_PARSE_NONET | XML_PARSE_NOENT | XML_PARSE_NO_XXE)
+#define _XML_OPTIONS (XML_PARSE_NONET | XML_PARSE_NOENT | XML_PARSE_NO_XXE | \
+                      XML_PARSE_BIG_LINES)
 #else
-#define _XML_OPTIONS (XML_PARSE_NONET)
+#define _XML_OPTIONS (XML_PARSE_NONET | XML_PARSE_BIG_LINES)
 #endif
 
 static bool
@@ -1453,59 +2273,302 @@ dtd_error:
     return success;
 }
 
+/* Read the document and validate it against the DTD */
+static xmlDoc *
+read_and_validate(struct rxkb_context *ctx, const char *path)
+{
+    xmlParserCtxtPtr xmlCtxt = xmlNewParserCtxt();
+    if (!xmlCtxt)
+        return NULL;
+
+    xmlCtxtUseOptions(xmlCtxt, _XML_OPTIONS);
+
+#ifdef HAVE_XML_CTXT_SET_ERRORHANDLER
+    /* Prefer contextual handler whenever possible. It takes precedence over
+     * the global generic handler. */
+    xmlCtxtSetErrorHandler(xmlCtxt, xml_structured_error_func, ctx);
+#endif
+
+    xmlDoc *doc = xmlCtxtReadFile(xmlCtxt, path, NULL, 0);
+    if (doc && !validate(ctx, doc)) {
+        log_err(ctx, XKB_LOG_MESSAGE_NO_ID,
+                "XML error: failed to validate document at %s\n", path);
+        xmlFreeDoc(doc);
+        doc = NULL;
+    }
+
+#ifdef HAVE_XML_CTXT_SET_ERRORHANDLER
+    xmlCtxtSetErrorHandler(xmlCtxt, NULL, NULL);
+#endif
+    xmlFreeParserCtxt(xmlCtxt);
+
+    return doc;
+}
+
+static struct lazy_file *
+lazy_file_new(struct rxkb_context *ctx, const char *path,
+              enum rxkb_popularity popularity)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return NULL;
+
+    struct lazy_file *file = calloc(1, sizeof(*file));
+    if (!file)
+        return NULL;
+    file->path = strdup(path);
+    if (!file->path) {
+        free(file);
+        return NULL;
+    }
+    file->ctx = ctx;
+    file->popularity = popularity;
+    file->size = st.st_size;
+    file->mtime = st.st_mtime;
+    darray_init(file->items);
+    return file;
+}
+
+static void
+lazy_file_free(struct lazy_file *file)
+{
+    struct lazy_item *item;
+    darray_foreach(item, file->items)
+        item->object->lazy = NULL;
+    darray_free(file->items);
+    free(file->path);
+    free(file);
+}
+
+static const char *
+lazy_item_name(const struct lazy_item *item)
+{
+    switch (item->kind) {
+    case LAZY_MODEL: {
+        const struct rxkb_model *m =
+            container_of(item->object, struct rxkb_model, base);
+        return m->name;
+    }
+    case LAZY_LAYOUT:
+    case LAZY_VARIANT: {
+        const struct rxkb_layout *l =
+            container_of(item->object, struct rxkb_layout, base);
+        return (item->kind == LAZY_VARIANT) ? l->variant : l->name;
+    }
+    case LAZY_OPTION_GROUP: {
+        const struct rxkb_option_group *g =
+            container_of(item->object, struct rxkb_option_group, base);
+        return g->name;
+    }
+    case LAZY_OPTION: {
+        const struct rxkb_option *o =
+            container_of(item->object, struct rxkb_option, base);
+        return o->name;
+    }
+    }
+    return NULL;
+}
+
+static void
+lazy_item_set_details(const struct lazy_item *item, struct config_item *config)
+{
+    switch (item->kind) {
+    case LAZY_MODEL: {
+        struct rxkb_model *m =
+            container_of(item->object, struct rxkb_model, base);
+        m->description = steal(&config->description);
+        m->vendor = steal(&config->vendor);
+        break;
+    }
+    case LAZY_LAYOUT:
+        layout_set_details(container_of(item->object, struct rxkb_layout, base),
+                           config);
+        break;
+    case LAZY_VARIANT:
+        variant_set_details(container_of(item->object, struct rxkb_layout, base),
+                            item->layout, config);
+        break;
+    case LAZY_OPTION_GROUP: {
+        struct rxkb_option_group *g =
+            container_of(item->object, struct rxkb_option_group, base);
+        g->description = steal(&config->description);
+        break;
+    }
+    case LAZY_OPTION: {
+        struct rxkb_option *o =
+            container_of(item->object, struct rxkb_option, base);
+        o->description = steal(&config->description);
+        break;
+    }
+    }
+}
+
+/*
+ * Load the details of all the items of a rules file.
+ *
+ * The file is read again and its “configItem” elements are matched with the
+ * items by their line and name, so that the items skipped when parsing, e.g.
+ * duplicates, are ignored.
+ */
+static void
+lazy_file_load(struct lazy_file *file)
+{
+    struct rxkb_context *ctx = file->ctx;
+    struct lazy_item *item;
+    struct stat st;
+
+    /* Variants may inherit details from a layout defined in another file */
+    darray_foreach(item, file->items) {
+        if (item->kind == LAZY_VARIANT && item->layout->base.lazy != file)
+            rxkb_object_load_details(&item->layout->base);
+    }
+
+    /* Details are loaded at most once, even on error */
+    darray_foreach(item, file->items)
+        item->object->lazy = NULL;
+
+    if (stat(file->path, &st) != 0 || st.st_size != file->size ||
+        st.st_mtime != file->mtime) {
+        log_warn(ctx, XKB_LOG_MESSAGE_NO_ID,
+                 "File modified since parsing, cannot load details: %s\n",
+                 file->path);
+        goto out;
+    }
+
+    log_dbg(ctx, "Loading details from %s\n", file->path);
+
+#ifndef HAVE_XML_CTXT_SET_ERRORHANDLER
+    xmlSetGenericErrorFunc(ctx, xml_error_func);
+#endif
+
+    struct rules_reader r = {
+        .ctx = ctx,
+        .reader = xmlReaderForFile(file->path, NULL, _XML_OPTIONS),
+        .popularity = file->popularity,
+        .failed = false,
+        .lazy = NULL,
+    };
+    if (!r.reader)
+        goto reset;
+#ifdef HAVE_XML_CTXT_SET_ERRORHANDLER
+    xmlTextReaderSetStructuredErrorHandler(r.reader, xml_structured_error_func,
+                                           ctx);
+#endif
+
+    darray_size_t k = 0;
+    const darray_size_t count = darray_size(file->items);
+    while (k < count && xmlTextReaderRead(r.reader) == 1) {
+        if (xmlTextReaderNodeType(r.reader) != XML_READER_TYPE_ELEMENT ||
+            !streq(reader_name(&r), "configItem"))
+            continue;
+
+        const long line = reader_line(&r);
+        while (k < count && darray_item(file->items, k).line < line)
+            k++;
+        if (k >= count || darray_item(file->items, k).line != line)
+            continue;
+
+        struct config_item config = config_item_new(file->popularity);
+        parse_config_item(&r, &config);
+        item = &darray_item(file->items, k);
+        if (config.name && streq_null(config.name, lazy_item_name(item))) {
+            lazy_item_set_details(item, &config);
+            k++;
+        }
+        config_item_free(&config);
+        r.failed = false;
+    }
+
+    xmlFreeTextReader(r.reader);
+reset:
+#ifndef HAVE_XML_CTXT_SET_ERRORHANDLER
+    xmlSetGenericErrorFunc(NULL, NULL);
+#endif
+out:
+    darray_free(file->items);
+}
+
+static void
+rxkb_context_load_details(struct rxkb_context *ctx)
+{
+    struct lazy_file **file;
+    darray_foreach(file, ctx->lazy_files)
+        lazy_file_load(*file);
+}
+
 static bool
 parse(struct rxkb_context *ctx, const char *path,
       enum rxkb_popularity popularity)
 {
     bool success = false;
     xmlDoc *doc = NULL;
-    xmlNode *root = NULL;
+    struct rules_reader r = {
+        .ctx = ctx,
+        .reader = NULL,
+        .popularity = popularity,
+        .failed = false,
+    };
 
     if (!check_eaccess(path, R_OK))
         return false;
 
-    LIBXML_TEST_VERSION
+    if (ctx->lazy_details) {
+        r.lazy = lazy_file_new(ctx, path, popularity);
+        if (!r.lazy)
+            return false;
+    }
 
-    xmlParserCtxtPtr xmlCtxt = xmlNewParserCtxt();
-    if (!xmlCtxt)
-        return false;
+    LIBXML_TEST_VERSION
 
-#ifdef XML_PARSE_NO_XXE
-#define _XML_OPTIONS (XML_PARSE_NONET | XML_PARSE_NOENT | XML_PARSE_NO_XXE)
-#else
-#define _XML_OPTIONS (XML_PARSE_NONET)
+#ifndef HAVE_XML_CTXT_SET_ERRORHANDLER
+    /* This is needed for the reader and the DTD validation */
+    xmlSetGenericErrorFunc(ctx, xml_error_func);
 #endif
-    xmlCtxtUseOptions(xmlCtxt, _XML_OPTIONS);
 
+    if (ctx->validate_xml) {
+        /* Full validation requires the whole document: walk its tree */
+        doc = read_and_validate(ctx, path);
+        if (!doc)
+            goto error;
+        r.reader = xmlReaderWalker(doc);
+    } else {
+        /* Build the registry objects while reading the file, checking its
+         * structure on the fly */
+        r.reader = xmlReaderForFile(path, NULL, _XML_OPTIONS);
 #ifdef HAVE_XML_CTXT_SET_ERRORHANDLER
-    /* Prefer contextual handler whenever possible. It takes precedence over
-     * the global generic handler. */
-    xmlCtxtSetErrorHandler(xmlCtxt, xml_structured_error_func, ctx);
-#endif
-#ifndef HAVE_XML_CTXT_PARSE_DTD
-    /* This is needed for the DTD validation */
-    xmlSetGenericErrorFunc(ctx, xml_error_func);
+        if (r.reader)
+            xmlTextReaderSetStructuredErrorHandler(r.reader,
+                                                   xml_structured_error_func,
+                                                   ctx);
 #endif
+    }
+    if (!r.reader)
+        goto error;
 
-    doc = xmlCtxtReadFile(xmlCtxt, path, NULL, 0);
-    if (!doc)
-        goto parse_error;
+    struct parse_checkpoint checkpoint;
+    parse_checkpoint_init(ctx, &checkpoint);
 
-    if (!validate(ctx, doc)) {
+    success = parse_rules_xml(&r) && !r.failed;
+    if (!success) {
         log_err(ctx, XKB_LOG_MESSAGE_NO_ID,
-                "XML error: failed to validate document at %s\n", path);
-        goto validate_error;
+                "XML error: failed to parse document at %s\n", path);
+        parse_checkpoint_restore(ctx, &checkpoint);
+    } else if (r.lazy) {
+        darray_append(ctx->lazy_files, r.lazy);
+        r.lazy = NULL;
     }
 
-    root = xmlDocGetRootElement(doc);
-    parse_rules_xml(ctx, root, popularity);
-
-    success = true;
-validate_error:
+    parse_checkpoint_free(&checkpoint);
+    xmlFreeTextReader(r.reader);
+error:
     xmlFreeDoc(doc);
-parse_error:
+    /* The items of a failed file have been removed */
+    if (r.lazy) {
+        darray_free(r.lazy->items);
+        lazy_file_free(r.lazy);
+    }
 
-#ifndef HAVE_XML_CTXT_PARSE_DTD
+#ifndef HAVE_XML_CTXT_SET_ERRORHANDLER
     /*
      * Reset the default libxml2 error handler to default, because this handler
      * is global and may be used on an invalid rxkb_context, e.g. *after* the
@@ -1517,10 +2580,403 @@ parse_error:
      */
     xmlSetGenericErrorFunc(NULL, NULL);
 #endif
-#ifdef HAVE_XML_CTXT_SET_ERRORHANDLER
-    xmlCtxtSetErrorHandler(xmlCtxt, NULL, NULL);
-#endif
-    xmlFreeParserCtxt(xmlCtxt);
 
     return success;
 }
+
+/*
+ * Binary cache of the registry
+ *
+ * The cache is a native-endian binary file that starts with a header and a key
+ * identifying the ruleset, the context flags and the rules files (path, size
+ * and modification time), followed by the items of the registry. Strings are
+ * stored inline as a 32-bit length (UINT32_MAX for NULL) followed by the bytes
+ * and a terminating NUL.
+ */
+
+#define CACHE_MAGIC "RXKBCACH"
+#define CACHE_VERSION 1
+#define CACHE_BYTE_ORDER UINT32_C(0x01020304)
+#define CACHE_NULL_STRING UINT32_MAX
+
+static void
+cache_write_u32(darray_uchar *buf, uint32_t value)
+{
+    darray_append_items(*buf, (const unsigned char *) &value, sizeof(value));
+}
+
+static void
+cache_write_u64(darray_uchar *buf, uint64_t value)
+{
+    darray_append_items(*buf, (const unsigned char *) &value, sizeof(value));
+}
+
+static void
+cache_write_str(darray_uchar *buf, const char *str)
+{
+    if (!str) {
+        cache_write_u32(buf, CACHE_NULL_STRING);
+        return;
+    }
+    const size_t len = strlen(str);
+    cache_write_u32(buf, (uint32_t) len);
+    darray_append_items(*buf, (const unsigned char *) str,
+                        (darray_size_t) len + 1);
+}
+
+static void
+cache_key_init(struct rxkb_context *ctx, darray_uchar *key,
+               const char *ruleset)
+{
+    cache_write_str(key, ruleset);
+    cache_write_u32(key, ctx->load_extra_rules_files);
+    cache_write_u32(key, ctx->validate_xml);
+}
+
+/* Identify a rules file by its path, size and modification time */
+static void
+cache_key_add_file(darray_uchar *key, const char *path)
+{
+    struct stat st;
+    cache_write_str(key, path);
+    if (stat(path, &st) == 0) {
+        cache_write_u64(key, (uint64_t) st.st_size);
+        cache_write_u64(key, (uint64_t) st.st_mtime);
+    } else {
+        cache_write_u64(key, UINT64_MAX);
+        cache_write_u64(key, UINT64_MAX);
+    }
+}
+
+/* Bounds-checked reader of the cache content */
+struct cache_reader {
+    const unsigned char *pos;
+    const unsigned char *end;
+    bool error;
+};
+
+static bool
+cache_read(struct cache_reader *r, void *out, size_t size)
+{
+    if (r->error || (size_t) (r->end - r->pos) < size) {
+        r->error = true;
+        return false;
+    }
+    memcpy(out, r->pos, size);
+    r->pos += size;
+    return true;
+}
+
+static uint32_t
+cache_read_u32(struct cache_reader *r)
+{
+    uint32_t value = 0;
+    cache_read(r, &value, sizeof(value));
+    return value;
+}
+
+static bool
+cache_read_bool(struct cache_reader *r)
+{
+    return cache_read_u32(r) != 0;
+}
+
+static enum rxkb_popularity
+cache_read_popularity(struct cache_reader *r)
+{
+    const uint32_t value = cache_read_u32(r);
+    if (value != RXKB_POPULARITY_STANDARD && value != RXKB_POPULARITY_EXOTIC)
+        r->error = true;
+    return (enum rxkb_popularity) value;
+}
+
+static char *
+cache_read_str(struct cache_reader *r)
+{
+    const uint32_t len = cache_read_u32(r);
+    if (r->error || len == CACHE_NULL_STRING)
+        return NULL;
+    if ((size_t) (r->end - r->pos) <= len || r->pos[len] != '\0') {
+        r->error = true;
+        return NULL;
+    }
+    char *str = strndup((const char *) r->pos, len);
+    if (!str)
+        r->error = true;
+    r->pos += len + 1;
+    return str;
+}
+
+static void
+cache_write_items(struct rxkb_context *ctx, darray_uchar *buf)
+{
+    struct rxkb_model *m;
+    struct rxkb_layout *l;
+    struct rxkb_iso639_code *iso639;
+    struct rxkb_iso3166_code *iso3166;
+    struct rxkb_option_group *g;
+    struct rxkb_option *o;
+    uint32_t count;
+
+    count = 0;
+    list_for_each(m, &ctx->models, base.link)
+        count++;
+    cache_write_u32(buf, count);
+    list_for_each(m, &ctx->models, base.link) {
+        cache_write_str(buf, m->name);
+        cache_write_str(buf, m->vendor);
+        cache_write_str(buf, m->description);
+        cache_write_u32(buf, m->popularity);
+    }
+
+    count = 0;
+    list_for_each(l, &ctx->layouts, base.link)
+        count++;
+    cache_write_u32(buf, count);
+    list_for_each(l, &ctx->layouts, base.link) {
+        cache_write_str(buf, l->name);
+        cache_write_str(buf, l->variant);
+        cache_write_str(buf, l->brief);
+        cache_write_str(buf, l->description);
+        cache_write_u32(buf, l->popularity);
+        count = 0;
+        list_for_each(iso639, &l->iso639s, base.link)
+            count++;
+        cache_write_u32(buf, count);
+        list_for_each(iso639, &l->iso639s, base.link)
+            cache_write_str(buf, iso639->code);
+        count = 0;
+        list_for_each(iso3166, &l->iso3166s, base.link)
+            count++;
+        cache_write_u32(buf, count);
+        list_for_each(iso3166, &l->iso3166s, base.link)
+            cache_write_str(buf, iso3166->code);
+    }
+
+    count = 0;
+    list_for_each(g, &ctx->option_groups, base.link)
+        count++;
+    cache_write_u32(buf, count);
+    list_for_each(g, &ctx->option_groups, base.link) {
+        cache_write_str(buf, g->name);
+        cache_write_str(buf, g->description);
+        cache_write_u32(buf, g->popularity);
+        cache_write_u32(buf, g->allow_multiple);
+        count = 0;
+        list_for_each(o, &g->options, base.link)
+            count++;
+        cache_write_u32(buf, count);
+        list_for_each(o, &g->options, base.link) {
+            cache_write_str(buf, o->name);
+            cache_write_str(buf, o->brief);
+            cache_write_str(buf, o->description);
+            cache_write_u32(buf, o->popularity);
+            cache_write_u32(buf, o->layout_specific);
+        }
+    }
+}
+
+/*
+ * Each item uses at least a few bytes: check the counts against the remaining
+ * size, so that a corrupted count cannot lead to a huge loop.
+ */
+static uint32_t
+cache_read_count(struct cache_reader *r)
+{
+    const uint32_t count = cache_read_u32(r);
+    if ((size_t) (r->end - r->pos) / sizeof(uint32_t) < count)
+        r->error = true;
+    return r->error ? 0 : count;
+}
+
+static bool
+cache_read_items(struct rxkb_context *ctx, struct cache_reader *r)
+{
+    uint32_t count;
+
+    count = cache_read_count(r);
+    for (uint32_t i = 0; i < count && !r->error; i++) {
+        struct rxkb_model *m = rxkb_model_create(&ctx->base);
+        if (!m)
+            return false;
+        list_append(&ctx->models, &m->base.link);
+        m->name = cache_read_str(r);
+        m->vendor = cache_read_str(r);
+        m->description = cache_read_str(r);
+        m->popularity = cache_read_popularity(r);
+        if (!m->name)
+            r->error = true;
+    }
+
+    count = cache_read_count(r);
+    for (uint32_t i = 0; i < count && !r->error; i++) {
+        struct rxkb_layout *l = rxkb_layout_create(&ctx->base);
+        if (!l)
+            return false;
+        list_init(&l->iso639s);
+        list_init(&l->iso3166s);
+        list_append(&ctx->layouts, &l->base.link);
+        l->name = cache_read_str(r);
+        l->variant = cache_read_str(r);
+        l->brief = cache_read_str(r);
+        l->description = cache_read_str(r);
+        l->popularity = cache_read_popularity(r);
+        if (!l->name)
+            r->error = true;
+
+        uint32_t codes = cache_read_count(r);
+        for (uint32_t c = 0; c < codes && !r->error; c++) {
+            struct rxkb_iso639_code *code =
+                rxkb_iso639_code_create(&l->base);
+            if (!code)
+                return false;
+            list_append(&l->iso639s, &code->base.link);
+            code->code = cache_read_str(r);
+        }
+        codes = cache_read_count(r);
+        for (uint32_t c = 0; c < codes && !r->error; c++) {
+            struct rxkb_iso3166_code *code =
+                rxkb_iso3166_code_create(&l->base);
+            if (!code)
+                return false;
+            list_append(&l->iso3166s, &code->base.link);
+            code->code = cache_read_str(r);
+        }
+    }
+
+    count = cache_read_count(r);
+    for (uint32_t i = 0; i < count && !r->error; i++) {
+        struct rxkb_option_group *g = rxkb_option_group_create(&ctx->base);
+        if (!g)
+            return false;
+        list_init(&g->options);
+        list_append(&ctx->option_groups, &g->base.link);
+        g->name = cache_read_str(r);
+        g->description = cache_read_str(r);
+        g->popularity = cache_read_popularity(r);
+        g->allow_multiple = cache_read_bool(r);
+        if (!g->name)
+            r->error = true;
+
+        const uint32_t options = cache_read_count(r);
+        for (uint32_t k = 0; k < options && !r->error; k++) {
+            struct rxkb_option *o = rxkb_option_create(&g->base);
+            if (!o)
+                return false;
+            list_append(&g->options, &o->base.link);
+            o->name = cache_read_str(r);
+            o->brief = cache_read_str(r);
+            o->description = cache_read_str(r);
+            o->popularity = cache_read_popularity(r);
+            o->layout_specific = cache_read_bool(r);
+            if (!o->name)
+                r->error = true;
+        }
+    }
+
+    return !r->error && r->pos == r->end;
+}
+
+static bool
+cache_load(struct rxkb_context *ctx, const darray_uchar *key)
+{
+    FILE *file = open_file(ctx->cache_path);
+    if (!file)
+        return false;
+
+    char *data;
+    size_t size;
+    bool success = false;
+    if (!map_file(file, &data, &size))
+        goto out;
+
+    struct cache_reader r = {
+        .pos = (const unsigned char *) data,
+        .end = (const unsigned char *) data + size,
+        .error = false,
+    };
+
+    char magic[sizeof(CACHE_MAGIC) - 1];
+    if (!cache_read(&r, magic, sizeof(magic)) ||
+        memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 ||
+        cache_read_u32(&r) != CACHE_VERSION ||
+        cache_read_u32(&r) != CACHE_BYTE_ORDER)
+        goto unmap;
+
+    /* Check that the cache is up to date */
+    const uint32_t key_size = cache_read_u32(&r);
+    if (r.error || key_size != darray_size(*key) ||
+        (size_t) (r.end - r.pos) < key_size ||
+        memcmp(r.pos, darray_items(*key), key_size) != 0) {
+        log_dbg(ctx, "Outdated registry cache: %s\n", ctx->cache_path);
+        goto unmap;
+    }
+    r.pos += key_size;
+
+    struct parse_checkpoint checkpoint;
+    parse_checkpoint_init(ctx, &checkpoint);
+    success = cache_read_items(ctx, &r);
+    if (success) {
+        log_dbg(ctx, "Loaded registry cache: %s\n", ctx->cache_path);
+    } else {
+        log_warn(ctx, XKB_LOG_MESSAGE_NO_ID,
+                 "Invalid registry cache: %s\n", ctx->cache_path);
+        parse_checkpoint_restore(ctx, &checkpoint);
+    }
+    parse_checkpoint_free(&checkpoint);
+
+unmap:
+    unmap_file(data, size);
+out:
+    fclose(file);
+    return success;
+}
+
+static void
+cache_write(struct rxkb_context *ctx, const darray_uchar *key)
+{
+    darray_uchar buf = darray_new();
+    darray_append_items(buf, (const unsigned char *) CACHE_MAGIC,
+                        sizeof(CACHE_MAGIC) - 1);
+    cache_write_u32(&buf, CACHE_VERSION);
+    cache_write_u32(&buf, CACHE_BYTE_ORDER);
+    cache_write_u32(&buf, darray_size(*key));
+    darray_append_items(buf, darray_items(*key), darray_size(*key));
+    cache_write_items(ctx, &buf);
+
+    /* Write to a temporary file, then rename it to update the cache
+     * atomically */
+    char *tmp = asprintf_safe("%s.XXXXXX", ctx->cache_path);
+    if (!tmp)
+        goto error;
+#ifdef HAVE_MKOSTEMP
+    const int fd = mkostemp(tmp, O_CLOEXEC);
+    FILE *file = (fd >= 0) ? fdopen(fd, "wb") : NULL;
+    if (fd >= 0 && !file)
+        close(fd);
+#else
+    FILE *file = fopen(tmp, "wb");
+#endif
+    if (!file)
+        goto error;
+
+    const bool written =
+        fwrite(darray_items(buf), 1, darray_size(buf), file) ==
+            darray_size(buf);
+    if (fclose(file) != 0 || !written ||
+        rename(tmp, ctx->cache_path) != 0) {
+        remove(tmp);
+        goto error;
+    }
+
+    log_dbg(ctx, "Wrote registry cache: %s\n", ctx->cache_path);
+    free(tmp);
+    darray_free(buf);
+    return;
+
+error:
+    log_warn(ctx, XKB_LOG_MESSAGE_NO_ID,
+             "Failed to write registry cache: %s\n", ctx->cache_path);
+    free(tmp);
+    darray_free(buf);
+}
@@ -10,6 +10,11 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "context.h"
 #include "darray.h"
@@ -143,6 +148,198 @@ scanner_skip_to_eol(struct scanner *s)
     s->pos = new_pos;
 }
 
+/*
+ * Vectorized scanning of runs of ASCII characters of a given class.
+ *
+ * Each helper checks blocks of 16 bytes at once and falls back to a byte loop
+ * for the last block and for targets without SIMD support. Bytes >= 0x80
+ * never belong to a class.
+ */
+#if defined(__SSE2__)
+#define SCANNER_VEC_SIZE 16
+typedef __m128i scanner_vec;
+
+static inline scanner_vec
+scanner_vec_load(const char *p)
+{
+    return _mm_loadu_si128((const __m128i *) p);
+}
+
+static inline scanner_vec
+scanner_vec_eq(scanner_vec v, char ch)
+{
+    return _mm_cmpeq_epi8(v, _mm_set1_epi8(ch));
+}
+
+/* Range [lo, hi] of ASCII characters; relies on signed comparisons */
+static inline scanner_vec
+scanner_vec_range(scanner_vec v, char lo, char hi)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((char) (lo - 1))),
+                         _mm_cmplt_epi8(v, _mm_set1_epi8((char) (hi + 1))));
+}
+
+static inline scanner_vec
+scanner_vec_or(scanner_vec a, scanner_vec b)
+{
+    return _mm_or_si128(a, b);
+}
+
+/* a & ~b */
+static inline scanner_vec
+scanner_vec_and_not(scanner_vec a, scanner_vec b)
+{
+    return _mm_andnot_si128(b, a);
+}
+
+static inline bool
+scanner_vec_all(scanner_vec mask)
+{
+    return _mm_movemask_epi8(mask) == 0xffff;
+}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define SCANNER_VEC_SIZE 16
+typedef uint8x16_t scanner_vec;
+
+static inline scanner_vec
+scanner_vec_load(const char *p)
+{
+    return vld1q_u8((const uint8_t *) p);
+}
+
+static inline scanner_vec
+scanner_vec_eq(scanner_vec v, char ch)
+{
+    return vceqq_u8(v, vdupq_n_u8((uint8_t) ch));
+}
+
+static inline scanner_vec
+scanner_vec_range(scanner_vec v, char lo, char hi)
+{
+    return vandq_u8(vcgeq_u8(v, vdupq_n_u8((uint8_t) lo)),
+                    vcleq_u8(v, vdupq_n_u8((uint8_t) hi)));
+}
+
+static inline scanner_vec
+scanner_vec_or(scanner_vec a, scanner_vec b)
+{
+    return vorrq_u8(a, b);
+}
+
+/* a & ~b */
+static inline scanner_vec
+scanner_vec_and_not(scanner_vec a, scanner_vec b)
+{
+    return vbicq_u8(a, b);
+}
+
+static inline bool
+scanner_vec_all(scanner_vec mask)
+{
+    return vminvq_u8(mask) == 0xff;
+}
+#endif
+
+static inline bool
+is_hspace(char ch)
+{
+    return is_space(ch) && ch != '\n';
+}
+
+static inline bool
+is_ident_char(char ch)
+{
+    return is_alnum(ch) || ch == '_';
+}
+
+#ifdef SCANNER_VEC_SIZE
+static inline scanner_vec
+scanner_vec_is_space(scanner_vec v)
+{
+    return scanner_vec_or(scanner_vec_eq(v, ' '),
+                          scanner_vec_range(v, '\t', '\r'));
+}
+
+static inline scanner_vec
+scanner_vec_is_hspace(scanner_vec v)
+{
+    return scanner_vec_and_not(scanner_vec_is_space(v),
+                               scanner_vec_eq(v, '\n'));
+}
+
+static inline scanner_vec
+scanner_vec_is_ident_char(scanner_vec v)
+{
+    return scanner_vec_or(
+        scanner_vec_or(scanner_vec_range(v, 'a', 'z'),
+                       scanner_vec_range(v, 'A', 'Z')),
+        scanner_vec_or(scanner_vec_range(v, '0', '9'),
+                       scanner_vec_eq(v, '_'))
+    );
+}
+
+static inline scanner_vec
+scanner_vec_is_graph_but(scanner_vec v, char excluded)
+{
+    return scanner_vec_and_not(scanner_vec_range(v, '!', '~'),
+                               scanner_vec_eq(v, excluded));
+}
+
+#define scanner_skip_run(s, vec_mask, is_member) do {                     \
+    while ((s)->len - (s)->pos >= SCANNER_VEC_SIZE) {                     \
+        const scanner_vec v = scanner_vec_load((s)->s + (s)->pos);        \
+        if (!scanner_vec_all(vec_mask))                                   \
+            break;                                                        \
+        (s)->pos += SCANNER_VEC_SIZE;                                     \
+    }                                                                     \
+    while ((s)->pos < (s)->len && is_member((s)->s[(s)->pos]))            \
+        (s)->pos++;                                                       \
+} while (0)
+#else
+#define scanner_skip_run(s, vec_mask, is_member) do {                     \
+    while ((s)->pos < (s)->len && is_member((s)->s[(s)->pos]))            \
+        (s)->pos++;                                                       \
+} while (0)
+#endif
+
+/* Skip a run of white space, including new lines */
+static inline void
+scanner_skip_spaces(struct scanner *s)
+{
+    scanner_skip_run(s, scanner_vec_is_space(v), is_space);
+}
+
+/* Skip a run of white space, stopping at the end of the line */
+static inline void
+scanner_skip_hspaces(struct scanner *s)
+{
+    scanner_skip_run(s, scanner_vec_is_hspace(v), is_hspace);
+}
+
+/* Skip a run of [A-Za-z0-9_] and return its length */
+static inline size_t
+scanner_skip_ident(struct scanner *s)
+{
+    const size_t start = s->pos;
+    scanner_skip_run(s, scanner_vec_is_ident_char(v), is_ident_char);
+    return s->pos - start;
+}
+
+/*
+ * Skip a run of printable ASCII characters other than `excluded` and return
+ * its length
+ */
+static inline size_t
+scanner_skip_graph_but(struct scanner *s, char excluded)
+{
+    const size_t start = s->pos;
+#define is_graph_but_excluded(ch) (is_graph(ch) && (ch) != excluded)
+    scanner_skip_run(s, scanner_vec_is_graph_but(v, excluded),
+                     is_graph_but_excluded);
+#undef is_graph_but_excluded
+    return s->pos - start;
+}
+
 static inline char
 scanner_next(struct scanner *s)
 {
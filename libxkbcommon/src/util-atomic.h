@@ -0,0 +1,62 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <stdbool.h>
+
+/*
+ * Minimal atomic pointer operations, used to publish lazily computed data
+ * of otherwise immutable objects, e.g. the serialization cache of keymaps.
+ *
+ * The data must be fully initialized before it is published with
+ * `atomic_ptr_publish()`; readers get it with `atomic_ptr_load()`.
+ */
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+
+/* Acquire load of *ptr */
+static inline void *
+atomic_ptr_load(void * const *ptr)
+{
+    /* No-op exchange, which is a full barrier */
+    return _InterlockedCompareExchangePointer((void * volatile *) ptr,
+                                              NULL, NULL);
+}
+
+/*
+ * Set *ptr to value if it is NULL, with release semantics.
+ * Returns false if another value was already published.
+ */
+static inline bool
+atomic_ptr_publish(void **ptr, void *value)
+{
+    return _InterlockedCompareExchangePointer((void * volatile *) ptr,
+                                              value, NULL) == NULL;
+}
+#else
+
+/* Acquire load of *ptr */
+static inline void *
+atomic_ptr_load(void * const *ptr)
+{
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Set *ptr to value if it is NULL, with release semantics.
+ * Returns false if another value was already published.
+ */
+static inline bool
+atomic_ptr_publish(void **ptr, void *value)
+{
+    void *expected = NULL;
+    return __atomic_compare_exchange_n(ptr, &expected, value, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+#endif
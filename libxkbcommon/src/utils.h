@@ -257,6 +257,20 @@ one_bit_set(uint32_t x)
     return x && (x & (x - 1)) == 0;
 }
 
+/* FNV-1a (http://www.isthe.com/chongo/tech/comp/fnv/). */
+static inline uint32_t
+hash_buf(const char *string, size_t len)
+{
+    uint32_t hash = UINT32_C(2166136261);
+    for (size_t i = 0; i < (len + 1) / 2; i++) {
+        hash ^= (uint8_t) string[i];
+        hash *= 0x01000193;
+        hash ^= (uint8_t) string[len - 1 - i];
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
 bool
 map_file(FILE *file, char **string_out, size_t *size_out);
 
@@ -1112,19 +1112,10 @@ fail:
     return false;
 }
 
-static bool
-get_names(struct xkb_keymap *keymap, struct x11_atom_interner *interner,
-          xcb_xkb_get_names_cookie_t cookie)
+static void
+unpack_names(xcb_xkb_get_names_reply_t *reply,
+             xcb_xkb_get_names_value_list_t *list)
 {
-    xcb_connection_t *conn = interner->conn;
-    xcb_xkb_get_names_reply_t *reply =
-        xcb_xkb_get_names_reply(conn, cookie, NULL);
-    xcb_xkb_get_names_value_list_t list;
-
-    FAIL_IF_BAD_REPLY(reply, "XkbGetNames");
-
-    FAIL_UNLESS((reply->which & get_names_required) == get_names_required);
-
     xcb_xkb_get_names_value_list_unpack(xcb_xkb_get_names_value_list(reply),
                                         reply->nTypes,
                                         reply->indicators,
@@ -1134,7 +1125,72 @@ get_names(struct xkb_keymap *keymap, struct x11_atom_interner *interner,
                                         reply->nKeyAliases,
                                         reply->nRadioGroups,
                                         reply->which,
-                                        &list);
+                                        list);
+}
+
+/*
+ * Send the GetAtomName requests for the atoms of the names reply right away,
+ * so that their round trip overlaps with the processing of the other replies.
+ */
+static void
+prefetch_names_atoms(struct x11_atom_interner *interner,
+                     xcb_xkb_get_names_reply_t *reply)
+{
+    if ((reply->which & get_names_required) != get_names_required)
+        return;
+
+    xcb_xkb_get_names_value_list_t list;
+    unpack_names(reply, &list);
+
+    x11_atom_interner_prefetch_atom(interner, list.keycodesName);
+    x11_atom_interner_prefetch_atom(interner, list.symbolsName);
+    x11_atom_interner_prefetch_atom(interner, list.typesName);
+    x11_atom_interner_prefetch_atom(interner, list.compatName);
+
+    const xcb_atom_t *atoms;
+    int length;
+
+    atoms = xcb_xkb_get_names_value_list_type_names(&list);
+    length = xcb_xkb_get_names_value_list_type_names_length(reply, &list);
+    for (int i = 0; i < length; i++)
+        x11_atom_interner_prefetch_atom(interner, atoms[i]);
+
+    atoms = xcb_xkb_get_names_value_list_kt_level_names(&list);
+    length = xcb_xkb_get_names_value_list_kt_level_names_length(reply, &list);
+    for (int i = 0; i < length; i++)
+        x11_atom_interner_prefetch_atom(interner, atoms[i]);
+
+    atoms = xcb_xkb_get_names_value_list_indicator_names(&list);
+    length = xcb_xkb_get_names_value_list_indicator_names_length(reply, &list);
+    for (int i = 0; i < length; i++)
+        x11_atom_interner_prefetch_atom(interner, atoms[i]);
+
+    atoms = xcb_xkb_get_names_value_list_virtual_mod_names(&list);
+    length = xcb_xkb_get_names_value_list_virtual_mod_names_length(reply, &list);
+    for (int i = 0; i < length; i++)
+        x11_atom_interner_prefetch_atom(interner, atoms[i]);
+
+    atoms = xcb_xkb_get_names_value_list_groups(&list);
+    length = xcb_xkb_get_names_value_list_groups_length(reply, &list);
+    for (int i = 0; i < length; i++)
+        x11_atom_interner_prefetch_atom(interner, atoms[i]);
+
+    /* Send the requests now */
+    xcb_flush(interner->conn);
+}
+
+static bool
+get_names(struct xkb_keymap *keymap, struct x11_atom_interner *interner,
+          xcb_xkb_get_names_reply_t *reply)
+{
+    xcb_connection_t *conn = interner->conn;
+    xcb_xkb_get_names_value_list_t list;
+
+    FAIL_IF_BAD_REPLY(reply, "XkbGetNames");
+
+    FAIL_UNLESS((reply->which & get_names_required) == get_names_required);
+
+    unpack_names(reply, &list);
 
     x11_atom_interner_get_escaped_atom_name(interner, list.keycodesName,
                                             &keymap->keycodes_section_name);
@@ -1152,11 +1208,9 @@ get_names(struct xkb_keymap *keymap, struct x11_atom_interner *interner,
         !get_aliases(keymap, conn, reply, &list))
         goto fail;
 
-    free(reply);
     return true;
 
 fail:
-    free(reply);
     return false;
 }
 
@@ -1186,77 +1240,225 @@ fail:
     return false;
 }
 
-struct xkb_keymap *
-xkb_x11_keymap_new_from_device(struct xkb_context *ctx,
-                               xcb_connection_t *conn,
-                               int32_t device_id,
-                               enum xkb_keymap_compile_flags flags)
-{
-    struct xkb_keymap *keymap;
-    const enum xkb_keymap_format format = XKB_KEYMAP_FORMAT_TEXT_V1;
+/* Cookies of the requests needed to build a keymap */
+struct x11_keymap_cookies {
+    xcb_xkb_get_map_cookie_t map;
+    xcb_xkb_get_indicator_map_cookie_t indicator_map;
+    xcb_xkb_get_compat_map_cookie_t compat_map;
+    xcb_xkb_get_names_cookie_t names;
+    xcb_xkb_get_controls_cookie_t controls;
+};
 
+static bool
+check_keymap_args(struct xkb_context *ctx, int32_t device_id,
+                  enum xkb_keymap_compile_flags flags, const char *func)
+{
     if (flags & ~(XKB_KEYMAP_COMPILE_NO_FLAGS)) {
-        log_err_func(ctx, XKB_LOG_MESSAGE_NO_ID,
-                     "unrecognized flags: %#x\n", flags);
-        return NULL;
+        log_err(ctx, XKB_LOG_MESSAGE_NO_ID,
+                "%s: unrecognized flags: %#x\n", func, flags);
+        return false;
     }
 
     if (device_id < 0 || device_id > 127) {
-        log_err_func(ctx, XKB_LOG_MESSAGE_NO_ID,
-                     "illegal device ID: %"PRId32"\n", device_id);
-        return NULL;
+        log_err(ctx, XKB_LOG_MESSAGE_NO_ID,
+                "%s: illegal device ID: %"PRId32"\n", func, device_id);
+        return false;
     }
 
-    keymap = xkb_keymap_new(ctx, format, flags);
-    if (!keymap)
-        return NULL;
-
-    struct x11_atom_interner interner;
-    x11_atom_interner_init(&interner, ctx, conn);
+    return true;
+}
 
-    /*
-     * Send all requests together so only one roundtrip is needed
-     * to get the replies.
-     */
-    xcb_xkb_get_map_cookie_t map_cookie =
+/*
+ * Send all requests together so only one roundtrip is needed
+ * to get the replies.
+ */
+static void
+send_keymap_requests(xcb_connection_t *conn, uint16_t device_id,
+                     struct x11_keymap_cookies *cookies)
+{
+    cookies->map =
         xcb_xkb_get_map(conn, device_id, get_map_required_components,
                         0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
-    xcb_xkb_get_indicator_map_cookie_t indicator_map_cookie =
+    cookies->indicator_map =
         xcb_xkb_get_indicator_map(conn, device_id, ALL_INDICATORS_MASK);
-    xcb_xkb_get_compat_map_cookie_t compat_map_cookie =
+    cookies->compat_map =
         xcb_xkb_get_compat_map(conn, device_id, 0, true, 0, 0);
-    xcb_xkb_get_names_cookie_t names_cookie =
+    cookies->names =
         xcb_xkb_get_names(conn, device_id, get_names_wanted);
-    xcb_xkb_get_controls_cookie_t controls_cookie =
+    cookies->controls =
         xcb_xkb_get_controls(conn, device_id);
+}
+
+static void
+discard_keymap_replies(xcb_connection_t *conn,
+                       const struct x11_keymap_cookies *cookies)
+{
+    xcb_discard_reply(conn, cookies->map.sequence);
+    xcb_discard_reply(conn, cookies->indicator_map.sequence);
+    xcb_discard_reply(conn, cookies->compat_map.sequence);
+    xcb_discard_reply(conn, cookies->names.sequence);
+    xcb_discard_reply(conn, cookies->controls.sequence);
+}
+
+static struct xkb_keymap *
+receive_keymap(struct xkb_context *ctx, xcb_connection_t *conn,
+               enum xkb_keymap_compile_flags flags,
+               const struct x11_keymap_cookies *cookies)
+{
+    const enum xkb_keymap_format format = XKB_KEYMAP_FORMAT_TEXT_V1;
+    struct xkb_keymap *keymap = xkb_keymap_new(ctx, format, flags);
+    if (!keymap) {
+        discard_keymap_replies(conn, cookies);
+        return NULL;
+    }
 
-    if (!get_map(keymap, conn, map_cookie))
+    struct x11_atom_interner interner;
+    x11_atom_interner_init(&interner, ctx, conn);
+
+    /*
+     * The names of the atoms of the names reply require a second round trip.
+     * Request them as soon as that reply arrives, so that they are fetched
+     * while the other replies are processed. The atoms already in the cache of
+     * the context are not requested, so if all of them are cached then there
+     * is no second round trip.
+     */
+    xcb_xkb_get_names_reply_t *names_reply =
+        xcb_xkb_get_names_reply(conn, cookies->names, NULL);
+    if (names_reply)
+        prefetch_names_atoms(&interner, names_reply);
+
+    if (!get_map(keymap, conn, cookies->map))
         goto err_map;
-    if (!get_indicator_map(keymap, conn, indicator_map_cookie))
+    if (!get_indicator_map(keymap, conn, cookies->indicator_map))
         goto err_indicator_map;
-    if (!get_compat_map(keymap, conn, compat_map_cookie))
-        goto err_compat_map;
-    if (!get_names(keymap, &interner, names_cookie))
+    if (!get_compat_map(keymap, conn, cookies->compat_map))
+        goto err_names;
+    if (!get_names(keymap, &interner, names_reply))
         goto err_names;
-    if (!get_controls(keymap, conn, controls_cookie))
+    if (!get_controls(keymap, conn, cookies->controls))
         goto err_controls;
     x11_atom_interner_round_trip(&interner);
     if (interner.had_error)
         goto err_interner;
 
+    free(names_reply);
     return keymap;
 
 err_map:
-    xcb_discard_reply(conn, indicator_map_cookie.sequence);
+    xcb_discard_reply(conn, cookies->indicator_map.sequence);
 err_indicator_map:
-    xcb_discard_reply(conn, compat_map_cookie.sequence);
-err_compat_map:
-    xcb_discard_reply(conn, names_cookie.sequence);
+    xcb_discard_reply(conn, cookies->compat_map.sequence);
 err_names:
-    xcb_discard_reply(conn, controls_cookie.sequence);
+    xcb_discard_reply(conn, cookies->controls.sequence);
 err_controls:
     x11_atom_interner_round_trip(&interner);
 err_interner:
+    free(names_reply);
     xkb_keymap_unref(keymap);
     return NULL;
 }
+
+struct xkb_keymap *
+xkb_x11_keymap_new_from_device(struct xkb_context *ctx,
+                               xcb_connection_t *conn,
+                               int32_t device_id,
+                               enum xkb_keymap_compile_flags flags)
+{
+    if (!check_keymap_args(ctx, device_id, flags, __func__))
+        return NULL;
+
+    struct x11_keymap_cookies cookies;
+    send_keymap_requests(conn, (uint16_t) device_id, &cookies);
+    return receive_keymap(ctx, conn, flags, &cookies);
+}
+
+struct xkb_x11_keymap_request {
+    struct xkb_context *ctx;
+    xcb_connection_t *conn;
+    enum xkb_keymap_compile_flags flags;
+    struct x11_keymap_cookies cookies;
+    xcb_xkb_get_state_cookie_t state;
+};
+
+struct xkb_x11_keymap_request *
+xkb_x11_keymap_request(struct xkb_context *ctx,
+                       xcb_connection_t *conn,
+                       int32_t device_id,
+                       enum xkb_keymap_compile_flags flags)
+{
+    if (!check_keymap_args(ctx, device_id, flags, __func__))
+        return NULL;
+
+    struct xkb_x11_keymap_request * const request = calloc(1, sizeof(*request));
+    if (!request) {
+        log_err_func1(ctx, XKB_LOG_MESSAGE_NO_ID,
+                      "failed to allocate the request\n");
+        return NULL;
+    }
+
+    request->ctx = xkb_context_ref(ctx);
+    request->conn = conn;
+    request->flags = flags;
+    send_keymap_requests(conn, (uint16_t) device_id, &request->cookies);
+    request->state = xcb_xkb_get_state(conn, (uint16_t) device_id);
+
+    /* Do not wait for the first reply to send the requests */
+    xcb_flush(conn);
+
+    return request;
+}
+
+static void
+free_request(struct xkb_x11_keymap_request *request)
+{
+    xkb_context_unref(request->ctx);
+    free(request);
+}
+
+struct xkb_keymap *
+xkb_x11_keymap_finish(struct xkb_x11_keymap_request *request,
+                      struct xkb_state **state_out)
+{
+    if (state_out)
+        *state_out = NULL;
+
+    xcb_connection_t * const conn = request->conn;
+    struct xkb_keymap * const keymap =
+        receive_keymap(request->ctx, conn, request->flags, &request->cookies);
+
+    if (!keymap || !state_out) {
+        xcb_discard_reply(conn, request->state.sequence);
+        free_request(request);
+        return keymap;
+    }
+
+    xcb_xkb_get_state_reply_t * const reply =
+        xcb_xkb_get_state_reply(conn, request->state, NULL);
+    struct xkb_state * const state = (reply) ? xkb_state_new(keymap) : NULL;
+    if (!state) {
+        log_err_func1(request->ctx, XKB_LOG_MESSAGE_NO_ID,
+                      "x11: failed to get the keyboard state\n");
+        free(reply);
+        free_request(request);
+        xkb_keymap_unref(keymap);
+        return NULL;
+    }
+
+    x11_state_update_from_reply(state, reply);
+    free(reply);
+    free_request(request);
+
+    *state_out = state;
+    return keymap;
+}
+
+void
+xkb_x11_keymap_cancel(struct xkb_x11_keymap_request *request)
+{
+    if (!request)
+        return;
+
+    discard_keymap_replies(request->conn, &request->cookies);
+    xcb_discard_reply(request->conn, request->state.sequence);
+    free_request(request);
+}
@@ -7,6 +7,19 @@
 
 #include "x11-priv.h"
 
+void
+x11_state_update_from_reply(struct xkb_state *state,
+                            const xcb_xkb_get_state_reply_t *reply)
+{
+    xkb_state_update_mask(state,
+                          reply->baseMods,
+                          reply->latchedMods,
+                          reply->lockedMods,
+                          reply->baseGroup,
+                          reply->latchedGroup,
+                          reply->lockedGroup);
+}
+
 static bool
 update_initial_state(struct xkb_state *state, xcb_connection_t *conn,
                      uint16_t device_id)
@@ -19,13 +32,7 @@ update_initial_state(struct xkb_state *state, xcb_connection_t *conn,
     if (!reply)
         return false;
 
-    xkb_state_update_mask(state,
-                          reply->baseMods,
-                          reply->latchedMods,
-                          reply->lockedMods,
-                          reply->baseGroup,
-                          reply->latchedGroup,
-                          reply->lockedGroup);
+    x11_state_update_from_reply(state, reply);
 
     free(reply);
     return true;
@@ -5,6 +5,8 @@
 
 #include "config.h"
 
+#include <sys/stat.h>
+
 #include "x11-priv.h"
 
 int
@@ -106,33 +108,233 @@ xkb_x11_get_core_keyboard_device_id(xcb_connection_t *conn)
     return device_id;
 }
 
+/*
+ * Cache of the X atoms names, shared by all the keymaps of a context.
+ *
+ * This is an open-addressing hash table with linear probing, keyed by the
+ * generation of the XCB connection and the X atom. X11 atoms are actually not
+ * per connection or client, but per X server session. But better be safe just
+ * in case we survive an X server restart.
+ *
+ * A generation identifies a connection for the lifetime of the cache: a new
+ * connection allocated at the address of a closed one gets a new generation,
+ * and the entries of the former connection are evicted. Only the most recently
+ * used connections are tracked, so that the table does not grow without bound.
+ *
+ * It is a single allocation, so that the context can free() it without
+ * knowing its layout.
+ */
+#define X11_ATOM_CACHE_MAX_CONNECTIONS 4
+
 struct x11_atom_cache {
-    /*
-     * Invalidate the cache based on the XCB connection.
-     * X11 atoms are actually not per connection or client, but per X server
-     * session. But better be safe just in case we survive an X server restart.
-     */
-    xcb_connection_t *conn;
-    struct {
+    /* Number of slots; always a power of 2 */
+    uint32_t size;
+    /* Number of used slots */
+    uint32_t count;
+    /* Last generation assigned */
+    uint32_t generation;
+    /* Counter to find the least recently used connection */
+    uint32_t clock;
+    struct x11_atom_cache_conn {
+        const xcb_connection_t *conn;
+        /* Socket of the connection, which is unique while it is open */
+        dev_t dev;
+        ino_t ino;
+        /* 0 for an unused slot */
+        uint32_t generation;
+        uint32_t last_used;
+    } conns[X11_ATOM_CACHE_MAX_CONNECTIONS];
+    struct x11_atom_cache_entry {
+        uint32_t generation;
+        /* XCB_ATOM_NONE for an empty slot */
         xcb_atom_t from;
         xkb_atom_t to;
-    } cache[256];
-    size_t len;
+    } entries[];
 };
 
+#define X11_ATOM_CACHE_INITIAL_SIZE 256u
+
+static inline uint32_t
+atom_cache_hash(uint32_t generation, xcb_atom_t atom)
+{
+    /* Fibonacci hashing; atoms are mostly small consecutive integers */
+    const uint64_t key = ((uint64_t) generation << 32) | atom;
+    return (uint32_t) ((key * UINT64_C(0x9E3779B97F4A7C15)) >> 32);
+}
+
 static struct x11_atom_cache *
-get_cache(struct xkb_context *ctx, xcb_connection_t *conn)
+atom_cache_new(uint32_t size)
 {
-    if (!ctx->x11_atom_cache) {
-        ctx->x11_atom_cache = calloc(1, sizeof(struct x11_atom_cache));
-    }
+    struct x11_atom_cache * const cache =
+        calloc(1, sizeof(*cache) + size * sizeof(cache->entries[0]));
+    if (cache)
+        cache->size = size;
+    return cache;
+}
+
+static struct x11_atom_cache_entry *
+atom_cache_slot(struct x11_atom_cache *cache,
+                uint32_t generation, xcb_atom_t atom)
+{
+    const uint32_t mask = cache->size - 1;
+    uint32_t idx = atom_cache_hash(generation, atom) & mask;
+    /* The table is never full, so this always terminates */
+    while (cache->entries[idx].from != XCB_ATOM_NONE &&
+           (cache->entries[idx].from != atom ||
+            cache->entries[idx].generation != generation))
+        idx = (idx + 1) & mask;
+    return &cache->entries[idx];
+}
+
+static struct x11_atom_cache *
+get_cache(struct xkb_context *ctx)
+{
+    if (!ctx->x11_atom_cache)
+        ctx->x11_atom_cache = atom_cache_new(X11_ATOM_CACHE_INITIAL_SIZE);
     /* Can be NULL in case the malloc failed. */
+    return ctx->x11_atom_cache;
+}
+
+/*
+ * Copy the entries to a new table of the given size, except those of the
+ * given generation. Returns NULL on allocation failure.
+ */
+static struct x11_atom_cache *
+atom_cache_rehash(const struct x11_atom_cache *cache, uint32_t size,
+                  uint32_t evicted)
+{
+    struct x11_atom_cache * const copy = atom_cache_new(size);
+    if (!copy)
+        return NULL;
+    copy->generation = cache->generation;
+    copy->clock = cache->clock;
+    memcpy(copy->conns, cache->conns, sizeof(cache->conns));
+    for (uint32_t i = 0; i < cache->size; i++) {
+        const struct x11_atom_cache_entry *entry = &cache->entries[i];
+        if (entry->from == XCB_ATOM_NONE || entry->generation == evicted)
+            continue;
+        *atom_cache_slot(copy, entry->generation, entry->from) = *entry;
+        copy->count++;
+    }
+    return copy;
+}
+
+static void
+atom_cache_evict(struct xkb_context *ctx, uint32_t generation)
+{
+    struct x11_atom_cache * const cache = ctx->x11_atom_cache;
+    struct x11_atom_cache * const copy =
+        atom_cache_rehash(cache, cache->size, generation);
+    if (copy) {
+        free(cache);
+        ctx->x11_atom_cache = copy;
+    } else {
+        /* Drop all the entries and connections on allocation failure */
+        memset(cache->conns, 0, sizeof(cache->conns));
+        memset(cache->entries, 0, cache->size * sizeof(cache->entries[0]));
+        cache->count = 0;
+    }
+}
+
+/* Get the generation of a connection; 0 if the cache is not available */
+static uint32_t
+atom_cache_connection(struct xkb_context *ctx, xcb_connection_t *conn)
+{
+    struct x11_atom_cache *cache = get_cache(ctx);
+    if (!cache)
+        return 0;
+
+    /* fstat() may fail, e.g. if the connection is in an error state */
+    struct stat st = { 0 };
+    (void) fstat(xcb_get_file_descriptor(conn), &st);
+
+    /* Find the connection, else its slot: unused or least recently used */
+    struct x11_atom_cache_conn *slot = &cache->conns[0];
+    for (size_t i = 0; i < ARRAY_SIZE(cache->conns); i++) {
+        struct x11_atom_cache_conn * const c = &cache->conns[i];
+        if (c->generation && c->conn == conn) {
+            slot = c;
+            break;
+        }
+        if (slot->generation &&
+            (!c->generation || c->last_used < slot->last_used))
+            slot = c;
+    }
+
+    if (slot->generation) {
+        if (slot->conn == conn && slot->dev == st.st_dev &&
+            slot->ino == st.st_ino) {
+            slot->last_used = ++cache->clock;
+            return slot->generation;
+        }
+        /* Other connection, or new connection at the address of a former one */
+        const size_t idx = (size_t) (slot - cache->conns);
+        atom_cache_evict(ctx, slot->generation);
+        cache = ctx->x11_atom_cache;
+        slot = &cache->conns[idx];
+    }
+
+    if (++cache->generation == 0)
+        cache->generation = 1;
+    slot->conn = conn;
+    slot->dev = st.st_dev;
+    slot->ino = st.st_ino;
+    slot->generation = cache->generation;
+    slot->last_used = ++cache->clock;
+    return slot->generation;
+}
+
+static bool
+atom_cache_lookup(struct xkb_context *ctx, uint32_t generation,
+                  xcb_atom_t atom, xkb_atom_t *out)
+{
+    struct x11_atom_cache * const cache = ctx->x11_atom_cache;
+    if (!cache || !generation)
+        return false;
+    const struct x11_atom_cache_entry * const entry =
+        atom_cache_slot(cache, generation, atom);
+    if (entry->from == XCB_ATOM_NONE)
+        return false;
+    *out = entry->to;
+    return true;
+}
+
+static void
+atom_cache_insert(struct xkb_context *ctx, uint32_t generation,
+                  xcb_atom_t from, xkb_atom_t to)
+{
     struct x11_atom_cache *cache = ctx->x11_atom_cache;
-    if (cache && cache->conn != conn) {
-        cache->conn = conn;
-        cache->len = 0;
+    if (!cache || !generation)
+        return;
+
+    /* Keep the load factor below 1/2 */
+    if ((cache->count + 1) * 2 > cache->size) {
+        if (cache->size > UINT32_MAX / 2)
+            return;
+        struct x11_atom_cache * const grown =
+            atom_cache_rehash(cache, cache->size * 2, 0);
+        /* Keep the current cache on allocation failure */
+        if (!grown)
+            return;
+        free(cache);
+        ctx->x11_atom_cache = cache = grown;
     }
-    return cache;
+
+    struct x11_atom_cache_entry * const entry =
+        atom_cache_slot(cache, generation, from);
+    if (entry->from == XCB_ATOM_NONE) {
+        entry->generation = generation;
+        entry->from = from;
+        cache->count++;
+    }
+    entry->to = to;
+}
+
+static char *
+atom_text_copy(struct xkb_context *ctx, xkb_atom_t atom)
+{
+    const char * const text = xkb_atom_text(ctx, atom);
+    return (text ? strdup(text) : NULL);
 }
 
 void
@@ -142,6 +344,7 @@ x11_atom_interner_init(struct x11_atom_interner *interner,
     interner->had_error = false;
     interner->ctx = ctx;
     interner->conn = conn;
+    interner->cache_generation = atom_cache_connection(ctx, conn);
     interner->num_pending = 0;
     interner->num_copies = 0;
     interner->num_escaped = 0;
@@ -156,24 +359,21 @@ x11_atom_interner_adopt_atom(struct x11_atom_interner *interner,
     if (atom == XCB_ATOM_NONE)
         return;
 
-    /* Can be NULL in case the malloc failed. */
-    struct x11_atom_cache *cache = get_cache(interner->ctx, interner->conn);
-
 retry:
 
     /* Already in the cache? */
-    if (cache) {
-        for (size_t c = 0; c < cache->len; c++) {
-            if (cache->cache[c].from == atom) {
-                *out = cache->cache[c].to;
-                return;
-            }
-        }
-    }
+    if (atom_cache_lookup(interner->ctx, interner->cache_generation,
+                          atom, out))
+        return;
 
     /* Already pending? */
     for (size_t i = 0; i < interner->num_pending; i++) {
         if (interner->pending[i].from == atom) {
+            if (!interner->pending[i].out) {
+                /* Prefetched atom */
+                interner->pending[i].out = out;
+                return;
+            }
             if (interner->num_copies == ARRAY_SIZE(interner->copies)) {
                 x11_atom_interner_round_trip(interner);
                 goto retry;
@@ -197,13 +397,35 @@ retry:
     interner->pending[idx].cookie = xcb_get_atom_name(interner->conn, atom);
 }
 
+void
+x11_atom_interner_prefetch_atom(struct x11_atom_interner *interner,
+                                const xcb_atom_t atom)
+{
+    if (atom == XCB_ATOM_NONE ||
+        interner->num_pending == ARRAY_SIZE(interner->pending))
+        return;
+
+    xkb_atom_t cached;
+    if (atom_cache_lookup(interner->ctx, interner->cache_generation,
+                          atom, &cached))
+        return;
+
+    for (size_t i = 0; i < interner->num_pending; i++) {
+        if (interner->pending[i].from == atom)
+            return;
+    }
+
+    size_t idx = interner->num_pending++;
+    interner->pending[idx].from = atom;
+    interner->pending[idx].out = NULL;
+    interner->pending[idx].cookie = xcb_get_atom_name(interner->conn, atom);
+}
+
 void
 x11_atom_interner_round_trip(struct x11_atom_interner *interner) {
     struct xkb_context *ctx = interner->ctx;
     xcb_connection_t *conn = interner->conn;
-
-    /* Can be NULL in case the malloc failed. */
-    struct x11_atom_cache *cache = get_cache(ctx, conn);
+    const uint32_t generation = interner->cache_generation;
 
     for (size_t i = 0; i < interner->num_pending; i++) {
         xcb_get_atom_name_reply_t *reply;
@@ -219,13 +441,10 @@ x11_atom_interner_round_trip(struct x11_atom_interner *interner) {
                                           xcb_get_atom_name_name_length(reply));
         free(reply);
 
-        if (cache && cache->len < ARRAY_SIZE(cache->cache)) {
-            size_t idx = cache->len++;
-            cache->cache[idx].from = x11_atom;
-            cache->cache[idx].to = atom;
-        }
+        atom_cache_insert(ctx, generation, x11_atom, atom);
 
-        *interner->pending[i].out = atom;
+        if (interner->pending[i].out)
+            *interner->pending[i].out = atom;
 
         for (size_t j = 0; j < interner->num_copies; j++) {
             if (interner->copies[j].from == x11_atom)
@@ -234,27 +453,33 @@ x11_atom_interner_round_trip(struct x11_atom_interner *interner) {
     }
 
     for (size_t i = 0; i < interner->num_escaped; i++) {
-        xcb_get_atom_name_reply_t *reply;
-        int length;
-        char *name;
         char **out = interner->escaped[i].out;
+        *out = NULL;
 
-        reply = xcb_get_atom_name_reply(conn, interner->escaped[i].cookie, NULL);
-        *interner->escaped[i].out = NULL;
-        if (!reply) {
-            interner->had_error = true;
+        if (interner->escaped[i].pending) {
+            /* Cached above, unless its request failed */
+            xkb_atom_t atom;
+            if (atom_cache_lookup(ctx, generation, interner->escaped[i].from,
+                                  &atom))
+                *out = atom_text_copy(ctx, atom);
         } else {
-            length = xcb_get_atom_name_name_length(reply);
-            name = xcb_get_atom_name_name(reply);
-
-            *out = strndup(name, length);
-            free(reply);
-            if (*out == NULL) {
-                interner->had_error = true;
-            } else {
-                XkbEscapeMapName(*out);
+            xcb_get_atom_name_reply_t *reply =
+                xcb_get_atom_name_reply(conn, interner->escaped[i].cookie,
+                                        NULL);
+            if (reply) {
+                const char *name = xcb_get_atom_name_name(reply);
+                const int length = xcb_get_atom_name_name_length(reply);
+                atom_cache_insert(ctx, generation, interner->escaped[i].from,
+                                  xkb_atom_intern(ctx, name, length));
+                *out = strndup(name, length);
+                free(reply);
             }
         }
+
+        if (*out == NULL)
+            interner->had_error = true;
+        else
+            XkbEscapeMapName(*out);
     }
 
     interner->num_pending = 0;
@@ -270,11 +495,34 @@ x11_atom_interner_get_escaped_atom_name(struct x11_atom_interner *interner,
         *out = NULL;
         return;
     }
+
+    xkb_atom_t cached;
+    if (atom_cache_lookup(interner->ctx, interner->cache_generation,
+                          atom, &cached)) {
+        *out = atom_text_copy(interner->ctx, cached);
+        if (*out == NULL)
+            interner->had_error = true;
+        else
+            XkbEscapeMapName(*out);
+        return;
+    }
+
     size_t idx = interner->num_escaped++;
     /* There can only be a fixed number of calls to this function "in-flight",
      * thus we assert this number. Increase the array size if this assert fails.
      */
     assert(idx < ARRAY_SIZE(interner->escaped));
+    interner->escaped[idx].from = atom;
     interner->escaped[idx].out = out;
+    interner->escaped[idx].pending = false;
+
+    /* Do not request the same atom twice, e.g. if it was prefetched */
+    for (size_t i = 0; i < interner->num_pending; i++) {
+        if (interner->pending[i].from == atom) {
+            interner->escaped[idx].pending = true;
+            return;
+        }
+    }
+
     interner->escaped[idx].cookie = xcb_get_atom_name(interner->conn, atom);
 }
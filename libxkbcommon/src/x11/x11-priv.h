@@ -14,10 +14,13 @@
 struct x11_atom_interner {
     struct xkb_context *ctx;
     xcb_connection_t *conn;
+    /* Generation of the connection in the atom cache of the context */
+    uint32_t cache_generation;
     bool had_error;
     /* Atoms for which we send a GetAtomName request */
     struct {
         xcb_atom_t from;
+        /* NULL if prefetched and not adopted yet */
         xkb_atom_t *out;
         xcb_get_atom_name_cookie_t cookie;
     } pending[128];
@@ -28,9 +31,12 @@ struct x11_atom_interner {
         xkb_atom_t *out;
     } copies[128];
     size_t num_copies;
-    /* These are not interned, but saved directly (after XkbEscapeMapName) */
+    /* These are saved as copies (after XkbEscapeMapName) */
     struct {
         xcb_get_atom_name_cookie_t cookie;
+        xcb_atom_t from;
+        /* Resolved by the pending request of the same atom */
+        bool pending;
         char **out;
     } escaped[4];
     size_t num_escaped;
@@ -52,9 +58,27 @@ x11_atom_interner_adopt_atom(struct x11_atom_interner *interner,
                              const xcb_atom_t atom, xkb_atom_t *out);
 
 /*
- * Get a strdup'd and XkbEscapeMapName'd name of an X atom. The actual write is
- * delayed until the next call to x11_atom_interner_round_trip().
+ * Send a GetAtomName request for an X atom that is neither cached nor
+ * pending, without writing it anywhere yet. This enables to overlap the
+ * requests with the processing of other replies: the next call to
+ * x11_atom_interner_adopt_atom() with this atom will not send a request.
+ */
+void
+x11_atom_interner_prefetch_atom(struct x11_atom_interner *interner,
+                                const xcb_atom_t atom);
+
+/*
+ * Get a strdup'd and XkbEscapeMapName'd name of an X atom. The name is written
+ * immediately if the atom is cached, else the write is delayed until the next
+ * call to x11_atom_interner_round_trip().
  */
 void
 x11_atom_interner_get_escaped_atom_name(struct x11_atom_interner *interner,
                                         xcb_atom_t atom, char **out);
+
+/*
+ * Update a keyboard state from the reply of a GetState request.
+ */
+void
+x11_state_update_from_reply(struct xkb_state *state,
+                            const xcb_xkb_get_state_reply_t *reply);
@@ -93,7 +93,7 @@ enum merge_mode {
 const char *
 xkb_file_type_to_string(enum xkb_file_type type);
 
-const char *
+XKB_EXPORT_PRIVATE const char *
 stmt_type_to_string(enum stmt_type type);
 
 char
@@ -22,13 +22,19 @@
 #include "messages-codes.h"
 #include "xkbcomp-priv.h"
 #include "text.h"
+#include "keysym.h"
 
 #define BUF_CHUNK_SIZE 4096
+/* Size from which the buffer is flushed, when streaming */
+#define BUF_FLUSH_SIZE (4 * BUF_CHUNK_SIZE)
 
 struct buf {
     char *buf;
     size_t size;
     size_t alloc;
+    /* Optional sink: if set, the buffer is flushed to it regularly */
+    xkb_keymap_write_func_t write;
+    void *data;
 };
 
 #define xkb_abs(n) _Generic((n),                \
@@ -36,18 +42,25 @@ struct buf {
                             long int: labs,     \
                             default: llabs )((n))
 
+/* Grow the buffer geometrically, so that at least `at_least` bytes fit */
 static bool
 do_realloc(struct buf *buf, size_t at_least)
 {
-    buf->alloc += BUF_CHUNK_SIZE;
-    if (at_least >= BUF_CHUNK_SIZE)
-        buf->alloc += at_least;
+    size_t alloc = MAX(buf->alloc, BUF_CHUNK_SIZE);
+    while (alloc - buf->size < at_least) {
+        if (alloc > SIZE_MAX / 2)
+            return false;
+        alloc *= 2;
+    }
+    if (alloc == buf->alloc)
+        return true;
 
-    char *const new = realloc(buf->buf, buf->alloc);
+    char *const new = realloc(buf->buf, alloc);
     if (!new)
         return false;
 
     buf->buf = new;
+    buf->alloc = alloc;
     return true;
 }
 
@@ -101,21 +114,61 @@ err:
         return false; \
 } while (0)
 
+/*
+ * Flush the buffer to its sink, if any and if it is large enough or if forced.
+ *
+ * This must be called only between complete statements, because some writers
+ * rewrite the end of the buffer.
+ */
+static bool
+check_flush_buf(struct buf *buf, bool force)
+{
+    if (!buf->write || (buf->size < BUF_FLUSH_SIZE && !force))
+        return true;
+
+    if (buf->size > 0 && !buf->write(buf->buf, buf->size, buf->data)) {
+        free(buf->buf);
+        buf->buf = NULL;
+        return false;
+    }
+
+    buf->size = 0;
+    return true;
+}
+
+#define flush_buf(buf) do { \
+    if (!check_flush_buf(buf, false)) \
+        return false; \
+} while (0)
+
+/*
+ * The following functions are specialized versions of `check_write_buf()`,
+ * for the most common fragments. They avoid the overhead of `vsnprintf()`.
+ */
+
+/* Ensure that `len` bytes, plus the terminating null byte, fit */
+static inline bool
+check_reserve_buf(struct buf *buf, size_t len)
+{
+    if (likely(len < buf->alloc - buf->size))
+        return true;
+
+    if (!do_realloc(buf, len + 1)) {
+        free(buf->buf);
+        buf->buf = NULL;
+        return false;
+    }
+    return true;
+}
+
 static bool
 check_copy_to_buf(struct buf *buf, const char* source, size_t len)
 {
     if (len == 0)
         return true;
 
-    const size_t available = buf->alloc - buf->size;
-    if (len >= available) {
-        /* len + 1 (terminating NULL) */
-        if (!do_realloc(buf, len + 1)) {
-            free(buf->buf);
-            buf->buf = NULL;
-            return false;
-        }
-    }
+    if (!check_reserve_buf(buf, len))
+        return false;
 
     memcpy(buf->buf + buf->size, source, len);
     buf->size += len;
@@ -132,6 +185,224 @@ check_copy_to_buf(struct buf *buf, const char* source, size_t len)
 #define copy_to_buf(buf, source) \
     copy_to_buf_len(buf, source, sizeof(source) - 1)
 
+#define copy_string_to_buf(buf, string) do { \
+    const char *const _s = (string); \
+    copy_to_buf_len(buf, _s, strlen(_s)); \
+} while (0)
+
+/*
+ * Equivalent of the `%*s` format: pad the string with spaces to the given
+ * width, on the left, or on the right if the width is negative.
+ */
+static bool
+check_copy_padded_to_buf(struct buf *buf, int width,
+                         const char *source, size_t len)
+{
+    const size_t abs_width = (size_t) xkb_abs(width);
+    const size_t padding = (abs_width > len) ? abs_width - len : 0;
+    if (!check_reserve_buf(buf, len + padding))
+        return false;
+
+    char *p = buf->buf + buf->size;
+    if (width > 0) {
+        memset(p, ' ', padding);
+        p += padding;
+    }
+    memcpy(p, source, len);
+    p += len;
+    if (width < 0) {
+        memset(p, ' ', padding);
+        p += padding;
+    }
+    *p = '\0';
+    buf->size += len + padding;
+    return true;
+}
+
+#define copy_padded_to_buf(buf, width, string) do { \
+    const char *const _s = (string); \
+    if (!check_copy_padded_to_buf(buf, width, _s, strlen(_s))) \
+        return false; \
+} while (0)
+
+/* Equivalent of the `%"PRIu32` format */
+static bool
+check_write_uint(struct buf *buf, uint32_t value)
+{
+    char digits[10];
+    size_t k = sizeof(digits);
+    do {
+        digits[--k] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value);
+    return check_copy_to_buf(buf, digits + k, sizeof(digits) - k);
+}
+
+#define write_buf_uint(buf, value) do { \
+    if (!check_write_uint(buf, value)) \
+        return false; \
+} while (0)
+
+/* Equivalent of the `0x%"PRIx32` format */
+static bool
+check_write_hex(struct buf *buf, uint32_t value)
+{
+    static const char hex_digits[] = "0123456789abcdef";
+    char digits[2 + 8];
+    size_t k = sizeof(digits);
+    do {
+        digits[--k] = hex_digits[value & 0xf];
+        value >>= 4;
+    } while (value);
+    digits[--k] = 'x';
+    digits[--k] = '0';
+    return check_copy_to_buf(buf, digits + k, sizeof(digits) - k);
+}
+
+#define write_buf_hex(buf, value) do { \
+    if (!check_write_hex(buf, value)) \
+        return false; \
+} while (0)
+
+/* Equivalent of `KeyNameText()` with the `%*s` format */
+static bool
+check_write_key_name(struct buf *buf, struct xkb_context *ctx, int width,
+                     xkb_atom_t name)
+{
+    const char *const text = strempty(xkb_atom_text(ctx, name));
+    const size_t len = strlen(text);
+    const size_t abs_width = (size_t) xkb_abs(width);
+    const size_t padding = (abs_width > len + 2) ? abs_width - len - 2 : 0;
+    if (!check_reserve_buf(buf, len + 2 + padding))
+        return false;
+
+    char *p = buf->buf + buf->size;
+    if (width > 0) {
+        memset(p, ' ', padding);
+        p += padding;
+    }
+    *p++ = '<';
+    memcpy(p, text, len);
+    p += len;
+    *p++ = '>';
+    if (width < 0) {
+        memset(p, ' ', padding);
+        p += padding;
+    }
+    *p = '\0';
+    buf->size += len + 2 + padding;
+    return true;
+}
+
+#define write_buf_key_name(buf, ctx, width, name) do { \
+    if (!check_write_key_name(buf, ctx, width, name)) \
+        return false; \
+} while (0)
+
+/* Equivalent of `KeysymText()` with the `%*s` format */
+static bool
+check_write_keysym(struct buf *buf, int width, xkb_keysym_t keysym)
+{
+    const char *name = xkb_keysym_get_explicit_name(keysym);
+    if (name)
+        return check_copy_padded_to_buf(buf, width, name, strlen(name));
+
+    /* Unnamed keysym: rare, use the generic path */
+    char buffer[XKB_KEYSYM_NAME_MAX_SIZE];
+    const int len = xkb_keysym_get_name(keysym, buffer, sizeof(buffer));
+    if (len < 0 || (size_t) len >= sizeof(buffer))
+        return check_copy_padded_to_buf(buf, width, "Invalid",
+                                        sizeof("Invalid") - 1);
+    return check_copy_padded_to_buf(buf, width, buffer, (size_t) len);
+}
+
+#define write_buf_keysym(buf, width, keysym) do { \
+    if (!check_write_keysym(buf, width, keysym)) \
+        return false; \
+} while (0)
+
+/* Equivalent of `ModMaskText()` */
+static bool
+check_write_mod_mask(struct buf *buf, struct xkb_context *ctx,
+                     enum mod_type type, const struct xkb_mod_set *mods,
+                     xkb_mod_mask_t mask)
+{
+    /* We want to avoid boolean blindness, but we expected only 2 values */
+    assert(type == MOD_REAL || type == MOD_BOTH);
+
+    if (mask == 0)
+        return check_copy_to_buf(buf, "none", sizeof("none") - 1);
+
+    if (mask == MOD_REAL_MASK_ALL)
+        return check_copy_to_buf(buf, "all", sizeof("all") - 1);
+
+    if ((type == MOD_REAL && (mask & ~MOD_REAL_MASK_ALL)) ||
+        unlikely(mask & ~((UINT64_C(1) << mods->num_mods) - 1))) {
+        /* If we get a mask that cannot be expressed with the known modifiers
+         * of the given type, print it as hexadecimal */
+        return check_write_hex(buf, mask);
+    }
+
+    /* Print known mods */
+    const struct xkb_mod *mod;
+    bool first = true;
+    xkb_mods_mask_foreach(mask, mod, mods) {
+        if (!first && !check_copy_to_buf(buf, "+", 1))
+            return false;
+        const char *const name = xkb_atom_text(ctx, mod->name);
+        if (!check_copy_to_buf(buf, name, strlen(name)))
+            return false;
+        first = false;
+    }
+    return true;
+}
+
+#define write_buf_mod_mask(buf, ctx, type, mods, mask) do { \
+    if (!check_write_mod_mask(buf, ctx, type, mods, mask)) \
+        return false; \
+} while (0)
+
+/* Equivalent of `LedStateMaskText()` and `ControlMaskText()` */
+static bool
+check_write_mask_names(struct buf *buf, const LookupEntry *lookup,
+                       uint32_t mask)
+{
+    bool first = true;
+    for (unsigned int i = 0; mask; i++) {
+        if (!(mask & (1u << i)))
+            continue;
+
+        mask &= ~(1u << i);
+
+        const char* const name = LookupValue(lookup, 1u << i);
+        assert(name != NULL);
+        if (!first && !check_copy_to_buf(buf, "+", 1))
+            return false;
+        if (!check_copy_to_buf(buf, name, strlen(name)))
+            return false;
+        first = false;
+    }
+    return true;
+}
+
+#define write_buf_led_state_mask(buf, lookup, mask) do { \
+    const enum xkb_state_component _mask = (mask); \
+    if (_mask == 0) \
+        copy_to_buf(buf, "0"); \
+    else if (!check_write_mask_names(buf, lookup, _mask)) \
+        return false; \
+} while (0)
+
+#define write_buf_control_mask(buf, mask) do { \
+    const enum xkb_action_controls _mask = (mask); \
+    if (_mask == 0) \
+        copy_to_buf(buf, "none"); \
+    else if (_mask == CONTROL_ALL) \
+        copy_to_buf(buf, "all"); \
+    else if (!check_write_mask_names(buf, ctrlMaskNames, _mask)) \
+        return false; \
+} while (0)
+
 static bool
 check_write_string_literal(struct buf *buf, const char* string)
 {
@@ -217,7 +488,7 @@ write_vmods(struct xkb_keymap *keymap, enum xkb_keymap_format format,
         } else {
             copy_to_buf(buf, ",");
         }
-        write_buf(buf, "%s", xkb_atom_text(keymap->ctx, mod->name));
+        copy_string_to_buf(buf, xkb_atom_text(keymap->ctx, mod->name));
 
         /*
          * Ensure to always honor explicit mappings when auto canonical vmods
@@ -243,9 +514,9 @@ write_vmods(struct xkb_keymap *keymap, enum xkb_keymap_format format,
              * Explicit non-default mapping
              * NOTE: we can only pretty-print *real* modifiers in this context.
              */
-            write_buf(buf, "=%s",
-                      ModMaskText(keymap->ctx, MOD_REAL, &keymap->mods,
-                                  mod->mapping));
+            copy_to_buf(buf, "=");
+            write_buf_mod_mask(buf, keymap->ctx, MOD_REAL, &keymap->mods,
+                               mod->mapping);
         }
     }
 
@@ -272,36 +543,40 @@ write_keycodes(struct xkb_keymap *keymap, bool pretty, struct buf *buf)
      * a maximum of at least 255, else XWayland really starts hating life.
      * If this is a problem and people really need strictly bounded keymaps,
      * we should probably control this with a flag. */
-    write_buf(buf, "\tminimum = %"PRIu32";\n", MIN(keymap->min_key_code, 8));
-    write_buf(buf, "\tmaximum = %"PRIu32";\n", MAX(keymap->max_key_code, 255));
+    copy_to_buf(buf, "\tminimum = ");
+    write_buf_uint(buf, MIN(keymap->min_key_code, 8));
+    copy_to_buf(buf, ";\n\tmaximum = ");
+    write_buf_uint(buf, MAX(keymap->max_key_code, 255));
+    copy_to_buf(buf, ";\n");
 
     xkb_keys_foreach(key, keymap) {
         if (key->name == XKB_ATOM_NONE)
             continue;
 
-        if (pretty)
-            write_buf(buf, "\t%-20s", KeyNameText(keymap->ctx, key->name));
-        else
-            write_buf(buf, "\t%s", KeyNameText(keymap->ctx, key->name));
-        write_buf(buf, " = %"PRIu32";\n", key->keycode);
+        copy_to_buf(buf, "\t");
+        write_buf_key_name(buf, keymap->ctx, (pretty ? -20 : 0), key->name);
+        copy_to_buf(buf, " = ");
+        write_buf_uint(buf, key->keycode);
+        copy_to_buf(buf, ";\n");
+        flush_buf(buf);
     }
 
     xkb_leds_enumerate(idx, led, keymap)
         if (led->name != XKB_ATOM_NONE) {
-            write_buf(buf, "\tindicator %u = ", idx + 1);
+            copy_to_buf(buf, "\tindicator ");
+            write_buf_uint(buf, idx + 1);
+            copy_to_buf(buf, " = ");
             write_buf_string_literal(buf, xkb_atom_text(keymap->ctx, led->name));
             copy_to_buf(buf, ";\n");
         }
 
     for (darray_size_t i = 0; i < keymap->num_key_aliases; i++) {
-        if (pretty)
-            write_buf(buf, "\talias %-14s",
-                      KeyNameText(keymap->ctx, keymap->key_aliases[i].alias));
-        else
-            write_buf(buf, "\talias %s",
-                      KeyNameText(keymap->ctx, keymap->key_aliases[i].alias));
-        write_buf(buf, " = %s;\n",
-                  KeyNameText(keymap->ctx, keymap->key_aliases[i].real));
+        copy_to_buf(buf, "\talias ");
+        write_buf_key_name(buf, keymap->ctx, (pretty ? -14 : 0),
+                           keymap->key_aliases[i].alias);
+        copy_to_buf(buf, " = ");
+        write_buf_key_name(buf, keymap->ctx, 0, keymap->key_aliases[i].real);
+        copy_to_buf(buf, ";\n");
     }
 
     copy_to_buf(buf, "};\n\n");
@@ -330,12 +605,12 @@ write_types(struct xkb_keymap *keymap, enum xkb_keymap_format format,
         write_buf_string_literal(buf, xkb_atom_text(keymap->ctx, type->name));
         copy_to_buf(buf, " {\n");
 
-        write_buf(buf, "\t\tmodifiers= %s;\n",
-                  ModMaskText(keymap->ctx, MOD_BOTH, &keymap->mods,
-                              type->mods.mods));
+        copy_to_buf(buf, "\t\tmodifiers= ");
+        write_buf_mod_mask(buf, keymap->ctx, MOD_BOTH, &keymap->mods,
+                           type->mods.mods);
+        copy_to_buf(buf, ";\n");
 
         for (darray_size_t j = 0; j < type->num_entries; j++) {
-            const char *str;
             const struct xkb_key_type_entry *entry = &type->entries[j];
 
             /*
@@ -345,20 +620,29 @@ write_types(struct xkb_keymap *keymap, enum xkb_keymap_format format,
             if (entry->level == 0 && entry->preserve.mods == 0)
                 continue;
 
-            str = ModMaskText(keymap->ctx, MOD_BOTH, &keymap->mods,
-                              entry->mods.mods);
-            write_buf(buf, "\t\tmap[%s]= %"PRIu32";\n",
-                      str, entry->level + 1);
+            copy_to_buf(buf, "\t\tmap[");
+            write_buf_mod_mask(buf, keymap->ctx, MOD_BOTH, &keymap->mods,
+                               entry->mods.mods);
+            copy_to_buf(buf, "]= ");
+            write_buf_uint(buf, entry->level + 1);
+            copy_to_buf(buf, ";\n");
 
-            if (entry->preserve.mods)
-                write_buf(buf, "\t\tpreserve[%s]= %s;\n",
-                          str, ModMaskText(keymap->ctx, MOD_BOTH, &keymap->mods,
-                                           entry->preserve.mods));
+            if (entry->preserve.mods) {
+                copy_to_buf(buf, "\t\tpreserve[");
+                write_buf_mod_mask(buf, keymap->ctx, MOD_BOTH, &keymap->mods,
+                                   entry->mods.mods);
+                copy_to_buf(buf, "]= ");
+                write_buf_mod_mask(buf, keymap->ctx, MOD_BOTH, &keymap->mods,
+                                   entry->preserve.mods);
+                copy_to_buf(buf, ";\n");
+            }
         }
 
         for (xkb_level_index_t n = 0; n < type->num_level_names; n++)
             if (type->level_names[n]) {
-                write_buf(buf, "\t\tlevel_name[%"PRIu32"]= ", n + 1);
+                copy_to_buf(buf, "\t\tlevel_name[");
+                write_buf_uint(buf, n + 1);
+                copy_to_buf(buf, "]= ");
                 write_buf_string_literal(
                     buf, xkb_atom_text(keymap->ctx, type->level_names[n]));
                 copy_to_buf(buf, ";\n");
@@ -366,6 +650,7 @@ write_types(struct xkb_keymap *keymap, enum xkb_keymap_format format,
 
 
         copy_to_buf(buf, "\t};\n");
+        flush_buf(buf);
     }
 
     copy_to_buf(buf, "};\n\n");
@@ -382,9 +667,10 @@ write_led_map(struct xkb_keymap *keymap, struct buf *buf,
 
     if (led->which_groups) {
         if (led->which_groups != XKB_STATE_LAYOUT_EFFECTIVE) {
-            write_buf(buf, "\t\twhichGroupState= %s;\n",
-                      LedStateMaskText(keymap->ctx, groupComponentMaskNames,
-                                       led->which_groups));
+            copy_to_buf(buf, "\t\twhichGroupState= ");
+            write_buf_led_state_mask(buf, groupComponentMaskNames,
+                                     led->which_groups);
+            copy_to_buf(buf, ";\n");
         }
         write_buf(buf, "\t\tgroups= 0x%02x;\n",
                   led->groups);
@@ -392,18 +678,21 @@ write_led_map(struct xkb_keymap *keymap, struct buf *buf,
 
     if (led->which_mods) {
         if (led->which_mods != XKB_STATE_MODS_EFFECTIVE) {
-            write_buf(buf, "\t\twhichModState= %s;\n",
-                      LedStateMaskText(keymap->ctx, modComponentMaskNames,
-                                       led->which_mods));
+            copy_to_buf(buf, "\t\twhichModState= ");
+            write_buf_led_state_mask(buf, modComponentMaskNames,
+                                     led->which_mods);
+            copy_to_buf(buf, ";\n");
         }
-        write_buf(buf, "\t\tmodifiers= %s;\n",
-                  ModMaskText(keymap->ctx, MOD_BOTH, &keymap->mods,
-                              led->mods.mods));
+        copy_to_buf(buf, "\t\tmodifiers= ");
+        write_buf_mod_mask(buf, keymap->ctx, MOD_BOTH, &keymap->mods,
+                           led->mods.mods);
+        copy_to_buf(buf, ";\n");
     }
 
     if (led->ctrls) {
-        write_buf(buf, "\t\tcontrols= %s;\n",
-                  ControlMaskText(keymap->ctx, led->ctrls));
+        copy_to_buf(buf, "\t\tcontrols= ");
+        write_buf_control_mask(buf, led->ctrls);
+        copy_to_buf(buf, ";\n");
     }
 
     copy_to_buf(buf, "\t};\n");
@@ -450,11 +739,6 @@ write_action(struct xkb_keymap *keymap, enum xkb_keymap_format format,
     case ACTION_TYPE_MOD_SET:
     case ACTION_TYPE_MOD_LATCH:
     case ACTION_TYPE_MOD_LOCK:
-        if (action->mods.flags & ACTION_MODS_LOOKUP_MODMAP)
-            args = "modMapMods";
-        else
-            args = ModMaskText(keymap->ctx, MOD_BOTH, &keymap->mods,
-                               action->mods.mods.mods);
         bool unlockOnPress = (action->mods.flags & ACTION_UNLOCK_ON_PRESS);
         if (unlockOnPress && !isModsUnLockOnPressSupported(format)) {
             log_err(keymap->ctx, XKB_ERROR_INCOMPATIBLE_KEYMAP_TEXT_FORMAT,
@@ -470,7 +754,13 @@ write_action(struct xkb_keymap *keymap, enum xkb_keymap_format format,
                     "in keymap format %d\n", format);
             latchOnPress = false;
         }
-        write_buf(buf, "%s%s(modifiers=%s%s%s%s%s%s)%s", prefix, type, args,
+        write_buf(buf, "%s%s(modifiers=", prefix, type);
+        if (action->mods.flags & ACTION_MODS_LOOKUP_MODMAP)
+            copy_to_buf(buf, "modMapMods");
+        else
+            write_buf_mod_mask(buf, keymap->ctx, MOD_BOTH, &keymap->mods,
+                               action->mods.mods.mods);
+        write_buf(buf, "%s%s%s%s%s)%s",
                   (action->type != ACTION_TYPE_MOD_LOCK && (action->mods.flags & ACTION_LOCK_CLEAR)) ? ",clearLocks" : "",
                   (action->type != ACTION_TYPE_MOD_LOCK && (action->mods.flags & ACTION_LATCH_TO_LOCK)) ? ",latchToLock" : "",
                   (action->type == ACTION_TYPE_MOD_LOCK) ? affect_lock_text(action->mods.flags, false) : "",
@@ -553,8 +843,9 @@ write_action(struct xkb_keymap *keymap, enum xkb_keymap_format format,
 
     case ACTION_TYPE_CTRL_SET:
     case ACTION_TYPE_CTRL_LOCK:
-        write_buf(buf, "%s%s(controls=%s%s)%s", prefix, type,
-                  ControlMaskText(keymap->ctx, action->ctrls.ctrls),
+        write_buf(buf, "%s%s(controls=", prefix, type);
+        write_buf_control_mask(buf, action->ctrls.ctrls);
+        write_buf(buf, "%s)%s",
                   (action->type == ACTION_TYPE_CTRL_LOCK) ? affect_lock_text(action->ctrls.flags, false) : "",
                   suffix);
         break;
@@ -637,13 +928,17 @@ write_actions(struct xkb_keymap *keymap, enum xkb_keymap_format format,
             if (!write_action(keymap, format, max_groups,
                               buf2, &noAction, NULL, NULL))
                 return false;
-            write_buf(buf, "%*s", ACTION_PADDING, buf2->buf);
+            if (!check_copy_padded_to_buf(buf, ACTION_PADDING,
+                                          buf2->buf, buf2->size))
+                return false;
         }
         else if (count == 1) {
             if (!write_action(keymap, format, max_groups,
                               buf2, &(actions[0]), NULL, NULL))
                 return false;
-            write_buf(buf, "%*s", ACTION_PADDING, buf2->buf);
+            if (!check_copy_padded_to_buf(buf, ACTION_PADDING,
+                                          buf2->buf, buf2->size))
+                return false;
         }
         else {
             copy_to_buf(buf2, "{ ");
@@ -660,13 +955,16 @@ write_actions(struct xkb_keymap *keymap, enum xkb_keymap_format format,
                 /* Compute and write padding, then write the action again */
                 const int padding = (int)(old_size + ACTION_PADDING - buf2->size);
                 buf2->size = old_size;
-                write_buf(buf2, "%*s", padding, "");
+                if (!check_copy_padded_to_buf(buf2, padding, "", 0))
+                    return false;
                 if (!write_action(keymap, format, max_groups,
                                   buf2, &(actions[k]), NULL, NULL))
                     return false;
             }
             copy_to_buf(buf2, " }");
-            write_buf(buf, "%*s", ACTION_PADDING, buf2->buf);
+            if (!check_copy_padded_to_buf(buf, ACTION_PADDING,
+                                          buf2->buf, buf2->size))
+                return false;
         }
     }
 
@@ -706,23 +1004,26 @@ write_compat(struct xkb_keymap *keymap, enum xkb_keymap_format format,
         if (!si->required && drop_unused)
             continue;
 
-        if (pretty || !si->sym) {
-            write_buf(buf, "\tinterpret %s+%s(%s) {",
-                      si->sym ? KeysymText(keymap->ctx, si->sym) : "Any",
-                      SIMatchText(si->match),
-                      ModMaskText(keymap->ctx, MOD_BOTH, &keymap->mods, si->mods));
-        } else {
-            write_buf(buf, "\tinterpret 0x%"PRIx32"+%s(%s) {",
-                      si->sym, SIMatchText(si->match),
-                      ModMaskText(keymap->ctx, MOD_BOTH, &keymap->mods, si->mods));
-        }
+        copy_to_buf(buf, "\tinterpret ");
+        if (!si->sym)
+            copy_to_buf(buf, "Any");
+        else if (pretty)
+            write_buf_keysym(buf, 0, si->sym);
+        else
+            write_buf_hex(buf, si->sym);
+        copy_to_buf(buf, "+");
+        copy_string_to_buf(buf, SIMatchText(si->match));
+        copy_to_buf(buf, "(");
+        write_buf_mod_mask(buf, keymap->ctx, MOD_BOTH, &keymap->mods, si->mods);
+        copy_to_buf(buf, ") {");
 
         bool has_explicit_properties = false;
 
         if (si->virtual_mod != XKB_MOD_INVALID) {
-            write_buf(buf, "\n\t\tvirtualModifier= %s;",
-                      ModIndexText(keymap->ctx, &keymap->mods,
-                                   si->virtual_mod));
+            copy_to_buf(buf, "\n\t\tvirtualModifier= ");
+            copy_string_to_buf(buf, ModIndexText(keymap->ctx, &keymap->mods,
+                                                 si->virtual_mod));
+            copy_to_buf(buf, ";");
             has_explicit_properties = true;
         }
 
@@ -767,11 +1068,13 @@ write_compat(struct xkb_keymap *keymap, enum xkb_keymap_format format,
                 return false;
             has_explicit_properties = true;
         }
-        write_buf(buf, (has_explicit_properties
-                        ? "\n\t};\n"
-                        /* Empty interpret is a syntax error in xkbcomp, so
-                         * use a dummy entry */
-                        : "\n\t\taction= NoAction();\n\t};\n"));
+        if (has_explicit_properties)
+            copy_to_buf(buf, "\n\t};\n");
+        else
+            /* Empty interpret is a syntax error in xkbcomp, so
+             * use a dummy entry */
+            copy_to_buf(buf, "\n\t\taction= NoAction();\n\t};\n");
+        flush_buf(buf);
     }
 
     xkb_leds_foreach(led, keymap)
@@ -817,9 +1120,9 @@ write_keysyms(struct xkb_keymap *keymap, struct buf *buf, struct buf *buf2,
 
         if (num_syms == 1) {
             if (pretty || syms[0] == XKB_KEY_NoSymbol)
-                write_buf(buf, "%*s", padding, KeysymText(keymap->ctx, syms[0]));
+                write_buf_keysym(buf, (int) padding, syms[0]);
             else
-                write_buf(buf, "0x%"PRIx32, syms[0]);
+                write_buf_hex(buf, syms[0]);
         } else {
             if (pretty) {
                 buf2->size = 0;
@@ -827,11 +1130,13 @@ write_keysyms(struct xkb_keymap *keymap, struct buf *buf, struct buf *buf2,
                 for (int s = 0; s < num_syms; s++) {
                     if (s != 0)
                         copy_to_buf(buf2, ", ");
-                    write_buf(buf2, "%*s", (show_actions ? padding : 0),
-                              KeysymText(keymap->ctx, syms[s]));
+                    write_buf_keysym(buf2, (show_actions ? (int) padding : 0),
+                                     syms[s]);
                 }
                 copy_to_buf(buf2, " }");
-                write_buf(buf, "%*s", padding, buf2->buf);
+                if (!check_copy_padded_to_buf(buf, (int) padding,
+                                              buf2->buf, buf2->size))
+                    return false;
             } else {
                 copy_to_buf(buf, "{");
                 for (int s = 0; s < num_syms; s++) {
@@ -840,7 +1145,7 @@ write_keysyms(struct xkb_keymap *keymap, struct buf *buf, struct buf *buf2,
                     if (syms[s] == XKB_KEY_NoSymbol)
                         copy_to_buf(buf, "NoSymbol");
                     else
-                        write_buf(buf, "0x%"PRIx32, syms[s]);
+                        write_buf_hex(buf, syms[s]);
                 }
                 copy_to_buf(buf, "}");
             }
@@ -858,10 +1163,9 @@ write_key(struct xkb_keymap *keymap, enum xkb_keymap_format format,
     bool simple = true;
     const xkb_layout_index_t num_groups = MIN(key->num_groups, max_groups);
 
-    if (pretty)
-        write_buf(buf, "\tkey %-20s {", KeyNameText(keymap->ctx, key->name));
-    else
-        write_buf(buf, "\tkey %s {", KeyNameText(keymap->ctx, key->name));
+    copy_to_buf(buf, "\tkey ");
+    write_buf_key_name(buf, keymap->ctx, (pretty ? -20 : 0), key->name);
+    copy_to_buf(buf, " {");
 
     if (key->explicit & EXPLICIT_TYPES) {
         simple = false;
@@ -880,7 +1184,9 @@ write_key(struct xkb_keymap *keymap, enum xkb_keymap_format format,
                     continue;
 
                 const struct xkb_key_type * const type = key->groups[group].type;
-                write_buf(buf, "\n\t\ttype[%"PRIu32"]= ", group + 1);
+                copy_to_buf(buf, "\n\t\ttype[");
+                write_buf_uint(buf, group + 1);
+                copy_to_buf(buf, "]= ");
                 write_buf_string_literal(
                   buf, xkb_atom_text(keymap->ctx, type->name));
                 copy_to_buf(buf, ",");
@@ -888,7 +1194,7 @@ write_key(struct xkb_keymap *keymap, enum xkb_keymap_format format,
         }
         else {
             const struct xkb_key_type * const type = key->groups[0].type;
-            write_buf(buf, "\n\t\ttype= ");
+            copy_to_buf(buf, "\n\t\ttype= ");
             write_buf_string_literal(
                 buf, xkb_atom_text(keymap->ctx, type->name));
             copy_to_buf(buf, ",");
@@ -917,10 +1223,12 @@ write_key(struct xkb_keymap *keymap, enum xkb_keymap_format format,
 
     /* If we show actions, interprets are not going to be used to set this
      * field, so make it explicit. */
-    if ((key->explicit & EXPLICIT_VMODMAP) || (show_actions && key->vmodmap))
-        write_buf(buf, "\n\t\tvirtualMods= %s,",
-                  ModMaskText(keymap->ctx, MOD_BOTH, &keymap->mods,
-                              key->vmodmap));
+    if ((key->explicit & EXPLICIT_VMODMAP) || (show_actions && key->vmodmap)) {
+        copy_to_buf(buf, "\n\t\tvirtualMods= ");
+        write_buf_mod_mask(buf, keymap->ctx, MOD_BOTH, &keymap->mods,
+                           key->vmodmap);
+        copy_to_buf(buf, ",");
+    }
 
     switch (key->out_of_range_group_action) {
     case RANGE_SATURATE:
@@ -956,19 +1264,26 @@ write_key(struct xkb_keymap *keymap, enum xkb_keymap_format format,
                 return false;
             copy_to_buf(buf, " ]");
         }
-        write_buf(buf, "%s", (only_symbols ? " };\n" : "\n\t};\n"));
+        if (only_symbols)
+            copy_to_buf(buf, " };\n");
+        else
+            copy_to_buf(buf, "\n\t};\n");
     }
     else {
         assert(num_groups > 0);
         for (xkb_layout_index_t group = 0; group < num_groups; group++) {
             if (group != 0)
                 copy_to_buf(buf, ",");
-            write_buf(buf, "\n\t\tsymbols[%"PRIu32"]= [ ", group + 1);
+            copy_to_buf(buf, "\n\t\tsymbols[");
+            write_buf_uint(buf, group + 1);
+            copy_to_buf(buf, "]= [ ");
             if (!write_keysyms(keymap, buf, buf2, key, group, pretty, show_actions))
                 return false;
             copy_to_buf(buf, " ]");
             if (show_actions) {
-                write_buf(buf, ",\n\t\tactions[%"PRIu32"]= [ ", group + 1);
+                copy_to_buf(buf, ",\n\t\tactions[");
+                write_buf_uint(buf, group + 1);
+                copy_to_buf(buf, "]= [ ");
                 if (!write_actions(keymap, format, max_groups,
                                    buf, buf2, key, group))
                     return false;
@@ -996,7 +1311,9 @@ write_symbols(struct xkb_keymap *keymap, enum xkb_keymap_format format,
     bool has_group_names = false;
     for (xkb_layout_index_t group = 0; group < num_group_names; group++)
         if (keymap->group_names[group]) {
-            write_buf(buf, "\tname[%"PRIu32"]=", group + 1);
+            copy_to_buf(buf, "\tname[");
+            write_buf_uint(buf, group + 1);
+            copy_to_buf(buf, "]=");
             write_buf_string_literal(
                 buf, xkb_atom_text(keymap->ctx, keymap->group_names[group]));
             copy_to_buf(buf, ";\n");
@@ -1010,7 +1327,8 @@ write_symbols(struct xkb_keymap *keymap, enum xkb_keymap_format format,
     xkb_keys_foreach(key, keymap) {
         /* Skip keys with no explicit values */
         if (key->explicit) {
-            if (!write_key(keymap, format, max_groups, pretty, buf, &buf2, key)) {
+            if (!write_key(keymap, format, max_groups, pretty, buf, &buf2, key) ||
+                !check_flush_buf(buf, false)) {
                 free(buf2.buf);
                 return false;
             }
@@ -1024,12 +1342,15 @@ write_symbols(struct xkb_keymap *keymap, enum xkb_keymap_format format,
         bool had_any = false;
         xkb_keys_foreach(key, keymap) {
             if (key->modmap & (UINT32_C(1) << i)) {
-                if (!had_any)
-                    write_buf(buf, "\tmodifier_map %s { ",
-                              xkb_atom_text(keymap->ctx, mod->name));
-                write_buf(buf, "%s%s",
-                          had_any ? ", " : "",
-                          KeyNameText(keymap->ctx, key->name));
+                if (!had_any) {
+                    copy_to_buf(buf, "\tmodifier_map ");
+                    copy_string_to_buf(buf,
+                                       xkb_atom_text(keymap->ctx, mod->name));
+                    copy_to_buf(buf, " { ");
+                } else {
+                    copy_to_buf(buf, ", ");
+                }
+                write_buf_key_name(buf, keymap->ctx, 0, key->name);
                 had_any = true;
             }
         }
@@ -1041,6 +1362,51 @@ write_symbols(struct xkb_keymap *keymap, enum xkb_keymap_format format,
     return true;
 }
 
+/*
+ * Rough estimate of the size of the serialization, so that the buffer is
+ * allocated once in the common case. The figures are the typical sizes of
+ * the corresponding entries.
+ */
+static size_t
+estimate_keymap_size(const struct xkb_keymap *keymap, bool pretty,
+                     bool drop_unused)
+{
+    /* Sections headers, virtual modifiers, LEDs, etc. */
+    size_t size = 1024;
+
+    size += keymap->num_key_aliases * (pretty ? 32 : 24);
+    for (darray_size_t i = 0; i < keymap->num_types; i++) {
+        if (keymap->types[i].required || !drop_unused)
+            size += 64 + keymap->types[i].num_entries * 40;
+    }
+    for (darray_size_t i = 0; i < keymap->num_sym_interprets; i++) {
+        if (keymap->sym_interprets[i].required || !drop_unused)
+            size += (pretty ? 64 : 56);
+    }
+
+    const unsigned int level_size = (pretty ? SYMBOL_PADDING + 2 : 12);
+    const struct xkb_key *key;
+    xkb_keys_foreach(key, keymap) {
+        if (key->name == XKB_ATOM_NONE)
+            continue;
+        /* Keycode and modifier map */
+        size += (pretty ? 32 : 16);
+        if (!key->explicit)
+            continue;
+        size += (pretty ? 40 : 24);
+        const bool show_actions = (key->explicit & EXPLICIT_INTERP);
+        for (xkb_layout_index_t group = 0; group < key->num_groups; group++) {
+            const xkb_level_index_t num_levels = XkbKeyNumLevels(key, group);
+            size += 24 + num_levels * level_size;
+            if (show_actions)
+                size += 24 + num_levels * (ACTION_PADDING + 2);
+        }
+    }
+
+    /* Some slack, so that a slight underestimate does not double the size */
+    return size + size / 8;
+}
+
 static bool
 write_keymap(struct xkb_keymap *keymap, enum xkb_keymap_format format,
              enum xkb_keymap_serialize_flags flags, struct buf *buf)
@@ -1061,7 +1427,8 @@ write_keymap(struct xkb_keymap *keymap, enum xkb_keymap_format format,
             write_types(keymap, format, drop_unused, buf) &&
             write_compat(keymap, format, max_groups, drop_unused, pretty, buf) &&
             write_symbols(keymap, format, max_groups, pretty, buf) &&
-            check_write_buf(buf, "};\n"));
+            check_write_buf(buf, "};\n") &&
+            check_flush_buf(buf, true));
 }
 
 char *
@@ -1071,6 +1438,11 @@ text_v1_keymap_get_as_string(struct xkb_keymap *keymap,
 {
     struct buf buf = { NULL, 0, 0 };
 
+    const bool pretty = !!(flags & XKB_KEYMAP_SERIALIZE_PRETTY);
+    const bool drop_unused = !(flags & XKB_KEYMAP_SERIALIZE_KEEP_UNUSED);
+    if (!do_realloc(&buf, estimate_keymap_size(keymap, pretty, drop_unused)))
+        return NULL;
+
     if (!write_keymap(keymap, format, flags, &buf)) {
         free(buf.buf);
         return NULL;
@@ -1078,3 +1450,19 @@ text_v1_keymap_get_as_string(struct xkb_keymap *keymap,
 
     return buf.buf;
 }
+
+bool
+text_v1_keymap_write(struct xkb_keymap *keymap, enum xkb_keymap_format format,
+                     enum xkb_keymap_serialize_flags flags,
+                     xkb_keymap_write_func_t write, void *data)
+{
+    struct buf buf = { NULL, 0, 0, write, data };
+
+    /* Large enough for any statement to fit without reallocation */
+    if (!do_realloc(&buf, BUF_FLUSH_SIZE + BUF_CHUNK_SIZE))
+        return false;
+
+    const bool ok = write_keymap(keymap, format, flags, &buf);
+    free(buf.buf);
+    return ok;
+}
@@ -18,6 +18,7 @@
 #include "darray.h"
 #include "keymap.h"
 #include "text.h"
+#include "util-mem.h"
 #include "utils.h"
 #include "xkbcomp-priv.h"
 
@@ -542,6 +543,194 @@ UpdateDerivedKeymapFields(struct xkb_keymap *keymap)
     return true;
 }
 
+/***====================================================================***/
+
+/*
+ * Cache of the keycodes, types and compat sections of the keymaps generated
+ * from RMLVO, e.g. `evdev+aliases(qwerty)`, `complete` and `complete`.
+ * These are usually shared by all the keymaps of a given model, so that only
+ * the symbols section needs to be compiled.
+ *
+ * The result of these sections depends only on their include statements, the
+ * keymap format and the compilation flags.
+ *
+ * The cache is stored in the context, see: xkb_context_compiler_cache_size().
+ */
+
+/* Number of the cached sections, which precede the symbols section */
+#define COMPONENTS_CACHE_NUM_SECTIONS FILE_TYPE_SYMBOLS
+
+/*
+ * Maximum number of cached results per keymap of the keymap cache, e.g. the
+ * key aliases depend on the first layout: `aliases(qwerty)`, `aliases(azerty)`
+ */
+#define COMPONENTS_CACHE_ENTRIES_PER_KEYMAP 4
+
+typedef struct {
+    enum xkb_keymap_format format;
+    enum xkb_keymap_compile_flags flags;
+    char *stmts[COMPONENTS_CACHE_NUM_SECTIONS];
+    /*
+     * Result of the sections; only the fields set by the keycodes, types and
+     * compat compilers are used.
+     */
+    struct xkb_keymap keymap;
+} ComponentsCacheEntry;
+
+typedef struct {
+    /* Most recently used first */
+    darray(ComponentsCacheEntry) entries;
+} ComponentsCache;
+
+/* Copy the fields set by the keycodes, types and compat compilers */
+static bool
+CopyComponents(struct xkb_keymap *dst, const struct xkb_keymap *src)
+{
+    dst->min_key_code = src->min_key_code;
+    dst->max_key_code = src->max_key_code;
+    dst->num_keys_low = src->num_keys_low;
+    /* Only the keycodes and names are set at this stage */
+    dst->keys = memdup(src->keys, src->num_keys, sizeof(*src->keys));
+    if (!dst->keys && src->num_keys)
+        return false;
+    dst->num_keys = src->num_keys;
+
+    dst->key_names = memdup(src->key_names, src->num_key_names,
+                            sizeof(*src->key_names));
+    if (!dst->key_names && src->num_key_names)
+        return false;
+    dst->num_key_names = src->num_key_names;
+
+    if (!copy_types(&dst->types, &dst->num_types, src->types, src->num_types) ||
+        !copy_interprets(&dst->sym_interprets, &dst->num_sym_interprets,
+                         src->sym_interprets, src->num_sym_interprets))
+        return false;
+
+    dst->mods = src->mods;
+    memcpy(dst->leds, src->leds, sizeof(src->leds));
+    dst->num_leds = src->num_leds;
+
+    dst->keycodes_section_name = strdup_safe(src->keycodes_section_name);
+    dst->types_section_name = strdup_safe(src->types_section_name);
+    dst->compat_section_name = strdup_safe(src->compat_section_name);
+    return true;
+}
+
+static void
+ClearComponentsCacheEntry(ComponentsCacheEntry *entry)
+{
+    for (size_t k = 0; k < ARRAY_SIZE(entry->stmts); k++)
+        free(entry->stmts[k]);
+    struct xkb_keymap * const keymap = &entry->keymap;
+    free(keymap->keys);
+    free(keymap->key_names);
+    clear_types(keymap->types, keymap->num_types);
+    clear_interprets(keymap->sym_interprets, keymap->num_sym_interprets);
+    free(keymap->keycodes_section_name);
+    free(keymap->types_section_name);
+    free(keymap->compat_section_name);
+}
+
+static void
+FreeComponentsCache(void *data)
+{
+    ComponentsCache * const cache = data;
+    ComponentsCacheEntry *entry;
+    darray_foreach(entry, cache->entries)
+        ClearComponentsCacheEntry(entry);
+    darray_free(cache->entries);
+    free(cache);
+}
+
+/* Get the cache of the context, or NULL if it is disabled */
+static ComponentsCache *
+GetComponentsCache(struct xkb_context *ctx)
+{
+    if (xkb_context_compiler_cache_size(ctx) == 0)
+        return NULL;
+    if (!ctx->compiler_caches[COMPILER_CACHE_COMPONENTS].data) {
+        ComponentsCache * const cache = calloc(1, sizeof(*cache));
+        if (!cache)
+            return NULL;
+        ctx->compiler_caches[COMPILER_CACHE_COMPONENTS].data = cache;
+        ctx->compiler_caches[COMPILER_CACHE_COMPONENTS].free =
+            FreeComponentsCache;
+    }
+    return ctx->compiler_caches[COMPILER_CACHE_COMPONENTS].data;
+}
+
+/*
+ * Get the include statements of the sections to cache, as generated from
+ * RMLVO, i.e. a single include per section. Returns false if not cacheable.
+ */
+static bool
+GetComponentsStatements(const struct xkb_keymap *keymap, XkbFile * const *files,
+                        const char **stmts)
+{
+    if (keymap->num_groups == 0)
+        return false;
+    for (enum xkb_file_type type = FIRST_KEYMAP_FILE_TYPE;
+         type < COMPONENTS_CACHE_NUM_SECTIONS; type++) {
+        const ParseCommon * const def = (files[type]) ? files[type]->defs : NULL;
+        if (!def || def->type != STMT_INCLUDE || def->next)
+            return false;
+        stmts[type] = ((const IncludeStmt *) def)->stmt;
+        if (!stmts[type])
+            return false;
+    }
+    return true;
+}
+
+static const ComponentsCacheEntry *
+LookupComponentsCache(ComponentsCache *cache, const struct xkb_keymap *keymap,
+                      const char * const *stmts)
+{
+    for (darray_size_t e = 0; e < darray_size(cache->entries); e++) {
+        const ComponentsCacheEntry * const entry = &darray_item(cache->entries, e);
+        if (entry->format != keymap->format || entry->flags != keymap->flags)
+            continue;
+        bool match = true;
+        for (size_t k = 0; k < ARRAY_SIZE(entry->stmts) && match; k++)
+            match = streq(entry->stmts[k], stmts[k]);
+        if (!match)
+            continue;
+        /* Move to front */
+        const ComponentsCacheEntry hit = *entry;
+        memmove(&darray_item(cache->entries, 1), darray_items(cache->entries),
+                e * sizeof(hit));
+        darray_item(cache->entries, 0) = hit;
+        return &darray_item(cache->entries, 0);
+    }
+    return NULL;
+}
+
+/* Add the result of the sections; takes ownership of the statements */
+static void
+AddToComponentsCache(ComponentsCache *cache, struct xkb_context *ctx,
+                     const struct xkb_keymap *keymap, char **stmts)
+{
+    ComponentsCacheEntry entry = {
+        .format = keymap->format,
+        .flags = keymap->flags,
+    };
+    for (size_t k = 0; k < ARRAY_SIZE(entry.stmts); k++)
+        entry.stmts[k] = steal(&stmts[k]);
+    if (!CopyComponents(&entry.keymap, keymap)) {
+        ClearComponentsCacheEntry(&entry);
+        return;
+    }
+
+    /* Evict the least recently used entries */
+    const size_t capacity = (size_t) xkb_context_compiler_cache_size(ctx)
+                          * COMPONENTS_CACHE_ENTRIES_PER_KEYMAP;
+    while (darray_size(cache->entries) >= capacity) {
+        ClearComponentsCacheEntry(&darray_item(cache->entries,
+                                               darray_size(cache->entries) - 1));
+        darray_remove_last(cache->entries);
+    }
+    darray_insert(cache->entries, 0, entry);
+}
+
 typedef bool (*compile_file_fn)(XkbFile *file, struct xkb_keymap *keymap);
 
 static const compile_file_fn compile_file_fns[LAST_KEYMAP_FILE_TYPE + 1] = {
@@ -586,14 +775,43 @@ CompileKeymap(XkbFile *file, struct xkb_keymap *keymap)
         files[file->file_type] = file;
     }
 
+    /* Reuse the cached keycodes, types and compat sections, if possible */
+    const char *stmts[COMPONENTS_CACHE_NUM_SECTIONS] = { NULL };
+    ComponentsCache * const cache =
+        (GetComponentsStatements(keymap, files, stmts))
+            ? GetComponentsCache(ctx)
+            : NULL;
+    /* Copies of the statements, which are stolen by the compilers */
+    char *cache_stmts[COMPONENTS_CACHE_NUM_SECTIONS] = { NULL };
+    bool store = false;
+    type = FIRST_KEYMAP_FILE_TYPE;
+    if (cache) {
+        const ComponentsCacheEntry * const cached =
+            LookupComponentsCache(cache, keymap, stmts);
+        if (cached) {
+            log_dbg(ctx, XKB_LOG_MESSAGE_NO_ID,
+                    "Using the cached keycodes, types and compat sections\n");
+            if (!CopyComponents(keymap, &cached->keymap)) {
+                log_err(ctx, XKB_ERROR_ALLOCATION_ERROR,
+                        "Could not copy the cached sections\n");
+                return false;
+            }
+            type = COMPONENTS_CACHE_NUM_SECTIONS;
+        } else {
+            store = true;
+            for (size_t k = 0; k < ARRAY_SIZE(cache_stmts); k++) {
+                cache_stmts[k] = strdup(stmts[k]);
+                store = store && cache_stmts[k];
+            }
+        }
+    }
+
     /*
      * Compile sections
      *
      * NOTE: Any component is optional.
      */
-    for (type = FIRST_KEYMAP_FILE_TYPE;
-         type <= LAST_KEYMAP_FILE_TYPE;
-         type++) {
+    for (; type <= LAST_KEYMAP_FILE_TYPE; type++) {
         if (files[type] == NULL) {
             log_dbg(ctx, XKB_LOG_MESSAGE_NO_ID,
                     "Component %s not provided in keymap\n",
@@ -610,9 +828,17 @@ CompileKeymap(XkbFile *file, struct xkb_keymap *keymap)
             log_err(ctx, XKB_LOG_MESSAGE_NO_ID,
                     "Failed to compile %s\n",
                     xkb_file_type_to_string(type));
+            for (size_t k = 0; k < ARRAY_SIZE(cache_stmts); k++)
+                free(cache_stmts[k]);
             return false;
         }
+
+        if (store && type + 1 == COMPONENTS_CACHE_NUM_SECTIONS)
+            AddToComponentsCache(cache, ctx, keymap, cache_stmts);
     }
 
+    for (size_t k = 0; k < ARRAY_SIZE(cache_stmts); k++)
+        free(cache_stmts[k]);
+
     return UpdateDerivedKeymapFields(keymap);
 }
@@ -23,5 +23,13 @@ parse(struct xkb_context *ctx, struct scanner *scanner, const char *map);
 bool
 parse_next(struct xkb_context *ctx, struct scanner *scanner, XkbFile **xkb_file);
 
+/* Hand-written parser, see: parser-rd.c */
+XkbFile *
+rd_parse(struct xkb_context *ctx, struct scanner *scanner, const char *map);
+
+bool
+rd_parse_next(struct xkb_context *ctx, struct scanner *scanner,
+              XkbFile **xkb_file);
+
 int
 keyword_to_token(const char *string, size_t len);
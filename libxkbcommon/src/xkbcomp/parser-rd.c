@@ -0,0 +1,1751 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Hand-written recursive-descent parser for the keymap text format.
+ *
+ * It accepts the same language as the Bison grammar in `parser.y` and builds
+ * the same AST, using the same scanner and tokens. The grammar is LL(2): the
+ * ambiguities are resolved with a lookahead of at most two tokens, e.g. to
+ * distinguish `key <A> { … };` from `key.type = …;`.
+ *
+ * Like `parse()`, it returns one map at a time and never reads beyond the end
+ * of a non-composite map, so that the remaining maps can be parsed lazily.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+
+#include "xkbcomp/xkbcomp-priv.h"
+#include "xkbcomp/parser-priv.h"
+#include "xkbcomp/ast-build.h"
+
+struct rd_token {
+    int type;
+    YYSTYPE val;
+    /* Position of the token, used to locate the messages */
+    size_t pos;
+};
+
+struct rd_parser {
+    struct xkb_context *ctx;
+    struct scanner *scanner;
+    /* Lookahead tokens */
+    struct rd_token la[2];
+    unsigned int la_count;
+    size_t last_pos;
+};
+
+struct rd_list {
+    ParseCommon *head;
+    ParseCommon *last;
+};
+
+static const char *
+token_name(int type)
+{
+    switch (type) {
+    case END_OF_FILE: return "end of file";
+    case XKB_KEYMAP: return "xkb_keymap";
+    case XKB_KEYCODES: return "xkb_keycodes";
+    case XKB_TYPES: return "xkb_types";
+    case XKB_SYMBOLS: return "xkb_symbols";
+    case XKB_COMPATMAP: return "xkb_compatibility";
+    case XKB_GEOMETRY: return "xkb_geometry";
+    case XKB_SEMANTICS: return "xkb_semantics";
+    case XKB_LAYOUT: return "xkb_layout";
+    case INCLUDE: return "include";
+    case OVERRIDE: return "override";
+    case AUGMENT: return "augment";
+    case REPLACE: return "replace";
+    case ALTERNATE: return "alternate";
+    case VIRTUAL_MODS: return "virtual_modifiers";
+    case TYPE: return "type";
+    case INTERPRET: return "interpret";
+    case ACTION_TOK: return "action";
+    case KEY: return "key";
+    case ALIAS: return "alias";
+    case GROUP: return "group";
+    case MODIFIER_MAP: return "modifier_map";
+    case INDICATOR: return "indicator";
+    case SHAPE: return "shape";
+    case KEYS: return "keys";
+    case ROW: return "row";
+    case SECTION: return "section";
+    case OVERLAY: return "overlay";
+    case TEXT: return "text";
+    case OUTLINE: return "outline";
+    case SOLID: return "solid";
+    case LOGO: return "logo";
+    case VIRTUAL: return "virtual";
+    case EQUALS: return "=";
+    case PLUS: return "+";
+    case MINUS: return "-";
+    case DIVIDE: return "/";
+    case TIMES: return "*";
+    case OBRACE: return "{";
+    case CBRACE: return "}";
+    case OPAREN: return "(";
+    case CPAREN: return ")";
+    case OBRACKET: return "[";
+    case CBRACKET: return "]";
+    case DOT: return ".";
+    case COMMA: return ",";
+    case SEMI: return ";";
+    case EXCLAM: return "!";
+    case INVERT: return "~";
+    case STRING: return "string literal";
+    case DECIMAL_DIGIT: return "decimal digit";
+    case INTEGER: return "integer literal";
+    case FLOAT: return "float literal";
+    case IDENT: return "identifier";
+    case KEYNAME: return "key name";
+    case PARTIAL: return "partial";
+    case DEFAULT: return "default";
+    case HIDDEN: return "hidden";
+    case ALPHANUMERIC_KEYS: return "alphanumeric_keys";
+    case MODIFIER_KEYS: return "modifier_keys";
+    case KEYPAD_KEYS: return "keypad_keys";
+    case FUNCTION_KEYS: return "function_keys";
+    case ALTERNATE_GROUP: return "alternate_group";
+    default: return "invalid token";
+    }
+}
+
+/***====================================================================***/
+
+static void
+rd_lex(struct rd_parser *p, struct rd_token *tok)
+{
+    tok->type = _xkbcommon_lex(&tok->val, p->scanner);
+    /* The end of file has no position: use the previous token instead */
+    if (tok->type != END_OF_FILE)
+        p->last_pos = p->scanner->token_pos;
+    tok->pos = p->last_pos;
+}
+
+static inline int
+peek(struct rd_parser *p)
+{
+    if (p->la_count == 0) {
+        rd_lex(p, &p->la[0]);
+        p->la_count = 1;
+    }
+    return p->la[0].type;
+}
+
+static inline int
+peek2(struct rd_parser *p)
+{
+    peek(p);
+    if (p->la_count < 2) {
+        rd_lex(p, &p->la[1]);
+        p->la_count = 2;
+    }
+    return p->la[1].type;
+}
+
+/*
+ * Consume the current token. The scanner location is reset to the token, so
+ * that the messages are located correctly even if we peeked further.
+ */
+static inline struct rd_token
+next(struct rd_parser *p)
+{
+    peek(p);
+    const struct rd_token tok = p->la[0];
+    p->la[0] = p->la[1];
+    p->la_count--;
+    p->scanner->token_pos = tok.pos;
+    return tok;
+}
+
+/* Consume the current token if it has the given type and no value to free */
+static inline bool
+accept(struct rd_parser *p, int type)
+{
+    if (peek(p) != type)
+        return false;
+    next(p);
+    return true;
+}
+
+static void
+syntax_error(struct rd_parser *p, int expected)
+{
+    peek(p);
+    p->scanner->token_pos = p->la[0].pos;
+    if (expected == ERROR_TOK) {
+        scanner_err(p->scanner, XKB_ERROR_INVALID_XKB_SYNTAX,
+                    "syntax error, unexpected %s",
+                    token_name(p->la[0].type));
+    } else {
+        scanner_err(p->scanner, XKB_ERROR_INVALID_XKB_SYNTAX,
+                    "syntax error, unexpected %s, expecting %s",
+                    token_name(p->la[0].type), token_name(expected));
+    }
+}
+
+static inline bool
+expect(struct rd_parser *p, int type)
+{
+    if (accept(p, type))
+        return true;
+    syntax_error(p, type);
+    return false;
+}
+
+static void
+rd_parser_finish(struct rd_parser *p)
+{
+    for (unsigned int k = 0; k < p->la_count; k++) {
+        if (p->la[k].type == STRING)
+            free(p->la[k].val.string.owned);
+    }
+    p->la_count = 0;
+}
+
+static inline void
+list_append(struct rd_list *list, ParseCommon *item)
+{
+    if (list->head)
+        list->last->next = item;
+    else
+        list->head = item;
+    list->last = item;
+}
+
+/***====================================================================***/
+
+static xkb_atom_t
+string_atom(struct rd_parser *p, struct rd_token *tok)
+{
+    assert(tok->type == STRING);
+    const xkb_atom_t atom = xkb_atom_intern(p->ctx, tok->val.string.sval.start,
+                                            tok->val.string.sval.len);
+    free(tok->val.string.owned);
+    return atom;
+}
+
+/* Get a NULL-terminated string from a string literal, taking its ownership */
+static char *
+string_take(struct rd_token *tok)
+{
+    assert(tok->type == STRING);
+    struct string_literal *literal = &tok->val.string;
+    char *str = (literal->owned)
+        ? literal->owned
+        : strndup(literal->sval.start, literal->sval.len);
+    literal->owned = NULL;
+    return str;
+}
+
+static inline bool
+is_ident(int type)
+{
+    return type == IDENT || type == DEFAULT;
+}
+
+static xkb_atom_t
+ident_atom(struct rd_parser *p, const struct rd_token *tok)
+{
+    if (tok->type == IDENT)
+        return xkb_atom_intern(p->ctx, tok->val.sval.start, tok->val.sval.len);
+    assert(tok->type == DEFAULT);
+    return xkb_atom_intern_literal(p->ctx, "default");
+}
+
+static bool
+parse_ident(struct rd_parser *p, xkb_atom_t *out)
+{
+    if (!is_ident(peek(p))) {
+        syntax_error(p, IDENT);
+        return false;
+    }
+    const struct rd_token tok = next(p);
+    *out = ident_atom(p, &tok);
+    return true;
+}
+
+static inline bool
+is_field_spec(int type)
+{
+    switch (type) {
+    case IDENT:
+    case DEFAULT:
+    case ACTION_TOK:
+    case INTERPRET:
+    case TYPE:
+    case KEY:
+    case GROUP:
+    case MODIFIER_MAP:
+    case INDICATOR:
+    case SHAPE:
+    case ROW:
+    case SECTION:
+    case TEXT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool
+parse_field_spec(struct rd_parser *p, xkb_atom_t *out)
+{
+    const char *element;
+    switch (peek(p)) {
+    case IDENT:
+    case DEFAULT:
+        return parse_ident(p, out);
+    case ACTION_TOK: element = "action"; break;
+    case INTERPRET: element = "interpret"; break;
+    case TYPE: element = "type"; break;
+    case KEY: element = "key"; break;
+    case GROUP: element = "group"; break;
+    case MODIFIER_MAP: element = "modifier_map"; break;
+    case INDICATOR: element = "indicator"; break;
+    case SHAPE: element = "shape"; break;
+    case ROW: element = "row"; break;
+    case SECTION: element = "section"; break;
+    case TEXT: element = "text"; break;
+    default:
+        syntax_error(p, ERROR_TOK);
+        return false;
+    }
+    next(p);
+    *out = xkb_atom_intern(p->ctx, element, strlen(element));
+    return true;
+}
+
+static bool
+parse_string(struct rd_parser *p, xkb_atom_t *out)
+{
+    if (peek(p) != STRING) {
+        syntax_error(p, STRING);
+        return false;
+    }
+    struct rd_token tok = next(p);
+    *out = string_atom(p, &tok);
+    return true;
+}
+
+static bool
+parse_integer(struct rd_parser *p, int64_t *out)
+{
+    if (peek(p) != INTEGER && peek(p) != DECIMAL_DIGIT) {
+        syntax_error(p, INTEGER);
+        return false;
+    }
+    *out = next(p).val.num;
+    return true;
+}
+
+/* Numbers are only used by the geometry, which is discarded */
+static bool
+parse_signed_number(struct rd_parser *p)
+{
+    accept(p, MINUS);
+    switch (peek(p)) {
+    case FLOAT:
+    case DECIMAL_DIGIT:
+    case INTEGER:
+        next(p);
+        return true;
+    default:
+        syntax_error(p, ERROR_TOK);
+        return false;
+    }
+}
+
+static bool
+parse_merge_mode(struct rd_parser *p, enum merge_mode *merge)
+{
+    switch (peek(p)) {
+    case INCLUDE: *merge = MERGE_DEFAULT; break;
+    case AUGMENT: *merge = MERGE_AUGMENT; break;
+    case OVERRIDE: *merge = MERGE_OVERRIDE; break;
+    case REPLACE: *merge = MERGE_REPLACE; break;
+    case ALTERNATE:
+        next(p);
+        /*
+         * This used to be MERGE_ALT_FORM. This functionality was unused and
+         * has been removed.
+         */
+        scanner_warn(p->scanner, XKB_LOG_MESSAGE_NO_ID,
+                     "ignored unsupported legacy merge mode \"alternate\"");
+        *merge = MERGE_DEFAULT;
+        return true;
+    default:
+        *merge = MERGE_DEFAULT;
+        return false;
+    }
+    next(p);
+    return true;
+}
+
+/***====================================================================***/
+
+/*
+ * Expressions
+ *
+ * Binary operators are parsed by precedence climbing. An assignment is only
+ * valid at the start of an expression or of the right operand of a binary
+ * operator, where it extends as far right as possible.
+ */
+
+enum precedence {
+    PREC_ADDITIVE = 1,
+    PREC_MULTIPLICATIVE = 2,
+};
+
+static ExprDef *
+parse_expr(struct rd_parser *p);
+
+static bool
+parse_expr_list(struct rd_parser *p, int end, ExprDef **out)
+{
+    struct rd_list list = { NULL, NULL };
+    bool first = true;
+
+    /* Note that a leading comma is accepted, e.g. `Action(, x)` */
+    if (peek(p) == COMMA || peek(p) == end)
+        first = false;
+
+    while (first || accept(p, COMMA)) {
+        first = false;
+        ExprDef *expr = parse_expr(p);
+        if (!expr) {
+            FreeStmt(list.head);
+            return false;
+        }
+        list_append(&list, &expr->common);
+    }
+
+    *out = (ExprDef *) list.head;
+    return true;
+}
+
+/* FieldSpec ( ExprList ) */
+static ExprDef *
+parse_action(struct rd_parser *p)
+{
+    xkb_atom_t name;
+    ExprDef *args = NULL;
+    if (!parse_field_spec(p, &name) || !expect(p, OPAREN) ||
+        !parse_expr_list(p, CPAREN, &args))
+        return NULL;
+
+    if (!expect(p, CPAREN)) {
+        FreeStmt((ParseCommon *) args);
+        return NULL;
+    }
+
+    ExprDef *action = ExprCreateAction(name, args);
+    if (!action)
+        FreeStmt((ParseCommon *) args);
+    return action;
+}
+
+/* ActionList }, with the opening brace already consumed */
+static ExprDef *
+parse_action_list_body(struct rd_parser *p)
+{
+    struct rd_list list = { NULL, NULL };
+    do {
+        ExprDef *action = parse_action(p);
+        if (!action)
+            goto error;
+        list_append(&list, &action->common);
+    } while (accept(p, COMMA));
+
+    if (!expect(p, CBRACE))
+        goto error;
+
+    ExprDef *actions = ExprCreateActionList((ExprDef *) list.head);
+    if (!actions)
+        goto error;
+    return actions;
+
+error:
+    FreeStmt(list.head);
+    return NULL;
+}
+
+/* { ActionList } or {} */
+static ExprDef *
+parse_actions(struct rd_parser *p)
+{
+    if (!expect(p, OBRACE))
+        return NULL;
+    if (accept(p, CBRACE))
+        return ExprCreateActionList(NULL);
+    return parse_action_list_body(p);
+}
+
+static ExprDef *
+parse_lhs(struct rd_parser *p)
+{
+    xkb_atom_t element = XKB_ATOM_NONE;
+    xkb_atom_t field;
+
+    if (!parse_field_spec(p, &field))
+        return NULL;
+
+    if (accept(p, DOT)) {
+        element = field;
+        if (!parse_field_spec(p, &field))
+            return NULL;
+    }
+
+    if (accept(p, OBRACKET)) {
+        ExprDef *entry = parse_expr(p);
+        if (!entry)
+            return NULL;
+        if (!expect(p, CBRACKET)) {
+            FreeStmt((ParseCommon *) entry);
+            return NULL;
+        }
+        ExprDef *expr = ExprCreateArrayRef(element, field, entry);
+        if (!expr)
+            FreeStmt((ParseCommon *) entry);
+        return expr;
+    }
+
+    return (element == XKB_ATOM_NONE)
+        ? ExprCreateIdent(field)
+        : ExprCreateFieldRef(element, field);
+}
+
+static ExprDef *
+parse_term(struct rd_parser *p, bool *is_lhs)
+{
+    enum stmt_type op;
+    struct rd_token tok;
+    ExprDef *expr;
+
+    *is_lhs = false;
+
+    switch (peek(p)) {
+    case MINUS: op = STMT_EXPR_NEGATE; goto unary;
+    case PLUS: op = STMT_EXPR_UNARY_PLUS; goto unary;
+    case EXCLAM: op = STMT_EXPR_NOT; goto unary;
+    case INVERT: op = STMT_EXPR_INVERT; goto unary;
+    case OBRACE:
+        return parse_actions(p);
+    case STRING:
+        tok = next(p);
+        return ExprCreateString(string_atom(p, &tok));
+    case INTEGER:
+    case DECIMAL_DIGIT:
+        return ExprCreateInteger(next(p).val.num);
+    case FLOAT:
+        next(p);
+        return ExprCreateFloat();
+    case KEYNAME:
+        return ExprCreateKeyName(next(p).val.atom);
+    case OPAREN:
+        next(p);
+        expr = parse_expr(p);
+        if (expr && !expect(p, CPAREN)) {
+            FreeStmt((ParseCommon *) expr);
+            return NULL;
+        }
+        return expr;
+    default:
+        if (!is_field_spec(peek(p))) {
+            syntax_error(p, ERROR_TOK);
+            return NULL;
+        }
+        if (peek2(p) == OPAREN)
+            return parse_action(p);
+        *is_lhs = true;
+        return parse_lhs(p);
+    }
+
+unary:
+    next(p);
+    bool child_is_lhs;
+    ExprDef *child = parse_term(p, &child_is_lhs);
+    if (!child)
+        return NULL;
+    expr = ExprCreateUnary(op, child);
+    if (!expr)
+        FreeStmt((ParseCommon *) child);
+    return expr;
+}
+
+static ExprDef *
+parse_binary(struct rd_parser *p, int min_prec);
+
+/* Term, or Lhs = Expr */
+static ExprDef *
+parse_operand(struct rd_parser *p)
+{
+    bool is_lhs;
+    ExprDef *left = parse_term(p, &is_lhs);
+    if (!left || !is_lhs || !accept(p, EQUALS))
+        return left;
+
+    ExprDef *right = parse_expr(p);
+    if (!right)
+        goto error;
+    ExprDef *expr = ExprCreateBinary(STMT_EXPR_ASSIGN, left, right);
+    if (!expr) {
+        FreeStmt((ParseCommon *) right);
+        goto error;
+    }
+    return expr;
+
+error:
+    FreeStmt((ParseCommon *) left);
+    return NULL;
+}
+
+static ExprDef *
+parse_binary(struct rd_parser *p, int min_prec)
+{
+    ExprDef *left = parse_operand(p);
+    if (!left)
+        return NULL;
+
+    for (;;) {
+        enum stmt_type op;
+        int prec;
+        switch (peek(p)) {
+        case PLUS: op = STMT_EXPR_ADD; prec = PREC_ADDITIVE; break;
+        case MINUS: op = STMT_EXPR_SUBTRACT; prec = PREC_ADDITIVE; break;
+        case TIMES: op = STMT_EXPR_MULTIPLY; prec = PREC_MULTIPLICATIVE; break;
+        case DIVIDE: op = STMT_EXPR_DIVIDE; prec = PREC_MULTIPLICATIVE; break;
+        default: return left;
+        }
+        if (prec < min_prec)
+            return left;
+        next(p);
+
+        /* Left-associative */
+        ExprDef *right = parse_binary(p, prec + 1);
+        if (!right)
+            goto error;
+        ExprDef *expr = ExprCreateBinary(op, left, right);
+        if (!expr) {
+            FreeStmt((ParseCommon *) right);
+            goto error;
+        }
+        left = expr;
+    }
+
+error:
+    FreeStmt((ParseCommon *) left);
+    return NULL;
+}
+
+static ExprDef *
+parse_expr(struct rd_parser *p)
+{
+    return parse_binary(p, PREC_ADDITIVE);
+}
+
+/***====================================================================***/
+
+/*
+ * Keysyms
+ */
+
+static inline bool
+is_keysym_lit(int type)
+{
+    return type == IDENT || type == SECTION ||
+           type == DECIMAL_DIGIT || type == INTEGER;
+}
+
+static xkb_keysym_t
+parse_keysym_lit(struct rd_parser *p)
+{
+    const struct rd_token tok = next(p);
+    switch (tok.type) {
+    case IDENT:
+        return KeysymParseIdent(p->scanner, tok.val.sval);
+    case SECTION:
+        /* Handle keysym that is also a keyword */
+        return XKB_KEY_section;
+    case DECIMAL_DIGIT:
+        /*
+         * Special case for digits 0..9: map to XKB_KEY_0 .. XKB_KEY_9,
+         * consistent with other keysym names: <name> → XKB_KEY_<name>.
+         */
+        return XKB_KEY_0 + (xkb_keysym_t) tok.val.num;
+    default:
+        assert(tok.type == INTEGER);
+        return KeysymParseInteger(p->scanner, tok.val.num);
+    }
+}
+
+/* KeySymLit or STRING */
+static bool
+parse_keysym(struct rd_parser *p, xkb_keysym_t *out)
+{
+    if (is_keysym_lit(peek(p))) {
+        *out = parse_keysym_lit(p);
+        return true;
+    } else if (peek(p) == STRING) {
+        struct rd_token tok = next(p);
+        *out = KeysymParseString(p->scanner, tok.val.string.sval);
+        free(tok.val.string.owned);
+        return *out != XKB_KEY_NoSymbol;
+    } else {
+        syntax_error(p, ERROR_TOK);
+        return false;
+    }
+}
+
+/* Append a string literal to a keysym list, creating it if necessary */
+static ExprDef *
+keysym_list_append_string(struct rd_parser *p, ExprDef *list)
+{
+    struct rd_token tok = next(p);
+    if (!list)
+        list = ExprCreateKeySymList(XKB_KEY_NoSymbol);
+    if (list)
+        list = ExprKeySymListAppendString(p->scanner, list,
+                                          tok.val.string.sval);
+    free(tok.val.string.owned);
+    return list;
+}
+
+/* KeySymList }, with the opening brace already consumed */
+static ExprDef *
+parse_keysym_list_body(struct rd_parser *p)
+{
+    ExprDef *list = NULL;
+    do {
+        if (is_keysym_lit(peek(p))) {
+            const xkb_keysym_t keysym = parse_keysym_lit(p);
+            list = (list)
+                ? ExprAppendKeySymList(list, keysym)
+                : ExprCreateKeySymList(keysym);
+        } else if (peek(p) == STRING) {
+            /* Frees the list on error */
+            list = keysym_list_append_string(p, list);
+        } else {
+            syntax_error(p, ERROR_TOK);
+            goto error;
+        }
+        if (!list)
+            return NULL;
+    } while (accept(p, COMMA));
+
+    if (!expect(p, CBRACE))
+        goto error;
+    return list;
+
+error:
+    FreeStmt((ParseCommon *) list);
+    return NULL;
+}
+
+/* Keysyms list of a level: KeySymLit, STRING, { KeySymList } or {} */
+static ExprDef *
+parse_level_keysyms(struct rd_parser *p)
+{
+    if (is_keysym_lit(peek(p)))
+        return ExprCreateKeySymList(parse_keysym_lit(p));
+    if (peek(p) == STRING)
+        return keysym_list_append_string(p, NULL);
+    if (!expect(p, OBRACE))
+        return NULL;
+    if (accept(p, CBRACE))
+        return ExprCreateKeySymList(XKB_KEY_NoSymbol);
+    return parse_keysym_list_body(p);
+}
+
+/* Actions list of a level: Action, { ActionList } or {} */
+static ExprDef *
+parse_level_actions(struct rd_parser *p)
+{
+    if (peek(p) == OBRACE)
+        return parse_actions(p);
+
+    ExprDef *action = parse_action(p);
+    if (!action)
+        return NULL;
+    ExprDef *actions = ExprCreateActionList(action);
+    if (!actions)
+        FreeStmt((ParseCommon *) action);
+    return actions;
+}
+
+/* Whether the tokens starting at the lookahead `type` are an action */
+static inline bool
+is_action_start(int type, int next_type)
+{
+    return is_field_spec(type) &&
+           (next_type == OPAREN || (type != IDENT && type != SECTION));
+}
+
+/*
+ * A list of keysym/action lists
+ *
+ * There is some ambiguity because we use `{}` to denote both an empty list of
+ * keysyms and an empty list of actions. So we count the `{}` at the
+ * *beginning*, then prepend the relevant count of `NoSymbol` or `NoAction()`
+ * once the ambiguity is solved. If not, this is a list of empties of *some*
+ * type: we drop those empties and delegate the type resolution using
+ * `ExprEmptyList()`.
+ */
+static ExprDef *
+parse_multi_keysym_or_action_list(struct rd_parser *p)
+{
+    uint32_t empties = 0;
+    bool prefix = false;
+    bool actions;
+    ExprDef *level;
+    struct rd_list list = { NULL, NULL };
+
+    if (!expect(p, OBRACKET))
+        return NULL;
+
+    if (peek(p) == OBRACE && peek2(p) == CBRACE) {
+        next(p);
+        next(p);
+        empties++;
+        prefix = true;
+    }
+
+    for (;;) {
+        if (accept(p, CBRACKET))
+            return ExprEmptyList();
+        if (accept(p, COMMA)) {
+            prefix = true;
+            if (peek(p) == OBRACE && peek2(p) == CBRACE) {
+                next(p);
+                next(p);
+                empties++;
+                continue;
+            }
+        } else if (prefix) {
+            syntax_error(p, ERROR_TOK);
+            return NULL;
+        }
+        break;
+    }
+
+    /* The first non-empty level determines the type of the list */
+    if (accept(p, OBRACE)) {
+        actions = is_action_start(peek(p), peek2(p));
+        level = (actions)
+            ? parse_action_list_body(p)
+            : parse_keysym_list_body(p);
+    } else {
+        actions = is_action_start(peek(p), peek2(p));
+        level = (actions)
+            ? parse_level_actions(p)
+            : parse_level_keysyms(p);
+    }
+    if (!level)
+        return NULL;
+    list_append(&list, &level->common);
+
+    while (accept(p, COMMA)) {
+        level = (actions)
+            ? parse_level_actions(p)
+            : parse_level_keysyms(p);
+        if (!level)
+            goto error;
+        list_append(&list, &level->common);
+    }
+
+    if (!expect(p, CBRACKET))
+        goto error;
+
+    /* Prepend the empty levels */
+    while (empties-- > 0) {
+        level = (actions)
+            ? ExprCreateActionList(NULL)
+            : ExprCreateKeySymList(XKB_KEY_NoSymbol);
+        if (!level)
+            goto error;
+        level->common.next = list.head;
+        list.head = &level->common;
+    }
+
+    return (ExprDef *) list.head;
+
+error:
+    FreeStmt(list.head);
+    return NULL;
+}
+
+/***====================================================================***/
+
+/*
+ * Declarations
+ */
+
+/* Lhs = Expr ;  |  Ident ;  |  ! Ident ; */
+static VarDef *
+parse_var_decl(struct rd_parser *p)
+{
+    xkb_atom_t ident;
+
+    if (accept(p, EXCLAM)) {
+        if (!parse_ident(p, &ident) || !expect(p, SEMI))
+            return NULL;
+        return BoolVarCreate(ident, false);
+    }
+
+    if (is_ident(peek(p)) && peek2(p) != EQUALS && peek2(p) != DOT &&
+        peek2(p) != OBRACKET) {
+        if (!parse_ident(p, &ident) || !expect(p, SEMI))
+            return NULL;
+        return BoolVarCreate(ident, true);
+    }
+
+    ExprDef *name = parse_lhs(p);
+    if (!name)
+        return NULL;
+    ExprDef *value = NULL;
+    if (!expect(p, EQUALS) || !(value = parse_expr(p)) || !expect(p, SEMI))
+        goto error;
+    VarDef *var = VarCreate(name, value);
+    if (!var)
+        goto error;
+    return var;
+
+error:
+    FreeStmt((ParseCommon *) name);
+    FreeStmt((ParseCommon *) value);
+    return NULL;
+}
+
+/* { VarDeclList } ; */
+static bool
+parse_var_decl_block(struct rd_parser *p, VarDef **out)
+{
+    struct rd_list list = { NULL, NULL };
+
+    if (!expect(p, OBRACE))
+        return false;
+
+    while (!accept(p, CBRACE)) {
+        VarDef *var = parse_var_decl(p);
+        if (!var)
+            goto error;
+        list_append(&list, &var->common);
+    }
+
+    if (!expect(p, SEMI))
+        goto error;
+
+    *out = (VarDef *) list.head;
+    return true;
+
+error:
+    FreeStmt(list.head);
+    return false;
+}
+
+/* Lhs = Expr  |  Lhs = MultiKeySymOrActionList  |  Ident  |  ! Ident
+ * |  MultiKeySymOrActionList */
+static VarDef *
+parse_symbols_var_decl(struct rd_parser *p)
+{
+    xkb_atom_t ident;
+    ExprDef *name = NULL;
+    ExprDef *value = NULL;
+
+    if (accept(p, EXCLAM)) {
+        if (!parse_ident(p, &ident))
+            return NULL;
+        return BoolVarCreate(ident, false);
+    }
+
+    if (peek(p) != OBRACKET) {
+        if (is_ident(peek(p)) && peek2(p) != EQUALS && peek2(p) != DOT &&
+            peek2(p) != OBRACKET) {
+            if (!parse_ident(p, &ident))
+                return NULL;
+            return BoolVarCreate(ident, true);
+        }
+        if (!(name = parse_lhs(p)))
+            return NULL;
+        if (!expect(p, EQUALS))
+            goto error;
+    }
+
+    value = (peek(p) == OBRACKET)
+        ? parse_multi_keysym_or_action_list(p)
+        : parse_expr(p);
+    if (!value)
+        goto error;
+
+    VarDef *var = VarCreate(name, value);
+    if (!var)
+        goto error;
+    return var;
+
+error:
+    FreeStmt((ParseCommon *) name);
+    FreeStmt((ParseCommon *) value);
+    return NULL;
+}
+
+/* virtual_modifiers VModDefList ; */
+static bool
+parse_vmod_decl(struct rd_parser *p, enum merge_mode merge,
+                struct rd_list *decls)
+{
+    struct rd_list list = { NULL, NULL };
+
+    next(p);
+    do {
+        xkb_atom_t name;
+        ExprDef *value = NULL;
+        if (!parse_ident(p, &name) ||
+            (accept(p, EQUALS) && !(value = parse_expr(p))))
+            goto error;
+        VModDef *vmod = VModCreate(name, value);
+        if (!vmod) {
+            FreeStmt((ParseCommon *) value);
+            goto error;
+        }
+        vmod->merge = merge;
+        list_append(&list, &vmod->common);
+    } while (accept(p, COMMA));
+
+    if (!expect(p, SEMI))
+        goto error;
+
+    /* Each VModDef is a separate declaration */
+    list_append(decls, list.head);
+    decls->last = list.last;
+    return true;
+
+error:
+    FreeStmt(list.head);
+    return false;
+}
+
+/* interpret KeySym [+ Expr] { VarDeclList } ; */
+static InterpDef *
+parse_interpret_decl(struct rd_parser *p, enum merge_mode merge)
+{
+    xkb_keysym_t keysym;
+    ExprDef *match = NULL;
+    VarDef *body;
+
+    next(p);
+    if (!parse_keysym(p, &keysym) ||
+        (accept(p, PLUS) && !(match = parse_expr(p))))
+        return NULL;
+    if (!parse_var_decl_block(p, &body)) {
+        FreeStmt((ParseCommon *) match);
+        return NULL;
+    }
+
+    InterpDef *interp = InterpCreate(keysym, match);
+    if (!interp) {
+        FreeStmt((ParseCommon *) match);
+        FreeStmt((ParseCommon *) body);
+        return NULL;
+    }
+    interp->merge = merge;
+    interp->def = body;
+    return interp;
+}
+
+/* <KEY> = KeyCode ; */
+static KeycodeDef *
+parse_keycode_decl(struct rd_parser *p, enum merge_mode merge)
+{
+    const xkb_atom_t name = next(p).val.atom;
+    int64_t value;
+    if (!expect(p, EQUALS) || !parse_integer(p, &value) || !expect(p, SEMI))
+        return NULL;
+    KeycodeDef *def = KeycodeCreate(name, value);
+    if (def)
+        def->merge = merge;
+    return def;
+}
+
+/* alias <ALIAS> = <KEY> ; */
+static KeyAliasDef *
+parse_key_alias_decl(struct rd_parser *p, enum merge_mode merge)
+{
+    xkb_atom_t alias, real;
+    next(p);
+    if (peek(p) != KEYNAME) {
+        syntax_error(p, KEYNAME);
+        return NULL;
+    }
+    alias = next(p).val.atom;
+    if (!expect(p, EQUALS))
+        return NULL;
+    if (peek(p) != KEYNAME) {
+        syntax_error(p, KEYNAME);
+        return NULL;
+    }
+    real = next(p).val.atom;
+    if (!expect(p, SEMI))
+        return NULL;
+    KeyAliasDef *def = KeyAliasCreate(alias, real);
+    if (def)
+        def->merge = merge;
+    return def;
+}
+
+/* type String { VarDeclList } ; */
+static KeyTypeDef *
+parse_key_type_decl(struct rd_parser *p, enum merge_mode merge)
+{
+    xkb_atom_t name;
+    VarDef *body;
+    next(p);
+    if (!parse_string(p, &name) || !parse_var_decl_block(p, &body))
+        return NULL;
+    KeyTypeDef *type = KeyTypeCreate(name, body);
+    if (!type) {
+        FreeStmt((ParseCommon *) body);
+        return NULL;
+    }
+    type->merge = merge;
+    return type;
+}
+
+/* key <KEY> { OptSymbolsBody } ; */
+static SymbolsDef *
+parse_symbols_decl(struct rd_parser *p, enum merge_mode merge)
+{
+    struct rd_list list = { NULL, NULL };
+
+    next(p);
+    const xkb_atom_t name = next(p).val.atom;
+    if (!expect(p, OBRACE))
+        return NULL;
+
+    if (peek(p) != CBRACE) {
+        do {
+            VarDef *var = parse_symbols_var_decl(p);
+            if (!var)
+                goto error;
+            list_append(&list, &var->common);
+        } while (accept(p, COMMA));
+    }
+
+    if (!expect(p, CBRACE) || !expect(p, SEMI))
+        goto error;
+
+    SymbolsDef *symbols = SymbolsCreate(name, (VarDef *) list.head);
+    if (!symbols)
+        goto error;
+    symbols->merge = merge;
+    return symbols;
+
+error:
+    FreeStmt(list.head);
+    return NULL;
+}
+
+/* modifier_map Ident { KeyOrKeySymList } ; */
+static ModMapDef *
+parse_modmap_decl(struct rd_parser *p, enum merge_mode merge)
+{
+    struct rd_list list = { NULL, NULL };
+    xkb_atom_t modifier;
+
+    next(p);
+    if (!parse_ident(p, &modifier) || !expect(p, OBRACE))
+        return NULL;
+
+    do {
+        ExprDef *key;
+        if (peek(p) == KEYNAME) {
+            key = ExprCreateKeyName(next(p).val.atom);
+        } else {
+            xkb_keysym_t keysym;
+            if (!parse_keysym(p, &keysym))
+                goto error;
+            key = ExprCreateKeySym(keysym);
+        }
+        if (!key)
+            goto error;
+        list_append(&list, &key->common);
+    } while (accept(p, COMMA));
+
+    if (!expect(p, CBRACE) || !expect(p, SEMI))
+        goto error;
+
+    ModMapDef *modmap = ModMapCreate(modifier, (ExprDef *) list.head);
+    if (!modmap)
+        goto error;
+    modmap->merge = merge;
+    return modmap;
+
+error:
+    FreeStmt(list.head);
+    return NULL;
+}
+
+/* Integer = Expr ; */
+static bool
+parse_indexed_assignment(struct rd_parser *p, int64_t *index, ExprDef **value)
+{
+    if (!parse_integer(p, index) || !expect(p, EQUALS) ||
+        !(*value = parse_expr(p)))
+        return false;
+    if (!expect(p, SEMI)) {
+        FreeStmt((ParseCommon *) *value);
+        return false;
+    }
+    return true;
+}
+
+/* group Integer = Expr ; */
+static GroupCompatDef *
+parse_group_compat_decl(struct rd_parser *p, enum merge_mode merge)
+{
+    int64_t group;
+    ExprDef *value;
+    next(p);
+    if (!parse_indexed_assignment(p, &group, &value))
+        return NULL;
+    GroupCompatDef *def = GroupCompatCreate(group, value);
+    if (!def) {
+        FreeStmt((ParseCommon *) value);
+        return NULL;
+    }
+    def->merge = merge;
+    return def;
+}
+
+/* indicator String { VarDeclList } ; */
+static LedMapDef *
+parse_led_map_decl(struct rd_parser *p, enum merge_mode merge)
+{
+    xkb_atom_t name;
+    VarDef *body;
+    next(p);
+    if (!parse_string(p, &name) || !parse_var_decl_block(p, &body))
+        return NULL;
+    LedMapDef *def = LedMapCreate(name, body);
+    if (!def) {
+        FreeStmt((ParseCommon *) body);
+        return NULL;
+    }
+    def->merge = merge;
+    return def;
+}
+
+/* [virtual] indicator Integer = Expr ; */
+static LedNameDef *
+parse_led_name_decl(struct rd_parser *p, enum merge_mode merge)
+{
+    int64_t index;
+    ExprDef *value;
+    const bool virtual = accept(p, VIRTUAL);
+    if (!expect(p, INDICATOR) ||
+        !parse_indexed_assignment(p, &index, &value))
+        return NULL;
+    LedNameDef *def = LedNameCreate(index, value, virtual);
+    if (!def) {
+        FreeStmt((ParseCommon *) value);
+        return NULL;
+    }
+    def->merge = merge;
+    return def;
+}
+
+/***====================================================================***/
+
+/*
+ * Geometry: parsed for compatibility, but discarded.
+ */
+
+/* [ SignedNumber , SignedNumber ] , … */
+static bool
+parse_coord_list(struct rd_parser *p)
+{
+    do {
+        if (!expect(p, OBRACKET) || !parse_signed_number(p) ||
+            !expect(p, COMMA) || !parse_signed_number(p) ||
+            !expect(p, CBRACKET))
+            return false;
+    } while (accept(p, COMMA));
+    return true;
+}
+
+/* { CoordList } */
+static bool
+parse_coord_block(struct rd_parser *p)
+{
+    return expect(p, OBRACE) && parse_coord_list(p) && expect(p, CBRACE);
+}
+
+/* Discard an expression */
+static bool
+skip_expr(struct rd_parser *p)
+{
+    ExprDef *expr = parse_expr(p);
+    FreeStmt((ParseCommon *) expr);
+    return !!expr;
+}
+
+/* Discard a variable declaration */
+static bool
+skip_var_decl(struct rd_parser *p)
+{
+    VarDef *var = parse_var_decl(p);
+    FreeStmt((ParseCommon *) var);
+    return !!var;
+}
+
+/* Discard a block of variable declarations */
+static bool
+skip_var_decl_block(struct rd_parser *p)
+{
+    VarDef *body;
+    if (!parse_var_decl_block(p, &body))
+        return false;
+    FreeStmt((ParseCommon *) body);
+    return true;
+}
+
+/* shape String { OutlineList } ;  |  shape String { CoordList } ; */
+static bool
+parse_shape_decl(struct rd_parser *p)
+{
+    xkb_atom_t name;
+    next(p);
+    if (!parse_string(p, &name) || !expect(p, OBRACE))
+        return false;
+
+    if (peek(p) == OBRACKET) {
+        if (!parse_coord_list(p))
+            return false;
+    } else {
+        do {
+            /* { CoordList }  |  Ident = { CoordList }  |  Ident = Expr */
+            if (peek(p) == OBRACE) {
+                if (!parse_coord_block(p))
+                    return false;
+                continue;
+            }
+            if (!parse_ident(p, &name) || !expect(p, EQUALS))
+                return false;
+            if (peek(p) == OBRACE && peek2(p) == OBRACKET) {
+                if (!parse_coord_block(p))
+                    return false;
+            } else if (!skip_expr(p)) {
+                return false;
+            }
+        } while (accept(p, COMMA));
+    }
+
+    return expect(p, CBRACE) && expect(p, SEMI);
+}
+
+/* DoodadType String { VarDeclList } ; */
+static bool
+parse_doodad_decl(struct rd_parser *p)
+{
+    xkb_atom_t name;
+    next(p);
+    return parse_string(p, &name) && skip_var_decl_block(p);
+}
+
+/* overlay String { OverlayKeyList } ; */
+static bool
+parse_overlay_decl(struct rd_parser *p)
+{
+    xkb_atom_t name;
+    next(p);
+    if (!parse_string(p, &name) || !expect(p, OBRACE))
+        return false;
+    do {
+        if (!expect(p, KEYNAME) || !expect(p, EQUALS) || !expect(p, KEYNAME))
+            return false;
+    } while (accept(p, COMMA));
+    return expect(p, CBRACE) && expect(p, SEMI);
+}
+
+/* keys { Keys } ; */
+static bool
+parse_keys_decl(struct rd_parser *p)
+{
+    next(p);
+    if (!expect(p, OBRACE))
+        return false;
+    do {
+        /* KEYNAME  |  { ExprList } */
+        if (!accept(p, KEYNAME)) {
+            ExprDef *exprs;
+            if (!expect(p, OBRACE) || !parse_expr_list(p, CBRACE, &exprs))
+                return false;
+            FreeStmt((ParseCommon *) exprs);
+            if (!expect(p, CBRACE))
+                return false;
+        }
+    } while (accept(p, COMMA));
+    return expect(p, CBRACE) && expect(p, SEMI);
+}
+
+/* row { RowBody } ; */
+static bool
+parse_row_decl(struct rd_parser *p)
+{
+    next(p);
+    if (!expect(p, OBRACE))
+        return false;
+    do {
+        if (!((peek(p) == KEYS) ? parse_keys_decl(p) : skip_var_decl(p)))
+            return false;
+    } while (!accept(p, CBRACE));
+    return expect(p, SEMI);
+}
+
+static inline bool
+is_doodad_type(int type)
+{
+    return type == TEXT || type == OUTLINE || type == SOLID || type == LOGO;
+}
+
+/* section String { SectionBody } ; */
+static bool
+parse_section_decl(struct rd_parser *p)
+{
+    xkb_atom_t name;
+    next(p);
+    if (!parse_string(p, &name) || !expect(p, OBRACE))
+        return false;
+    do {
+        bool ok;
+        if (peek(p) == ROW && peek2(p) == OBRACE) {
+            ok = parse_row_decl(p);
+        } else if (is_doodad_type(peek(p)) &&
+                   (peek(p) != TEXT || peek2(p) == STRING)) {
+            ok = parse_doodad_decl(p);
+        } else if (peek(p) == INDICATOR && peek2(p) == STRING) {
+            LedMapDef *led = parse_led_map_decl(p, MERGE_DEFAULT);
+            FreeStmt((ParseCommon *) led);
+            ok = !!led;
+        } else if (peek(p) == OVERLAY) {
+            ok = parse_overlay_decl(p);
+        } else {
+            ok = skip_var_decl(p);
+        }
+        if (!ok)
+            return false;
+    } while (!accept(p, CBRACE));
+    return expect(p, SEMI);
+}
+
+/***====================================================================***/
+
+/* Whether a keyword starts a variable declaration rather than a statement */
+static inline bool
+is_var_decl_start(struct rd_parser *p)
+{
+    const int type = peek2(p);
+    return type == EQUALS || type == DOT || type == OBRACKET;
+}
+
+static bool
+parse_decl(struct rd_parser *p, struct rd_list *decls)
+{
+    enum merge_mode merge;
+    ParseCommon *decl;
+
+    if (parse_merge_mode(p, &merge) && peek(p) == STRING) {
+        /* Include statement */
+        struct rd_token tok = next(p);
+        char *str = string_take(&tok);
+        decl = (ParseCommon *) IncludeCreate(p->ctx, str, merge);
+        free(str);
+        /* Invalid include statements are dropped */
+        if (decl)
+            list_append(decls, decl);
+        return true;
+    }
+
+    switch (peek(p)) {
+    case VIRTUAL_MODS:
+        return parse_vmod_decl(p, merge, decls);
+    case INTERPRET:
+        if (is_var_decl_start(p))
+            goto var_decl;
+        decl = (ParseCommon *) parse_interpret_decl(p, merge);
+        break;
+    case KEYNAME:
+        decl = (ParseCommon *) parse_keycode_decl(p, merge);
+        break;
+    case ALIAS:
+        decl = (ParseCommon *) parse_key_alias_decl(p, merge);
+        break;
+    case TYPE:
+        if (peek2(p) != STRING)
+            goto var_decl;
+        decl = (ParseCommon *) parse_key_type_decl(p, merge);
+        break;
+    case KEY:
+        if (peek2(p) != KEYNAME)
+            goto var_decl;
+        decl = (ParseCommon *) parse_symbols_decl(p, merge);
+        break;
+    case MODIFIER_MAP:
+        if (is_var_decl_start(p))
+            goto var_decl;
+        decl = (ParseCommon *) parse_modmap_decl(p, merge);
+        break;
+    case GROUP:
+        if (is_var_decl_start(p))
+            goto var_decl;
+        decl = (ParseCommon *) parse_group_compat_decl(p, merge);
+        break;
+    case INDICATOR:
+        if (is_var_decl_start(p))
+            goto var_decl;
+        if (peek2(p) == STRING) {
+            decl = (ParseCommon *) parse_led_map_decl(p, merge);
+            break;
+        }
+        /* fallthrough */
+    case VIRTUAL:
+        decl = (ParseCommon *) parse_led_name_decl(p, merge);
+        break;
+    case SHAPE:
+        if (is_var_decl_start(p))
+            goto var_decl;
+        return parse_shape_decl(p);
+    case SECTION:
+        if (is_var_decl_start(p))
+            goto var_decl;
+        return parse_section_decl(p);
+    case TEXT:
+        if (is_var_decl_start(p))
+            goto var_decl;
+        /* fallthrough */
+    case OUTLINE:
+    case SOLID:
+    case LOGO:
+        return parse_doodad_decl(p);
+    default:
+var_decl:
+        decl = (ParseCommon *) parse_var_decl(p);
+        if (decl)
+            ((VarDef *) decl)->merge = merge;
+        break;
+    }
+
+    if (!decl)
+        return false;
+    list_append(decls, decl);
+    return true;
+}
+
+/* Flags FileType OptMapName { DeclList } ; */
+static XkbFile *
+parse_map_config(struct rd_parser *p, enum xkb_map_flags flags)
+{
+    enum xkb_file_type file_type;
+    char *name = NULL;
+    struct rd_list decls = { NULL, NULL };
+
+    switch (peek(p)) {
+    case XKB_KEYCODES: file_type = FILE_TYPE_KEYCODES; break;
+    case XKB_TYPES: file_type = FILE_TYPE_TYPES; break;
+    case XKB_COMPATMAP: file_type = FILE_TYPE_COMPAT; break;
+    case XKB_SYMBOLS: file_type = FILE_TYPE_SYMBOLS; break;
+    case XKB_GEOMETRY: file_type = FILE_TYPE_GEOMETRY; break;
+    default:
+        syntax_error(p, ERROR_TOK);
+        return NULL;
+    }
+    next(p);
+
+    if (peek(p) == STRING) {
+        struct rd_token tok = next(p);
+        if (!(name = string_take(&tok)))
+            return NULL;
+    }
+
+    if (!expect(p, OBRACE))
+        goto error;
+
+    while (!accept(p, CBRACE)) {
+        if (!parse_decl(p, &decls))
+            goto error;
+    }
+
+    /* Do not read further than the end of the map */
+    if (!expect(p, SEMI))
+        goto error;
+
+    XkbFile *file = XkbFileCreate(file_type, name, decls.head, flags);
+    if (!file)
+        goto error;
+    return file;
+
+error:
+    FreeStmt(decls.head);
+    free(name);
+    return NULL;
+}
+
+static enum xkb_map_flags
+parse_flags(struct rd_parser *p)
+{
+    enum xkb_map_flags flags = 0;
+    for (;;) {
+        switch (peek(p)) {
+        case PARTIAL: flags |= MAP_IS_PARTIAL; break;
+        case DEFAULT: flags |= MAP_IS_DEFAULT; break;
+        case HIDDEN: flags |= MAP_IS_HIDDEN; break;
+        case ALPHANUMERIC_KEYS: flags |= MAP_HAS_ALPHANUMERIC; break;
+        case MODIFIER_KEYS: flags |= MAP_HAS_MODIFIER; break;
+        case KEYPAD_KEYS: flags |= MAP_HAS_KEYPAD; break;
+        case FUNCTION_KEYS: flags |= MAP_HAS_FN; break;
+        case ALTERNATE_GROUP: flags |= MAP_IS_ALTGR; break;
+        default: return flags;
+        }
+        next(p);
+    }
+}
+
+/* Flags CompositeType OptMapName { XkbMapConfigList } ; END_OF_FILE */
+static XkbFile *
+parse_composite_map(struct rd_parser *p, enum xkb_map_flags flags)
+{
+    char *name = NULL;
+    struct rd_list maps = { NULL, NULL };
+
+    next(p);
+
+    if (peek(p) == STRING) {
+        struct rd_token tok = next(p);
+        if (!(name = string_take(&tok)))
+            return NULL;
+    }
+
+    if (!expect(p, OBRACE))
+        goto error;
+
+    while (!accept(p, CBRACE)) {
+        XkbFile *map = parse_map_config(p, parse_flags(p));
+        if (!map)
+            goto error;
+        list_append(&maps, &map->common);
+    }
+
+    /* A composite map must be the last map of the file */
+    if (!expect(p, SEMI))
+        goto error;
+    if (peek(p) != END_OF_FILE) {
+        syntax_error(p, END_OF_FILE);
+        goto error;
+    }
+
+    XkbFile *file = XkbFileCreate(FILE_TYPE_KEYMAP, name, maps.head, flags);
+    if (!file)
+        goto error;
+    return file;
+
+error:
+    FreeXkbFile((XkbFile *) maps.head);
+    free(name);
+    return NULL;
+}
+
+/* Parse the next map of the file; `*out` is NULL at the end of the file */
+static bool
+parse_xkb_file(struct rd_parser *p, XkbFile **out)
+{
+    *out = NULL;
+
+    if (peek(p) == END_OF_FILE)
+        return true;
+
+    const enum xkb_map_flags flags = parse_flags(p);
+    switch (peek(p)) {
+    case XKB_KEYMAP:
+    case XKB_SEMANTICS:
+    case XKB_LAYOUT:
+        *out = parse_composite_map(p, flags);
+        break;
+    default:
+        *out = parse_map_config(p, flags);
+        break;
+    }
+
+    return !!*out;
+}
+
+static bool
+rd_parse_map(struct xkb_context *ctx, struct scanner *scanner, XkbFile **out)
+{
+    struct rd_parser p = {
+        .ctx = ctx,
+        .scanner = scanner,
+        .la_count = 0,
+        .last_pos = scanner->token_pos,
+    };
+    const bool ok = parse_xkb_file(&p, out);
+    rd_parser_finish(&p);
+    return ok;
+}
+
+/* Parse a specific section */
+XkbFile *
+rd_parse(struct xkb_context *ctx, struct scanner *scanner, const char *map)
+{
+    XkbFile *first = NULL;
+    XkbFile *file;
+    bool ok;
+
+    /* See: parse() */
+    while ((ok = rd_parse_map(ctx, scanner, &file)) && file) {
+        if (map) {
+            if (streq_not_null(map, file->name))
+                return file;
+            else
+                FreeXkbFile(file);
+        }
+        else {
+            if (file->flags & MAP_IS_DEFAULT) {
+                FreeXkbFile(first);
+                return file;
+            }
+            else if (!first) {
+                first = file;
+            }
+            else {
+                FreeXkbFile(file);
+            }
+        }
+    }
+
+    if (!ok) {
+        /* Some error happend; clear the Xkbfiles parsed so far */
+        FreeXkbFile(first);
+        return NULL;
+    }
+
+    if (first)
+        log_vrb(ctx, XKB_LOG_VERBOSITY_DETAILED,
+                XKB_WARNING_MISSING_DEFAULT_SECTION,
+                "No map in include statement, but \"%s\" contains several; "
+                "Using first defined map, \"%s\"\n",
+                scanner->file_name, safe_map_name(first));
+
+    return first;
+}
+
+/* Parse the next section */
+bool
+rd_parse_next(struct xkb_context *ctx, struct scanner *scanner,
+              XkbFile **xkb_file)
+{
+    return rd_parse_map(ctx, scanner, xkb_file);
+}
@@ -109,11 +109,7 @@ skip_more_whitespace_and_comments:
     /* Group name. */
     if (scanner_chr(s, '$')) {
         val->string.start = s->s + s->pos;
-        val->string.len = 0;
-        while (is_ident(scanner_peek(s))) {
-            scanner_next(s);
-            val->string.len++;
-        }
+        val->string.len = scanner_skip_graph_but(s, '\\');
         if (val->string.len == 0) {
             scanner_err(s, XKB_ERROR_INVALID_RULES_SYNTAX,
                         "unexpected character after \'$\'; expected name");
@@ -133,11 +129,7 @@ skip_more_whitespace_and_comments:
     assert(is_ident(MERGE_REPLACE_PREFIX));
     if (is_ident(scanner_peek(s))) {
         val->string.start = s->s + s->pos;
-        val->string.len = 0;
-        while (is_ident(scanner_peek(s))) {
-            scanner_next(s);
-            val->string.len++;
-        }
+        val->string.len = scanner_skip_graph_but(s, '\\');
         return TOK_IDENTIFIER;
     }
 
@@ -211,9 +203,80 @@ struct rule_names {
     darray_matched_sval options;
 };
 
+/*
+ * Open addressing hash table of the strings of an array, in order to find the
+ * first item with a given string in constant time.
+ */
+struct sval_table {
+    /* 1-based item indices, 0 for empty slots; NULL if not built yet */
+    darray_size_t *slots;
+    /* Number of slots minus 1; the number of slots is a power of 2 */
+    uint32_t mask;
+};
+
+/* Get the string of the item `i`, given the string of the first item */
+#define sval_table_item(first, stride, i) \
+    (*(const struct sval *) ((const char *) (first) + (size_t) (i) * (stride)))
+
+/*
+ * Build the table of the `count` items, which string members are separated
+ * by `stride` bytes. If `next` is not NULL, it is filled with the 1-based
+ * index of the next item with the same string, or 0.
+ */
+static bool
+sval_table_build(struct sval_table *table, const struct sval *first,
+                 size_t stride, darray_size_t count, darray_size_t *next)
+{
+    size_t size = 8;
+    while (size < 2 * (size_t) count)
+        size <<= 1;
+    table->slots = calloc(size, sizeof(*table->slots));
+    if (!table->slots)
+        return false;
+    table->mask = (uint32_t) (size - 1);
+
+    /* Insert in reverse order, so that the first item ends up in the slot */
+    for (darray_size_t i = count; i-- > 0;) {
+        const struct sval key = sval_table_item(first, stride, i);
+        uint32_t slot = hash_buf(key.start, key.len) & table->mask;
+        while (table->slots[slot] &&
+               !svaleq(sval_table_item(first, stride, table->slots[slot] - 1),
+                       key))
+            slot = (slot + 1) & table->mask;
+        if (next)
+            next[i] = table->slots[slot];
+        table->slots[slot] = i + 1;
+    }
+    return true;
+}
+
+/* Returns the 1-based index of the first item with the given string, or 0 */
+static darray_size_t
+sval_table_find(const struct sval_table *table, const struct sval *first,
+                size_t stride, struct sval key)
+{
+    uint32_t slot = hash_buf(key.start, key.len) & table->mask;
+    while (table->slots[slot]) {
+        const darray_size_t idx = table->slots[slot];
+        if (svaleq(sval_table_item(first, stride, idx - 1), key))
+            return idx;
+        slot = (slot + 1) & table->mask;
+    }
+    return 0;
+}
+
+static void
+sval_table_free(struct sval_table *table)
+{
+    free(table->slots);
+    table->slots = NULL;
+}
+
 struct group {
     struct sval name;
     darray_sval elements;
+    /* Built on first use */
+    struct sval_table elements_table;
 };
 
 struct mapping {
@@ -300,8 +363,14 @@ struct matcher {
     struct xkb_context *ctx;
     /* Input.*/
     struct rule_names rmlvo;
+    /* Options by value, built on first use */
+    struct sval_table options_table;
+    /* 1-based index of the next option with the same value, or 0 */
+    darray_size_t *options_next;
     union lvalue val;
     darray(struct group) groups;
+    /* Groups by name, built on first use */
+    struct sval_table groups_table;
     /* Current mapping. */
     struct mapping mapping;
     /* Current rule. */
@@ -312,10 +381,21 @@ struct matcher {
      * See the note: “Layout index ranges and merging KcCGST values”.
      */
     struct kccgst_buffer pending_kccgst;
+    /* Scratch buffer for the %-expansions, reused across the rules */
+    darray_char expanded;
     /* Output. */
     darray_char kccgst[_KCCGST_NUM_ENTRIES];
+    /*
+     * Next matcher of the batch, if any. All the matchers of a batch are fed
+     * with the tokens lexed by the first one.
+     */
+    struct matcher *next;
 };
 
+/* Iterate over the matchers of the batch starting at @m */
+#define matcher_foreach(it, m) \
+    for (struct matcher *it = (m); it; it = it->next)
+
 static struct sval
 strip_spaces(struct sval v)
 {
@@ -545,11 +625,17 @@ matcher_free(struct matcher *m)
     darray_free(m->rmlvo.layouts);
     darray_free(m->rmlvo.variants);
     darray_free(m->rmlvo.options);
+    sval_table_free(&m->options_table);
+    free(m->options_next);
     struct group *group;
-    darray_foreach(group, m->groups)
+    darray_foreach(group, m->groups) {
         darray_free(group->elements);
+        sval_table_free(&group->elements_table);
+    }
+    sval_table_free(&m->groups_table);
     darray_free(m->pending_kccgst.buffer);
     darray_free(m->pending_kccgst.slices);
+    darray_free(m->expanded);
     for (kccgst_index_t i = 0; i < (kccgst_index_t) _KCCGST_NUM_ENTRIES; i++)
         darray_free(m->kccgst[i]);
     darray_free(m->groups);
@@ -561,14 +647,17 @@ matcher_group_start_new(struct matcher *m, struct sval name)
 {
     struct group group = { .name = name, .elements = darray_new() };
     darray_append(m->groups, group);
+    sval_table_free(&m->groups_table);
 }
 
 static void
 matcher_group_add_element(struct matcher *m, struct scanner *s,
                           struct sval element)
 {
-    darray_append(darray_item(m->groups, darray_size(m->groups) - 1).elements,
-                  element);
+    struct group * const group = &darray_item(m->groups,
+                                              darray_size(m->groups) - 1);
+    darray_append(group->elements, element);
+    sval_table_free(&group->elements_table);
 }
 
 static bool
@@ -1099,21 +1188,35 @@ matcher_rule_set_kccgst(struct matcher *m, struct scanner *s,
     m->rule.num_kccgst_values++;
 }
 
-static bool
-match_group(struct matcher *m, struct sval group_name, struct sval to)
+static const struct group *
+find_group(struct matcher *m, struct sval group_name)
 {
-    struct group *group = NULL;
-    struct sval *element;
-    bool found = false;
+    if (darray_empty(m->groups))
+        return NULL;
+
+    const struct sval * const first = &darray_item(m->groups, 0).name;
+    const size_t stride = sizeof(struct group);
+    if (m->groups_table.slots ||
+        sval_table_build(&m->groups_table, first, stride,
+                         darray_size(m->groups), NULL)) {
+        const darray_size_t idx =
+            sval_table_find(&m->groups_table, first, stride, group_name);
+        return (idx) ? &darray_item(m->groups, idx - 1) : NULL;
+    }
 
+    const struct group *group;
     darray_foreach(group, m->groups) {
-        if (svaleq(group->name, group_name)) {
-            found = true;
-            break;
-        }
+        if (svaleq(group->name, group_name))
+            return group;
     }
+    return NULL;
+}
 
-    if (!found) {
+static bool
+match_group(struct matcher *m, struct sval group_name, struct sval to)
+{
+    struct group * const group = (struct group *) find_group(m, group_name);
+    if (!group) {
         /*
          * rules/evdev intentionally uses some undeclared group names
          * in rules (e.g. commented group definitions which may be
@@ -1122,6 +1225,18 @@ match_group(struct matcher *m, struct sval group_name, struct sval to)
         return false;
     }
 
+    if (darray_empty(group->elements))
+        return false;
+
+    const struct sval * const first = &darray_item(group->elements, 0);
+    if (group->elements_table.slots ||
+        sval_table_build(&group->elements_table, first, sizeof(*first),
+                         darray_size(group->elements), NULL)) {
+        return sval_table_find(&group->elements_table, first, sizeof(*first),
+                               to) != 0;
+    }
+
+    const struct sval *element;
     darray_foreach(element, group->elements)
         if (svaleq(to, *element))
             return true;
@@ -1164,6 +1279,54 @@ match_value_and_mark(struct matcher *m, struct sval val,
     return matched;
 }
 
+/*
+ * Find and mark the first option matching the rule value, skipping the
+ * layout-specific options that do not target the given layout.
+ */
+static bool
+match_option_and_mark(struct matcher *m, struct sval val,
+                      enum mlvo_match_type match_type,
+                      xkb_layout_index_t layout)
+{
+    struct matched_sval *to;
+    const darray_size_t count = darray_size(m->rmlvo.options);
+
+    if (match_type == MLVO_MATCH_NORMAL && count > 0) {
+        /* Plain values are looked up by value */
+        const struct sval * const first = &darray_item(m->rmlvo.options, 0).sval;
+        const size_t stride = sizeof(struct matched_sval);
+        if (!m->options_table.slots) {
+            m->options_next = calloc(count, sizeof(*m->options_next));
+            if (!m->options_next ||
+                !sval_table_build(&m->options_table, first, stride, count,
+                                  m->options_next)) {
+                free(m->options_next);
+                m->options_next = NULL;
+                goto linear;
+            }
+        }
+        for (darray_size_t idx = sval_table_find(&m->options_table, first,
+                                                 stride, val);
+             idx; idx = m->options_next[idx - 1]) {
+            to = &darray_item(m->rmlvo.options, idx - 1);
+            if (to->layout != OPTIONS_MATCH_ALL_GROUPS && to->layout != layout)
+                continue;
+            to->matched = true;
+            return true;
+        }
+        return false;
+    }
+
+linear:
+    darray_foreach(to, m->rmlvo.options) {
+        if (to->layout != OPTIONS_MATCH_ALL_GROUPS && to->layout != layout)
+            continue;
+        if (match_value_and_mark(m, val, to, match_type, WILDCARD_MATCH_ALL))
+            return true;
+    }
+    return false;
+}
+
 /*
  * This function performs %-expansion on @value (see overview above),
  * and appends the result to @expanded.
@@ -1331,9 +1494,18 @@ expand_qualifier_in_kccgst_value(
             char layout_index[MAX_LAYOUT_INDEX_STR_LENGTH + 1];
             const darray_size_t prefix_length =
                 darray_size(*expanded) - prefix_idx - 1;
-            for (xkb_layout_index_t l = 1;
-                 l < MIN(XKB_MAX_GROUPS, darray_size(m->rmlvo.layouts));
-                 l++)
+            const xkb_layout_index_t num_layouts =
+                MIN(XKB_MAX_GROUPS, darray_size(m->rmlvo.layouts));
+            /*
+             * Allocate upfront rather than growing for each layout.  Note
+             * that the prefix is copied from the buffer itself: its address
+             * must be taken after each resize, which
+             * darray_appends_nullterminate() does.
+             */
+            darray_growalloc(*expanded, darray_size(*expanded) + 1 +
+                             (num_layouts - 1) * (1 + prefix_length +
+                                            MAX_LAYOUT_INDEX_STR_LENGTH));
+            for (xkb_layout_index_t l = 1; l < num_layouts; l++)
             {
                 if (!has_separator)
                     darray_append(*expanded, MERGE_DEFAULT_PREFIX);
@@ -1376,6 +1548,12 @@ concat_kccgst(darray_char *into, darray_size_t size, const char from[static size
     }
 }
 
+static inline bool
+is_kccgst_special_char(char ch)
+{
+    return ch == ':' || ch == '%' || is_merge_mode_prefix(ch);
+}
+
 /*
  * This function performs %-expansion and :all-expansion on @value
  * (see overview above), and appends the result to @to.
@@ -1386,7 +1564,21 @@ append_expanded_kccgst_value(struct matcher *m, struct scanner *s,
                              xkb_layout_index_t layout_idx)
 {
     const char *str = value.start;
-    darray_char expanded = darray_new();
+
+    /* Fast path: nothing to expand, append the value as is */
+    if (!memchr(str, '%', value.len) && !memchr(str, ':', value.len)) {
+        if (value.len == 0)
+            return true;
+        /* See note: “Layout index ranges and merging KcCGST values” */
+        if (merge)
+            concat_kccgst(to, (darray_size_t) value.len, str);
+        else
+            darray_append_items(*to, str, (darray_size_t) value.len);
+        return true;
+    }
+
+    darray_char * const expanded = &m->expanded;
+    darray_size(*expanded) = 0;
     darray_size_t last_item_idx = 0;
     bool has_separator = false;
 
@@ -1395,8 +1587,8 @@ append_expanded_kccgst_value(struct matcher *m, struct scanner *s,
         switch (str[i]) {
             /* Qualifier */
             case ':':
-                darray_appends_nullterminate(expanded, &str[i++], 1);
-                expand_qualifier_in_kccgst_value(m, s, value, &expanded,
+                darray_appends_nullterminate(*expanded, &str[i++], 1);
+                expand_qualifier_in_kccgst_value(m, s, value, expanded,
                                                  m->mapping.has_layout_idx_range,
                                                  has_separator,
                                                  last_item_idx, &i);
@@ -1406,36 +1598,35 @@ append_expanded_kccgst_value(struct matcher *m, struct scanner *s,
                 i++;
                 if (i >= value.len ||
                     !expand_rmlvo_in_kccgst_value(m, s, value, layout_idx,
-                                                  &expanded, &i))
-                        goto error;
+                                                  expanded, &i))
+                        return false;
                 break;
             /* New item */
             case MERGE_OVERRIDE_PREFIX:
             case MERGE_AUGMENT_PREFIX:
             case MERGE_REPLACE_PREFIX:
-                darray_appends_nullterminate(expanded, &str[i++], 1);
-                last_item_idx = darray_size(expanded) - 1;
+                darray_appends_nullterminate(*expanded, &str[i++], 1);
+                last_item_idx = darray_size(*expanded) - 1;
                 has_separator = true;
                 break;
-            /* Just a normal character. */
-            default:
-                darray_appends_nullterminate(expanded, &str[i++], 1);
+            /* Normal characters: append the whole run at once */
+            default: {
+                const size_t start = i;
+                while (++i < value.len && !is_kccgst_special_char(str[i]));
+                darray_appends_nullterminate(*expanded, &str[start],
+                                             (darray_size_t) (i - start));
+            }
         }
     }
 
     /* See note: “Layout index ranges and merging KcCGST values” */
     if (merge) {
-        if (!darray_empty(expanded))
-            concat_kccgst(to, darray_size(expanded), darray_items(expanded));
+        if (!darray_empty(*expanded))
+            concat_kccgst(to, darray_size(*expanded), darray_items(*expanded));
     } else {
-        darray_concat(*to, expanded);
+        darray_concat(*to, *expanded);
     }
-    darray_free(expanded);
     return true;
-
-error:
-    darray_free(expanded);
-    return false;
 }
 
 static bool
@@ -1541,24 +1732,10 @@ matcher_rule_apply_if_matches(struct matcher *m, struct scanner *s)
                         break;
                     default:
                         assert(mlvo == MLVO_OPTION);
-                        bool found_option = false;
-                        darray_foreach(to, m->rmlvo.options) {
-                            /*
-                             * Skip if layout-specific option and the target
-                             * layout does not match.
-                             */
-                            if (to->layout != OPTIONS_MATCH_ALL_GROUPS &&
-                                to->layout != idx)
-                                continue;
-                            if (match_value_and_mark(m, value, to, match_type,
-                                                     WILDCARD_MATCH_ALL)) {
-                                /* Mark matched, keep index */
-                                matched = true;
-                                found_option = true;
-                                break;
-                            }
-                        }
-                        if (!found_option) {
+                        if (match_option_and_mark(m, value, match_type, idx)) {
+                            /* Mark matched, keep index */
+                            matched = true;
+                        } else {
                             /* Not matched, remove index */
                             candidate_layouts &= ~mask;
                         }
@@ -1582,21 +1759,14 @@ matcher_rule_apply_if_matches(struct matcher *m, struct scanner *s)
                 break;
             default:
                 assert(mlvo == MLVO_OPTION);
-                darray_foreach(to, m->rmlvo.options) {
-                    /*
-                     * Skip if it is a layout-specific option and either:
-                     * - the rule has no layout nor variant field
-                     *   (layout_idx_min == XKB_LAYOUT_INVALID), or
-                     * - the target layout index does not match.
-                     */
-                    if (to->layout != OPTIONS_MATCH_ALL_GROUPS &&
-                        to->layout != m->mapping.layout_idx_min)
-                        continue;
-                    matched = match_value_and_mark(m, value, to, match_type,
-                                                   WILDCARD_MATCH_ALL);
-                    if (matched)
-                        break;
-                }
+                /*
+                 * Layout-specific options are skipped if either:
+                 * - the rule has no layout nor variant field
+                 *   (layout_idx_min == XKB_LAYOUT_INVALID), or
+                 * - the target layout index does not match.
+                 */
+                matched = match_option_and_mark(m, value, match_type,
+                                                m->mapping.layout_idx_min);
             }
         }
 
@@ -1688,10 +1858,169 @@ matcher_rule_apply_if_matches(struct matcher *m, struct scanner *s)
     }
 }
 
+/*
+ * Cache of the lexed rules files
+ *
+ * The tokens of a rules file do not depend on the RMLVO to resolve: a file is
+ * lexed once, while its tokens are recorded, then the next resolutions replay
+ * them. Only the files that were matched successfully are cached.
+ *
+ * The files are identified by their path: changes of their content are only
+ * taken into account after clearing the cache.
+ *
+ * The cache is stored in the context, see: xkb_context_compiler_cache_size().
+ */
+
+/* Maximum number of cached files, e.g. a main rules file and its includes */
+#define RULES_CACHE_MAX_FILES 4
+
+struct rules_cached_token {
+    enum rules_token tok;
+    /* Used to locate the diagnostics */
+    size_t token_pos;
+    /* Only set for the tokens with a string value */
+    struct sval string;
+};
+
+/* Lexed rules file; the strings of its tokens point to its content */
+struct rules_cache_entry {
+    /* One reference for the cache, one for each file being matched */
+    unsigned int refcnt;
+    char *path;
+    char *string;
+    size_t size;
+    darray(struct rules_cached_token) tokens;
+};
+
+struct rules_cache {
+    /* Most recently used first */
+    darray(struct rules_cache_entry *) entries;
+};
+
+/* Tokens of the file being matched; used as the scanner private data */
+struct rules_file_tokens {
+    struct rules_cache_entry *entry;
+    /* Replay the cached tokens, else record the lexed tokens */
+    bool replay;
+    darray_size_t next;
+};
+
+static struct rules_cache_entry *
+rules_cache_entry_new(const char *path, const char *string, size_t size)
+{
+    struct rules_cache_entry * const entry = calloc(1, sizeof(*entry));
+    if (!entry)
+        return NULL;
+    entry->refcnt = 1;
+    entry->path = strdup(path);
+    /* Keep a terminating NULL byte, as a safety net */
+    entry->string = calloc(size + 1, sizeof(*entry->string));
+    if (!entry->path || !entry->string) {
+        free(entry->path);
+        free(entry->string);
+        free(entry);
+        return NULL;
+    }
+    memcpy(entry->string, string, size);
+    entry->size = size;
+    darray_init(entry->tokens);
+    return entry;
+}
+
+static void
+rules_cache_entry_unref(struct rules_cache_entry *entry)
+{
+    assert(entry->refcnt > 0);
+    if (--entry->refcnt > 0)
+        return;
+    free(entry->path);
+    free(entry->string);
+    darray_free(entry->tokens);
+    free(entry);
+}
+
+static void
+rules_cache_free(void *data)
+{
+    struct rules_cache * const cache = data;
+    struct rules_cache_entry **entry;
+    darray_foreach(entry, cache->entries)
+        rules_cache_entry_unref(*entry);
+    darray_free(cache->entries);
+    free(cache);
+}
+
+/* Get the cache of the context, or NULL if it is disabled */
+static struct rules_cache *
+rules_cache_get(struct xkb_context *ctx)
+{
+    if (xkb_context_compiler_cache_size(ctx) == 0)
+        return NULL;
+    if (!ctx->compiler_caches[COMPILER_CACHE_RULES].data) {
+        struct rules_cache * const cache = calloc(1, sizeof(*cache));
+        if (!cache)
+            return NULL;
+        ctx->compiler_caches[COMPILER_CACHE_RULES].data = cache;
+        ctx->compiler_caches[COMPILER_CACHE_RULES].free = rules_cache_free;
+    }
+    return ctx->compiler_caches[COMPILER_CACHE_RULES].data;
+}
+
+/* Lookup a file and take a reference to it. Returns NULL if not found. */
+static struct rules_cache_entry *
+rules_cache_lookup(struct rules_cache *cache, const char *path)
+{
+    for (darray_size_t e = 0; e < darray_size(cache->entries); e++) {
+        struct rules_cache_entry * const entry = darray_item(cache->entries, e);
+        if (!streq(entry->path, path))
+            continue;
+        /* Move to front */
+        memmove(&darray_item(cache->entries, 1), darray_items(cache->entries),
+                e * sizeof(entry));
+        darray_item(cache->entries, 0) = entry;
+        entry->refcnt++;
+        return entry;
+    }
+    return NULL;
+}
+
+static void
+rules_cache_add(struct rules_cache *cache, struct rules_cache_entry *entry)
+{
+    /* Evict the least recently used entries */
+    while (darray_size(cache->entries) >= RULES_CACHE_MAX_FILES) {
+        rules_cache_entry_unref(darray_item(cache->entries,
+                                            darray_size(cache->entries) - 1));
+        darray_remove_last(cache->entries);
+    }
+    entry->refcnt++;
+    darray_insert(cache->entries, 0, entry);
+}
+
 static enum rules_token
 gettok(struct matcher *m, struct scanner *s)
 {
-    return lex(s, &m->val);
+    struct rules_file_tokens * const tokens = s->priv;
+    if (!tokens)
+        return lex(s, &m->val);
+
+    if (tokens->replay) {
+        /* The cached tokens end with TOK_END_OF_FILE, which ends the match */
+        assert(tokens->next < darray_size(tokens->entry->tokens));
+        const struct rules_cached_token * const token =
+            &darray_item(tokens->entry->tokens, tokens->next++);
+        s->token_pos = token->token_pos;
+        if (token->tok == TOK_IDENTIFIER || token->tok == TOK_GROUP_NAME)
+            m->val.string = token->string;
+        return token->tok;
+    }
+
+    const enum rules_token tok = lex(s, &m->val);
+    struct rules_cached_token token = { .tok = tok, .token_pos = s->token_pos };
+    if (tok == TOK_IDENTIFIER || tok == TOK_GROUP_NAME)
+        token.string = m->val.string;
+    darray_append(tokens->entry->tokens, token);
+    return tok;
 }
 
 static bool
@@ -1720,13 +2049,16 @@ initial:
 bang:
     switch (tok = gettok(m, s)) {
     case TOK_GROUP_NAME:
-        matcher_group_start_new(m, m->val.string);
+        matcher_foreach(it, m)
+            matcher_group_start_new(it, m->val.string);
         goto group_name;
     case TOK_INCLUDE:
         goto include_statement;
     case TOK_IDENTIFIER:
-        matcher_mapping_start_new(m);
-        matcher_mapping_set_mlvo(m, s, m->val.string);
+        matcher_foreach(it, m) {
+            matcher_mapping_start_new(it);
+            matcher_mapping_set_mlvo(it, s, m->val.string);
+        }
         goto mapping_mlvo;
     default:
         goto unexpected;
@@ -1743,7 +2075,8 @@ group_name:
 group_element:
     switch (tok = gettok(m, s)) {
     case TOK_IDENTIFIER:
-        matcher_group_add_element(m, s, m->val.string);
+        matcher_foreach(it, m)
+            matcher_group_add_element(it, s, m->val.string);
         goto group_element;
     case TOK_END_OF_LINE:
         goto initial;
@@ -1771,8 +2104,10 @@ include_statement_end:
 mapping_mlvo:
     switch (tok = gettok(m, s)) {
     case TOK_IDENTIFIER:
-        if (m->mapping.active)
-            matcher_mapping_set_mlvo(m, s, m->val.string);
+        matcher_foreach(it, m) {
+            if (it->mapping.active)
+                matcher_mapping_set_mlvo(it, s, m->val.string);
+        }
         goto mapping_mlvo;
     case TOK_EQUALS:
         goto mapping_kccgst;
@@ -1783,17 +2118,21 @@ mapping_mlvo:
 mapping_kccgst:
     switch (tok = gettok(m, s)) {
     case TOK_IDENTIFIER:
-        if (m->mapping.active)
-            matcher_mapping_set_kccgst(m, s, m->val.string);
+        matcher_foreach(it, m) {
+            if (it->mapping.active)
+                matcher_mapping_set_kccgst(it, s, m->val.string);
+        }
         goto mapping_kccgst;
     case TOK_END_OF_LINE:
-        if (m->mapping.active && matcher_mapping_verify(m, s)) {
-            matcher_mapping_set_layout_bounds(m);
-            if (m->mapping.has_layout_idx_range) {
-                /* Lazily reset buffers for layout index ranges.
-                 * We’ll reuse the allocations. */
-                darray_size(m->pending_kccgst.buffer) = 0;
-                darray_size(m->pending_kccgst.slices) = 0;
+        matcher_foreach(it, m) {
+            if (it->mapping.active && matcher_mapping_verify(it, s)) {
+                matcher_mapping_set_layout_bounds(it);
+                if (it->mapping.has_layout_idx_range) {
+                    /* Lazily reset buffers for layout index ranges.
+                     * We’ll reuse the allocations. */
+                    darray_size(it->pending_kccgst.buffer) = 0;
+                    darray_size(it->pending_kccgst.slices) = 0;
+                }
             }
         }
         goto rule_mlvo_first;
@@ -1804,15 +2143,18 @@ mapping_kccgst:
 rule_mlvo_first:
     switch (tok = gettok(m, s)) {
     case TOK_BANG:
-        matcher_append_pending_kccgst(m);
+        matcher_foreach(it, m)
+            matcher_append_pending_kccgst(it);
         goto bang;
     case TOK_END_OF_LINE:
         goto rule_mlvo_first;
     case TOK_END_OF_FILE:
-        matcher_append_pending_kccgst(m);
+        matcher_foreach(it, m)
+            matcher_append_pending_kccgst(it);
         goto finish;
     default:
-        matcher_rule_start_new(m);
+        matcher_foreach(it, m)
+            matcher_rule_start_new(it);
         goto rule_mlvo_no_tok;
     }
 
@@ -1821,32 +2163,44 @@ rule_mlvo:
 rule_mlvo_no_tok:
     switch (tok) {
     case TOK_IDENTIFIER:
-        if (!m->rule.skip) {
+        matcher_foreach(it, m) {
+            if (it->rule.skip)
+                continue;
             if (m->val.string.len == 1 && m->val.string.start[0] == '+')
-                matcher_rule_set_mlvo_wildcard(m, s, MLVO_MATCH_WILDCARD_SOME);
+                matcher_rule_set_mlvo_wildcard(it, s, MLVO_MATCH_WILDCARD_SOME);
             else
-                matcher_rule_set_mlvo(m, s, m->val.string);
+                matcher_rule_set_mlvo(it, s, m->val.string);
         }
         goto rule_mlvo;
     case TOK_WILD_CARD_STAR:
-        if (!m->rule.skip)
-            matcher_rule_set_mlvo_wildcard(m, s, MLVO_MATCH_WILDCARD_LEGACY);
+        matcher_foreach(it, m) {
+            if (!it->rule.skip)
+                matcher_rule_set_mlvo_wildcard(it, s, MLVO_MATCH_WILDCARD_LEGACY);
+        }
         goto rule_mlvo;
     case TOK_WILD_CARD_NONE:
-        if (!m->rule.skip)
-            matcher_rule_set_mlvo_wildcard(m, s, MLVO_MATCH_WILDCARD_NONE);
+        matcher_foreach(it, m) {
+            if (!it->rule.skip)
+                matcher_rule_set_mlvo_wildcard(it, s, MLVO_MATCH_WILDCARD_NONE);
+        }
         goto rule_mlvo;
     case TOK_WILD_CARD_SOME:
-        if (!m->rule.skip)
-            matcher_rule_set_mlvo_wildcard(m, s, MLVO_MATCH_WILDCARD_SOME);
+        matcher_foreach(it, m) {
+            if (!it->rule.skip)
+                matcher_rule_set_mlvo_wildcard(it, s, MLVO_MATCH_WILDCARD_SOME);
+        }
         goto rule_mlvo;
     case TOK_WILD_CARD_ANY:
-        if (!m->rule.skip)
-            matcher_rule_set_mlvo_wildcard(m, s, MLVO_MATCH_WILDCARD_ANY);
+        matcher_foreach(it, m) {
+            if (!it->rule.skip)
+                matcher_rule_set_mlvo_wildcard(it, s, MLVO_MATCH_WILDCARD_ANY);
+        }
         goto rule_mlvo;
     case TOK_GROUP_NAME:
-        if (!m->rule.skip)
-            matcher_rule_set_mlvo_group(m, s, m->val.string);
+        matcher_foreach(it, m) {
+            if (!it->rule.skip)
+                matcher_rule_set_mlvo_group(it, s, m->val.string);
+        }
         goto rule_mlvo;
     case TOK_EQUALS:
         goto rule_kccgst;
@@ -1857,14 +2211,18 @@ rule_mlvo_no_tok:
 rule_kccgst:
     switch (tok = gettok(m, s)) {
     case TOK_IDENTIFIER:
-        if (!m->rule.skip)
-            matcher_rule_set_kccgst(m, s, m->val.string);
+        matcher_foreach(it, m) {
+            if (!it->rule.skip)
+                matcher_rule_set_kccgst(it, s, m->val.string);
+        }
         goto rule_kccgst;
     case TOK_END_OF_LINE:
-        if (!m->rule.skip)
-            matcher_rule_verify(m, s);
-        if (!m->rule.skip)
-            matcher_rule_apply_if_matches(m, s);
+        matcher_foreach(it, m) {
+            if (!it->rule.skip)
+                matcher_rule_verify(it, s);
+            if (!it->rule.skip)
+                matcher_rule_apply_if_matches(it, s);
+        }
         goto rule_mlvo_first;
     default:
         goto unexpected;
@@ -1900,6 +2258,22 @@ read_rules_file(struct xkb_context *ctx,
     size_t size;
     struct scanner scanner;
 
+    struct rules_cache * const cache = rules_cache_get(ctx);
+    struct rules_file_tokens tokens = {
+        .entry = (cache) ? rules_cache_lookup(cache, path) : NULL,
+        .replay = true,
+        .next = 0,
+    };
+    if (tokens.entry) {
+        /* The encoding was checked when the file was cached */
+        scanner_init(&scanner, matcher->ctx, tokens.entry->string,
+                     tokens.entry->size, path, &tokens);
+        ret = matcher_match(matcher, &scanner, include_depth,
+                            tokens.entry->string, tokens.entry->size, path);
+        rules_cache_entry_unref(tokens.entry);
+        return ret;
+    }
+
     if (!map_file(file, &string, &size)) {
         log_err(ctx, XKB_LOG_MESSAGE_NO_ID,
                 "Couldn't read rules file \"%s\": %s\n",
@@ -1907,7 +2281,18 @@ read_rules_file(struct xkb_context *ctx,
         return false;
     }
 
-    scanner_init(&scanner, matcher->ctx, string, size, path, NULL);
+    if (cache) {
+        /* Record the tokens, which point to a copy of the file */
+        tokens.entry = rules_cache_entry_new(path, string, size);
+        tokens.replay = false;
+        if (tokens.entry) {
+            unmap_file(string, size);
+            string = tokens.entry->string;
+        }
+    }
+
+    scanner_init(&scanner, matcher->ctx, string, size, path,
+                 (tokens.entry) ? &tokens : NULL);
 
     /* Basic detection of wrong character encoding.
        The first character relevant to the grammar must be ASCII:
@@ -1919,12 +2304,19 @@ read_rules_file(struct xkb_context *ctx,
         scanner_err(&scanner, XKB_ERROR_INVALID_FILE_ENCODING,
                     "E.g. ISO/CEI 8859 and UTF-8 are supported "
                     "but UTF-16, UTF-32 and CP1026 are not.");
-        unmap_file(string, size);
-        return false;
+        ret = false;
+        goto out;
     }
 
     ret = matcher_match(matcher, &scanner, include_depth, string, size, path);
-    unmap_file(string, size);
+    if (ret && tokens.entry)
+        rules_cache_add(cache, tokens.entry);
+
+out:
+    if (tokens.entry)
+        rules_cache_entry_unref(tokens.entry);
+    else
+        unmap_file(string, size);
     return ret;
 }
 
@@ -1935,10 +2327,14 @@ read_rules_file(struct xkb_context *ctx,
  * resulting from the previous file.
  */
 static bool
-xkb_resolve_partial_rules(struct xkb_context *ctx, char *path, size_t path_size,
+xkb_resolve_partial_rules(struct xkb_context *ctx,
                           const char* rules, const char* suffix,
                           struct matcher *matcher)
 {
+    /* Do not overwrite the path of the main rules file, which identifies it
+     * in the rules cache */
+    char path[PATH_MAX];
+
     /* Set partial rules filename: canonical rules filename + suffix */
     char partial_rules[60]; /* Arbitrary, but we do not expect long names */
     if (unlikely(!snprintf_safe(partial_rules, sizeof(partial_rules),
@@ -1957,7 +2353,7 @@ xkb_resolve_partial_rules(struct xkb_context *ctx, char *path, size_t path_size,
     const size_t len = strlen(partial_rules);
     while ((file = FindFileInXkbPath(ctx, "(unknown)",
                                      partial_rules, len, FILE_TYPE_RULES,
-                                     path, path_size, &offset, false)) != NULL) {
+                                     path, sizeof(path), &offset, false)) != NULL) {
         const bool ok = read_rules_file(ctx, matcher, 0, file, path);
         fclose(file);
         if (!ok) {
@@ -1971,11 +2367,10 @@ xkb_resolve_partial_rules(struct xkb_context *ctx, char *path, size_t path_size,
     return true;
 }
 
+/* Match the rules against all the matchers of the batch `matcher` */
 static bool
 xkb_resolve_rules(struct xkb_context *ctx,
-                  const char* rules, struct matcher *matcher,
-                  struct xkb_component_names *out,
-                  xkb_layout_index_t *explicit_layouts)
+                  const char* rules, struct matcher *matcher)
 {
     bool ret = false;
 
@@ -2004,8 +2399,7 @@ xkb_resolve_rules(struct xkb_context *ctx,
      */
 
     /* XKB extension: resolve optional <rules>.pre files */
-    ret = xkb_resolve_partial_rules(ctx, path, sizeof(path),
-                                    rules, ".pre", matcher);
+    ret = xkb_resolve_partial_rules(ctx, rules, ".pre", matcher);
     if (!ret)
         goto err_out;
 
@@ -2018,21 +2412,30 @@ xkb_resolve_rules(struct xkb_context *ctx,
     }
 
     /* XKB extension: resolve optional <rules>.post files */
-    ret = xkb_resolve_partial_rules(ctx, path, sizeof(path),
-                                    rules, ".post", matcher);
-    if (!ret)
-        goto err_out;
+    ret = xkb_resolve_partial_rules(ctx, rules, ".post", matcher);
 
+err_out:
+    if (file)
+        fclose(file);
+
+    return ret;
+}
+
+/* Get the components resulting of a successful xkb_resolve_rules() */
+static bool
+matcher_get_components(struct matcher *matcher, const char *rules,
+                       struct xkb_component_names *out,
+                       xkb_layout_index_t *explicit_layouts)
+{
     /* Check we got required components */
     if (darray_empty(matcher->kccgst[KCCGST_KEYCODES]) ||
         darray_empty(matcher->kccgst[KCCGST_TYPES]) ||
         darray_empty(matcher->kccgst[KCCGST_COMPAT]) ||
         /* darray_empty(matcher->kccgst[KCCGST_GEOMETRY]) || */
         darray_empty(matcher->kccgst[KCCGST_SYMBOLS])) {
-        log_err(ctx, XKB_ERROR_CANNOT_RESOLVE_RMLVO,
+        log_err(matcher->ctx, XKB_ERROR_CANNOT_RESOLVE_RMLVO,
                 "No components returned from XKB rules \"%s\"\n", rules);
-        ret = false;
-        goto err_out;
+        return false;
     }
 
     darray_steal(matcher->kccgst[KCCGST_KEYCODES], &out->keycodes, NULL);
@@ -2081,11 +2484,7 @@ xkb_resolve_rules(struct xkb_context *ctx,
         }
     }
 
-err_out:
-    if (file)
-        fclose(file);
-
-    return ret;
+    return true;
 }
 
 bool
@@ -2098,8 +2497,9 @@ xkb_components_from_rmlvo_builder(const struct xkb_rmlvo_builder *rmlvo,
     if (!matcher)
         return false;
 
-    const bool ret = xkb_resolve_rules(rmlvo->ctx, rules, matcher,
-                                       out, explicit_layouts);
+    const bool ret =
+        xkb_resolve_rules(rmlvo->ctx, rules, matcher) &&
+        matcher_get_components(matcher, rules, out, explicit_layouts);
 
     matcher_free(matcher);
     return ret;
@@ -2116,9 +2516,67 @@ xkb_components_from_rules_names(struct xkb_context *ctx,
     if (!matcher)
         return false;
 
-    const bool ret = xkb_resolve_rules(ctx, rmlvo->rules, matcher,
-                                       out, explicit_layouts);
+    const bool ret =
+        xkb_resolve_rules(ctx, rmlvo->rules, matcher) &&
+        matcher_get_components(matcher, rmlvo->rules, out, explicit_layouts);
 
     matcher_free(matcher);
     return ret;
 }
+
+size_t
+xkb_components_from_rules_names_batch(struct xkb_context *ctx,
+                                      const struct xkb_rule_names *rmlvo,
+                                      size_t count,
+                                      struct xkb_component_names *out)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = (struct xkb_component_names) { 0 };
+
+    /* Processed names; kept until the end so that they are not batched twice */
+    struct matcher **matchers = calloc(count, sizeof(*matchers));
+    if (!matchers) {
+        log_err(ctx, XKB_ERROR_ALLOCATION_ERROR,
+                "Could not allocate the rules matchers\n");
+        return 0;
+    }
+
+    size_t resolved = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (matchers[i])
+            continue;
+
+        /* Resolve all the names sharing the same rules in a single pass */
+        struct matcher *batch = NULL;
+        struct matcher **last = &batch;
+        bool ok = true;
+        for (size_t j = i; j < count; j++) {
+            if (matchers[j] || strcmp(rmlvo[j].rules, rmlvo[i].rules) != 0)
+                continue;
+            matchers[j] = matcher_new_from_names(ctx, &rmlvo[j]);
+            if (!matchers[j]) {
+                ok = false;
+                break;
+            }
+            *last = matchers[j];
+            last = &matchers[j]->next;
+        }
+
+        if (!ok || !xkb_resolve_rules(ctx, rmlvo[i].rules, batch))
+            continue;
+
+        /* The batch follows the order of the names */
+        size_t j = i;
+        matcher_foreach(m, batch) {
+            while (matchers[j] != m)
+                j++;
+            if (matcher_get_components(m, rmlvo[j].rules, &out[j], NULL))
+                resolved++;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++)
+        matcher_free(matchers[i]);
+    free(matchers);
+    return resolved;
+}
@@ -22,6 +22,17 @@ xkb_components_from_rules_names(struct xkb_context *ctx,
                                 struct xkb_component_names *out,
                                 xkb_layout_index_t *explicit_layouts);
 
+/*
+ * Resolve several RMLVO names with a single pass per rules file. The names
+ * must be sanitized. Returns the number of names successfully resolved; the
+ * components of the other names are set to NULL.
+ */
+size_t
+xkb_components_from_rules_names_batch(struct xkb_context *ctx,
+                                      const struct xkb_rule_names *rmlvo,
+                                      size_t count,
+                                      struct xkb_component_names *out);
+
 /* Maximum length of a layout index string:
  *
  * length = ceiling (bitsize(xkb_layout_index_t) * logBase 10 2)
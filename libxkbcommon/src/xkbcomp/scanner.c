@@ -75,7 +75,7 @@ _xkbcommon_lex(YYSTYPE *yylval, struct scanner *s)
 {
 skip_more_whitespace_and_comments:
     /* Skip spaces. */
-    while (is_space(scanner_peek(s))) scanner_next(s);
+    scanner_skip_spaces(s);
 
     /*
      * Skip U+200E LEFT-TO-RIGHT MARK and U+200F RIGHT-TO-LEFT MARK, assuming
@@ -100,6 +100,20 @@ skip_more_whitespace_and_comments:
 
     /* String literal. */
     if (scanner_chr(s, '\"')) {
+        /* Fast path: no escape sequence, return a slice of the input. */
+        const size_t start = s->pos;
+        while (s->pos < s->len && s->s[s->pos] != '\"' &&
+               s->s[s->pos] != '\\' && s->s[s->pos] != '\n' &&
+               s->s[s->pos] != '\0')
+            s->pos++;
+        if (s->pos - start + 1 < sizeof(s->buf) && scanner_chr(s, '\"')) {
+            yylval->string.sval = SVAL(s->s + start, s->pos - start - 1);
+            yylval->string.owned = NULL;
+            return STRING;
+        }
+
+        /* Slow path: unescape the string literal. */
+        s->pos = start;
         while (!scanner_eof(s) && !scanner_eol(s) && scanner_peek(s) != '\"') {
             if (scanner_chr(s, '\\')) {
                 uint8_t o;
@@ -156,16 +170,17 @@ skip_more_whitespace_and_comments:
                         "unterminated string literal");
             return ERROR_TOK;
         }
-        yylval->str = strdup(s->buf);
-        if (!yylval->str)
+        yylval->string.owned = strdup(s->buf);
+        if (!yylval->string.owned)
             return ERROR_TOK;
+        yylval->string.sval = SVAL(yylval->string.owned,
+                                   strlen(yylval->string.owned));
         return STRING;
     }
 
     /* Key name literal. */
     if (scanner_chr(s, '<')) {
-        while (is_graph(scanner_peek(s)) && scanner_peek(s) != '>')
-            scanner_next(s);
+        scanner_skip_graph_but(s, '>');
         if (!scanner_chr(s, '>')) {
             scanner_err(s, XKB_LOG_MESSAGE_NO_ID,
                         "unterminated key name literal");
@@ -200,8 +215,7 @@ skip_more_whitespace_and_comments:
 
     /* Identifier. */
     if (is_alpha(scanner_peek(s)) || scanner_peek(s) == '_') {
-        while (is_alnum(scanner_peek(s)) || scanner_peek(s) == '_')
-            scanner_next(s);
+        scanner_skip_ident(s);
 
         const char *start = s->s + s->token_pos;
         const size_t len = s->pos - s->token_pos;
@@ -252,6 +266,12 @@ XkbParseStringInit(struct xkb_context *ctx, struct scanner *scanner,
     return true;
 }
 
+#if ENABLE_HANDWRITTEN_KEYMAP_PARSER
+#define DEFAULT_KEYMAP_TEXT_PARSER KEYMAP_TEXT_PARSER_HANDWRITTEN
+#else
+#define DEFAULT_KEYMAP_TEXT_PARSER KEYMAP_TEXT_PARSER_BISON
+#endif
+
 XkbFile *
 XkbParseString(struct xkb_context *ctx, const char *string, size_t len,
                const char *file_name, const char *map)
@@ -260,21 +280,37 @@ XkbParseString(struct xkb_context *ctx, const char *string, size_t len,
     if (!XkbParseStringInit(ctx, &scanner, string, len, file_name, map))
         return NULL;
 
-    return parse(ctx, &scanner, map);
+    return (DEFAULT_KEYMAP_TEXT_PARSER == KEYMAP_TEXT_PARSER_HANDWRITTEN)
+        ? rd_parse(ctx, &scanner, map)
+        : parse(ctx, &scanner, map);
 }
 
 bool
-XkbParseStringNext(struct xkb_context *ctx, struct scanner *scanner,
-                   const char *map, XkbFile **out)
+XkbParseStringNextWithParser(struct xkb_context *ctx, struct scanner *scanner,
+                             enum keymap_text_parser parser,
+                             const char *map, XkbFile **out)
 {
+    const bool handwritten = (parser == KEYMAP_TEXT_PARSER_HANDWRITTEN);
     if (map) {
-        *out = parse(ctx, scanner, map);
+        *out = (handwritten)
+            ? rd_parse(ctx, scanner, map)
+            : parse(ctx, scanner, map);
         return !!(*out);
     } else {
-        return parse_next(ctx, scanner, out);
+        return (handwritten)
+            ? rd_parse_next(ctx, scanner, out)
+            : parse_next(ctx, scanner, out);
     }
 }
 
+bool
+XkbParseStringNext(struct xkb_context *ctx, struct scanner *scanner,
+                   const char *map, XkbFile **out)
+{
+    return XkbParseStringNextWithParser(ctx, scanner,
+                                        DEFAULT_KEYMAP_TEXT_PARSER, map, out);
+}
+
 XkbFile *
 XkbParseFile(struct xkb_context *ctx, FILE *file,
              const char *file_name, const char *map)
@@ -151,6 +151,17 @@ ClearKeyInfo(KeyInfo *keyi)
     darray_free(keyi->groups);
 }
 
+static void
+CopyKeyInfo(KeyInfo *to, const KeyInfo *from)
+{
+    *to = *from;
+    darray_init(to->groups);
+    darray_copy(to->groups, from->groups);
+    for (xkb_layout_index_t i = 0; i < darray_size(to->groups); i++)
+        CopyGroupInfo(&darray_item(to->groups, i),
+                      &darray_item(from->groups, i));
+}
+
 /***====================================================================***/
 
 typedef struct {
@@ -211,6 +222,22 @@ ClearSymbolsInfo(SymbolsInfo *info)
     ClearKeyInfo(&info->default_key);
 }
 
+static void
+CopySymbolsInfo(SymbolsInfo *to, const SymbolsInfo *from)
+{
+    *to = *from;
+    to->name = strdup_safe(from->name);
+    darray_init(to->keys);
+    darray_copy(to->keys, from->keys);
+    for (darray_size_t k = 0; k < darray_size(to->keys); k++)
+        CopyKeyInfo(&darray_item(to->keys, k), &darray_item(from->keys, k));
+    CopyKeyInfo(&to->default_key, &from->default_key);
+    darray_init(to->group_names);
+    darray_copy(to->group_names, from->group_names);
+    darray_init(to->modmaps);
+    darray_copy(to->modmaps, from->modmaps);
+}
+
 static const char *
 KeyInfoText(SymbolsInfo *info, KeyInfo *keyi)
 {
@@ -682,6 +709,145 @@ MergeIncludedSymbols(SymbolsInfo *into, SymbolsInfo *from,
     }
 }
 
+/***====================================================================***/
+
+/*
+ * Cache of the top-level includes of the keymaps generated from RMLVO, e.g.
+ * each of `pc`, `us`, `ru:2` and `inet(evdev)` in `pc+us+ru:2+inet(evdev)`.
+ * Each layout is compiled into a fixed group, so adding or removing a layout
+ * only compiles that layout, while the others are copied from the cache.
+ *
+ * The result of an include depends on its file and map, but also on the
+ * explicit group, the keymap format, the key aliases and the modifiers
+ * defined by the previous sections and includes.
+ *
+ * The cache is stored in the context, see: xkb_context_compiler_cache_size().
+ */
+
+/* Maximum number of cached includes per keymap of the keymap cache */
+#define SYMBOLS_CACHE_ENTRIES_PER_KEYMAP 8
+
+typedef struct {
+    char *file;
+    char *map;
+    xkb_layout_index_t explicit_group;
+    enum xkb_keymap_format format;
+    char *keycodes;
+    struct xkb_mod_set mods;
+    /* Result of the include; its keymap is not set */
+    SymbolsInfo info;
+} SymbolsCacheEntry;
+
+typedef struct {
+    /* Most recently used first */
+    darray(SymbolsCacheEntry) entries;
+} SymbolsCache;
+
+static void
+ClearSymbolsCacheEntry(SymbolsCacheEntry *entry)
+{
+    free(entry->file);
+    free(entry->map);
+    free(entry->keycodes);
+    ClearSymbolsInfo(&entry->info);
+}
+
+static void
+FreeSymbolsCache(void *data)
+{
+    SymbolsCache * const cache = data;
+    SymbolsCacheEntry *entry;
+    darray_foreach(entry, cache->entries)
+        ClearSymbolsCacheEntry(entry);
+    darray_free(cache->entries);
+    free(cache);
+}
+
+static size_t
+SymbolsCacheCapacity(struct xkb_context *ctx)
+{
+    return (size_t) xkb_context_compiler_cache_size(ctx)
+           * SYMBOLS_CACHE_ENTRIES_PER_KEYMAP;
+}
+
+/* Get the cache of the context, or NULL if it is disabled */
+static SymbolsCache *
+GetSymbolsCache(struct xkb_context *ctx)
+{
+    if (SymbolsCacheCapacity(ctx) == 0)
+        return NULL;
+    if (!ctx->compiler_caches[COMPILER_CACHE_SYMBOLS].data) {
+        SymbolsCache * const cache = calloc(1, sizeof(*cache));
+        if (!cache)
+            return NULL;
+        ctx->compiler_caches[COMPILER_CACHE_SYMBOLS].data = cache;
+        ctx->compiler_caches[COMPILER_CACHE_SYMBOLS].free = FreeSymbolsCache;
+    }
+    return ctx->compiler_caches[COMPILER_CACHE_SYMBOLS].data;
+}
+
+static bool
+ModSetsEqual(const struct xkb_mod_set *a, const struct xkb_mod_set *b)
+{
+    return a->num_mods == b->num_mods &&
+           a->explicit_vmods == b->explicit_vmods &&
+           memcmp(a->mods, b->mods, a->num_mods * sizeof(a->mods[0])) == 0;
+}
+
+/*
+ * Lookup the result of an include, given the initial state used to process
+ * it. Returns NULL if not found.
+ */
+static const SymbolsInfo *
+LookupSymbolsCache(SymbolsCache *cache, const IncludeStmt *stmt,
+                   const SymbolsInfo *initial)
+{
+    const struct xkb_keymap * const keymap = initial->keymap;
+    for (darray_size_t e = 0; e < darray_size(cache->entries); e++) {
+        const SymbolsCacheEntry * const entry = &darray_item(cache->entries, e);
+        if (entry->explicit_group != initial->explicit_group ||
+            entry->format != keymap->format ||
+            !streq_null(entry->file, stmt->file) ||
+            !streq_null(entry->map, stmt->map) ||
+            !streq_null(entry->keycodes, keymap->keycodes_section_name) ||
+            !ModSetsEqual(&entry->mods, &initial->mods))
+            continue;
+        /* Move to front */
+        const SymbolsCacheEntry hit = *entry;
+        memmove(&darray_item(cache->entries, 1), darray_items(cache->entries),
+                e * sizeof(hit));
+        darray_item(cache->entries, 0) = hit;
+        return &darray_item(cache->entries, 0).info;
+    }
+    return NULL;
+}
+
+static void
+AddToSymbolsCache(SymbolsCache *cache, struct xkb_context *ctx,
+                  const IncludeStmt *stmt, const struct xkb_mod_set *mods,
+                  const SymbolsInfo *result)
+{
+    /* Evict the least recently used entries */
+    const size_t capacity = SymbolsCacheCapacity(ctx);
+    while (darray_size(cache->entries) >= capacity) {
+        ClearSymbolsCacheEntry(&darray_item(cache->entries,
+                                            darray_size(cache->entries) - 1));
+        darray_remove_last(cache->entries);
+    }
+
+    SymbolsCacheEntry entry = {
+        .file = strdup_safe(stmt->file),
+        .map = strdup_safe(stmt->map),
+        .explicit_group = result->explicit_group,
+        .format = result->keymap->format,
+        .keycodes = strdup_safe(result->keymap->keycodes_section_name),
+        .mods = *mods,
+    };
+    CopySymbolsInfo(&entry.info, result);
+    entry.info.keymap = NULL;
+    darray_insert(cache->entries, 0, entry);
+}
+
 static void
 HandleSymbolsFile(SymbolsInfo *info, XkbFile *file);
 
@@ -699,18 +865,14 @@ HandleIncludeSymbols(SymbolsInfo *info, IncludeStmt *include)
                     &info->mods);
     included.name = steal(&include->stmt);
 
+    /* Only the top-level includes of keymaps from RMLVO are cached */
+    SymbolsCache * const cache =
+        (info->include_depth == 0 && info->keymap->num_groups != 0)
+            ? GetSymbolsCache(info->ctx)
+            : NULL;
+
     for (IncludeStmt *stmt = include; stmt; stmt = stmt->next_incl) {
         SymbolsInfo next_incl;
-        XkbFile *file;
-
-        char path[PATH_MAX];
-        file = ProcessIncludeFile(info->ctx, stmt, FILE_TYPE_SYMBOLS,
-                                  path, sizeof(path));
-        if (!file) {
-            info->errorCount += 10;
-            ClearSymbolsInfo(&included);
-            return false;
-        }
 
         InitSymbolsInfo(&next_incl, info->keymap, info->include_depth + 1,
                         &included.mods);
@@ -738,12 +900,35 @@ HandleIncludeSymbols(SymbolsInfo *info, IncludeStmt *include)
             next_incl.explicit_group = info->explicit_group;
         }
 
-        HandleSymbolsFile(&next_incl, file);
+        const SymbolsInfo * const cached =
+            (cache) ? LookupSymbolsCache(cache, stmt, &next_incl) : NULL;
+        if (cached) {
+            ClearSymbolsInfo(&next_incl);
+            CopySymbolsInfo(&next_incl, cached);
+            next_incl.keymap = info->keymap;
+        } else {
+            char path[PATH_MAX];
+            XkbFile * const file = ProcessIncludeFile(info->ctx, stmt,
+                                                      FILE_TYPE_SYMBOLS,
+                                                      path, sizeof(path));
+            if (!file) {
+                info->errorCount += 10;
+                ClearSymbolsInfo(&next_incl);
+                ClearSymbolsInfo(&included);
+                return false;
+            }
+
+            const struct xkb_mod_set mods = next_incl.mods;
+            HandleSymbolsFile(&next_incl, file);
+            FreeXkbFile(file);
+
+            if (cache && next_incl.errorCount == 0)
+                AddToSymbolsCache(cache, info->ctx, stmt, &mods, &next_incl);
+        }
 
         MergeIncludedSymbols(&included, &next_incl, stmt->merge);
 
         ClearSymbolsInfo(&next_incl);
-        FreeXkbFile(file);
     }
 
     MergeIncludedSymbols(info, &included, include->merge);
@@ -1411,12 +1596,7 @@ HandleSymbolsDef(SymbolsInfo *info, SymbolsDef *stmt)
 {
     KeyInfo keyi;
 
-    keyi = info->default_key;
-    darray_init(keyi.groups);
-    darray_copy(keyi.groups, info->default_key.groups);
-    for (xkb_layout_index_t i = 0; i < darray_size(keyi.groups); i++)
-        CopyGroupInfo(&darray_item(keyi.groups, i),
-                      &darray_item(info->default_key.groups, i));
+    CopyKeyInfo(&keyi, &info->default_key);
     keyi.merge = stmt->merge;
     keyi.name = stmt->keyName;
 
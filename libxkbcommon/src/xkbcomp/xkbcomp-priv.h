@@ -15,10 +15,15 @@ text_v1_keymap_get_as_string(struct xkb_keymap *keymap,
                              enum xkb_keymap_format format,
                              enum xkb_keymap_serialize_flags flags);
 
+bool
+text_v1_keymap_write(struct xkb_keymap *keymap, enum xkb_keymap_format format,
+                     enum xkb_keymap_serialize_flags flags,
+                     xkb_keymap_write_func_t write, void *data);
+
 XkbFile *
 XkbParseFile(struct xkb_context *ctx, FILE *file,
              const char *file_name, const char *map);
-bool
+XKB_EXPORT_PRIVATE bool
 XkbParseStringInit(struct xkb_context *ctx, struct scanner *scanner,
                    const char *string, size_t len,
                    const char *file_name, const char *map);
@@ -32,7 +37,21 @@ bool
 XkbParseStringNext(struct xkb_context *ctx, struct scanner *scanner,
                    const char *map, XkbFile **out);
 
-void
+/** Parsers of the keymap text format */
+enum keymap_text_parser {
+    /** LALR parser generated by Bison */
+    KEYMAP_TEXT_PARSER_BISON,
+    /** Hand-written recursive-descent parser */
+    KEYMAP_TEXT_PARSER_HANDWRITTEN,
+};
+
+/* Same as XkbParseStringNext, but with an explicit parser */
+XKB_EXPORT_PRIVATE bool
+XkbParseStringNextWithParser(struct xkb_context *ctx, struct scanner *scanner,
+                             enum keymap_text_parser parser,
+                             const char *map, XkbFile **out);
+
+XKB_EXPORT_PRIVATE void
 FreeXkbFile(XkbFile *file);
 
 XkbFile *
@@ -47,6 +47,36 @@ xkb_components_names_from_rules(struct xkb_context *ctx,
     return xkb_components_from_rules_names(ctx, &rmlvo, components_out, NULL);
 }
 
+size_t
+xkb_components_names_from_rules_batch(struct xkb_context *ctx,
+                                      const struct xkb_rule_names *rmlvo_in,
+                                      size_t count,
+                                      struct xkb_component_names *components_out)
+{
+    if (!count)
+        return 0;
+
+    /* Resolve default RMLVO values. We need a mutable copy of the input. */
+    struct xkb_rule_names * const rmlvo = calloc(count, sizeof(*rmlvo));
+    if (!rmlvo) {
+        log_err(ctx, XKB_ERROR_ALLOCATION_ERROR,
+                "Could not allocate the RMLVO names\n");
+        for (size_t i = 0; i < count; i++)
+            components_out[i] = (struct xkb_component_names){ 0 };
+        return 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        rmlvo[i] = rmlvo_in[i];
+        xkb_context_sanitize_rule_names(ctx, &rmlvo[i]);
+    }
+
+    const size_t resolved =
+        xkb_components_from_rules_names_batch(ctx, rmlvo, count,
+                                              components_out);
+    free(rmlvo);
+    return resolved;
+}
+
 static bool
 compile_keymap_file(struct xkb_keymap *keymap, XkbFile *file)
 {
@@ -236,4 +266,5 @@ const struct xkb_keymap_format_ops text_v1_keymap_format_ops = {
     .keymap_new_from_string = text_v1_keymap_new_from_string,
     .keymap_new_from_file = text_v1_keymap_new_from_file,
     .keymap_get_as_string = text_v1_keymap_get_as_string,
+    .keymap_write = text_v1_keymap_write,
 };
@@ -48,9 +48,9 @@ for_each_helper(struct xkb_compose_table *table,
 }
 
 void
-xkb_compose_table_for_each(struct xkb_compose_table *table,
-                           xkb_compose_table_iter_t iter,
-                           void *data)
+compose_table_for_each_recursive(struct xkb_compose_table *table,
+                                 xkb_compose_table_iter_t iter,
+                                 void *data)
 {
     if (darray_size(table->nodes) <= 1) {
         return;
@@ -8,20 +8,14 @@
 #include "src/compose/table.h"
 
 /**
- * The iterator function type used by xkb_compose_table_for_each().
- */
-typedef void
-(*xkb_compose_table_iter_t)(struct xkb_compose_table_entry *entry,
-                            void *data);
-
-/**
- * Run a specified function for every valid entry in the table.
+ * Reference implementation of xkb_compose_table_for_each(), using a
+ * recursive traversal.
  *
  * The entries are returned in lexicographic order of the left-hand
  * side of entries. This does not correspond to the order in which
  * the entries appear in the Compose file.
  */
 void
-xkb_compose_table_for_each(struct xkb_compose_table *table,
-                           xkb_compose_table_iter_t iter,
-                           void *data);
+compose_table_for_each_recursive(struct xkb_compose_table *table,
+                                 xkb_compose_table_iter_t iter,
+                                 void *data);
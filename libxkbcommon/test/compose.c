@@ -19,6 +19,7 @@
 #include "src/keysym.h"
 #include "src/compose/constants.h"
 #include "src/compose/parser.h"
+#include "src/compose/table.h"
 #include "src/compose/escape.h"
 #include "src/compose/dump.h"
 #include "test/compose-iter.h"
@@ -417,7 +418,7 @@ test_conflicting(struct xkb_context *ctx)
         XKB_KEY_B,              XKB_COMPOSE_FEED_ACCEPTED,  XKB_COMPOSE_COMPOSED,   "foo",  XKB_KEY_B,
         XKB_KEY_NoSymbol));
 
-    // new same length as old #3: overwritable string: do not allocate
+    // new same length as old #3: shorter string
     assert(test_compose_seq_buffer(ctx,
         "<A> <B>      :  \"foo\"  A \n"
         "<A> <B>      :  \"qu\"   A \n",
@@ -425,7 +426,7 @@ test_conflicting(struct xkb_context *ctx)
         XKB_KEY_B,              XKB_COMPOSE_FEED_ACCEPTED,  XKB_COMPOSE_COMPOSED,   "qu",   XKB_KEY_A,
         XKB_KEY_NoSymbol));
 
-    // new same length as old #4: no-overwritable string: allocate
+    // new same length as old #4: longer string
     assert(test_compose_seq_buffer(ctx,
         "<A> <B>      :  \"foo\"  A \n"
         "<A> <B>      :  \"quux\" A \n",
@@ -715,6 +716,45 @@ test_override(struct xkb_context *ctx)
         XKB_KEY_NoSymbol));
 }
 
+static void
+test_utf8_pool(struct xkb_context *ctx)
+{
+    const char table_string[] =
+        "<a> <b> : \"foo\" X\n"
+        "<a> <c> : \"bar\" X\n"
+        "<a> <d> : \"foo\" Y\n"
+        "<a> <e> : \"baz\" X\n"
+        "<a> <e> : \"qux\" X\n"  /* Override: "baz" is no longer used */
+        "<a> <f> : \"bar\" X\n"
+        "<a> <f> <g> : \"quux\" X\n"; /* Override: "bar" is still used */
+    struct xkb_compose_table *table =
+        xkb_compose_table_new_from_buffer(ctx, table_string,
+                                          sizeof(table_string) - 1, "",
+                                          XKB_COMPOSE_FORMAT_TEXT_V1,
+                                          XKB_COMPOSE_COMPILE_NO_FLAGS);
+    assert(table);
+
+    /* Identical strings are shared and unused strings are dropped */
+    const char expected[] = "\0foo\0bar\0qux\0quux";
+    assert(darray_size(table->utf8) == sizeof(expected));
+    assert(memcmp(darray_items(table->utf8), expected, sizeof(expected)) == 0);
+    assert(!table->utf8_index);
+
+    assert(test_compose_seq(table,
+        XKB_KEY_a, XKB_COMPOSE_FEED_ACCEPTED, XKB_COMPOSE_COMPOSING, "",     XKB_KEY_NoSymbol,
+        XKB_KEY_d, XKB_COMPOSE_FEED_ACCEPTED, XKB_COMPOSE_COMPOSED,  "foo",  XKB_KEY_Y,
+        XKB_KEY_a, XKB_COMPOSE_FEED_ACCEPTED, XKB_COMPOSE_COMPOSING, "",     XKB_KEY_NoSymbol,
+        XKB_KEY_c, XKB_COMPOSE_FEED_ACCEPTED, XKB_COMPOSE_COMPOSED,  "bar",  XKB_KEY_X,
+        XKB_KEY_a, XKB_COMPOSE_FEED_ACCEPTED, XKB_COMPOSE_COMPOSING, "",     XKB_KEY_NoSymbol,
+        XKB_KEY_e, XKB_COMPOSE_FEED_ACCEPTED, XKB_COMPOSE_COMPOSED,  "qux",  XKB_KEY_X,
+        XKB_KEY_a, XKB_COMPOSE_FEED_ACCEPTED, XKB_COMPOSE_COMPOSING, "",     XKB_KEY_NoSymbol,
+        XKB_KEY_f, XKB_COMPOSE_FEED_ACCEPTED, XKB_COMPOSE_COMPOSING, "",     XKB_KEY_NoSymbol,
+        XKB_KEY_g, XKB_COMPOSE_FEED_ACCEPTED, XKB_COMPOSE_COMPOSED,  "quux", XKB_KEY_X,
+        XKB_KEY_NoSymbol));
+
+    xkb_compose_table_unref(table);
+}
+
 static bool
 test_eq_entry_va(struct xkb_compose_table_entry *entry, xkb_keysym_t keysym_ref, const char *utf8_ref, va_list ap)
 {
@@ -884,6 +924,24 @@ test_traverse(struct xkb_context *ctx, size_t quickcheck_loops)
                                                   XKB_COMPOSE_COMPILE_NO_FLAGS);
         assert(table);
 
+        iter = xkb_compose_table_iterator_new(table);
+        assert(iter);
+        compose_table_for_each_recursive(table, compose_traverse_fn, iter);
+        assert(xkb_compose_table_iterator_next(iter) == NULL);
+        xkb_compose_table_iterator_free(iter);
+
+        /* Iterator in caller-provided storage */
+        const size_t storage_size = xkb_compose_table_iterator_storage_size(table);
+        void *storage = malloc(storage_size);
+        assert(storage);
+        assert(!xkb_compose_table_iterator_init(table, storage, storage_size - 1));
+        iter = xkb_compose_table_iterator_init(table, storage, storage_size);
+        assert(iter);
+        compose_table_for_each_recursive(table, compose_traverse_fn, iter);
+        assert(xkb_compose_table_iterator_next(iter) == NULL);
+        free(storage);
+
+        /* Callback-based traversal */
         iter = xkb_compose_table_iterator_new(table);
         assert(iter);
         xkb_compose_table_for_each(table, compose_traverse_fn, iter);
@@ -1159,6 +1217,7 @@ main(int argc, char *argv[])
     test_modifier_syntax(ctx);
     test_include(ctx);
     test_override(ctx);
+    test_utf8_pool(ctx);
     test_traverse(ctx, quickcheck_loops);
     test_string_length(ctx);
     test_decode_escape_sequences(ctx);
@@ -7,6 +7,8 @@
 
 #include "config.h"
 
+#include <inttypes.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -365,6 +367,240 @@ test_delayed_includes(void)
     restore_env();
 }
 
+static void
+assert_keymap_cache_stats(struct xkb_context *ctx,
+                          uint64_t expected_hits, uint64_t expected_misses)
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    xkb_context_get_keymap_cache_stats(ctx, &hits, &misses);
+    assert_eq("Cache hits", expected_hits, hits, "%"PRIu64);
+    assert_eq("Cache misses", expected_misses, misses, "%"PRIu64);
+}
+
+static void
+test_keymap_cache(void)
+{
+    struct xkb_context *ctx = test_get_context(0);
+    assert(ctx);
+
+    const struct xkb_rule_names us = {
+        .rules = "evdev", .model = "pc104", .layout = "us", .variant = NULL
+    };
+    const struct xkb_rule_names us_empty_variant = {
+        .rules = "evdev", .model = "pc104", .layout = "us", .variant = "",
+        .options = ""
+    };
+    const struct xkb_rule_names de = {
+        .rules = "evdev", .model = "pc104", .layout = "de"
+    };
+    const struct xkb_rule_names ch = {
+        .rules = "evdev", .model = "pc104", .layout = "ch"
+    };
+    const enum xkb_keymap_format format = XKB_KEYMAP_FORMAT_TEXT_V1;
+
+    /* Disabled by default */
+    struct xkb_keymap *keymap1 = xkb_keymap_new_from_names2(ctx, &us, format, 0);
+    struct xkb_keymap *keymap2 = xkb_keymap_new_from_names2(ctx, &us, format, 0);
+    assert(keymap1 && keymap2 && keymap1 != keymap2);
+    assert_keymap_cache_stats(ctx, 0, 0);
+    xkb_keymap_unref(keymap1);
+    xkb_keymap_unref(keymap2);
+
+    xkb_context_set_keymap_cache_size(ctx, 3);
+
+    /* Same names, after normalization */
+    keymap1 = xkb_keymap_new_from_names2(ctx, &us, format, 0);
+    keymap2 = xkb_keymap_new_from_names2(ctx, &us_empty_variant, format, 0);
+    assert(keymap1 && keymap1 == keymap2);
+    assert_keymap_cache_stats(ctx, 1, 1);
+    xkb_keymap_unref(keymap2);
+
+    /* The format is part of the key */
+    struct xkb_keymap * const keymap_v2 =
+        xkb_keymap_new_from_names2(ctx, &us, XKB_KEYMAP_FORMAT_TEXT_V2, 0);
+    assert(keymap_v2 && keymap1 != keymap_v2);
+    assert_keymap_cache_stats(ctx, 1, 2);
+
+    /* Least recently used keymaps are evicted first */
+    keymap2 = xkb_keymap_new_from_names2(ctx, &de, format, 0);
+    assert(keymap2);
+    xkb_keymap_unref(keymap2);
+    keymap2 = xkb_keymap_new_from_names2(ctx, &us, format, 0);
+    assert(keymap2 == keymap1);
+    xkb_keymap_unref(keymap2);
+    keymap2 = xkb_keymap_new_from_names2(ctx, &ch, format, 0);
+    assert(keymap2);
+    xkb_keymap_unref(keymap2);
+    assert_keymap_cache_stats(ctx, 2, 4);
+    keymap2 = xkb_keymap_new_from_names2(ctx, &us, XKB_KEYMAP_FORMAT_TEXT_V2, 0);
+    assert(keymap2 && keymap2 != keymap_v2);
+    xkb_keymap_unref(keymap2);
+    xkb_keymap_unref(keymap_v2);
+    keymap2 = xkb_keymap_new_from_names2(ctx, &us, format, 0);
+    assert(keymap2 == keymap1);
+    xkb_keymap_unref(keymap2);
+    assert_keymap_cache_stats(ctx, 3, 5);
+
+    /* Shrinking the cache keeps the most recently used keymaps */
+    xkb_context_set_keymap_cache_size(ctx, 1);
+    keymap2 = xkb_keymap_new_from_names2(ctx, &us, format, 0);
+    assert(keymap2 == keymap1);
+    xkb_keymap_unref(keymap2);
+    keymap2 = xkb_keymap_new_from_names2(ctx, &ch, format, 0);
+    assert(keymap2);
+    xkb_keymap_unref(keymap2);
+    assert_keymap_cache_stats(ctx, 4, 6);
+
+    /* RMLVO builder */
+    struct xkb_rmlvo_builder *rmlvo =
+        xkb_rmlvo_builder_new(ctx, "evdev", "pc104", XKB_RMLVO_BUILDER_NO_FLAGS);
+    assert(rmlvo);
+    assert(xkb_rmlvo_builder_append_layout(rmlvo, "us", NULL, NULL, 0));
+    keymap2 = xkb_keymap_new_from_rmlvo(rmlvo, format, 0);
+    assert(keymap2 && keymap2 != keymap1);
+    struct xkb_keymap * const keymap3 =
+        xkb_keymap_new_from_rmlvo(rmlvo, format, 0);
+    assert(keymap3 == keymap2);
+    xkb_keymap_unref(keymap3);
+    xkb_keymap_unref(keymap2);
+    assert(xkb_rmlvo_builder_append_option(rmlvo, "caps:none"));
+    keymap2 = xkb_keymap_new_from_rmlvo(rmlvo, format, 0);
+    assert(keymap2);
+    xkb_keymap_unref(keymap2);
+    xkb_rmlvo_builder_unref(rmlvo);
+    assert_keymap_cache_stats(ctx, 5, 8);
+
+    /* Changing the include path invalidates the cache */
+    keymap2 = xkb_keymap_new_from_names2(ctx, &us, format, 0);
+    assert(keymap2 && keymap2 != keymap1);
+    char * const path = test_get_path("");
+    assert(path);
+    assert(xkb_context_include_path_append(ctx, path));
+    free(path);
+    struct xkb_keymap * const keymap4 =
+        xkb_keymap_new_from_names2(ctx, &us, format, 0);
+    assert(keymap4 && keymap4 != keymap2);
+    xkb_keymap_unref(keymap4);
+    xkb_keymap_unref(keymap2);
+    assert_keymap_cache_stats(ctx, 5, 10);
+    xkb_keymap_unref(keymap1);
+
+    /* Explicit clearing */
+    keymap1 = xkb_keymap_new_from_names2(ctx, &us, format, 0);
+    assert(keymap1);
+    assert_keymap_cache_stats(ctx, 6, 10);
+    xkb_context_clear_keymap_cache(ctx);
+    keymap2 = xkb_keymap_new_from_names2(ctx, &us, format, 0);
+    assert(keymap2 && keymap2 != keymap1);
+    assert_keymap_cache_stats(ctx, 6, 11);
+    xkb_keymap_unref(keymap1);
+
+    /*
+     * The cache does not keep the context alive, but the keymaps still
+     * referenced by the user do.
+     */
+    xkb_context_unref(ctx);
+    struct xkb_state * const state = xkb_state_new(keymap2);
+    assert(state);
+    xkb_state_unref(state);
+    xkb_keymap_unref(keymap2);
+
+    /* Unused cached keymaps are released with the context */
+    ctx = test_get_context(0);
+    assert(ctx);
+    xkb_context_set_keymap_cache_size(ctx, 4);
+    keymap1 = xkb_keymap_new_from_names2(ctx, &us, format, 0);
+    assert(keymap1);
+    xkb_keymap_unref(keymap1);
+    xkb_context_unref(ctx);
+}
+
+static void
+write_rules_file(const char *path, const char *symbols)
+{
+    FILE * const file = fopen(path, "w");
+    assert(file);
+    fprintf(file,
+            "! model = keycodes types compat\n"
+            "  *     = evdev    complete complete\n"
+            "\n"
+            "! layout = symbols\n"
+            "  *      = %s\n", symbols);
+    fclose(file);
+}
+
+static const char *
+first_layout_name(struct xkb_context *ctx, const struct xkb_rule_names *names)
+{
+    struct xkb_keymap * const keymap =
+        xkb_keymap_new_from_names2(ctx, names, XKB_KEYMAP_FORMAT_TEXT_V1, 0);
+    assert(keymap);
+    /* Layout names are atoms of the context */
+    const char * const name = xkb_keymap_layout_get_name(keymap, 0);
+    xkb_keymap_unref(keymap);
+    return name;
+}
+
+static void
+test_prewarm(void)
+{
+    struct xkb_context * const ctx = test_get_context(0);
+    assert(ctx);
+
+    /* Rules file that we can modify */
+    const char * const tmpdir = maketmpdir();
+    const char * const rules_dir = makedir(tmpdir, "rules");
+    char * const rules_path = asprintf_safe("%s/prewarm", rules_dir);
+    assert(rules_path);
+    write_rules_file(rules_path, "pc+%l");
+    assert(xkb_context_include_path_append(ctx, tmpdir));
+
+    const struct xkb_rule_names names = {
+        .rules = "prewarm", .model = "pc104", .layout = "us"
+    };
+    for (size_t c = 0; c < ARRAY_SIZE(ctx->compiler_caches); c++)
+        assert(!ctx->compiler_caches[c].data);
+    assert(xkb_context_prewarm(ctx, &names, XKB_KEYMAP_FORMAT_TEXT_V1));
+
+    /* The compiler caches are enabled without the keymap cache */
+    assert_keymap_cache_stats(ctx, 0, 0);
+    for (size_t c = 0; c < ARRAY_SIZE(ctx->compiler_caches); c++)
+        assert(ctx->compiler_caches[c].data);
+
+    /* The next compilations reuse the parsed rules */
+    write_rules_file(rules_path, "pc+de");
+    assert_streq_not_null("Cached rules", "English (US)",
+                          first_layout_name(ctx, &names));
+
+    /* Cleared caches are populated again */
+    xkb_context_clear_keymap_cache(ctx);
+    for (size_t c = 0; c < ARRAY_SIZE(ctx->compiler_caches); c++)
+        assert(!ctx->compiler_caches[c].data);
+    assert_streq_not_null("Updated rules", "German",
+                          first_layout_name(ctx, &names));
+    for (size_t c = 0; c < ARRAY_SIZE(ctx->compiler_caches); c++)
+        assert(ctx->compiler_caches[c].data);
+
+    /* Disabling the keymap cache also disables the compiler caches */
+    xkb_context_set_keymap_cache_size(ctx, 0);
+    for (size_t c = 0; c < ARRAY_SIZE(ctx->compiler_caches); c++)
+        assert(!ctx->compiler_caches[c].data);
+    write_rules_file(rules_path, "pc+ch");
+    assert_streq_not_null("Uncached rules", "German (Switzerland)",
+                          first_layout_name(ctx, &names));
+    for (size_t c = 0; c < ARRAY_SIZE(ctx->compiler_caches); c++)
+        assert(!ctx->compiler_caches[c].data);
+
+    const struct xkb_rule_names invalid = { .rules = "does-not-exist" };
+    assert(!xkb_context_prewarm(ctx, &invalid, XKB_KEYMAP_FORMAT_TEXT_V1));
+
+    xkb_context_unref(ctx);
+    remove(rules_path);
+    free(rules_path);
+    unmakedirs();
+}
+
 int
 main(void)
 {
@@ -396,6 +632,8 @@ main(void)
     test_xdg_include_path_fallback();
     test_include_order();
     test_delayed_includes();
+    test_keymap_cache();
+    test_prewarm();
 
     return EXIT_SUCCESS;
 }
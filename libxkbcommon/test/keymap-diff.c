@@ -0,0 +1,369 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xkbcommon/xkbcommon.h"
+#include "test.h"
+#include "utils.h"
+
+/* Check that applying the diff to `from` results in a keymap identical to `to` */
+static void
+assert_apply(const struct xkb_keymap_diff *diff,
+             struct xkb_keymap *from, struct xkb_keymap *to)
+{
+    struct xkb_keymap * const keymap = xkb_keymap_diff_apply(diff, from);
+    assert(keymap);
+
+    static const enum xkb_keymap_serialize_flags flags[] = {
+        XKB_KEYMAP_SERIALIZE_NO_FLAGS,
+        XKB_KEYMAP_SERIALIZE_KEEP_UNUSED,
+    };
+    for (size_t f = 0; f < ARRAY_SIZE(flags); f++) {
+        char * const expected =
+            xkb_keymap_get_as_string2(to, XKB_KEYMAP_USE_ORIGINAL_FORMAT,
+                                      flags[f]);
+        char * const got =
+            xkb_keymap_get_as_string2(keymap, XKB_KEYMAP_USE_ORIGINAL_FORMAT,
+                                      flags[f]);
+        assert_streq_not_null("Patched keymap", expected, got);
+        free(expected);
+        free(got);
+    }
+
+    uint8_t fingerprint1[XKB_KEYMAP_FINGERPRINT_SIZE];
+    uint8_t fingerprint2[XKB_KEYMAP_FINGERPRINT_SIZE];
+    xkb_keymap_get_fingerprint(to, fingerprint1);
+    xkb_keymap_get_fingerprint(keymap, fingerprint2);
+    assert(memcmp(fingerprint1, fingerprint2, sizeof(fingerprint1)) == 0);
+
+    /* The patched keymap is usable */
+    struct xkb_state * const state = xkb_state_new(keymap);
+    assert(state);
+    xkb_state_unref(state);
+
+    xkb_keymap_unref(keymap);
+}
+
+static bool
+has_key(const struct xkb_keymap_diff *diff, xkb_keycode_t kc)
+{
+    size_t count = 0;
+    const xkb_keycode_t * const keys = xkb_keymap_diff_get_keys(diff, &count);
+    for (size_t k = 0; k < count; k++) {
+        if (keys[k] == kc)
+            return true;
+    }
+    return false;
+}
+
+static void
+test_rmlvo_diff(struct xkb_context *ctx)
+{
+    static const struct {
+        const char *layout;
+        const char *variant;
+        const char *options;
+        enum xkb_keymap_component components;
+        enum { STATE_ANY, STATE_SAME, STATE_CHANGED } state;
+    } tests[] = {
+        /* Same keymap */
+        { "us", NULL, NULL, 0, STATE_SAME },
+        /* Other layouts */
+        { "us", "dvorak", NULL, XKB_KEYMAP_COMPONENT_SYMBOLS, STATE_ANY },
+        { "de", NULL, NULL, XKB_KEYMAP_COMPONENT_SYMBOLS, STATE_ANY },
+        { "us,de", NULL, "grp:menu_toggle", XKB_KEYMAP_COMPONENT_SYMBOLS,
+          STATE_CHANGED },
+        /* Modifiers mapping */
+        { "us", NULL, "caps:ctrl_modifier", XKB_KEYMAP_COMPONENT_SYMBOLS,
+          STATE_CHANGED },
+    };
+
+    struct xkb_keymap * const from =
+        test_compile_rules(ctx, XKB_KEYMAP_FORMAT_TEXT_V1, "evdev", "pc104",
+                           "us", NULL, NULL);
+    assert(from);
+
+    for (size_t t = 0; t < ARRAY_SIZE(tests); t++) {
+        fprintf(stderr, "------\n%s: #%zu\n", __func__, t);
+        struct xkb_keymap * const to =
+            test_compile_rules(ctx, XKB_KEYMAP_FORMAT_TEXT_V1, "evdev", "pc104",
+                               tests[t].layout, tests[t].variant,
+                               tests[t].options);
+        assert(to);
+
+        struct xkb_keymap_diff * const diff = xkb_keymap_diff_new(from, to);
+        assert(diff);
+
+        const enum xkb_keymap_component components =
+            xkb_keymap_diff_get_components(diff);
+        assert((components & tests[t].components) == tests[t].components);
+        assert(!tests[t].components == !components);
+        if (tests[t].state != STATE_ANY) {
+            assert(xkb_keymap_diff_affects_state(diff) ==
+                   (tests[t].state == STATE_CHANGED));
+        }
+
+        size_t count = 0;
+        xkb_keymap_diff_get_keys(diff, &count);
+        assert(!tests[t].components == !count);
+        assert(xkb_keymap_diff_get_leds(diff) == 0);
+
+        assert_apply(diff, from, to);
+
+        xkb_keymap_diff_free(diff);
+        xkb_keymap_unref(to);
+    }
+
+    /* Check the reported keys */
+    struct xkb_keymap * const to =
+        test_compile_rules(ctx, XKB_KEYMAP_FORMAT_TEXT_V1, "evdev", "pc104",
+                           "us", NULL, "caps:ctrl_modifier");
+    assert(to);
+    struct xkb_keymap_diff * const diff = xkb_keymap_diff_new(from, to);
+    assert(diff);
+    const xkb_keycode_t caps = xkb_keymap_key_by_name(to, "CAPS");
+    const xkb_keycode_t lctrl = xkb_keymap_key_by_name(to, "LCTL");
+    assert(has_key(diff, caps));
+    assert(!has_key(diff, lctrl));
+
+    /* The diff must be applied to its source keymap */
+    assert(!xkb_keymap_diff_apply(diff, to));
+
+    xkb_keymap_diff_free(diff);
+    xkb_keymap_unref(to);
+    xkb_keymap_unref(from);
+}
+
+static void
+test_string_diff(struct xkb_context *ctx)
+{
+    const char from_str[] =
+        "xkb_keymap {\n"
+        "  xkb_keycodes {\n"
+        "    <a> = 10;\n"
+        "    <b> = 11;\n"
+        "    <caps> = 66;\n"
+        "    indicator 1 = \"Caps Lock\";\n"
+        "  };\n"
+        "  xkb_types { include \"basic\" };\n"
+        "  xkb_compat { include \"ledcaps\" };\n"
+        "  xkb_symbols {\n"
+        "    key <a> { [a, A] };\n"
+        "    key <b> { [b, B] };\n"
+        "    key <caps> { [Caps_Lock], [LockMods(modifiers=Lock)] };\n"
+        "    modifier_map Lock { <caps> };\n"
+        "  };\n"
+        "};";
+    const char to_str[] =
+        "xkb_keymap {\n"
+        "  xkb_keycodes {\n"
+        "    <a> = 10;\n"
+        "    <c> = 12;\n"
+        "    <caps> = 66;\n"
+        "    <high> = 5000;\n"
+        "    alias <x> = <a>;\n"
+        "    indicator 1 = \"Caps Lock\";\n"
+        "    indicator 2 = \"Num Lock\";\n"
+        "  };\n"
+        "  xkb_types { include \"basic+extra\" };\n"
+        "  xkb_compat {\n"
+        "    include \"ledcaps+lednum\"\n"
+        "    interpret Num_Lock { action = LockMods(modifiers=NumLock); };\n"
+        "  };\n"
+        "  xkb_symbols {\n"
+        "    virtual_modifiers NumLock;\n"
+        "    key <a> { [a, A] };\n"
+        "    key <c> { [c, C] };\n"
+        "    key <caps> { [Caps_Lock], [LockMods(modifiers=Lock)] };\n"
+        "    key <high> { [Num_Lock], [LockMods(modifiers=NumLock)] };\n"
+        "    modifier_map Lock { <caps> };\n"
+        "    modifier_map Mod2 { <high> };\n"
+        "  };\n"
+        "};";
+
+    struct xkb_keymap * const from =
+        test_compile_string(ctx, XKB_KEYMAP_FORMAT_TEXT_V1, from_str);
+    assert(from);
+    struct xkb_keymap * const to =
+        test_compile_string(ctx, XKB_KEYMAP_FORMAT_TEXT_V1, to_str);
+    assert(to);
+
+    struct xkb_keymap_diff *diff = xkb_keymap_diff_new(from, to);
+    assert(diff);
+    const enum xkb_keymap_component components =
+        xkb_keymap_diff_get_components(diff);
+    assert(components & XKB_KEYMAP_COMPONENT_KEYCODES);
+    assert(components & XKB_KEYMAP_COMPONENT_TYPES);
+    assert(components & XKB_KEYMAP_COMPONENT_COMPAT);
+    assert(components & XKB_KEYMAP_COMPONENT_SYMBOLS);
+    assert(components & XKB_KEYMAP_COMPONENT_MODS);
+    assert(components & XKB_KEYMAP_COMPONENT_LEDS);
+    assert(xkb_keymap_diff_affects_state(diff));
+
+    /* Removed, added and changed keys, but not the unchanged keys */
+    size_t count = 0;
+    const xkb_keycode_t * const keys = xkb_keymap_diff_get_keys(diff, &count);
+    const xkb_keycode_t expected_keys[] = { 11, 12, 5000 };
+    assert(count == ARRAY_SIZE(expected_keys));
+    assert(memcmp(keys, expected_keys, sizeof(expected_keys)) == 0);
+
+    /* Only the new virtual modifiers and the new LED changed */
+    const xkb_mod_index_t alt = xkb_keymap_mod_get_index(to, "Alt");
+    const xkb_mod_index_t level3 = xkb_keymap_mod_get_index(to, "LevelThree");
+    assert(alt != XKB_MOD_INVALID && level3 != XKB_MOD_INVALID);
+    assert(xkb_keymap_diff_get_mods(diff) ==
+           ((UINT32_C(1) << alt) | (UINT32_C(1) << level3)));
+    const xkb_led_index_t led = xkb_keymap_led_get_index(to, "Num Lock");
+    assert(led != XKB_LED_INVALID);
+    assert(xkb_keymap_diff_get_leds(diff) == (UINT32_C(1) << led));
+
+    assert_apply(diff, from, to);
+    xkb_keymap_diff_free(diff);
+
+    /* Reverse diff */
+    diff = xkb_keymap_diff_new(to, from);
+    assert(diff);
+    assert(xkb_keymap_diff_get_components(diff) == components);
+    assert_apply(diff, to, from);
+    xkb_keymap_diff_free(diff);
+
+    /* Keysyms changes do not affect the state */
+    char * const str = strdup(from_str);
+    assert(str);
+    char * const b = strstr(str, "[b, B]");
+    assert(b);
+    memcpy(b, "[x, X]", sizeof("[x, X]") - 1);
+    struct xkb_keymap * const keysyms =
+        test_compile_string(ctx, XKB_KEYMAP_FORMAT_TEXT_V1, str);
+    free(str);
+    assert(keysyms);
+    diff = xkb_keymap_diff_new(from, keysyms);
+    assert(diff);
+    assert(xkb_keymap_diff_get_components(diff) == XKB_KEYMAP_COMPONENT_SYMBOLS);
+    assert(!xkb_keymap_diff_affects_state(diff));
+    assert(xkb_keymap_diff_get_keys(diff, &count)[0] == 11 && count == 1);
+    assert(xkb_keymap_diff_get_mods(diff) == 0);
+    assert_apply(diff, from, keysyms);
+    xkb_keymap_diff_free(diff);
+    xkb_keymap_unref(keysyms);
+
+    /* Keymaps with different contexts cannot be compared */
+    struct xkb_context * const ctx2 = test_get_context(CONTEXT_NO_FLAG);
+    assert(ctx2);
+    struct xkb_keymap * const other =
+        test_compile_string(ctx2, XKB_KEYMAP_FORMAT_TEXT_V1, to_str);
+    assert(other);
+    assert(!xkb_keymap_diff_new(from, other));
+    xkb_keymap_unref(other);
+    xkb_context_unref(ctx2);
+
+    xkb_keymap_unref(to);
+    xkb_keymap_unref(from);
+}
+
+/* The diff checks the items of its source keymap that the fingerprint ignores */
+static void
+test_fingerprint_equal_source(struct xkb_context *ctx)
+{
+    const char from_str[] =
+        "xkb_keymap {\n"
+        "  xkb_keycodes {\n"
+        "    <a> = 10;\n"
+        "    <b> = 11;\n"
+        "  };\n"
+        "  xkb_types { include \"basic\" };\n"
+        "  xkb_compat {\n"
+        "    interpret Num_Lock { action = LockMods(modifiers=Mod2); };\n"
+        "  };\n"
+        "  xkb_symbols {\n"
+        "    key <a> { [a, A] };\n"
+        "    key <b> { [b, B] };\n"
+        "  };\n"
+        "};";
+    /* Same as above, but with another unused interpretation */
+    const char other_str[] =
+        "xkb_keymap {\n"
+        "  xkb_keycodes {\n"
+        "    <a> = 10;\n"
+        "    <b> = 11;\n"
+        "  };\n"
+        "  xkb_types { include \"basic\" };\n"
+        "  xkb_compat {\n"
+        "    interpret Num_Lock { action = LockMods(modifiers=Mod5); };\n"
+        "  };\n"
+        "  xkb_symbols {\n"
+        "    key <a> { [a, A] };\n"
+        "    key <b> { [b, B] };\n"
+        "  };\n"
+        "};";
+    /* Same as `from_str`, but with a change on <b> */
+    const char to_str[] =
+        "xkb_keymap {\n"
+        "  xkb_keycodes {\n"
+        "    <a> = 10;\n"
+        "    <b> = 11;\n"
+        "  };\n"
+        "  xkb_types { include \"basic\" };\n"
+        "  xkb_compat {\n"
+        "    interpret Num_Lock { action = LockMods(modifiers=Mod2); };\n"
+        "  };\n"
+        "  xkb_symbols {\n"
+        "    key <a> { [a, A] };\n"
+        "    key <b> { [x, X] };\n"
+        "  };\n"
+        "};";
+
+    struct xkb_keymap * const from =
+        test_compile_string(ctx, XKB_KEYMAP_FORMAT_TEXT_V1, from_str);
+    assert(from);
+    struct xkb_keymap * const other =
+        test_compile_string(ctx, XKB_KEYMAP_FORMAT_TEXT_V1, other_str);
+    assert(other);
+    struct xkb_keymap * const to =
+        test_compile_string(ctx, XKB_KEYMAP_FORMAT_TEXT_V1, to_str);
+    assert(to);
+
+    /* The keymaps differ only by their interpretations */
+    uint8_t fingerprint1[XKB_KEYMAP_FINGERPRINT_SIZE];
+    uint8_t fingerprint2[XKB_KEYMAP_FINGERPRINT_SIZE];
+    xkb_keymap_get_fingerprint(from, fingerprint1);
+    xkb_keymap_get_fingerprint(other, fingerprint2);
+    assert(memcmp(fingerprint1, fingerprint2, sizeof(fingerprint1)) == 0);
+
+    struct xkb_keymap_diff * const diff = xkb_keymap_diff_new(from, to);
+    assert(diff);
+    assert(xkb_keymap_diff_get_components(diff) == XKB_KEYMAP_COMPONENT_SYMBOLS);
+    assert_apply(diff, from, to);
+
+    /* Would copy the wrong interpretations */
+    assert(!xkb_keymap_diff_apply(diff, other));
+
+    xkb_keymap_diff_free(diff);
+    xkb_keymap_unref(to);
+    xkb_keymap_unref(other);
+    xkb_keymap_unref(from);
+}
+
+int
+main(void)
+{
+    test_init();
+
+    struct xkb_context * const ctx = test_get_context(CONTEXT_NO_FLAG);
+    assert(ctx);
+
+    test_rmlvo_diff(ctx);
+    test_string_diff(ctx);
+    test_fingerprint_equal_source(ctx);
+
+    xkb_context_unref(ctx);
+    return EXIT_SUCCESS;
+}
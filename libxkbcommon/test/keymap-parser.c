@@ -0,0 +1,477 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Cross-check the parsers of the keymap text format: they must accept the
+ * same inputs and produce the same AST.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if HAVE_DIRENT_H
+#include <dirent.h>
+#endif
+
+#include "xkbcommon/xkbcommon.h"
+#include "src/xkbcomp/ast.h"
+#include "src/xkbcomp/xkbcomp-priv.h"
+#include "test.h"
+#include "utils.h"
+
+static bool
+stmt_equal(const ParseCommon *a, const ParseCommon *b, bool top_level);
+
+static bool
+include_equal(const IncludeStmt *a, const IncludeStmt *b)
+{
+    for (; a && b; a = a->next_incl, b = b->next_incl) {
+        if (a->merge != b->merge || !streq_null(a->stmt, b->stmt) ||
+            !streq_null(a->file, b->file) || !streq_null(a->map, b->map) ||
+            !streq_null(a->modifier, b->modifier))
+            return false;
+    }
+    return !a && !b;
+}
+
+#define expr_equal(a, b) \
+    stmt_equal((const ParseCommon *) (a), (const ParseCommon *) (b), false)
+
+/*
+ * Compare two lists of statements. The merge mode of the variables is only
+ * set for the top-level declarations.
+ */
+static bool
+stmt_equal(const ParseCommon *a, const ParseCommon *b, bool top_level)
+{
+    for (; a && b; a = a->next, b = b->next) {
+        if (a->type != b->type)
+            return false;
+
+        const ExprDef *ea = (const ExprDef *) a;
+        const ExprDef *eb = (const ExprDef *) b;
+        bool ok;
+
+        switch (a->type) {
+        case STMT_INCLUDE:
+            ok = include_equal((const IncludeStmt *) a,
+                               (const IncludeStmt *) b);
+            break;
+        case STMT_KEYCODE: {
+            const KeycodeDef *da = (const KeycodeDef *) a;
+            const KeycodeDef *db = (const KeycodeDef *) b;
+            ok = da->merge == db->merge && da->name == db->name &&
+                 da->value == db->value;
+            break;
+        }
+        case STMT_ALIAS: {
+            const KeyAliasDef *da = (const KeyAliasDef *) a;
+            const KeyAliasDef *db = (const KeyAliasDef *) b;
+            ok = da->merge == db->merge && da->alias == db->alias &&
+                 da->real == db->real;
+            break;
+        }
+        case STMT_EXPR_STRING_LITERAL:
+            ok = ea->string.str == eb->string.str;
+            break;
+        case STMT_EXPR_INTEGER_LITERAL:
+            ok = ea->integer.ival == eb->integer.ival;
+            break;
+        case STMT_EXPR_FLOAT_LITERAL:
+        case STMT_EXPR_EMPTY_LIST:
+            ok = true;
+            break;
+        case STMT_EXPR_BOOLEAN_LITERAL:
+            ok = ea->boolean.set == eb->boolean.set;
+            break;
+        case STMT_EXPR_KEYNAME_LITERAL:
+            ok = ea->key_name.key_name == eb->key_name.key_name;
+            break;
+        case STMT_EXPR_KEYSYM_LITERAL:
+            ok = ea->keysym.keysym == eb->keysym.keysym;
+            break;
+        case STMT_EXPR_IDENT:
+            ok = ea->ident.ident == eb->ident.ident;
+            break;
+        case STMT_EXPR_ACTION_DECL:
+            ok = ea->action.name == eb->action.name &&
+                 expr_equal(ea->action.args, eb->action.args);
+            break;
+        case STMT_EXPR_FIELD_REF:
+            ok = ea->field_ref.element == eb->field_ref.element &&
+                 ea->field_ref.field == eb->field_ref.field;
+            break;
+        case STMT_EXPR_ARRAY_REF:
+            ok = ea->array_ref.element == eb->array_ref.element &&
+                 ea->array_ref.field == eb->array_ref.field &&
+                 expr_equal(ea->array_ref.entry, eb->array_ref.entry);
+            break;
+        case STMT_EXPR_KEYSYM_LIST:
+            ok = darray_size(ea->keysym_list.syms) ==
+                 darray_size(eb->keysym_list.syms) &&
+                 (darray_empty(ea->keysym_list.syms) ||
+                  memcmp(darray_items(ea->keysym_list.syms),
+                         darray_items(eb->keysym_list.syms),
+                         darray_size(ea->keysym_list.syms) *
+                         sizeof(xkb_keysym_t)) == 0);
+            break;
+        case STMT_EXPR_ACTION_LIST:
+            ok = expr_equal(ea->actions.actions, eb->actions.actions);
+            break;
+        case STMT_EXPR_ADD:
+        case STMT_EXPR_SUBTRACT:
+        case STMT_EXPR_MULTIPLY:
+        case STMT_EXPR_DIVIDE:
+        case STMT_EXPR_ASSIGN:
+            ok = expr_equal(ea->binary.left, eb->binary.left) &&
+                 expr_equal(ea->binary.right, eb->binary.right);
+            break;
+        case STMT_EXPR_NOT:
+        case STMT_EXPR_NEGATE:
+        case STMT_EXPR_INVERT:
+        case STMT_EXPR_UNARY_PLUS:
+            ok = expr_equal(ea->unary.child, eb->unary.child);
+            break;
+        case STMT_VAR: {
+            const VarDef *da = (const VarDef *) a;
+            const VarDef *db = (const VarDef *) b;
+            ok = (!top_level || da->merge == db->merge) &&
+                 expr_equal(da->name, db->name) &&
+                 expr_equal(da->value, db->value);
+            break;
+        }
+        case STMT_TYPE: {
+            const KeyTypeDef *da = (const KeyTypeDef *) a;
+            const KeyTypeDef *db = (const KeyTypeDef *) b;
+            ok = da->merge == db->merge && da->name == db->name &&
+                 expr_equal(da->body, db->body);
+            break;
+        }
+        case STMT_INTERP: {
+            const InterpDef *da = (const InterpDef *) a;
+            const InterpDef *db = (const InterpDef *) b;
+            ok = da->merge == db->merge && da->sym == db->sym &&
+                 expr_equal(da->match, db->match) &&
+                 expr_equal(da->def, db->def);
+            break;
+        }
+        case STMT_VMOD: {
+            const VModDef *da = (const VModDef *) a;
+            const VModDef *db = (const VModDef *) b;
+            ok = da->merge == db->merge && da->name == db->name &&
+                 expr_equal(da->value, db->value);
+            break;
+        }
+        case STMT_SYMBOLS: {
+            const SymbolsDef *da = (const SymbolsDef *) a;
+            const SymbolsDef *db = (const SymbolsDef *) b;
+            ok = da->merge == db->merge && da->keyName == db->keyName &&
+                 expr_equal(da->symbols, db->symbols);
+            break;
+        }
+        case STMT_MODMAP: {
+            const ModMapDef *da = (const ModMapDef *) a;
+            const ModMapDef *db = (const ModMapDef *) b;
+            ok = da->merge == db->merge && da->modifier == db->modifier &&
+                 expr_equal(da->keys, db->keys);
+            break;
+        }
+        case STMT_GROUP_COMPAT: {
+            const GroupCompatDef *da = (const GroupCompatDef *) a;
+            const GroupCompatDef *db = (const GroupCompatDef *) b;
+            ok = da->merge == db->merge && da->group == db->group &&
+                 expr_equal(da->def, db->def);
+            break;
+        }
+        case STMT_LED_MAP: {
+            const LedMapDef *da = (const LedMapDef *) a;
+            const LedMapDef *db = (const LedMapDef *) b;
+            ok = da->merge == db->merge && da->name == db->name &&
+                 expr_equal(da->body, db->body);
+            break;
+        }
+        case STMT_LED_NAME: {
+            const LedNameDef *da = (const LedNameDef *) a;
+            const LedNameDef *db = (const LedNameDef *) b;
+            ok = da->merge == db->merge && da->ndx == db->ndx &&
+                 da->virtual == db->virtual && expr_equal(da->name, db->name);
+            break;
+        }
+        default:
+            fprintf(stderr, "ERROR: unexpected statement: %s\n",
+                    stmt_type_to_string(a->type));
+            ok = false;
+        }
+
+        if (!ok)
+            return false;
+    }
+    return !a && !b;
+}
+
+static bool
+xkb_file_equal(const XkbFile *a, const XkbFile *b)
+{
+    for (; a && b; a = (const XkbFile *) a->common.next,
+                   b = (const XkbFile *) b->common.next) {
+        if (a->file_type != b->file_type || a->flags != b->flags ||
+            !streq_null(a->name, b->name))
+            return false;
+        if (a->file_type == FILE_TYPE_KEYMAP) {
+            if (!xkb_file_equal((const XkbFile *) a->defs,
+                                (const XkbFile *) b->defs))
+                return false;
+        } else if (!stmt_equal(a->defs, b->defs, true)) {
+            return false;
+        }
+    }
+    return !a && !b;
+}
+
+/* Parse all the maps of a string with both parsers and compare the results */
+static bool
+check_string(struct xkb_context *ctx, const char *name,
+             const char *string, size_t len, const char *map)
+{
+    struct scanner bison_scanner, rd_scanner;
+    if (!XkbParseStringInit(ctx, &bison_scanner, string, len, name, map) ||
+        !XkbParseStringInit(ctx, &rd_scanner, string, len, name, map))
+        return true;
+
+    unsigned int count = 0;
+    for (;; count++) {
+        XkbFile *bison_file = NULL;
+        XkbFile *rd_file = NULL;
+        const bool bison_ok = XkbParseStringNextWithParser(
+            ctx, &bison_scanner, KEYMAP_TEXT_PARSER_BISON, map, &bison_file
+        );
+        const bool rd_ok = XkbParseStringNextWithParser(
+            ctx, &rd_scanner, KEYMAP_TEXT_PARSER_HANDWRITTEN, map, &rd_file
+        );
+        const bool equal = xkb_file_equal(bison_file, rd_file);
+        FreeXkbFile(bison_file);
+        FreeXkbFile(rd_file);
+        if (bison_ok != rd_ok || !equal) {
+            fprintf(stderr, "ERROR: %s, map #%u (%s): parsers mismatch: "
+                    "status: %d/%d, AST equal: %d\n", name, count,
+                    (map ? map : "(no map)"), bison_ok, rd_ok, equal);
+            return false;
+        }
+        if (!bison_ok || !bison_file || map)
+            break;
+    }
+    return true;
+}
+
+static bool
+check_file(struct xkb_context *ctx, const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    char *string = read_file(path, file);
+    if (!string) {
+        fprintf(stderr, "ERROR: cannot read file: %s\n", path);
+        return false;
+    }
+    const bool ok = check_string(ctx, path, string, strlen(string), NULL);
+    free(string);
+    return ok;
+}
+
+/* Check all the files of a directory, recursively */
+static unsigned int
+check_directory(struct xkb_context *ctx, const char *path, bool *ok)
+{
+    unsigned int count = 0;
+#if HAVE_DIRENT_H
+    DIR *dir = opendir(path);
+    if (!dir)
+        return 0;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.')
+            continue;
+        char *entry_path = asprintf_safe("%s/%s", path, entry->d_name);
+        assert(entry_path);
+        struct stat info;
+        if (stat(entry_path, &info) == 0) {
+            if (S_ISDIR(info.st_mode)) {
+                count += check_directory(ctx, entry_path, ok);
+            } else if (S_ISREG(info.st_mode)) {
+                *ok &= check_file(ctx, entry_path);
+                count++;
+            }
+        }
+        free(entry_path);
+    }
+    closedir(dir);
+#else
+    (void) ctx;
+    (void) path;
+    (void) ok;
+#endif
+    return count;
+}
+
+static void
+test_corpora(struct xkb_context *ctx)
+{
+    static const char *dirs[] = {
+        "keymaps", "keycodes", "types", "compat", "symbols",
+        "extensions", "extra",
+    };
+
+    bool ok = true;
+    unsigned int count = 0;
+    for (size_t k = 0; k < ARRAY_SIZE(dirs); k++) {
+        char *path = test_get_path(dirs[k]);
+        assert(path);
+        count += check_directory(ctx, path, &ok);
+        free(path);
+    }
+
+    /* Fuzzing corpus */
+    const char *srcdir = getenv("top_srcdir");
+    char *path = asprintf_safe("%s/fuzz/keymap/testcases",
+                               (srcdir ? srcdir : "."));
+    assert(path);
+    count += check_directory(ctx, path, &ok);
+    free(path);
+
+    fprintf(stderr, "Checked %u files\n", count);
+    assert(ok);
+}
+
+static void
+test_snippets(struct xkb_context *ctx)
+{
+    static const struct {
+        const char *input;
+        const char *map;
+    } tests[] = {
+        /* Flags, names, includes, virtual modifiers */
+        {
+            "default partial alphanumeric_keys xkb_symbols \"a\" {\n"
+            "  include \"us\" augment \"de(nodeadkeys)+fr:2|ru\"\n"
+            "  replace \"\" alternate \"x\"\n"
+            "  virtual_modifiers A, B = 1;\n"
+            "  override virtual_modifiers C = Mod1 + Mod2;\n"
+            "};\n"
+            "hidden xkb_symbols \"b\" { augment key <A> { [a] }; };\n"
+            "xkb_symbols \"c\" { name[Group1] = \"C\"; };",
+            "b"
+        },
+        /* Keysyms and actions lists */
+        {
+            "xkb_symbols {\n"
+            "  key <A> { [ {}, {}, a, \"bc\", {}, {d, \"ef\", 0x20, 1} ] };\n"
+            "  key <B> { [ , a ], [ {}, SetMods(mods = Shift), {} ] };\n"
+            "  key <C> { [ {} ], [], [{}, {}] };\n"
+            "  key <D> { [ {NoAction(), NoAction()}, SetGroup(group=1) ] };\n"
+            "  key <E> { type[1] = \"X\", symbols[2] = [section, 9, 10],\n"
+            "            !repeat, locks, actions = [{}, {}, LockMods()] };\n"
+            "  key <F> { };\n"
+            "  key.type = \"ONE_LEVEL\";\n"
+            "  modifier_map Mod1 { <A>, a, \"b\", 0x61 };\n"
+            "};",
+            NULL
+        },
+        /* Expressions */
+        {
+            "xkb_compat {\n"
+            "  interpret Any + AnyOf(all) { action = NoAction(); };\n"
+            "  interpret \"a\" { useModMapMods = level1; };\n"
+            "  interpret.repeat = False;\n"
+            "  x = a + b * c - d / e;\n"
+            "  y = a + b = c * d + e;\n"
+            "  z = -a + !b * ~(c + +d);\n"
+            "  w = f(, x = y, g.h, i[1], j.k[2], 1.5, <KEY>, { A() });\n"
+            "  group 1 = Mod1; indicator 2 = \"LED\"; virtual indicator 3 = \"V\";\n"
+            "  indicator \"Caps Lock\" { !allowExplicit; whichModState = Locked; };\n"
+            "  x; !y;\n"
+            "};",
+            NULL
+        },
+        /* Geometry */
+        {
+            "xkb_geometry \"g\" {\n"
+            "  shape \"s\" { { [1, 2], [3, -4.5] }, approx = { [0, 0] }, c = 1 };\n"
+            "  shape \"t\" { [1, 2] };\n"
+            "  section \"x\" {\n"
+            "    row { keys { <A>, { <B>, 1 } }; top = 1; };\n"
+            "    text \"t\" { x = 1; }; indicator \"i\" { x = 1; };\n"
+            "    overlay \"o\" { <A> = <B>, <C> = <D> }; left = 1;\n"
+            "  };\n"
+            "  text.color = \"red\"; outline \"o\" { }; solid \"s\" { };\n"
+            "};",
+            NULL
+        },
+        /* Composite maps */
+        {
+            "xkb_keymap \"k\" {\n"
+            "  xkb_keycodes { <A> = 9; alias <B> = <A>; };\n"
+            "  xkb_types { type \"T\" { modifiers = None; map[None] = 1; }; };\n"
+            "  partial xkb_compat \"c\" { };\n"
+            "  xkb_symbols { };\n"
+            "};",
+            NULL
+        },
+        { "xkb_semantics { };", NULL },
+        { "", NULL },
+        { "// comment only", NULL },
+        /* Syntax errors */
+        { "xkb_keymap {", NULL },
+        { "xkb_keymap { }; xkb_symbols { };", NULL },
+        { "xkb_symbols { }; xkb_symbols { ", NULL },
+        { "xkb_symbols { }; xkb_keymap { }; xkb_symbols { };", NULL },
+        { "partial", NULL },
+        { "xkb_symbols { key <A> { [ {} a ] }; };", NULL },
+        { "xkb_symbols { key <A> { [ , ] }; };", NULL },
+        { "xkb_symbols { key <A> { [ a, SetMods() ] }; };", NULL },
+        { "xkb_symbols { key <A> { [ SetMods(), a ] }; };", NULL },
+        { "xkb_symbols { key <A> { [ default ] }; };", NULL },
+        { "xkb_symbols { key <A> { type }; };", NULL },
+        { "xkb_symbols { \"us\" };", NULL },
+        { "xkb_compat { x = -a = b; };", NULL },
+        { "xkb_compat { x = (a) = b; };", NULL },
+        { "xkb_compat { x = f(,); };", NULL },
+        { "xkb_compat { x.y; };", NULL },
+        { "xkb_compat { interpret \"ab\" { }; };", NULL },
+        { "xkb_geometry { shape \"s\" { { } }; };", NULL },
+        { "xkb_geometry { section \"s\" { }; };", NULL },
+        { "xkb_keycodes { <A> = 1 }; };", NULL },
+        { "xkb_keycodes { <A> = \"1\"; };", NULL },
+        { "xkb_keycodes { <A = 1; };", NULL },
+        { "xkb_symbols { key <A> { [ \"\\xff\" ] }; };", NULL },
+    };
+
+    for (size_t k = 0; k < ARRAY_SIZE(tests); k++) {
+        fprintf(stderr, "------\n*** %s: #%zu ***\n", __func__, k);
+        assert(check_string(ctx, "(input string)", tests[k].input,
+                            strlen(tests[k].input), tests[k].map));
+    }
+}
+
+int
+main(void)
+{
+    test_init();
+
+    struct xkb_context *ctx = test_get_context(CONTEXT_NO_FLAG);
+    assert(ctx);
+    /* Only errors matter here, and each one is logged twice */
+    xkb_context_set_log_level(ctx, XKB_LOG_LEVEL_CRITICAL);
+
+    test_snippets(ctx);
+    test_corpora(ctx);
+
+    xkb_context_unref(ctx);
+    return EXIT_SUCCESS;
+}
@@ -8,8 +8,12 @@
 #include "config.h"
 
 #include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#ifdef HAVE_MEMFD_CREATE
+#include <fcntl.h>
+#endif
 
 #include "xkbcommon/xkbcommon.h"
 #include "xkbcommon/xkbcommon-keysyms.h"
@@ -726,6 +730,189 @@ test_issue_934(void)
     xkb_context_unref(context);
 }
 
+struct chunks {
+    char *string;
+    size_t size;
+    unsigned int count;
+    unsigned int max_count;
+};
+
+static bool
+append_chunk(const char *chunk, size_t size, void *data)
+{
+    struct chunks *chunks = data;
+    assert(size > 0);
+    if (chunks->count++ >= chunks->max_count)
+        return false;
+    chunks->string = realloc(chunks->string, chunks->size + size + 1);
+    assert(chunks->string);
+    memcpy(chunks->string + chunks->size, chunk, size);
+    chunks->size += size;
+    chunks->string[chunks->size] = '\0';
+    return true;
+}
+
+static void
+test_streaming_serialization(void)
+{
+    struct xkb_context *context = test_get_context(CONTEXT_NO_FLAG);
+    assert(context);
+
+    struct xkb_keymap *keymap =
+        test_compile_rules(context, XKB_KEYMAP_FORMAT_TEXT_V2, "evdev",
+                           "pc104", "us,de,ru,il", NULL,
+                           "grp:menu_toggle,ctrl:nocaps");
+    assert(keymap);
+
+    const enum xkb_keymap_serialize_flags flags[] = {
+        XKB_KEYMAP_SERIALIZE_NO_FLAGS,
+        XKB_KEYMAP_SERIALIZE_PRETTY,
+        XKB_KEYMAP_SERIALIZE_KEEP_UNUSED,
+        XKB_KEYMAP_SERIALIZE_PRETTY | XKB_KEYMAP_SERIALIZE_KEEP_UNUSED,
+    };
+    for (size_t f = 0; f < ARRAY_SIZE(flags); f++) {
+        for (enum xkb_keymap_format format = XKB_KEYMAP_FORMAT_TEXT_V1;
+             format <= XKB_KEYMAP_FORMAT_TEXT_V2; format++) {
+            char *expected = xkb_keymap_get_as_string2(keymap, format,
+                                                       flags[f]);
+            assert(expected);
+            const size_t expected_size = strlen(expected);
+
+            /* Callback */
+            struct chunks chunks = { .max_count = UINT_MAX };
+            assert(xkb_keymap_write(keymap, format, flags[f],
+                                    append_chunk, &chunks));
+            assert(chunks.count > 1);
+            assert_streq_not_null("callback", expected, chunks.string);
+
+            /* Aborted by the callback */
+            const unsigned int count = chunks.count;
+            chunks.count = 0;
+            chunks.max_count = count / 2;
+            assert(!xkb_keymap_write(keymap, format, flags[f],
+                                     append_chunk, &chunks));
+            assert(chunks.count == count / 2 + 1);
+            free(chunks.string);
+
+            /* File descriptor */
+            FILE *file = tmpfile();
+            assert(file);
+            assert(xkb_keymap_write_to_fd(keymap, fileno(file), format,
+                                          flags[f]));
+            rewind(file);
+            char *got = calloc(expected_size + 2, 1);
+            assert(got);
+            assert(fread(got, 1, expected_size + 1, file) == expected_size);
+            fclose(file);
+            assert_streq_not_null("file descriptor", expected, got);
+
+#ifdef HAVE_MEMFD_CREATE
+            /* Sealed memory file */
+            size_t size = 0;
+            const int fd = xkb_keymap_get_as_memfd(keymap, format, flags[f],
+                                                   &size);
+            assert(fd >= 0);
+            assert(size == expected_size + 1);
+            const int seals = fcntl(fd, F_GET_SEALS);
+            assert(seals >= 0);
+            assert((seals & F_SEAL_WRITE) && (seals & F_SEAL_SHRINK) &&
+                   (seals & F_SEAL_GROW) && (seals & F_SEAL_SEAL));
+            memset(got, 0xff, expected_size + 2);
+            assert(pread(fd, got, expected_size + 2, 0) == (ssize_t) size);
+            assert(got[expected_size] == '\0');
+            assert_streq_not_null("memfd", expected, got);
+            assert(write(fd, "x", 1) < 0);
+            close(fd);
+#endif
+
+            free(got);
+            free(expected);
+        }
+    }
+
+    /* Invalid flags */
+    struct chunks chunks = { .max_count = UINT_MAX };
+    assert(!xkb_keymap_write(keymap, XKB_KEYMAP_FORMAT_TEXT_V1, 0xf000,
+                             append_chunk, &chunks));
+    assert(chunks.count == 0);
+
+    /* Invalid file descriptor */
+    assert(!xkb_keymap_write_to_fd(keymap, -1, XKB_KEYMAP_FORMAT_TEXT_V1,
+                                   XKB_KEYMAP_SERIALIZE_NO_FLAGS));
+
+    xkb_keymap_unref(keymap);
+    xkb_context_unref(context);
+}
+
+static void
+test_cached_serialization(void)
+{
+    struct xkb_context *context = test_get_context(CONTEXT_NO_FLAG);
+    assert(context);
+
+    struct xkb_keymap *keymap =
+        test_compile_rules(context, XKB_KEYMAP_FORMAT_TEXT_V1, "evdev",
+                           "pc104", "us,de", NULL, "grp:menu_toggle");
+    assert(keymap);
+
+    const char *previous = NULL;
+    for (enum xkb_keymap_format format = XKB_KEYMAP_FORMAT_TEXT_V1;
+         format <= XKB_KEYMAP_FORMAT_TEXT_V2; format++) {
+        for (enum xkb_keymap_serialize_flags flags = 0;
+             flags <= (XKB_KEYMAP_SERIALIZE_PRETTY |
+                       XKB_KEYMAP_SERIALIZE_KEEP_UNUSED);
+             flags++) {
+            char *expected = xkb_keymap_get_as_string2(keymap, format, flags);
+            assert(expected);
+
+            size_t length = 0;
+            const char *cached =
+                xkb_keymap_get_as_cached_string(keymap, format, flags, &length);
+            assert(cached);
+            assert(cached != previous);
+            assert(length == strlen(expected));
+            assert_streq_not_null("cached", expected, cached);
+            free(expected);
+
+            /* Same string on further calls */
+            assert(xkb_keymap_get_as_cached_string(keymap, format, flags,
+                                                   NULL) == cached);
+
+            /* Other serialization functions use the cache */
+            char *copy = xkb_keymap_get_as_string2(keymap, format, flags);
+            assert(copy && copy != cached);
+            assert_streq_not_null("copy", cached, copy);
+            free(copy);
+            struct chunks chunks = { .max_count = UINT_MAX };
+            assert(xkb_keymap_write(keymap, format, flags,
+                                    append_chunk, &chunks));
+            assert(chunks.count == 1);
+            assert_streq_not_null("write", cached, chunks.string);
+            free(chunks.string);
+
+            previous = cached;
+        }
+    }
+
+    /* Original format */
+    assert(xkb_keymap_get_as_cached_string(keymap,
+                                           XKB_KEYMAP_USE_ORIGINAL_FORMAT,
+                                           XKB_KEYMAP_SERIALIZE_NO_FLAGS,
+                                           NULL) ==
+           xkb_keymap_get_as_cached_string(keymap, XKB_KEYMAP_FORMAT_TEXT_V1,
+                                           XKB_KEYMAP_SERIALIZE_NO_FLAGS,
+                                           NULL));
+
+    /* Invalid arguments */
+    assert(!xkb_keymap_get_as_cached_string(keymap, XKB_KEYMAP_FORMAT_TEXT_V1,
+                                            0xf000, NULL));
+    assert(!xkb_keymap_get_as_cached_string(keymap, 0, 0, NULL));
+    assert(!xkb_keymap_get_as_cached_string(keymap, 1000, 0, NULL));
+
+    xkb_keymap_unref(keymap);
+    xkb_context_unref(context);
+}
+
 int
 main(void)
 {
@@ -740,6 +927,8 @@ main(void)
     test_multiple_actions_per_level();
     test_keynames_atoms();
     test_issue_934();
+    test_streaming_serialization();
+    test_cached_serialization();
 
     return EXIT_SUCCESS;
 }
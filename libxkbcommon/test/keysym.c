@@ -411,6 +411,110 @@ test_utf32_to_keysym(uint32_t ucs, xkb_keysym_t expected)
     return expected == actual;
 }
 
+/* Check the generated lookup tables against the reference table */
+static void
+test_legacy_keysyms_tables(void)
+{
+    for (xkb_keysym_t ks = 0; ks <= 0xffff; ks++) {
+        if ((ks & 0xff00) == 0xff00)
+            continue; /* special keysyms */
+        const bool latin1 = (ks >= 0x0020 && ks <= 0x007e) ||
+                            (ks >= 0x00a0 && ks <= 0x00ff);
+        const uint32_t expected = (latin1)
+            ? ks
+            : xkb_keysymtab_keysym_to_utf32(ks);
+        const uint32_t actual = xkb_keysym_to_utf32(ks);
+        assert_printf(actual == expected,
+                      "keysym 0x%04"PRIx32": expected U+%04"PRIX32", "
+                      "got: U+%04"PRIX32"\n", ks, expected, actual);
+    }
+
+    for (uint32_t cp = 0x0100; cp <= 0xffff; cp++) {
+        if (cp >= 0xd800 && cp <= 0xdfff)
+            continue; /* surrogates */
+        xkb_keysym_t expected = xkb_keysymtab_utf32_to_keysym(cp);
+        if (expected == XKB_KEY_NoSymbol)
+            expected = cp + XKB_KEYSYM_UNICODE_OFFSET;
+        const xkb_keysym_t actual = xkb_utf32_to_keysym(cp);
+        assert_printf(actual == expected,
+                      "U+%04"PRIX32": expected keysym 0x%04"PRIx32", "
+                      "got: 0x%04"PRIx32"\n", cp, expected, actual);
+    }
+}
+
+static void
+test_bulk_conversions(void)
+{
+    static const struct { uint32_t first; uint32_t last; } ranges[] = {
+        /* Latin-1 and legacy keysyms/code points */
+        { 0x0000, 0x3200 },
+        /* Special keysyms */
+        { 0xfe00, 0xffff },
+        /* Unicode keysyms; includes surrogates */
+        { XKB_KEYSYM_UNICODE_OFFSET, XKB_KEYSYM_UNICODE_OFFSET + 0x10000 },
+        { XKB_KEYSYM_UNICODE_MAX - 0x10, XKB_KEYSYM_UNICODE_MAX + 0x10 },
+        /* Non-BMP code points */
+        { 0x1f600, 0x1f64f },
+        { 0x10fff0, 0x110010 },
+        { 0xfffffff0, 0xffffffff },
+    };
+
+    darray(uint32_t) values = darray_new();
+    for (size_t r = 0; r < ARRAY_SIZE(ranges); r++) {
+        for (uint32_t v = ranges[r].first; ; v++) {
+            darray_append(values, v);
+            if (v == ranges[r].last)
+                break;
+        }
+    }
+    /* Mix the fast and the slow paths in the same blocks */
+    const uint32_t mixed[] = { 'a', 'B', 0x01000000 + 'c', 0x06c1, 0x20ac, 'z' };
+    darray_append_items(values, mixed, (darray_size_t) ARRAY_SIZE(mixed));
+
+    const size_t count = darray_size(values);
+    uint32_t *results = calloc(count, sizeof(*results));
+    assert(results);
+
+    /*
+     * Check both the vectorized path, if any, and the scalar fallback against
+     * the scalar functions. Shift the input, so that the values fall at every
+     * position of a block, with different neighbors.
+     */
+    for (size_t offset = 0; offset < 4; offset++) {
+        const uint32_t * const input = darray_items(values) + offset;
+        const size_t n = count - offset;
+
+        /* Keysym to UTF-32 */
+        xkb_keysyms_to_utf32(input, results, n);
+        for (size_t k = 0; k < n; k++)
+            assert(results[k] == xkb_keysym_to_utf32(input[k]));
+
+        /* UTF-32 to keysym */
+        xkb_utf32_to_keysyms(input, results, n);
+        for (size_t k = 0; k < n; k++)
+            assert(results[k] == xkb_utf32_to_keysym(input[k]));
+
+        /* Case mappings */
+        xkb_keysyms_to_upper(input, results, n);
+        for (size_t k = 0; k < n; k++)
+            assert(results[k] == xkb_keysym_to_upper(input[k]));
+        xkb_keysyms_to_lower(input, results, n);
+        for (size_t k = 0; k < n; k++)
+            assert(results[k] == xkb_keysym_to_lower(input[k]));
+    }
+
+    /* In-place conversion, with a size that is not a multiple of a block */
+    const size_t partial = ARRAY_SIZE(mixed) - 1;
+    memcpy(results, mixed, sizeof(mixed));
+    xkb_keysyms_to_upper(results, results, partial);
+    for (size_t k = 0; k < partial; k++)
+        assert(results[k] == xkb_keysym_to_upper(mixed[k]));
+    assert(results[partial] == mixed[partial]);
+
+    free(results);
+    darray_free(values);
+}
+
 int
 main(void)
 {
@@ -919,6 +1023,9 @@ main(void)
     assert(test_utf32_to_keysym(0x110000, XKB_KEY_NoSymbol));
     assert(test_utf32_to_keysym(0xdeadbeef, XKB_KEY_NoSymbol));
 
+    test_legacy_keysyms_tables();
+    test_bulk_conversions();
+
     assert(xkb_keysym_is_lower(XKB_KEY_a));
     assert(xkb_keysym_is_lower(XKB_KEY_Greek_lambda));
     assert(xkb_keysym_is_lower(xkb_keysym_from_name("U03b1", 0))); /* GREEK SMALL LETTER ALPHA */
@@ -13,6 +13,7 @@
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <utime.h>
 #include <libxml/parser.h>
 #include <libxml/tree.h>
 
@@ -1097,7 +1098,505 @@ test_invalid_include(void)
     rxkb_context_unref(ctx);
 }
 
+/* Count the items of a registry */
+static void
+count_items(struct rxkb_context *ctx, unsigned int counts[4])
+{
+    memset(counts, 0, 4 * sizeof(*counts));
+    for (struct rxkb_model *m = rxkb_model_first(ctx); m;
+         m = rxkb_model_next(m))
+        counts[0]++;
+    for (struct rxkb_layout *l = rxkb_layout_first(ctx); l;
+         l = rxkb_layout_next(l))
+        counts[1]++;
+    for (struct rxkb_option_group *g = rxkb_option_group_first(ctx); g;
+         g = rxkb_option_group_next(g)) {
+        counts[2]++;
+        for (struct rxkb_option *o = rxkb_option_first(g); o;
+             o = rxkb_option_next(o))
+            counts[3]++;
+    }
+}
+
+/* The streaming parser and the full DTD validation load the same items */
+static void
+test_validation(void)
+{
+    char *root = test_get_path("");
+    assert(root);
+    unsigned int counts[2][4];
+
+    const enum rxkb_context_flags flags[] = {
+        RXKB_CONTEXT_NO_FLAGS, RXKB_CONTEXT_VALIDATE_XML
+    };
+    for (size_t f = 0; f < ARRAY_SIZE(flags); f++) {
+        struct rxkb_context *ctx =
+            rxkb_context_new(RXKB_CONTEXT_NO_DEFAULT_INCLUDES |
+                             RXKB_CONTEXT_LOAD_EXOTIC_RULES | flags[f]);
+        assert(ctx);
+        assert(rxkb_context_include_path_append(ctx, root));
+        assert(rxkb_context_parse(ctx, "evdev"));
+        count_items(ctx, counts[f]);
+        assert(counts[f][0] > 0 && counts[f][1] > 0 &&
+               counts[f][2] > 0 && counts[f][3] > 0);
+        assert(find_layout(ctx, "us", "intl"));
+        assert(find_option(ctx, "grp", "grp:alt_shift_toggle"));
+        rxkb_context_unref(ctx);
+    }
+    assert(memcmp(counts[0], counts[1], sizeof(counts[0])) == 0);
+
+    free(root);
+}
+
+/* A file that does not match the registry structure contributes no item */
+static void
+test_invalid_structure(void)
+{
+    struct test_model system_models[] = {
+        {"m1"},
+        {NULL},
+    };
+    struct test_layout system_layouts[] = {
+        {"l1"},
+        {NULL},
+    };
+    struct test_option_group system_groups[] = {
+        {"grp1", NULL, true,
+          { {"grp1:1"}, {NULL} },
+        },
+        { NULL },
+    };
+    const char *invalid[] = {
+        /* Error at the end of the file */
+        "<modelList><model><configItem><name>m2</name></configItem></model>"
+        "</modelList>\n"
+        "<layoutList><layout><configItem><name>l2</name></configItem>"
+        "<variantList><variant><configItem><name>v2</name></configItem>"
+        "</variant></variantList></layout></layoutList>\n"
+        "<optionList><group><configItem><name>grp1</name></configItem>"
+        "<option><configItem><name>grp1:2</name></configItem></option>"
+        "</group><group><configItem><name>grp2</name></configItem>"
+        "<option><configItem><name>grp2:1</name></configItem></option>"
+        "</group>\n<unknown/></optionList>\n",
+        /* Invalid order */
+        "<layoutList><layout><configItem><name>l2</name></configItem>"
+        "</layout></layoutList>\n"
+        "<modelList><model><configItem><name>m2</name></configItem></model>"
+        "</modelList>\n",
+        /* Missing required element */
+        "<modelList><model><configItem><name>m2</name></configItem></model>"
+        "<model><configItem><vendor>v</vendor></configItem></model>"
+        "</modelList>\n",
+        /* Invalid attribute */
+        "<optionList><group allowMultipleSelection=\"maybe\"><configItem>"
+        "<name>grp2</name></configItem></group></optionList>\n",
+        /* Unexpected text */
+        "<modelList><model><configItem><name>m2</name></configItem></model>"
+        "text</modelList>\n",
+        /* Malformed XML */
+        "<modelList><model><configItem><name>m2</name></configItem></model>"
+        "</modelList>\n<layoutList>",
+    };
+
+    const enum rxkb_context_flags flags[] = {
+        RXKB_CONTEXT_NO_FLAGS, RXKB_CONTEXT_VALIDATE_XML
+    };
+    for (size_t f = 0; f < ARRAY_SIZE(flags); f++) {
+        for (size_t k = 0; k < ARRAY_SIZE(invalid); k++) {
+            char *sysdir = test_create_rules("xkbtests", system_models,
+                                             system_layouts, system_groups);
+            char *userdir = test_create_rules("xkbtests", NULL, NULL, NULL);
+            char path[PATH_MAX];
+            assert(snprintf_safe(path, sizeof(path), "%s/rules/xkbtests.xml",
+                                 userdir));
+            FILE *fp = fopen(path, "w");
+            assert(fp);
+            fprintf(fp,
+                    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                    "<!DOCTYPE xkbConfigRegistry SYSTEM \"xkb.dtd\">\n"
+                    "<xkbConfigRegistry version=\"1.1\">\n%s"
+                    "</xkbConfigRegistry>\n", invalid[k]);
+            fclose(fp);
+
+            struct rxkb_context *ctx =
+                rxkb_context_new(RXKB_CONTEXT_NO_DEFAULT_INCLUDES | flags[f]);
+            assert(ctx);
+            assert(rxkb_context_include_path_append(ctx, userdir));
+            assert(rxkb_context_include_path_append(ctx, sysdir));
+            /* The system file is valid */
+            assert(rxkb_context_parse(ctx, "xkbtests"));
+
+            unsigned int counts[4];
+            count_items(ctx, counts);
+            assert(counts[0] == 1 && counts[1] == 1 &&
+                   counts[2] == 1 && counts[3] == 1);
+            assert(find_model(ctx, "m1"));
+            assert(find_layout(ctx, "l1", NO_VARIANT));
+            assert(find_option(ctx, "grp1", "grp1:1"));
+
+            rxkb_context_unref(ctx);
+            test_remove_rules(sysdir, "xkbtests");
+            test_remove_rules(userdir, "xkbtests");
+        }
+    }
+}
+
 /* Check that libxml2 error handler is reset after parsing */
+static struct rxkb_context *
+test_parse_with_cache(const char *dir, const char *cache, bool expect_success)
+{
+    struct rxkb_context *ctx =
+        rxkb_context_new(RXKB_CONTEXT_NO_DEFAULT_INCLUDES);
+    assert(ctx);
+    assert(rxkb_context_include_path_append(ctx, dir));
+    assert(rxkb_context_set_cache_path(ctx, cache));
+    assert(rxkb_context_parse(ctx, "xkbtests") == expect_success);
+    /* The cache must be set before parsing */
+    assert(!rxkb_context_set_cache_path(ctx, NULL));
+    return ctx;
+}
+
+static void
+test_check_cached_items(struct rxkb_context *ctx,
+                        struct test_model *models,
+                        struct test_layout *layouts,
+                        struct test_option_group *groups)
+{
+    struct rxkb_model *m = fetch_model(ctx, "m1");
+    assert(cmp_models(&models[0], m));
+    rxkb_model_unref(m);
+
+    for (size_t k = 0; layouts[k].name; k++) {
+        struct rxkb_layout *l =
+            fetch_layout(ctx, layouts[k].name, layouts[k].variant);
+        assert(cmp_layouts(&layouts[k], l));
+        rxkb_layout_unref(l);
+    }
+    assert(check_layouts_order(ctx, "l1", NO_VARIANT, "l1", "v1",
+                               "l2", NO_VARIANT, NULL));
+
+    struct rxkb_option_group *g = fetch_option_group(ctx, "grp1");
+    assert(cmp_option_groups(&groups[0], g, CMP_EXACT));
+    rxkb_option_group_unref(g);
+}
+
+static void
+test_overwrite_file(const char *path, const char *content, size_t size,
+                    time_t mtime)
+{
+    FILE *file = fopen(path, "wb");
+    assert(file);
+    assert(fwrite(content, 1, size, file) == size);
+    fclose(file);
+    if (mtime) {
+        const struct utimbuf times = { .actime = mtime, .modtime = mtime };
+        assert(utime(path, &times) == 0);
+    }
+}
+
+static void
+test_cache(void)
+{
+    struct test_model models[] =  {
+        {"m1", "vendor1", "desc1"},
+        {NULL},
+    };
+    struct test_layout layouts[] =  {
+        {"l1", NO_VARIANT, "lbrief1", "ldesc1", {"eng", "fra"}, {"US"}},
+        {"l1", "v1", "vbrief1", "vdesc1", {"eng"}, {"CA", "FR"}},
+        {"l2", NO_VARIANT, NULL, "ldesc2"},
+        {NULL},
+    };
+    struct test_option_group groups[] = {
+        {"grp1", "gdesc1", true,
+          { {"grp1:1", "odesc11"}, {"grp1:2", "odesc12"} } },
+        { NULL },
+    };
+    struct rxkb_context *ctx;
+    struct stat st;
+    char rules[PATH_MAX];
+    char cache[PATH_MAX];
+
+    char *dir = test_create_rules("xkbtests", models, layouts, groups);
+    assert(snprintf_safe(rules, sizeof(rules), "%s/rules/xkbtests.xml", dir));
+    assert(snprintf_safe(cache, sizeof(cache), "%s/registry.cache", dir));
+
+    FILE *file = fopen(rules, "rb");
+    assert(file);
+    char *xml = read_file(rules, file);
+    fclose(file);
+    assert(xml);
+    const size_t size = strlen(xml);
+    assert(stat(rules, &st) == 0);
+    const time_t mtime = st.st_mtime;
+
+    /* First parse: the cache is created */
+    ctx = test_parse_with_cache(dir, cache, true);
+    test_check_cached_items(ctx, models, layouts, groups);
+    rxkb_context_unref(ctx);
+    assert(stat(cache, &st) == 0);
+
+    /* Same size and modification time: the cache is used, so the XML file is
+     * not read at all */
+    char *garbage = malloc(size);
+    assert(garbage);
+    memset(garbage, 'x', size);
+    test_overwrite_file(rules, garbage, size, mtime);
+    ctx = test_parse_with_cache(dir, cache, true);
+    test_check_cached_items(ctx, models, layouts, groups);
+    rxkb_context_unref(ctx);
+
+    /* Modified file: the cache is invalidated */
+    test_overwrite_file(rules, garbage, size, mtime + 10);
+    ctx = test_parse_with_cache(dir, cache, false);
+    rxkb_context_unref(ctx);
+    free(garbage);
+
+    /* Corrupted cache: fall back to the XML file */
+    test_overwrite_file(rules, xml, size, mtime);
+    const char corrupted[] = "RXKBCACH\x01";
+    test_overwrite_file(cache, corrupted, sizeof(corrupted) - 1, 0);
+    ctx = test_parse_with_cache(dir, cache, true);
+    test_check_cached_items(ctx, models, layouts, groups);
+    rxkb_context_unref(ctx);
+
+    /* Truncated cache: fall back to the XML file */
+    assert(stat(cache, &st) == 0);
+    assert(truncate(cache, st.st_size - 3) == 0);
+    ctx = test_parse_with_cache(dir, cache, true);
+    test_check_cached_items(ctx, models, layouts, groups);
+    rxkb_context_unref(ctx);
+
+    /* A cache that cannot be written is not an error */
+    assert(snprintf_safe(cache, sizeof(cache), "%s/missing/registry.cache",
+                         dir));
+    ctx = test_parse_with_cache(dir, cache, true);
+    test_check_cached_items(ctx, models, layouts, groups);
+    rxkb_context_unref(ctx);
+
+    assert(snprintf_safe(cache, sizeof(cache), "%s/registry.cache", dir));
+    unlink(cache);
+    free(xml);
+    test_remove_rules(dir, "xkbtests");
+}
+
+/* Indexed lookups return the same objects as linear searches */
+static void
+test_find(void)
+{
+    struct test_model system_models[] = { {"m1", "vendor1", "desc1"}, {NULL} };
+    struct test_layout system_layouts[] =  {
+        {"l1", NO_VARIANT, "lbrief1", "ldesc1", {"eng", "fra"}, {"US"}},
+        {"l1", "v1", "vbrief1", "vdesc1", {"fra"}, {"CA", "FR"}},
+        {"l2", NO_VARIANT, NULL, "ldesc2", {"deu"}, {"DE"}},
+        {NULL},
+    };
+    struct test_layout user_layouts[] =  {
+        {"l0", NO_VARIANT, NULL, "udesc0", {"eng"}, {"US"}},
+        {"l0", "v0", NULL, "udesc00", {"eng"}, {"GB"}},
+        {"l1", NO_VARIANT, NULL, "udesc1", {"ita"}}, /* not loaded */
+        {NULL},
+    };
+    struct test_option_group system_groups[] = {
+        {"grp1", "gdesc1", true,
+          { {"grp1:1", "odesc11"}, {"grp1:2", "odesc12"} } },
+        {"grp2", "gdesc2", false, { {"grp2:1", "odesc21"} } },
+        { NULL },
+    };
+    struct rxkb_context *ctx;
+    size_t count;
+
+    /* Not parsed */
+    ctx = rxkb_context_new(RXKB_CONTEXT_NO_DEFAULT_INCLUDES);
+    assert(ctx);
+    assert(!rxkb_layout_find(ctx, "l1", NULL));
+    assert(!rxkb_option_find(ctx, "grp1:1"));
+    assert(!rxkb_layouts_for_language(ctx, "eng", &count) && count == 0);
+    rxkb_context_unref(ctx);
+
+    ctx = test_setup_context(system_models, NULL,
+                             system_layouts, user_layouts,
+                             system_groups, NULL);
+
+    /* Layouts */
+    struct rxkb_layout *l = rxkb_layout_find(ctx, "l1", NULL);
+    assert(cmp_layouts(&system_layouts[0], l));
+    assert(rxkb_layout_find(ctx, "l1", "") == l);
+    l = rxkb_layout_find(ctx, "l1", "v1");
+    assert(cmp_layouts(&system_layouts[1], l));
+    assert(l == fetch_layout(ctx, "l1", "v1"));
+    rxkb_layout_unref(l);
+    l = rxkb_layout_find(ctx, "l0", "v0");
+    assert(cmp_layouts(&user_layouts[1], l));
+    assert(cmp_layouts(&user_layouts[0], rxkb_layout_find(ctx, "l0", NULL)));
+    assert(!rxkb_layout_find(ctx, "l0", "v1"));
+    assert(!rxkb_layout_find(ctx, "l2", "v1"));
+    assert(!rxkb_layout_find(ctx, "l3", NULL));
+    assert(!rxkb_layout_find(ctx, NULL, NULL));
+
+    /* Options */
+    struct rxkb_option *o = rxkb_option_find(ctx, "grp2:1");
+    assert(o && streq(rxkb_option_get_description(o), "odesc21"));
+    assert(o == fetch_option(ctx, "grp2", "grp2:1"));
+    rxkb_option_unref(o);
+    assert(rxkb_option_find(ctx, "grp1:2"));
+    assert(!rxkb_option_find(ctx, "grp1"));
+    assert(!rxkb_option_find(ctx, "grp1:3"));
+
+    /* Languages and countries, in the order of the layout list */
+    struct rxkb_layout * const *layouts =
+        rxkb_layouts_for_language(ctx, "eng", &count);
+    assert(layouts && count == 3);
+    assert(cmp_layouts(&system_layouts[0], layouts[0]));
+    assert(cmp_layouts(&user_layouts[0], layouts[1]));
+    assert(cmp_layouts(&user_layouts[1], layouts[2]));
+    layouts = rxkb_layouts_for_language(ctx, "FRA", &count);
+    assert(layouts && count == 2);
+    assert(cmp_layouts(&system_layouts[0], layouts[0]));
+    assert(cmp_layouts(&system_layouts[1], layouts[1]));
+    assert(!rxkb_layouts_for_language(ctx, "ita", &count) && count == 0);
+    assert(!rxkb_layouts_for_language(ctx, "en", &count) && count == 0);
+    layouts = rxkb_layouts_for_country(ctx, "us", &count);
+    assert(layouts && count == 2);
+    assert(cmp_layouts(&system_layouts[0], layouts[0]));
+    assert(cmp_layouts(&user_layouts[0], layouts[1]));
+    layouts = rxkb_layouts_for_country(ctx, "DE", &count);
+    assert(layouts && count == 1);
+    assert(cmp_layouts(&system_layouts[2], layouts[0]));
+    assert(!rxkb_layouts_for_country(ctx, "IT", &count) && count == 0);
+
+    rxkb_context_unref(ctx);
+
+    /* Real data: every layout and option can be found */
+    char *root = test_get_path("");
+    assert(root);
+    ctx = rxkb_context_new(RXKB_CONTEXT_NO_DEFAULT_INCLUDES |
+                           RXKB_CONTEXT_LOAD_EXOTIC_RULES);
+    assert(ctx);
+    assert(rxkb_context_include_path_append(ctx, root));
+    assert(rxkb_context_parse(ctx, "evdev"));
+    free(root);
+    for (l = rxkb_layout_first(ctx); l; l = rxkb_layout_next(l)) {
+        struct rxkb_layout *expected =
+            fetch_layout(ctx, rxkb_layout_get_name(l),
+                         rxkb_layout_get_variant(l));
+        assert(rxkb_layout_find(ctx, rxkb_layout_get_name(l),
+                                rxkb_layout_get_variant(l)) == expected);
+        rxkb_layout_unref(expected);
+        for (struct rxkb_iso639_code *iso = rxkb_layout_get_iso639_first(l);
+             iso; iso = rxkb_iso639_code_next(iso)) {
+            layouts = rxkb_layouts_for_language(
+                ctx, rxkb_iso639_code_get_code(iso), &count
+            );
+            bool found = false;
+            for (size_t k = 0; k < count; k++)
+                found = found || layouts[k] == l;
+            assert(found);
+        }
+    }
+    for (struct rxkb_option_group *g = rxkb_option_group_first(ctx); g;
+         g = rxkb_option_group_next(g)) {
+        for (o = rxkb_option_first(g); o; o = rxkb_option_next(o))
+            assert(rxkb_option_find(ctx, rxkb_option_get_name(o)));
+    }
+    rxkb_context_unref(ctx);
+}
+
+static void
+test_lazy_details(void)
+{
+    struct test_model system_models[] =  {
+        {"m1", "vendor1", "desc1"},
+        {"m2", "vendor2", "desc2"},
+        {NULL},
+    };
+    struct test_layout system_layouts[] =  {
+        {"l1", NO_VARIANT, "lbrief1", "ldesc1", {"eng", "fra"}, {"US"}},
+        {"l1", "v1", NULL, "vdesc1"},
+        {"l2", NO_VARIANT, "lbrief2", "ldesc2", {"deu"}},
+        {NULL},
+    };
+    struct test_layout user_layouts[] =  {
+        {"l1", NO_VARIANT, "XXX", "YYY", {"ita"}}, /* not loaded */
+        {"l1", "v2", NULL, "vdesc2"},
+        {"l3", NO_VARIANT, NULL, "ldesc3", {"spa"}, {"ES"}},
+        {"l3", "v3", "vbrief3", "vdesc3", {"cat"}},
+        {NULL},
+    };
+    struct test_option_group system_groups[] = {
+        {"grp1", "gdesc1", true,
+          { {"grp1:1", "odesc11"}, {"grp1:2", "odesc12"} } },
+        { NULL },
+    };
+    /* Expected details, with the inherited ones */
+    struct test_layout expected[] =  {
+        {"l1", "v2", "lbrief1", "vdesc2", {"eng", "fra"}, {"US"}},
+        {"l1", "v1", "lbrief1", "vdesc1", {"eng", "fra"}, {"US"}},
+        {"l1", NO_VARIANT, "lbrief1", "ldesc1", {"eng", "fra"}, {"US"}},
+        {"l3", "v3", "vbrief3", "vdesc3", {"cat"}, {"ES"}},
+        {"l3", NO_VARIANT, NULL, "ldesc3", {"spa"}, {"ES"}},
+        {"l2", NO_VARIANT, "lbrief2", "ldesc2", {"deu"}},
+    };
+    struct rxkb_context *ctx;
+    struct rxkb_layout *l;
+
+    char *sysdir = test_create_rules("xkbtests", system_models, system_layouts,
+                                     system_groups);
+    char *userdir = test_create_rules("xkbtests", NULL, user_layouts, NULL);
+
+    ctx = rxkb_context_new(RXKB_CONTEXT_NO_DEFAULT_INCLUDES |
+                           RXKB_CONTEXT_LAZY_DETAILS);
+    assert(ctx);
+    assert(rxkb_context_include_path_append(ctx, userdir));
+    assert(rxkb_context_include_path_append(ctx, sysdir));
+    assert(rxkb_context_parse(ctx, "xkbtests"));
+    assert(check_layouts_order(ctx, "l1", NO_VARIANT, "l1", "v1",
+                               "l2", NO_VARIANT, "l1", "v2",
+                               "l3", NO_VARIANT, "l3", "v3", NULL));
+
+    /* Load the details in any order; the user variant inherits from the
+     * system layout. */
+    for (size_t k = 0; k < ARRAY_SIZE(expected); k++) {
+        l = fetch_layout(ctx, expected[k].name, expected[k].variant);
+        assert(cmp_layouts(&expected[k], l));
+        rxkb_layout_unref(l);
+    }
+
+    struct rxkb_model *m = fetch_model(ctx, "m2");
+    assert(cmp_models(&system_models[1], m));
+    rxkb_model_unref(m);
+    struct rxkb_option_group *g = fetch_option_group(ctx, "grp1");
+    assert(cmp_option_groups(&system_groups[0], g, CMP_EXACT));
+    rxkb_option_group_unref(g);
+
+    size_t count = 0;
+    assert(rxkb_layouts_for_language(ctx, "fra", &count) && count == 3);
+    rxkb_context_unref(ctx);
+
+    /* Modified files are not read again */
+    ctx = rxkb_context_new(RXKB_CONTEXT_NO_DEFAULT_INCLUDES |
+                           RXKB_CONTEXT_LAZY_DETAILS);
+    assert(ctx);
+    assert(rxkb_context_include_path_append(ctx, sysdir));
+    assert(rxkb_context_parse(ctx, "xkbtests"));
+    char path[PATH_MAX];
+    assert(snprintf_safe(path, sizeof(path), "%s/rules/xkbtests.xml", sysdir));
+    struct stat st;
+    assert(stat(path, &st) == 0);
+    const struct utimbuf times = {
+        .actime = st.st_mtime + 10, .modtime = st.st_mtime + 10
+    };
+    assert(utime(path, &times) == 0);
+    l = fetch_layout(ctx, "l1", NO_VARIANT);
+    assert(streq(rxkb_layout_get_name(l), "l1"));
+    assert(rxkb_layout_get_description(l) == NULL);
+    rxkb_layout_unref(l);
+    rxkb_context_unref(ctx);
+
+    test_remove_rules(sysdir, "xkbtests");
+    test_remove_rules(userdir, "xkbtests");
+}
+
 static void
 test_xml_error_handler(void)
 {
@@ -1136,6 +1635,11 @@ main(void)
     test_load_languages();
     test_load_invalid_languages();
     test_popularity();
+    test_validation();
+    test_invalid_structure();
+    test_cache();
+    test_find();
+    test_lazy_details();
 
     return 0;
 }
@@ -593,6 +593,26 @@ test_all_qualifier(struct xkb_context *ctx,
                        "+extra_option:1"
                        "+extra_option:2+extra_option:3+extra_option:4+extra_option:5",
             .explicit_layouts = 5,
+        },
+        /* Test :all qualifier with a long prefix, which is copied from the
+         * buffer it is appended to */
+        {
+            .rules = "all_qualifier",
+
+            .model = "my_model",
+            .layout = "layout_a,layout_b,layout_a,layout_b,layout_c",
+            .variant = "",
+            .options = "long_prefix",
+
+            .keycodes = "my_keycodes", .types = "my_types",
+            .compat = "my_compat",
+            .symbols = "symbols_a:1+symbols_b:2+symbols_a:3+symbols_b:4+symbols_c:5"
+                       "+extra_option_with_a_long_name_that_is_copied_many_times_when_expanding_all:1"
+                       "+extra_option_with_a_long_name_that_is_copied_many_times_when_expanding_all:2"
+                       "+extra_option_with_a_long_name_that_is_copied_many_times_when_expanding_all:3"
+                       "+extra_option_with_a_long_name_that_is_copied_many_times_when_expanding_all:4"
+                       "+extra_option_with_a_long_name_that_is_copied_many_times_when_expanding_all:5",
+            .explicit_layouts = 5,
         }
     };
 
@@ -782,6 +802,18 @@ test_partial_rules(struct xkb_context *ctx)
         assert(test_rules(ctx, &tests_1[k]));
     }
 
+    /*
+     * Same with the rules cache, which identifies the files by their path
+     */
+
+    struct xkb_context * const cached_ctx = test_get_context(CONTEXT_NO_FLAG);
+    assert(cached_ctx);
+    xkb_context_set_keymap_cache_size(cached_ctx, 1);
+    for (unsigned int k = 0; k < ARRAY_SIZE(tests_1); k++) {
+        fprintf(stderr, "------\n*** %s: #%u (cached) ***\n", __func__, k);
+        assert(test_rules(cached_ctx, &tests_1[k]));
+    }
+    xkb_context_unref(cached_ctx);
 
     /*
      * 2 include paths
@@ -839,6 +871,66 @@ test_partial_rules(struct xkb_context *ctx)
     xkb_context_unref(ctx);
 }
 
+static void
+test_batch(struct xkb_context *ctx)
+{
+    static const struct xkb_rule_names names[] = {
+        { "special_indices", NULL, "layout_a,layout_b,layout_c", NULL,
+          "option_3,option_2,option_1" },
+        { "evdev-modern", "pc104", "gb,de", ",neo", NULL },
+        { "special_indices", NULL, "a,b", ",c", NULL },
+        { "partial", "m1", "l1,l2", NULL, "opt:a!1" },
+        /* Unknown rules */
+        { "does-not-exist", "pc104", "us", NULL, NULL },
+        { "inc-src-relative-path", "my_model", "my_layout", NULL, NULL },
+        { "evdev-modern", "ataritt", "jp", NULL, NULL },
+        /* Include loop */
+        { "inc-src-looped", "my_model", "my_layout", NULL, NULL },
+        { "special_indices", NULL, "layout_e,layout_a", NULL, NULL },
+        { "evdev-modern", "olpc", "us", NULL, NULL },
+        { "inc-src-relative-path", "my_model", "other_layout", NULL, NULL },
+    };
+    struct xkb_component_names batch[ARRAY_SIZE(names)];
+
+    const size_t resolved =
+        xkb_components_names_from_rules_batch(ctx, names, ARRAY_SIZE(names),
+                                              batch);
+
+    /* Results must be identical to the separate resolutions */
+    size_t expected_resolved = 0;
+    for (size_t k = 0; k < ARRAY_SIZE(names); k++) {
+        fprintf(stderr, "------\n*** %s: #%zu ***\n", __func__, k);
+        struct xkb_component_names kccgst = { 0 };
+        if (xkb_components_names_from_rules(ctx, &names[k], NULL, &kccgst)) {
+            expected_resolved++;
+            assert_streq_not_null("keycodes", kccgst.keycodes, batch[k].keycodes);
+            assert_streq_not_null("types", kccgst.types, batch[k].types);
+            assert_streq_not_null("compat", kccgst.compatibility,
+                                  batch[k].compatibility);
+            assert_streq_not_null("symbols", kccgst.symbols, batch[k].symbols);
+            assert(streq_null(kccgst.geometry, batch[k].geometry));
+        } else {
+            assert(!batch[k].keycodes && !batch[k].types &&
+                   !batch[k].compatibility && !batch[k].symbols &&
+                   !batch[k].geometry);
+        }
+        free(kccgst.keycodes);
+        free(kccgst.types);
+        free(kccgst.compatibility);
+        free(kccgst.symbols);
+        free(kccgst.geometry);
+        free(batch[k].keycodes);
+        free(batch[k].types);
+        free(batch[k].compatibility);
+        free(batch[k].symbols);
+        free(batch[k].geometry);
+    }
+    assert(resolved == expected_resolved);
+    assert(resolved == ARRAY_SIZE(names) - 2);
+
+    assert(xkb_components_names_from_rules_batch(ctx, names, 0, NULL) == 0);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -876,6 +968,7 @@ main(int argc, char *argv[])
     test_all_qualifier(ctx, too_much_layouts, too_much_symbols);
     test_layout_specific_options(ctx);
     test_partial_rules(ctx);
+    test_batch(ctx);
 
     xkb_context_unref(ctx);
     return EXIT_SUCCESS;
@@ -196,6 +196,65 @@ test_extended_groups(struct xkb_context *ctx)
 #undef U
 }
 
+/* Per-layout symbols cache: adding and removing layouts */
+static void
+test_symbols_cache(void)
+{
+    static const struct {
+        const char *layout;
+        const char *variant;
+        const char *options;
+    } tests[] = {
+        { "us,ru", NULL, NULL },
+        { "us,ru,de", NULL, NULL },
+        { "us,de", NULL, NULL },
+        { "ru,us", NULL, NULL },
+        { "us,ru,de", ",,nodeadkeys", "grp:alts_toggle" },
+        { "us,ru,de,cz", NULL, "grp:alts_toggle,ctrl:nocaps" },
+        { "us,ru", NULL, "ctrl:nocaps" },
+        { "us,ru", NULL, NULL },
+    };
+
+    struct xkb_context * const ctx = test_get_context(0);
+    struct xkb_context * const cached_ctx = test_get_context(0);
+    assert(ctx && cached_ctx);
+    /* Keep only one keymap, so that the layouts must be reassembled */
+    xkb_context_set_keymap_cache_size(cached_ctx, 1);
+
+    static const enum xkb_keymap_format formats[] = {
+        XKB_KEYMAP_FORMAT_TEXT_V1, XKB_KEYMAP_FORMAT_TEXT_V2
+    };
+    for (size_t f = 0; f < ARRAY_SIZE(formats); f++) {
+        for (size_t t = 0; t < ARRAY_SIZE(tests); t++) {
+            fprintf(stderr, "------\n*** %s: #%zu, format %d ***\n",
+                    __func__, t, formats[f]);
+            struct xkb_keymap * const expected =
+                test_compile_rules(ctx, formats[f], "evdev", "pc105",
+                                   tests[t].layout, tests[t].variant,
+                                   tests[t].options);
+            struct xkb_keymap * const got =
+                test_compile_rules(cached_ctx, formats[f], "evdev", "pc105",
+                                   tests[t].layout, tests[t].variant,
+                                   tests[t].options);
+            assert(expected && got);
+            char * const expected_str =
+                xkb_keymap_get_as_string(expected,
+                                         XKB_KEYMAP_USE_ORIGINAL_FORMAT);
+            char * const got_str =
+                xkb_keymap_get_as_string(got, XKB_KEYMAP_USE_ORIGINAL_FORMAT);
+            assert_streq_not_null("Keymap with cached symbols",
+                                  expected_str, got_str);
+            free(expected_str);
+            free(got_str);
+            xkb_keymap_unref(expected);
+            xkb_keymap_unref(got);
+        }
+    }
+
+    xkb_context_unref(cached_ctx);
+    xkb_context_unref(ctx);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -310,6 +369,7 @@ main(int argc, char *argv[])
                           KEY_A,          BOTH, XKB_KEY_a,                FINISH));
 
     test_extended_groups(ctx);
+    test_symbols_cache();
 
     xkb_context_unref(ctx);
 
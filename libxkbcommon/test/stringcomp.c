@@ -8,6 +8,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "xkbcommon/xkbcommon.h"
 #include "test.h"
@@ -89,11 +90,80 @@ test_keymap_comparison(struct xkb_context *ctx)
         assert(keymap2);
         assert(xkb_keymap_compare(ctx, keymap1, keymap2, tests[t].properties) ==
                tests[t].same);
+        /* Fingerprints match if and only if the keymaps are identical */
+        uint8_t fingerprint1[XKB_KEYMAP_FINGERPRINT_SIZE];
+        uint8_t fingerprint2[XKB_KEYMAP_FINGERPRINT_SIZE];
+        xkb_keymap_get_fingerprint(keymap1, fingerprint1);
+        xkb_keymap_get_fingerprint(keymap2, fingerprint2);
+        assert(xkb_keymap_compare(ctx, keymap1, keymap2, XKB_KEYMAP_CMP_ALL) ==
+               (memcmp(fingerprint1, fingerprint2, sizeof(fingerprint1)) == 0));
         xkb_keymap_unref(keymap1);
         xkb_keymap_unref(keymap2);
     }
 }
 
+static void
+test_keymap_fingerprint(struct xkb_context *ctx)
+{
+    uint8_t fingerprint1[XKB_KEYMAP_FINGERPRINT_SIZE];
+    uint8_t fingerprint2[XKB_KEYMAP_FINGERPRINT_SIZE];
+
+    /* The fingerprint does not depend on the platform */
+    struct xkb_keymap *keymap1 =
+        test_compile_string(ctx, XKB_KEYMAP_FORMAT_TEXT_V1, "xkb_keymap {};");
+    assert(keymap1);
+    static const uint8_t empty[XKB_KEYMAP_FINGERPRINT_SIZE] = {
+        0xa0, 0xb9, 0x05, 0x94, 0x4a, 0xd7, 0xb9, 0x4a,
+        0xf7, 0xb2, 0xaa, 0x1c, 0xb0, 0xd4, 0xe1, 0x1d
+    };
+    xkb_keymap_get_fingerprint(keymap1, fingerprint1);
+    assert(memcmp(fingerprint1, empty, sizeof(empty)) == 0);
+    xkb_keymap_unref(keymap1);
+
+    /* Same keymap, different contexts */
+    struct xkb_context * const ctx2 = test_get_context(CONTEXT_NO_FLAG);
+    assert(ctx2);
+    keymap1 = test_compile_rules(ctx, XKB_KEYMAP_FORMAT_TEXT_V1, "evdev",
+                                 "pc104", "us,de", NULL, "grp:menu_toggle");
+    assert(keymap1);
+    struct xkb_keymap *keymap2 =
+        test_compile_rules(ctx2, XKB_KEYMAP_FORMAT_TEXT_V1, "evdev",
+                           "pc104", "us,de", NULL, "grp:menu_toggle");
+    assert(keymap2);
+    assert(xkb_keymap_compare(ctx, keymap1, keymap2, XKB_KEYMAP_CMP_ALL));
+    xkb_keymap_get_fingerprint(keymap1, fingerprint1);
+    xkb_keymap_get_fingerprint(keymap2, fingerprint2);
+    assert(memcmp(fingerprint1, fingerprint2, sizeof(fingerprint1)) == 0);
+    /* Cached value */
+    xkb_keymap_get_fingerprint(keymap1, fingerprint2);
+    assert(memcmp(fingerprint1, fingerprint2, sizeof(fingerprint1)) == 0);
+    xkb_keymap_unref(keymap2);
+
+    /* Different keymaps */
+    static const struct {
+        const char *layout;
+        const char *variant;
+        const char *options;
+    } others[] = {
+        { "us,de", NULL, NULL },
+        { "de,us", NULL, "grp:menu_toggle" },
+        { "us,de", ",nodeadkeys", "grp:menu_toggle" },
+        { "us,de", NULL, "grp:menu_toggle,caps:none" },
+    };
+    for (size_t k = 0; k < ARRAY_SIZE(others); k++) {
+        keymap2 = test_compile_rules(ctx2, XKB_KEYMAP_FORMAT_TEXT_V1, "evdev",
+                                     "pc104", others[k].layout,
+                                     others[k].variant, others[k].options);
+        assert(keymap2);
+        xkb_keymap_get_fingerprint(keymap2, fingerprint2);
+        assert(memcmp(fingerprint1, fingerprint2, sizeof(fingerprint1)) != 0);
+        xkb_keymap_unref(keymap2);
+    }
+
+    xkb_keymap_unref(keymap1);
+    xkb_context_unref(ctx2);
+}
+
 static void
 test_explicit_actions(struct xkb_context *ctx)
 {
@@ -255,6 +325,11 @@ main(int argc, char *argv[])
         );
         assert(keymap2);
         assert(xkb_keymap_compare(ctx, keymap, keymap2, XKB_KEYMAP_CMP_ALL));
+        uint8_t fingerprint1[XKB_KEYMAP_FINGERPRINT_SIZE];
+        uint8_t fingerprint2[XKB_KEYMAP_FINGERPRINT_SIZE];
+        xkb_keymap_get_fingerprint(keymap, fingerprint1);
+        xkb_keymap_get_fingerprint(keymap2, fingerprint2);
+        assert(memcmp(fingerprint1, fingerprint2, sizeof(fingerprint1)) == 0);
         xkb_keymap_unref(keymap2);
 
         assert(test_compile_output2(ctx, data[k].format,
@@ -301,6 +376,7 @@ main(int argc, char *argv[])
     free(dump2);
 
     test_keymap_comparison(ctx);
+    test_keymap_fingerprint(ctx);
     test_explicit_actions(ctx);
 
     xkb_context_unref(ctx);
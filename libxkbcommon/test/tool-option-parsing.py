@@ -262,6 +262,7 @@ class TestXkbcli(unittest.TestCase):
     xkbcli_how_to_type: ClassVar[XkbcliTool]
     xkbcli_compile_keymap: ClassVar[XkbcliTool]
     xkbcli_compile_compose: ClassVar[XkbcliTool]
+    xkbcli_resolve_rmlvo: ClassVar[XkbcliTool]
     xkbcli_interactive_evdev: ClassVar[XkbcliTool]
     xkbcli_interactive_x11: ClassVar[XkbcliTool]
     xkbcli_interactive_wayland: ClassVar[XkbcliTool]
@@ -286,6 +287,7 @@ class TestXkbcli(unittest.TestCase):
         cls.xkbcli_how_to_type = XkbcliTool("how-to-type")
         cls.xkbcli_compile_keymap = XkbcliTool("compile-keymap")
         cls.xkbcli_compile_compose = XkbcliTool("compile-compose")
+        cls.xkbcli_resolve_rmlvo = XkbcliTool("resolve-rmlvo")
         no_interactive_evdev = (
             (
                 not int(os.getenv("HAVE_XKBCLI_INTERACTIVE_EVDEV", "1")),
@@ -353,6 +355,7 @@ class TestXkbcli(unittest.TestCase):
             cls.xkbcli_how_to_type,
             cls.xkbcli_compile_keymap,
             cls.xkbcli_compile_compose,
+            cls.xkbcli_resolve_rmlvo,
             cls.xkbcli_interactive_evdev,
             cls.xkbcli_interactive_x11,
             cls.xkbcli_interactive_wayland,
@@ -542,6 +545,27 @@ class TestXkbcli(unittest.TestCase):
             with self.subTest(args=args):
                 self.xkbcli_compile_compose.run_command_success(args)
 
+    def test_resolve_rmlvo(self):
+        stdout, _stderr = self.xkbcli_resolve_rmlvo.run_command_success(
+            ["--rules", "evdev", "us", "us(intl)", "us,de(nodeadkeys)"]
+        )
+        lines = stdout.splitlines()
+        assert lines.count("- layout: \"us\"") == 2, stdout
+        assert "  variant: \"intl\"" in lines, stdout
+        assert "  variant: \",nodeadkeys\"" in lines, stdout
+        assert sum(line.startswith("  symbols: ") for line in lines) == 3, stdout
+
+        # Read the layouts from stdin
+        stdout, _stderr = self.xkbcli_resolve_rmlvo.run_command_success(
+            ["--rules", "evdev"], input="# comment\nus(intl)\n\nde\n"
+        )
+        lines = stdout.splitlines()
+        assert "- layout: \"us\"" in lines, stdout
+        assert "- layout: \"de\"" in lines, stdout
+
+        # Invalid layout syntax
+        self.xkbcli_resolve_rmlvo.run_command_invalid(["us(intl"])
+
     def test_how_to_type(self):
         for args in (["--verbose", "1"],):
             with self.subTest(args=args):
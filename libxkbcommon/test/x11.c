@@ -57,6 +57,31 @@ X11_TEST(test_basic)
     assert(dump);
     fputs(dump, stdout);
 
+    /* The asynchronous API retrieves the same keymap */
+    struct xkb_x11_keymap_request *request =
+        xkb_x11_keymap_request(ctx, conn, device_id,
+                               XKB_KEYMAP_COMPILE_NO_FLAGS);
+    assert(request);
+    struct xkb_state *state2 = NULL;
+    struct xkb_keymap *keymap2 = xkb_x11_keymap_finish(request, &state2);
+    assert(keymap2);
+    assert(state2);
+    char *dump2 = xkb_keymap_get_as_string(keymap2,
+                                           XKB_KEYMAP_USE_ORIGINAL_FORMAT);
+    assert(dump2);
+    assert(streq(dump, dump2));
+    free(dump2);
+    xkb_state_unref(state2);
+    xkb_keymap_unref(keymap2);
+
+    /* Cancelled requests do not leave pending replies */
+    request = xkb_x11_keymap_request(ctx, conn, device_id,
+                                     XKB_KEYMAP_COMPILE_NO_FLAGS);
+    assert(request);
+    xkb_x11_keymap_cancel(request);
+    assert(!xkb_x11_keymap_request(ctx, conn, 128,
+                                   XKB_KEYMAP_COMPILE_NO_FLAGS));
+
     /* TODO: Write some X11-specific tests. */
 
     free(dump);
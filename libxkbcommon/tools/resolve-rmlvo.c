@@ -0,0 +1,335 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <getopt.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xkbcommon/xkbcommon.h"
+#include "tools-common.h"
+#include "src/darray.h"
+#include "src/utils.h"
+
+#define DEFAULT_INCLUDE_PATH_PLACEHOLDER "__defaults__"
+
+static bool verbose = false;
+static const char *includes[64] = { 0 };
+static size_t num_includes = 0;
+static bool test = false;
+
+static void
+usage(FILE *file, const char *progname)
+{
+    fprintf(file,
+           "Usage: %s [OPTIONS] [LAYOUT...]\n"
+           "\n"
+           "Resolve RMLVO names to KcCGST components, without compiling the\n"
+           "keymaps, and print them in YAML format.\n"
+           "\n"
+           "Each LAYOUT argument is a comma-separated list of layouts, each\n"
+           "optionally followed by a variant in parentheses, e.g. \"us(intl)\"\n"
+           "or \"us,de(nodeadkeys)\". If no LAYOUT argument is given, they are\n"
+           "read from the standard input, one per line.\n"
+           "\n"
+           "All the layouts are resolved together, in a single pass over the\n"
+           "rules files.\n"
+           "\n"
+           "General options:\n"
+           " --help\n"
+           "    Print this help and exit\n"
+           " --verbose\n"
+           "    Enable verbose debugging output\n"
+           " --test\n"
+           "    Test the resolution but do not print the components.\n"
+           "\n"
+           "Input options:\n"
+           " --include\n"
+           "    Add the given path to the include path list. This option is\n"
+           "    order-dependent, include paths given first are searched first.\n"
+           "    If an include path is given, the default include path list is\n"
+           "    not used. Use --include-defaults to add the default include\n"
+           "    paths\n"
+           " --include-defaults\n"
+           "    Add the default set of include directories.\n"
+           "    This option is order-dependent, include paths given first\n"
+           "    are searched first.\n"
+           " --rules <rules>\n"
+           "    The XKB ruleset (default: '%s')\n"
+           " --model <model>\n"
+           "    The XKB model (default: '%s')\n"
+           " --options <options>\n"
+           "    The XKB options (default: '%s')\n"
+           "\n",
+           progname, DEFAULT_XKB_RULES, DEFAULT_XKB_MODEL,
+           DEFAULT_XKB_OPTIONS ? DEFAULT_XKB_OPTIONS : "<none>");
+}
+
+/* Layouts and variants parsed from a LAYOUT argument */
+struct layout_entry {
+    char *layout;
+    char *variant;
+};
+
+typedef darray(struct layout_entry) darray_layout_entry;
+
+/* Split "l1(v1),l2,l3(v3)" into "l1,l2,l3" and "v1,,v3" */
+static bool
+parse_layout_entry(const char *arg, struct layout_entry *entry)
+{
+    darray_char layout = darray_new();
+    darray_char variant = darray_new();
+    bool has_variant = false;
+
+    const char *s = arg;
+    while (true) {
+        const size_t len = strcspn(s, "(,");
+        darray_appends_nullterminate(layout, s, (darray_size_t) len);
+        s += len;
+        if (*s == '(') {
+            const char * const end = strchr(++s, ')');
+            if (!end || (end[1] != ',' && end[1] != '\0'))
+                goto error;
+            darray_appends_nullterminate(variant, s,
+                                         (darray_size_t) (end - s));
+            has_variant = true;
+            s = end + 1;
+        }
+        if (*s != ',')
+            break;
+        darray_appends_nullterminate(layout, ",", 1);
+        darray_appends_nullterminate(variant, ",", 1);
+        s++;
+    }
+
+    if (darray_empty(layout))
+        goto error;
+
+    darray_steal(layout, &entry->layout, NULL);
+    if (has_variant) {
+        darray_steal(variant, &entry->variant, NULL);
+    } else {
+        darray_free(variant);
+        entry->variant = NULL;
+    }
+    return true;
+
+error:
+    fprintf(stderr, "ERROR: Invalid layout: \"%s\"\n", arg);
+    darray_free(layout);
+    darray_free(variant);
+    return false;
+}
+
+/* Read the LAYOUT arguments from stdin, skipping empty lines and comments */
+static bool
+read_layout_entries(FILE *file, darray_layout_entry *entries)
+{
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len;
+    bool ok = true;
+    while ((len = getline(&line, &size, file)) != -1) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r' ||
+                           line[len - 1] == ' ' || line[len - 1] == '\t'))
+            line[--len] = '\0';
+        const char *start = line;
+        while (*start == ' ' || *start == '\t')
+            start++;
+        if (*start == '\0' || *start == '#')
+            continue;
+        struct layout_entry entry;
+        if (!parse_layout_entry(start, &entry)) {
+            ok = false;
+            break;
+        }
+        darray_append(*entries, entry);
+    }
+    free(line);
+    return ok;
+}
+
+int
+main(int argc, char **argv)
+{
+    enum options {
+        OPT_VERBOSE,
+        OPT_TEST,
+        OPT_INCLUDE,
+        OPT_INCLUDE_DEFAULTS,
+        OPT_RULES,
+        OPT_MODEL,
+        OPT_OPTION,
+    };
+    static struct option opts[] = {
+        {"help",             no_argument,            0, 'h'},
+        {"verbose",          no_argument,            0, OPT_VERBOSE},
+        {"test",             no_argument,            0, OPT_TEST},
+        {"include",          required_argument,      0, OPT_INCLUDE},
+        {"include-defaults", no_argument,            0, OPT_INCLUDE_DEFAULTS},
+        {"rules",            required_argument,      0, OPT_RULES},
+        {"model",            required_argument,      0, OPT_MODEL},
+        {"options",          required_argument,      0, OPT_OPTION},
+        {0, 0, 0, 0},
+    };
+    const char *rules = NULL;
+    const char *model = NULL;
+    const char *options = NULL;
+
+    setlocale(LC_ALL, "");
+
+    while (1) {
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "h", opts, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'h':
+            usage(stdout, argv[0]);
+            return EXIT_SUCCESS;
+        case OPT_VERBOSE:
+            verbose = true;
+            break;
+        case OPT_TEST:
+            test = true;
+            break;
+        case OPT_INCLUDE:
+            if (num_includes >= ARRAY_SIZE(includes))
+                goto too_many_includes;
+            includes[num_includes++] = optarg;
+            break;
+        case OPT_INCLUDE_DEFAULTS:
+            if (num_includes >= ARRAY_SIZE(includes))
+                goto too_many_includes;
+            includes[num_includes++] = DEFAULT_INCLUDE_PATH_PLACEHOLDER;
+            break;
+        case OPT_RULES:
+            rules = optarg;
+            break;
+        case OPT_MODEL:
+            model = optarg;
+            break;
+        case OPT_OPTION:
+            options = optarg;
+            break;
+        default:
+            usage(stderr, argv[0]);
+            return EXIT_INVALID_USAGE;
+        }
+    }
+
+    darray_layout_entry entries = darray_new();
+    bool ok = true;
+    if (optind < argc) {
+        for (int i = optind; i < argc; i++) {
+            struct layout_entry entry;
+            if (!parse_layout_entry(argv[i], &entry)) {
+                ok = false;
+                break;
+            }
+            darray_append(entries, entry);
+        }
+    } else {
+        ok = read_layout_entries(stdin, &entries);
+    }
+
+    int rc = EXIT_INVALID_USAGE;
+    struct xkb_rule_names *names = NULL;
+    struct xkb_component_names *components = NULL;
+    struct xkb_context *ctx = NULL;
+    if (!ok)
+        goto out;
+
+    ctx = xkb_context_new(XKB_CONTEXT_NO_DEFAULT_INCLUDES |
+                          XKB_CONTEXT_NO_ENVIRONMENT_NAMES);
+    assert(ctx);
+
+    if (verbose)
+        tools_enable_verbose_logging(ctx);
+
+    if (num_includes == 0)
+        includes[num_includes++] = DEFAULT_INCLUDE_PATH_PLACEHOLDER;
+
+    for (size_t i = 0; i < num_includes; i++) {
+        const char *include = includes[i];
+        if (strcmp(include, DEFAULT_INCLUDE_PATH_PLACEHOLDER) == 0)
+            xkb_context_include_path_append_default(ctx);
+        else
+            xkb_context_include_path_append(ctx, include);
+    }
+
+    const size_t count = darray_size(entries);
+    names = calloc(count + 1, sizeof(*names));
+    components = calloc(count + 1, sizeof(*components));
+    if (!names || !components) {
+        fprintf(stderr, "ERROR: Could not allocate the RMLVO names\n");
+        rc = EXIT_FAILURE;
+        goto out;
+    }
+    for (size_t i = 0; i < count; i++) {
+        names[i] = (struct xkb_rule_names) {
+            .rules = rules,
+            .model = model,
+            .layout = darray_item(entries, i).layout,
+            .variant = darray_item(entries, i).variant,
+            .options = options,
+        };
+    }
+
+    const size_t resolved =
+        xkb_components_names_from_rules_batch(ctx, names, count, components);
+    rc = (resolved == count) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    for (size_t i = 0; i < count; i++) {
+        const struct xkb_component_names * const kccgst = &components[i];
+        if (!test) {
+            printf("- layout: \"%s\"\n", names[i].layout);
+            if (!isempty(names[i].variant))
+                printf("  variant: \"%s\"\n", names[i].variant);
+            if (kccgst->keycodes) {
+                printf("  keycodes: \"%s\"\n"
+                       "  types: \"%s\"\n"
+                       "  compat: \"%s\"\n"
+                       "  symbols: \"%s\"\n",
+                       kccgst->keycodes, kccgst->types,
+                       kccgst->compatibility, kccgst->symbols);
+                /* Contrary to the previous components, geometry can be empty */
+                if (!isempty(kccgst->geometry))
+                    printf("  geometry: \"%s\"\n", kccgst->geometry);
+            } else {
+                printf("  error: \"cannot resolve\"\n");
+            }
+        }
+        free(kccgst->keycodes);
+        free(kccgst->types);
+        free(kccgst->compatibility);
+        free(kccgst->symbols);
+        free(kccgst->geometry);
+    }
+
+out:
+    free(names);
+    free(components);
+    struct layout_entry *entry;
+    darray_foreach(entry, entries) {
+        free(entry->layout);
+        free(entry->variant);
+    }
+    darray_free(entries);
+    xkb_context_unref(ctx);
+    return rc;
+
+too_many_includes:
+    fprintf(stderr, "ERROR: too many includes (max: %zu)\n",
+            ARRAY_SIZE(includes));
+    usage(stderr, argv[0]);
+    return EXIT_INVALID_USAGE;
+}
@@ -70,6 +70,11 @@ usage(void)
            "    Compile an XKB keymap\n"
            "\n"
 #endif
+#if HAVE_XKBCLI_RESOLVE_RMLVO
+           "  resolve-rmlvo\n"
+           "    Resolve RMLVO names to KcCGST components\n"
+           "\n"
+#endif
 #if HAVE_XKBCLI_COMPILE_COMPOSE
            "  compile-compose\n"
            "    Compile a Compose file\n"